@@ -0,0 +1,347 @@
+/* ***************************************************************************
+ functions in this (BatchTrans_Class.hpp) hpp file:
+ 
+ (1) BatchTrans(char* save_dir);
+ * Every result is saved as save_dir/<file name of the input>.
+ 
+ (2) void SetOps(const char* op_chain);
+ * may throw: BATCH_BAD_OPS, PIPELINE_TOO_MANY_OPS.
+ * op_chain: operations separated by ',', arguments by ':', e.g.
+ *     gray,stretch:exp:128:2:0.6,zoom:1920x1080:bicubic
+ *     gray | binary[:threshold] | reverse
+ *     stretch:log[:a:b:c] | stretch:exp[:a:b:c]
+ *     zoom:<width>x<height>[:algorithm]
+ *     rotate:<degree>[:algorithm[:color_default[:cut]]]
+ * algorithm: 1 ~ 6 as in GeometryTrans, or nearest (1), bilinear (2), bicubic (3),
+ * fast-bilinear (4), fast-bicubic (5), area (6, zoom only). Arguments left out take the defaults of ColorTrans / GeometryTrans.
+ * pack (only as the last one): save a gray result as a 1-bit BMP, pixels >= 128 white (see BitMapImg <SetPacked>),
+ * e.g. gray,binary:140,pack for scanned documents: 1/8 of the file.
+ * A color result fails its file with IMG_NOT_GRAY.
+ 
+ (3) void AddInput(const char* input);
+ * may throw: WRONG_FILE_PATH.
+ * input: a BMP file, a directory (all the *.bmp in it, in name order),
+ * or @list_file (one path per line).
+ 
+ (4) long Run(void);
+ * Process all inputs, on GetThreadCount() worker threads (see <SetThreadCount>),
+ * every worker takes the next file: read -> PipelineTrans -> save (<BitMapImg::SaveToBmp>).
+ * While one worker reads or saves, the others compute, so the stages overlap,
+ * and at most one image per worker is in memory.
+ * The tiles inside one image run in its worker (the pool is busy), not in more threads.
+ * Print one line per file, the total throughput (images/s, MB/s of input and output)
+ * and the hit rate of the pixel pool (see <PixelPoolReport>).
+ * Return how many files failed (their error codes are printed, the others go on).
+ * A std::exception of a file (e.g. std::bad_alloc on a huge or broken input) fails that file only,
+ * as BATCH_EXCEPTION with its what().
+ 
+ (5) static void BatchFile(long file_index, void* context);
+ * tile_function of <RunTiles>, context is the BatchTrans.
+ 
+ (6) static int ParseAlgorithm(const char* text, int max_algorithm);
+ * "1" ~ "6" or a name of (2), 0 if unknown.
+ *****************************************************************************/
+
+#ifndef BatchTrans_Class_hpp
+#define BatchTrans_Class_hpp
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define BATCH_DIRECT_IO_BYTES   (256UL << 20)   //larger outputs are saved with direct_io, see <BitMapImg::SaveToBmp>.
+
+typedef struct struct_BatchResult {
+    int error;  //0: done, else the error code thrown.
+    char what[64];  //error BATCH_EXCEPTION: what() of the std::exception.
+    long org_width, org_height;
+    long out_width, out_height;
+    unsigned long read_bytes;
+    unsigned long save_bytes;
+    double read_time;   //seconds
+    double compute_time;
+    double save_time;
+} BatchResult;
+
+class BatchTrans {
+//data:
+private:
+    std::string save_dir;
+    StreamOp op_list[PIPELINE_MAX_OPS];
+    int op_count;
+    bool save_packed;   //the last op is "pack"
+    std::vector<std::string> file_list;
+    std::vector<BatchResult> result_list;
+    
+//functions:
+public:
+    BatchTrans(char* save_dir) {
+        this->save_dir = save_dir;
+        op_count = 0;
+        save_packed = false;
+    }
+    void SetOps(const char* op_chain);
+    void AddInput(const char* input);
+    long Run(void);
+    
+private:
+    static void BatchFile(long file_index, void* context);
+    static int ParseAlgorithm(const char* text, int max_algorithm);
+    static double Seconds(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+
+
+void BatchTrans::SetOps(const char* op_chain) {
+    std::string chain = op_chain;
+    std::vector<std::string> field;
+    size_t op_first = 0, op_last, arg_first, arg_last;
+    StreamOp op;
+    
+    op_count = 0;
+    save_packed = false;
+    while (op_first <= chain.size()) {
+        op_last = chain.find(',', op_first);
+        if (std::string::npos == op_last)
+            op_last = chain.size();
+        
+        //fields of one operation:
+        field.clear();
+        for (arg_first = op_first; arg_first <= op_last; arg_first = arg_last + 1) {
+            arg_last = chain.find(':', arg_first);
+            if (std::string::npos == arg_last || arg_last > op_last)
+                arg_last = op_last;
+            field.push_back(chain.substr(arg_first, arg_last - arg_first));
+        }
+        op_first = op_last + 1;
+        
+        memset(&op, 0, sizeof(op));
+        if ("pack" == field[0] && 1 == field.size() && op_last == chain.size()) {
+            //not an operation of the pipeline, the result is packed after <PipelineTrans::Run>.
+            save_packed = true;
+            continue;
+        }
+        else if ("gray" == field[0] && 1 == field.size()) {
+            op.op_code = STREAM_OP_GRAY;
+        }
+        else if ("binary" == field[0] && field.size() <= 2) {
+            op.op_code = STREAM_OP_BINARY;
+            op.arg[0] = field.size() > 1 ? atoi(field[1].c_str()) : 128;
+        }
+        else if ("reverse" == field[0] && 1 == field.size()) {
+            op.op_code = STREAM_OP_REVERSE;
+        }
+        else if ("stretch" == field[0] && field.size() >= 2 && field.size() <= 5 && ("log" == field[1] || "exp" == field[1])) {
+            //defaults of <ColorTrans::LogarithmStretch>, <ColorTrans::ExponentStretch>:
+            double log_default[3] = {0, 0.033, 2};
+            double exp_default[3] = {128, 2, 0.6};
+            op.op_code = ("log" == field[1]) ? STREAM_OP_LOG : STREAM_OP_EXP;
+            for (int i = 0; i < 3; i++) {
+                if (i + 2 < (int)field.size())
+                    op.arg[i] = atof(field[i + 2].c_str());
+                else
+                    op.arg[i] = (STREAM_OP_LOG == op.op_code) ? log_default[i] : exp_default[i];
+            }
+        }
+        else if ("zoom" == field[0] && field.size() >= 2 && field.size() <= 3) {
+            long zoom_width = 0, zoom_height = 0;
+            if (2 != sscanf(field[1].c_str(), "%ldx%ld", &zoom_width, &zoom_height) || zoom_width <= 0 || zoom_height <= 0)
+                throw BATCH_BAD_OPS;
+            op.op_code = PIPELINE_OP_ZOOM;
+            op.arg[0] = zoom_width;
+            op.arg[1] = zoom_height;
+            op.arg[2] = field.size() > 2 ? ParseAlgorithm(field[2].c_str(), 6) : 1;
+            if (0 == op.arg[2])
+                throw BATCH_BAD_OPS;
+        }
+        else if ("rotate" == field[0] && field.size() >= 2 && field.size() <= 5) {
+            op.op_code = PIPELINE_OP_ROTATE;
+            op.arg[0] = atof(field[1].c_str());
+            op.arg[1] = field.size() > 2 ? ParseAlgorithm(field[2].c_str(), 3) : 1;
+            op.arg[2] = field.size() > 3 ? atoi(field[3].c_str()) : 255;
+            op.arg[3] = field.size() > 4 ? atoi(field[4].c_str()) : 0;
+            if (0 == op.arg[1])
+                throw BATCH_BAD_OPS;
+        }
+        else {
+            throw BATCH_BAD_OPS;
+        }
+        
+        if (op_count >= PIPELINE_MAX_OPS)
+            throw PIPELINE_TOO_MANY_OPS;
+        op_list[op_count] = op;
+        op_count++;
+    }
+}
+
+int BatchTrans::ParseAlgorithm(const char* text, int max_algorithm) {
+    const char* name[6] = {"nearest", "bilinear", "bicubic", "fast-bilinear", "fast-bicubic", "area"};
+    int algorithm = 0;
+    
+    for (int i = 0; i < 6; i++) {
+        if (0 == strcmp(text, name[i]))
+            algorithm = i + 1;
+    }
+    if (text[0] >= '1' && text[0] <= '6' && '\0' == text[1])
+        algorithm = text[0] - '0';
+    return algorithm <= max_algorithm ? algorithm : 0;
+}
+
+void BatchTrans::AddInput(const char* input) {
+    struct stat input_stat;
+    std::vector<std::string> dir_list;
+    std::string name;
+    
+    if ('@' == input[0]) {
+        FILE* list_file = fopen(input + 1, "r");
+        char line[4096];
+        if (NULL == list_file)
+            throw WRONG_FILE_PATH;
+        while (NULL != fgets(line, sizeof(line), list_file)) {
+            line[strcspn(line, "\r\n")] = '\0';
+            if ('\0' != line[0])
+                file_list.push_back(line);
+        }
+        fclose(list_file);
+        return;
+    }
+    
+    if (0 != stat(input, &input_stat))
+        throw WRONG_FILE_PATH;
+    if (!S_ISDIR(input_stat.st_mode)) {
+        file_list.push_back(input);
+        return;
+    }
+    
+    DIR* dir = opendir(input);
+    struct dirent* entry;
+    if (NULL == dir)
+        throw WRONG_FILE_PATH;
+    while (NULL != (entry = readdir(dir))) {
+        name = entry->d_name;
+        if (name.size() > 4 && 0 == strcasecmp(name.c_str() + name.size() - 4, ".bmp"))
+            dir_list.push_back(std::string(input) + "/" + name);
+    }
+    closedir(dir);
+    std::sort(dir_list.begin(), dir_list.end());
+    file_list.insert(file_list.end(), dir_list.begin(), dir_list.end());
+}
+
+long BatchTrans::Run(void) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double total_time;
+    unsigned long read_bytes = 0, save_bytes = 0;
+    long failed = 0, done = 0;
+    
+    result_list.assign(file_list.size(), BatchResult());
+    RunTiles((long)file_list.size(), BatchFile, this);
+    total_time = Seconds(start);
+    
+    for (size_t i = 0; i < file_list.size(); i++) {
+        const BatchResult &result = result_list[i];
+        if (0 != result.error) {
+            if (BATCH_EXCEPTION == result.error)
+                printf("%s: error code: 0x%08X (%s)\n", file_list[i].c_str(), result.error, result.what);
+            else
+                printf("%s: error code: 0x%08X\n", file_list[i].c_str(), result.error);
+            failed++;
+            continue;
+        }
+        printf("%s: %ldx%ld -> %ldx%ld, read %.1f ms, compute %.1f ms, save %.1f ms\n", file_list[i].c_str(),
+               result.org_width, result.org_height, result.out_width, result.out_height,
+               result.read_time * 1000, result.compute_time * 1000, result.save_time * 1000);
+        read_bytes += result.read_bytes;
+        save_bytes += result.save_bytes;
+        done++;
+    }
+    printf("%ld images (%ld failed) in %.3f s on %d threads: %.2f images/s, read %.1f MB/s, save %.1f MB/s\n",
+           done, failed, total_time, GetThreadCount(), done / total_time,
+           read_bytes / total_time / 1e6, save_bytes / total_time / 1e6);
+    PixelPoolReport(stdout);
+    return failed;
+}
+
+void BatchTrans::BatchFile(long file_index, void* context) {
+    BatchTrans* batch = (BatchTrans*)context;
+    BatchResult &result = batch->result_list[file_index];
+    std::string read_path = batch->file_list[file_index];
+    std::string save_path = batch->save_dir + "/" + read_path.substr(read_path.find_last_of('/') + 1);
+    PipelineTrans* pipeline = NULL;
+    std::chrono::steady_clock::time_point start;
+    struct stat read_stat;
+    bmpData org_bmp;
+    int bit_count;
+    
+    memset(&result, 0, sizeof(result));
+    try {
+        start = std::chrono::steady_clock::now();
+        org_bmp = ReadBmp_Mapped((char*)read_path.c_str());
+        if (0 == stat(read_path.c_str(), &read_stat))
+            result.read_bytes = read_stat.st_size;   //bmp_mapped_length is 0 when the file was read, not mapped
+        pipeline = new PipelineTrans(org_bmp);
+        result.org_width = pipeline->GetWidth();
+        result.org_height = pipeline->GetHeight();
+        result.read_time = Seconds(start);
+        
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < batch->op_count; i++) {
+            const StreamOp &op = batch->op_list[i];
+            switch (op.op_code) {
+                case STREAM_OP_GRAY:
+                    pipeline->ColorToGray();
+                    break;
+                case STREAM_OP_BINARY:
+                    pipeline->Binary((int)op.arg[0]);
+                    break;
+                case STREAM_OP_REVERSE:
+                    pipeline->Reverse();
+                    break;
+                case STREAM_OP_LOG:
+                    pipeline->LogarithmStretch(op.arg[0], op.arg[1], op.arg[2]);
+                    break;
+                case STREAM_OP_EXP:
+                    pipeline->ExponentStretch(op.arg[0], op.arg[1], op.arg[2]);
+                    break;
+                case PIPELINE_OP_ZOOM:
+                    pipeline->Zoom((long)op.arg[0], (long)op.arg[1], (int)op.arg[2]);
+                    break;
+                case PIPELINE_OP_ROTATE:
+                    pipeline->Rotate(op.arg[0], (int)op.arg[1], (unsigned char)op.arg[2], op.arg[3] != 0);
+                    break;
+            }
+        }
+        pipeline->Run();
+        if (batch->save_packed)
+            pipeline->SetPacked(true);
+        result.out_width = pipeline->GetWidth();
+        result.out_height = pipeline->GetHeight();
+        result.compute_time = Seconds(start);
+        
+        start = std::chrono::steady_clock::now();
+        bit_count = pipeline->GetPacked() ? 1 : (pipeline->GetGrayForm() ? 8 : 24);
+        result.save_bytes = 54 + (bit_count <= 8 ? 4 << bit_count : 0)
+                          + (result.out_width * bit_count + 31) / 32 * 4 * result.out_height;
+        pipeline->SaveToBmp((char*)save_path.c_str(), result.save_bytes >= BATCH_DIRECT_IO_BYTES);
+        delete pipeline;
+        pipeline = NULL;
+        result.save_time = Seconds(start);
+    } catch (const int error) {
+        result.error = error;
+        delete pipeline;
+    } catch (const std::exception &exception) {
+        result.error = BATCH_EXCEPTION;
+        snprintf(result.what, sizeof(result.what), "%s", exception.what());
+        delete pipeline;
+    }
+}
+
+#endif /* BatchTrans_Class_hpp */
@@ -0,0 +1,602 @@
+/* ***************************************************************************
+ functions in this (Benchmark_Class.hpp) hpp file:
+ 
+ (1) Benchmark(double max_megapixels = 12, const char* filter = "", double min_time = 0.5);
+ * Synthetic images of VGA (640x480), 1080p (1920x1080), 12 MP (4000x3000) and 100 MP (10000x10000),
+ * only the sizes up to max_megapixels are run (100 MP needs about 2 GB of memory).
+ * filter: only run the benchmarks whose name contains it ("" runs all).
+ * min_time: seconds of timed work for every benchmark, at least one iteration.
+ 
+ (2) void Run(void);
+ * may throw: WRONG_FILE_PATH, WRITE_IN_ERROR (the temporary BMP files in temp_dir).
+ * Run every benchmark on every size, print one line each (Google Benchmark like), named <operation>/<size>/<form>:
+ *     ReadBmp, ReadBmp_Mapped (until the pixels are in a BitMapImg, i.e. with <StandardizeBMP>),
+ *     (ReadBmp_Mapped of bgr is zero-copy, its pages are only read later, when the pixels are touched),
+ *     StandardizeBMP of 1, 4, 8, 16 (5-5-5), 24 and 32-bit data, TransToBmp, SaveBmp, SaveToBmp, SaveToBmp_Direct,
+ *     ColorToGray, Binary, Reverse, LogarithmStretch, ExponentStretch, ApplyLut, Histogram, Equalize, AutoContrast,
+ *     Binary_Otsu, Binary_Sauvola, Binary_Bradley (default windows, see ColorTrans <Binary>), Binary_Packed (threshold 128, packed),
+ *     Zoom_1 ~ Zoom_6 (to 5/4 of the size), ZoomOut_1 ~ ZoomOut_6 (to 1/8 of the size), Rotate_90, Rotate_180, Rotate_270, Rotate_30_1 ~ Rotate_30_3.
+ * ReadBmp, ReadBmp_RLE8, SaveBmp and SaveBmp_RLE8 run on a binarized gray image too (form binary), BI_RGB against BI_RLE8,
+ * and TransToBmp, SaveToBmp, Reverse, Histogram, Rotate_90 / 180 / 270 on it packed (form packed, see BitMapImg <SetPacked>, 1-bit output).
+ * form: gray (8-bit), bgr (24-bit) or planar (bgr made planar before the timing, see BitMapImg <SetPlanar>,
+ * without ReadBmp); StandardizeBMP uses the bit count instead.
+ * ns/pixel is per output pixel for Zoom and Rotate, per input pixel for the others (ZoomOut too).
+ * GB/s counts the bytes read and written by the operation (arrays or files).
+ 
+ (3) void SaveJson(const char* json_path);
+ * may throw: WRONG_FILE_PATH.
+ * Save the results of <Run> in the JSON form of Google Benchmark ("context" and "benchmarks"),
+ * real_time is ns per iteration, with ns_per_pixel and bytes_per_second as counters,
+ * so two runs (e.g. two releases) can be compared by the usual tools.
+ 
+ (4) static bmpData MakeBmp(long width, long height, unsigned short bit_count, bool gray);
+ * A synthetic bmpData (rows padded to 4 bytes, like <ReadBmp>), delete it by <DeleteBmpData>.
+ * Smooth gradients with some noise; gray: 8-bit with a gray color table, else colorful.
+ 
+ (5) static double Bench_xxx(BenchCase &bench);
+ * One iteration of a benchmark: set up (not timed), run the operation, clean up (not timed).
+ * Return the timed seconds, and set bench.pixels / bench.bytes of this iteration.
+ *****************************************************************************/
+
+#ifndef Benchmark_Class_hpp
+#define Benchmark_Class_hpp
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <unistd.h>
+
+//operation of Bench_Color:
+#define BENCH_OP_GRAY       1
+#define BENCH_OP_BINARY     2
+#define BENCH_OP_REVERSE    3
+#define BENCH_OP_LOG        4
+#define BENCH_OP_EXP        5
+#define BENCH_OP_LUT        6
+#define BENCH_OP_HISTOGRAM  7
+#define BENCH_OP_EQUALIZE   8
+#define BENCH_OP_AUTOCONTRAST   9
+#define BENCH_OP_OTSU       10
+#define BENCH_OP_SAUVOLA    11
+#define BENCH_OP_BRADLEY    12
+#define BENCH_OP_PACK       13
+
+typedef struct struct_BenchCase {
+    const bmpData* source;  //padded, as from <ReadBmp>
+    char* file_path;        //a BMP file of source (ReadBmp), or the file to write (SaveBmp)
+    int arg;                //BENCH_OP_xxx, algorithm, degree, direct_io, compression (SaveBmp) or 1 / ratio (Zoom)
+    int algorithm;
+    bool planar;            //the image is made planar (not timed)
+    bool packed;            //the image is packed (not timed)
+    double pixels;          //of the last iteration
+    double bytes;
+} BenchCase;
+
+typedef struct struct_BenchResult {
+    std::string name;
+    long iterations;
+    double seconds;         //timed, of all iterations
+    double pixels;          //of one iteration
+    double bytes;
+} BenchResult;
+
+class Benchmark {
+//data:
+private:
+    double max_megapixels;
+    std::string filter;
+    double min_time;
+    std::string temp_dir;
+    std::vector<BenchResult> result_list;
+    
+//functions:
+public:
+    Benchmark(double max_megapixels = 12, const char* filter = "", double min_time = 0.5) {
+        const char* tmp = getenv("TMPDIR");
+        this->max_megapixels = max_megapixels;
+        this->filter = filter;
+        this->min_time = min_time;
+        temp_dir = (NULL != tmp && '\0' != tmp[0]) ? tmp : "/tmp";
+    }
+    void Run(void);
+    void SaveJson(const char* json_path);
+    
+    static bmpData MakeBmp(long width, long height, unsigned short bit_count, bool gray);
+    
+private:
+    typedef double (*BenchFunction)(BenchCase &bench);
+    void RunCase(const std::string &name, BenchFunction function, BenchCase &bench);
+    bool Selected(const std::string &name) {
+        return filter.empty() || std::string::npos != name.find(filter);
+    }
+    
+    static double Bench_ReadBmp(BenchCase &bench);
+    static double Bench_ReadBmp_Mapped(BenchCase &bench);
+    static double Bench_Standardize(BenchCase &bench);
+    static double Bench_TransToBmp(BenchCase &bench);
+    static double Bench_SaveBmp(BenchCase &bench);
+    static double Bench_SaveToBmp(BenchCase &bench);
+    static double Bench_Color(BenchCase &bench);
+    static double Bench_Zoom(BenchCase &bench);
+    static double Bench_Rotate(BenchCase &bench);
+    
+    static double ArrayBytes(BitMapImg &img) {
+        if (img.GetPacked())
+            return (double)((img.GetWidth() + 31) / 32 * 4) * img.GetHeight();
+        return (double)img.GetWidth() * img.GetHeight() * (img.GetGrayForm() ? 1 : 3);
+    }
+    static double FileBytes(const bmpData &bmp) {
+        return 54 + (bmp.bmp_BitCount <= 8 ? 4 << bmp.bmp_BitCount : 0) + (double)bmp.bmp_data_length;
+    }
+    static double Seconds(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+
+
+void Benchmark::Run(void) {
+    const long size_list[4][2] = {{640, 480}, {1920, 1080}, {4000, 3000}, {10000, 10000}};
+    const unsigned short bit_list[6] = {1, 4, 8, 16, 24, 32};
+    const char* form_name[3] = {"gray", "bgr", "planar"};
+    const char* color_name[13] = {"ColorToGray", "Binary", "Reverse", "LogarithmStretch", "ExponentStretch", "ApplyLut",
+                                  "Histogram", "Equalize", "AutoContrast", "Binary_Otsu", "Binary_Sauvola", "Binary_Bradley", "Binary_Packed"};
+    const char* packed_name[7] = {"TransToBmp", "SaveToBmp", "Reverse", "Histogram", "Rotate_90", "Rotate_180", "Rotate_270"};
+    char size_name[32];
+    std::string read_path, save_path, prefix, packed_prefix;
+    bool packed_selected;
+    BenchCase bench;
+    bmpData source;
+    
+    result_list.clear();
+    printf("%-40s %14s %12s %10s %8s\n", "Benchmark", "Time", "Iterations", "ns/pixel", "GB/s");
+    printf("------------------------------------------------------------------------------------------\n");
+    
+    for (int s = 0; s < 4; s++) {
+        long width = size_list[s][0], height = size_list[s][1];
+        if (width * height > max_megapixels * 1e6)
+            continue;
+        snprintf(size_name, sizeof(size_name), "%ldx%ld", width, height);
+        read_path = temp_dir + "/bench_" + size_name + ".bmp";
+        save_path = temp_dir + "/bench_" + size_name + "-out.bmp";
+        memset(&bench, 0, sizeof(bench));
+        
+        for (int b = 0; b < 6; b++) {
+            source = MakeBmp(width, height, bit_list[b], false);
+            bench.source = &source;
+            RunCase(std::string("StandardizeBMP/") + size_name + "/" + std::to_string(bit_list[b]) + "bit", Bench_Standardize, bench);
+            DeleteBmpData(source);
+        }
+        
+        prefix = std::string("/") + size_name + "/binary";
+        packed_prefix = std::string("/") + size_name + "/packed";
+        packed_selected = false;
+        for (int i = 0; i < 7; i++)
+            packed_selected = packed_selected || Selected(packed_name[i] + packed_prefix);
+        if (Selected("ReadBmp" + prefix) || Selected("ReadBmp_RLE8" + prefix) || Selected("SaveBmp" + prefix) || Selected("SaveBmp_RLE8" + prefix)
+            || packed_selected) {
+            //a binarized gray image, long runs: BI_RGB against BI_RLE8, and packed to 1 bit per pixel.
+            source = MakeBmp(width, height, 8, true);
+            ColorTrans* binary_img = new ColorTrans(source);
+            DeleteBmpData(source);
+            binary_img->Binary(128);
+            source = binary_img->TransToBmp();
+            delete binary_img;
+            bench.source = &source;
+            for (int c = 0; c < 2; c++) {
+                std::string rle_name = (0 == c) ? "" : "_RLE8";
+                bench.arg = (0 == c) ? BI_RGB : BI_RLE8;
+                if (Selected("ReadBmp" + rle_name + prefix)) {
+                    BitMapImg* img = new BitMapImg(source);
+                    SaveBmp((char*)read_path.c_str(), img->TransToBmp(), bench.arg);
+                    delete img;
+                    bench.file_path = (char*)read_path.c_str();
+                    RunCase("ReadBmp" + rle_name + prefix, Bench_ReadBmp, bench);
+                    unlink(read_path.c_str());
+                }
+                bench.file_path = (char*)save_path.c_str();
+                RunCase("SaveBmp" + rle_name + prefix, Bench_SaveBmp, bench);
+                unlink(save_path.c_str());
+            }
+            
+            bench.packed = true;
+            RunCase("TransToBmp" + packed_prefix, Bench_TransToBmp, bench);
+            bench.arg = 0;
+            RunCase("SaveToBmp" + packed_prefix, Bench_SaveToBmp, bench);
+            unlink(save_path.c_str());
+            bench.arg = BENCH_OP_REVERSE;
+            RunCase("Reverse" + packed_prefix, Bench_Color, bench);
+            bench.arg = BENCH_OP_HISTOGRAM;
+            RunCase("Histogram" + packed_prefix, Bench_Color, bench);
+            for (int degree = 90; degree <= 270; degree += 90) {
+                bench.arg = degree;
+                bench.algorithm = 1;
+                RunCase("Rotate_" + std::to_string(degree) + packed_prefix, Bench_Rotate, bench);
+            }
+            bench.packed = false;
+            DeleteBmpData(source);
+        }
+        
+        for (int f = 0; f < 3; f++) {
+            prefix = std::string("/") + size_name + "/" + form_name[f];
+            source = MakeBmp(width, height, 0 == f ? 8 : 24, 0 == f);
+            bench.source = &source;
+            bench.planar = (2 == f);
+            
+            if (!bench.planar && (Selected("ReadBmp" + prefix) || Selected("ReadBmp_Mapped" + prefix))) {
+                BitMapImg* img = new BitMapImg(source);
+                SaveBmp((char*)read_path.c_str(), img->TransToBmp());
+                delete img;
+                bench.file_path = (char*)read_path.c_str();
+                RunCase("ReadBmp" + prefix, Bench_ReadBmp, bench);
+                RunCase("ReadBmp_Mapped" + prefix, Bench_ReadBmp_Mapped, bench);
+                unlink(read_path.c_str());
+            }
+            
+            bench.file_path = (char*)save_path.c_str();
+            RunCase("TransToBmp" + prefix, Bench_TransToBmp, bench);
+            bench.arg = BI_RGB;
+            RunCase("SaveBmp" + prefix, Bench_SaveBmp, bench);
+            bench.arg = 0;
+            RunCase("SaveToBmp" + prefix, Bench_SaveToBmp, bench);
+            bench.arg = 1;
+            RunCase("SaveToBmp_Direct" + prefix, Bench_SaveToBmp, bench);
+            unlink(save_path.c_str());
+            
+            for (int op = BENCH_OP_GRAY; op <= BENCH_OP_PACK; op++) {
+                if (BENCH_OP_GRAY == op && 0 == f)
+                    continue;
+                bench.arg = op;
+                RunCase(color_name[op - 1] + prefix, Bench_Color, bench);
+            }
+            for (int algorithm = 1; algorithm <= 6; algorithm++) {
+                bench.algorithm = algorithm;
+                bench.arg = 0;
+                RunCase("Zoom_" + std::to_string(algorithm) + prefix, Bench_Zoom, bench);
+                bench.arg = 8;
+                RunCase("ZoomOut_" + std::to_string(algorithm) + prefix, Bench_Zoom, bench);
+            }
+            for (int degree = 90; degree <= 270; degree += 90) {
+                bench.arg = degree;
+                bench.algorithm = 1;
+                RunCase("Rotate_" + std::to_string(degree) + prefix, Bench_Rotate, bench);
+            }
+            for (int algorithm = 1; algorithm <= 3; algorithm++) {
+                bench.arg = 30;
+                bench.algorithm = algorithm;
+                RunCase("Rotate_30_" + std::to_string(algorithm) + prefix, Bench_Rotate, bench);
+            }
+            DeleteBmpData(source);
+        }
+        bench.planar = false;
+    }
+}
+
+void Benchmark::RunCase(const std::string &name, BenchFunction function, BenchCase &bench) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    BenchResult result;
+    
+    if (!Selected(name))
+        return;
+    
+    //setup is not timed, but it is limited too: large images stop after a few iterations.
+    result.name = name;
+    result.iterations = 0;
+    result.seconds = 0;
+    do {
+        result.seconds += function(bench);
+        result.iterations++;
+    } while (result.seconds < min_time && Seconds(start) < min_time * 4);
+    result.pixels = bench.pixels;
+    result.bytes = bench.bytes;
+    result_list.push_back(result);
+    
+    printf("%-40s %11.3f ms %12ld %10.3f %8.3f\n", name.c_str(), result.seconds / result.iterations * 1e3, result.iterations,
+           result.seconds / result.iterations / result.pixels * 1e9, result.bytes * result.iterations / result.seconds / 1e9);
+    fflush(stdout);
+}
+
+void Benchmark::SaveJson(const char* json_path) {
+    FILE* json_file = fopen(json_path, "w");
+    char date[64];
+    time_t now = time(NULL);
+    
+    if (NULL == json_file)
+        throw WRONG_FILE_PATH;
+    
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+    fprintf(json_file, "{\n  \"context\": {\n");
+    fprintf(json_file, "    \"date\": \"%s\",\n", date);
+    fprintf(json_file, "    \"num_cpus\": %ld,\n", sysconf(_SC_NPROCESSORS_ONLN));
+    fprintf(json_file, "    \"threads\": %d,\n", GetThreadCount());
+    fprintf(json_file, "    \"simd_level\": %d,\n", GetSimdLevel());
+    fprintf(json_file, "    \"max_megapixels\": %g,\n", max_megapixels);
+    fprintf(json_file, "    \"min_time\": %g\n  },\n", min_time);
+    fprintf(json_file, "  \"benchmarks\": [\n");
+    for (size_t i = 0; i < result_list.size(); i++) {
+        const BenchResult &result = result_list[i];
+        double time = result.seconds / result.iterations;
+        fprintf(json_file, "    {\n");
+        fprintf(json_file, "      \"name\": \"%s\",\n", result.name.c_str());
+        fprintf(json_file, "      \"run_type\": \"iteration\",\n");
+        fprintf(json_file, "      \"iterations\": %ld,\n", result.iterations);
+        fprintf(json_file, "      \"real_time\": %.6e,\n", time * 1e9);
+        fprintf(json_file, "      \"time_unit\": \"ns\",\n");
+        fprintf(json_file, "      \"pixels\": %.0f,\n", result.pixels);
+        fprintf(json_file, "      \"ns_per_pixel\": %.6e,\n", time / result.pixels * 1e9);
+        fprintf(json_file, "      \"bytes_per_second\": %.6e\n", result.bytes / time);
+        fprintf(json_file, "    }%s\n", i + 1 < result_list.size() ? "," : "");
+    }
+    fprintf(json_file, "  ]\n}\n");
+    fclose(json_file);
+}
+
+bmpData Benchmark::MakeBmp(long width, long height, unsigned short bit_count, bool gray) {
+    long line_byte = (width * bit_count + 31) / 32 * 4;
+    unsigned int noise = 2463534242u;
+    unsigned char value;
+    bmpData output;
+    long x, y;
+    
+    output.bmp_Width = width;
+    output.bmp_Height = height;
+    output.bmp_BitCount = bit_count;
+    output.bmp_Compression = BI_RGB;
+    output.bmp_data_length = line_byte * height;
+    output.bmp_mapped_base = NULL;
+    output.bmp_mapped_length = 0;
+    output.bmp_color_table = NULL;
+    output.bmp_data_array = PixelAlloc(line_byte * height);
+    memset(output.bmp_data_array, 0, line_byte * height);
+    
+    if (bit_count <= 8) {
+        output.bmp_color_table = new RgbQuad[256]();
+        for (x = 0; x < (1 << bit_count); x++) {
+            value = (unsigned char)(x * 255 / ((1 << bit_count) - 1));
+            output.bmp_color_table[x].rgbBlue = value;
+            output.bmp_color_table[x].rgbGreen = gray ? value : (unsigned char)(255 - value);
+            output.bmp_color_table[x].rgbRed = gray ? value : (unsigned char)(value * 7);
+        }
+    }
+    
+    for (y = 0; y < height; y++) {
+        unsigned char* row = output.bmp_data_array + y * line_byte;
+        for (x = 0; x < width; x++) {
+            //xorshift32:
+            noise ^= noise << 13;
+            noise ^= noise >> 17;
+            noise ^= noise << 5;
+            value = (unsigned char)((x * 255 / width + y * 255 / height) / 2 + (noise & 15));
+            
+            switch (bit_count) {
+                case 1:
+                    row[x / 8] |= (value >> 7) << (7 - x % 8);
+                    break;
+                case 4:
+                    row[x / 2] |= (value >> 4) << (x % 2 ? 0 : 4);
+                    break;
+                case 8:
+                    row[x] = value;
+                    break;
+                case 16:
+                    //5-5-5: the top 5 bits of B, G, R as below.
+                    row[x * 2] = (unsigned char)((value >> 3) | ((x * 255 / width) >> 3) << 5);
+                    row[x * 2 + 1] = (unsigned char)(((x * 255 / width) >> 6) | ((y * 255 / height) >> 3) << 2);
+                    break;
+                case 24:
+                case 32:
+                    row[x * (bit_count / 8)] = value;
+                    row[x * (bit_count / 8) + 1] = (unsigned char)(x * 255 / width);
+                    row[x * (bit_count / 8) + 2] = (unsigned char)(y * 255 / height);
+                    break;
+            }
+        }
+    }
+    return output;
+}
+
+double Benchmark::Bench_ReadBmp(BenchCase &bench) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bmpData org_bmp = ReadBmp(bench.file_path);
+    BitMapImg* img = new BitMapImg(org_bmp);
+    double seconds = Seconds(start);
+    
+    bench.pixels = (double)img->GetWidth() * img->GetHeight();
+    bench.bytes = FileBytes(org_bmp) + ArrayBytes(*img);
+    DeleteBmpData(org_bmp);
+    delete img;
+    return seconds;
+}
+
+double Benchmark::Bench_ReadBmp_Mapped(BenchCase &bench) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bmpData org_bmp = ReadBmp_Mapped(bench.file_path);
+    double file_bytes = FileBytes(org_bmp);
+    BitMapImg* img = new BitMapImg(org_bmp);    //consumes org_bmp
+    double seconds = Seconds(start);
+    
+    bench.pixels = (double)img->GetWidth() * img->GetHeight();
+    bench.bytes = file_bytes + ArrayBytes(*img);
+    delete img;
+    return seconds;
+}
+
+double Benchmark::Bench_Standardize(BenchCase &bench) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    BitMapImg* img = new BitMapImg(*bench.source);
+    double seconds = Seconds(start);
+    
+    bench.pixels = (double)img->GetWidth() * img->GetHeight();
+    bench.bytes = FileBytes(*bench.source) + ArrayBytes(*img);
+    delete img;
+    return seconds;
+}
+
+double Benchmark::Bench_TransToBmp(BenchCase &bench) {
+    BitMapImg* img = new BitMapImg(*bench.source);
+    if (bench.planar)
+        img->SetPlanar(true);
+    if (bench.packed)
+        img->SetPacked(true);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bmpData out_bmp = img->TransToBmp();
+    double seconds = Seconds(start);
+    
+    bench.pixels = (double)img->GetWidth() * img->GetHeight();
+    bench.bytes = ArrayBytes(*img) + FileBytes(out_bmp);
+    DeleteBmpData(out_bmp);
+    delete img;
+    return seconds;
+}
+
+double Benchmark::Bench_SaveBmp(BenchCase &bench) {
+    BitMapImg* img = new BitMapImg(*bench.source);
+    if (bench.planar)
+        img->SetPlanar(true);
+    if (bench.packed)
+        img->SetPacked(true);
+    bmpData out_bmp = img->TransToBmp();
+    double file_bytes = FileBytes(out_bmp);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    SaveBmp(bench.file_path, out_bmp, bench.arg);
+    double seconds = Seconds(start);
+    
+    bench.pixels = (double)img->GetWidth() * img->GetHeight();
+    bench.bytes = file_bytes;
+    delete img;
+    return seconds;
+}
+
+double Benchmark::Bench_SaveToBmp(BenchCase &bench) {
+    BitMapImg* img = new BitMapImg(*bench.source);
+    if (bench.planar)
+        img->SetPlanar(true);
+    if (bench.packed)
+        img->SetPacked(true);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    img->SaveToBmp(bench.file_path, 0 != bench.arg);
+    double seconds = Seconds(start);
+    
+    bench.pixels = (double)img->GetWidth() * img->GetHeight();
+    int bit_count = img->GetPacked() ? 1 : (img->GetGrayForm() ? 8 : 24);
+    bench.bytes = ArrayBytes(*img) + 54 + (bit_count <= 8 ? 4 << bit_count : 0)
+                + (double)((img->GetWidth() * bit_count + 31) / 32 * 4) * img->GetHeight();
+    delete img;
+    return seconds;
+}
+
+double Benchmark::Bench_Color(BenchCase &bench) {
+    ColorTrans* img = new ColorTrans(*bench.source);
+    if (bench.planar)
+        img->SetPlanar(true);
+    if (bench.packed)
+        img->SetPacked(true);
+    double org_bytes = ArrayBytes(*img);
+    unsigned char lut[256];
+    Histogram histogram;
+    std::chrono::steady_clock::time_point start;
+    double seconds;
+    
+    Lut_Identity(lut);
+    Lut_Reverse(lut);
+    Lut_ExponentStretch(lut, 128, 2, 0.6);
+    start = std::chrono::steady_clock::now();
+    switch (bench.arg) {
+        case BENCH_OP_GRAY:
+            img->ColorToGray();
+            break;
+        case BENCH_OP_BINARY:
+            img->Binary(128);
+            break;
+        case BENCH_OP_REVERSE:
+            img->Reverse();
+            break;
+        case BENCH_OP_LOG:
+            img->LogarithmStretch(0, 0.033, 2);
+            break;
+        case BENCH_OP_EXP:
+            img->ExponentStretch(128, 2, 0.6);
+            break;
+        case BENCH_OP_LUT:
+            img->ApplyLut(lut);
+            break;
+        case BENCH_OP_HISTOGRAM:
+            img->GetHistogram(&histogram);
+            break;
+        case BENCH_OP_EQUALIZE:
+            img->Equalize();
+            break;
+        case BENCH_OP_AUTOCONTRAST:
+            img->AutoContrast(0.5, 0.5);
+            break;
+        case BENCH_OP_OTSU:
+            img->Binary(BINARY_OTSU, 0, 0);
+            break;
+        case BENCH_OP_SAUVOLA:
+            img->Binary(BINARY_SAUVOLA, 0, 0);
+            break;
+        case BENCH_OP_BRADLEY:
+            img->Binary(BINARY_BRADLEY, 0, 0);
+            break;
+        case BENCH_OP_PACK:
+            img->Binary(128, 0, 0, true);
+            break;
+    }
+    seconds = Seconds(start);
+    
+    bench.pixels = (double)img->GetWidth() * img->GetHeight();
+    //Histogram only reads, Equalize, AutoContrast and Otsu read twice (the tables of Sauvola, Bradley are not counted).
+    if (BENCH_OP_HISTOGRAM == bench.arg)
+        bench.bytes = org_bytes;
+    else if (BENCH_OP_EQUALIZE == bench.arg || BENCH_OP_AUTOCONTRAST == bench.arg || BENCH_OP_OTSU == bench.arg)
+        bench.bytes = 2 * org_bytes + ArrayBytes(*img);
+    else
+        bench.bytes = org_bytes + ArrayBytes(*img);
+    delete img;
+    return seconds;
+}
+
+double Benchmark::Bench_Zoom(BenchCase &bench) {
+    GeometryTrans* img = new GeometryTrans(*bench.source);
+    if (bench.planar)
+        img->SetPlanar(true);
+    if (bench.packed)
+        img->SetPacked(true);
+    double org_bytes = ArrayBytes(*img);
+    double org_pixels = (double)img->GetWidth() * img->GetHeight();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    //arg 0: to 5/4 of the size, else to 1/arg of it.
+    if (0 == bench.arg)
+        img->Zoom(img->GetWidth() * 5 / 4, img->GetHeight() * 5 / 4, bench.algorithm);
+    else
+        img->Zoom(img->GetWidth() / bench.arg, img->GetHeight() / bench.arg, bench.algorithm);
+    double seconds = Seconds(start);
+    
+    bench.pixels = (0 == bench.arg) ? (double)img->GetWidth() * img->GetHeight() : org_pixels;
+    bench.bytes = org_bytes + ArrayBytes(*img);
+    delete img;
+    return seconds;
+}
+
+double Benchmark::Bench_Rotate(BenchCase &bench) {
+    GeometryTrans* img = new GeometryTrans(*bench.source);
+    if (bench.planar)
+        img->SetPlanar(true);
+    if (bench.packed)
+        img->SetPacked(true);
+    double org_bytes = ArrayBytes(*img);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    img->Rotate(bench.arg, bench.algorithm, 255, false);
+    double seconds = Seconds(start);
+    
+    bench.pixels = (double)img->GetWidth() * img->GetHeight();
+    bench.bytes = org_bytes + ArrayBytes(*img);
+    delete img;
+    return seconds;
+}
+
+#endif /* Benchmark_Class_hpp */
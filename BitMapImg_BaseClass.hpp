@@ -8,13 +8,33 @@
  * (inline)
  * call <StandardizeBMP>
  
+ (2.1) BitMapImg(PixelBuffer &&pixels);
+ * may throw: IMG_BAD_CHANNEL (pixels has not 1 or 3 channels, it is left as it was).
+ * Take the pixels of a PixelBuffer (1 or 3 channels), nothing is copied unless its rows have padding
+ * (then they are packed in place). pixels is left empty.
+ 
+ (2.2) BitMapImg(BitMapImg &&org);
+       BitMapImg& operator=(BitMapImg &&org);
+ * Move only: the pixels (and the file mapping they may live in) go to the new owner, org is left empty (0 x 0).
+ * A BitMapImg can not be copied, so bitmap_array is never freed twice.
+ * Derived classes (ColorTrans, GeometryTrans, PipelineTrans) are made from any other one the same way,
+ * e.g. ColorTrans color(std::move(geometry)): a chain of operations never copies the pixels.
+ 
  (3) ~BitMapImg(void);
  * (inline)
- * delete [] bitmap_array.
+ * call <FreeBitmapArray>.
  
  (4) bmpData BitMapImg::TransToBmp(void);
  * Write data of this class into a bmpData for output.
- * Always output 24-bit form or 8-bit form.
+ * Output 24-bit form, 8-bit form, or 1-bit form (a packed image, see <SetPacked>, its rows are copied as they are).
+ * A planar image is interleaved row by row on the way.
+ 
+ (4.1) int BitMapImg::SaveToBmp(char* save_file_path, bool direct_io = false);
+ * may throw: NO_DATA, WRONG_FILE_PATH, WRITE_IN_ERROR.
+ * Save this image as a BMP file straight from bitmap_array (<SaveBmp_Gather>, basic_bmp_writev.cpp),
+ * the same file as SaveBmp(save_file_path, TransToBmp()), without making the padded copy.
+ * direct_io: preallocate the file and bypass the page cache, for large outputs.
+ * A planar image is interleaved into a temporary buffer first, a packed one is saved as a 1-bit BMP.
  
  (5) long getWidth(void) {return width;}
  
@@ -22,13 +42,94 @@
  
  (7) bool GetGrayForm(void) {return is_gray_form;}
  
- (8) unsigned char* MoveBitmapDataTo(unsigned char* target);
+ (7.1) void SetPlanar(bool planar);
+       bool GetPlanar(void);
+ * The layout of a color bitmap_array (a gray one has one plane already, it is never planar):
+ * interleaved (default): B, G, R of a pixel side by side, width * 3 bytes per row.
+ * planar: a plane of B, then of G, then of R, 1 byte per pixel, every row <PlaneStride> bytes from the next:
+ * width rounded up to 64, so every row (and every plane) starts 64-byte aligned, on a cache line.
+ * Nothing reads the padding bytes as pixels (SetPlanar sets them to 0, the other operations may leave anything there).
+ * Every per-channel kernel runs on a plane as on a gray image (Zoom and Rotate of GeometryTrans,
+ * the point operations of ColorTrans), with 1-byte pixels and straight SIMD loads instead of a 3-byte stride.
+ * The layout only changes here (<Deinterleave_Simd> / <Interleave_Simd>, one pass, row by row),
+ * and the output (<TransToBmp>, <SaveToBmp>, <TakePixels>) is always interleaved.
  
- (9) void StandardizeBMP(bmpData org_bmp_data)
- !!!!!!!!!!!!!! CAN NOT processing 16-bit BMP !!!!!!!!!!!!!!
- * Transfer all other kinds of BMP data to 24-bit (B:1byte, G:1byte, R:1byte).
+ (7.1.1) void SetPacked(bool packed);
+         bool GetPacked(void);
+ * 1 bit per pixel for a gray image of only black and white (e.g. after ColorTrans <Binary>):
+ * rows of <PackedLine> bytes, the first pixel in the top bit (bit 7) of the first byte, 1: white (255), 0: black (0),
+ * the padding bits are always 0. That is the row of a 1-bit BMP, so <TransToBmp> / <SaveToBmp> write it as it is,
+ * and the image takes 1/8 of the memory and of the file.
+ * Packing: pixels >= 128 become 1 (<PackBits_Simd>), unpacking: 0 / 255 (<UnpackBits_Simd>).
+ * Reverse (ColorTrans), Rotate_90 / 180 / 270 (GeometryTrans) and the histogram work on the bits;
+ * every other operation unpacks the image first (and leaves it unpacked), and so does <TakePixels>.
+ * may throw: IMG_NOT_GRAY (SetPacked(true) on a color image, make it gray first, e.g. ColorTrans <ColorToGray>).
+ 
+ (7.1.2) void PackRows(int threshold);
+         void ClearPackedPadding(void);
+ * The body of <SetPacked>(true), with any threshold (pixels >= threshold become 1), for ColorTrans <Binary>.
+ * <ClearPackedPadding>: set the padding bits of a packed image back to 0, after an operation on whole bytes.
+ 
+ (7.2) static long PlaneStride(long width);
+       static long PlaneByte(long width, long height);
+       static long PackedLine(long width);
+       long RowByte(long width);
+       long ArrayLength(long width, long height);
+ * (inline)
+ * Bytes of a plane row (width rounded up to 64), of one plane (PlaneStride * height),
+ * of a packed row ((width + 31) / 32 * 4, as a 1-bit BMP row),
+ * of a row (of a plane, when planar: the stride of ImgBand) and of a whole bitmap_array of this layout.
+ 
+ (8) PixelBuffer TakePixels(void);
+ * Move the pixels out into a PixelBuffer (stride: width * channel), this image is left empty.
+ * A planar image is interleaved first, a packed one unpacked.
+ 
+ (9) void MoveFrom(BitMapImg &org);
+ * (inline)
+ * The body of (2.2): <FreeBitmapArray>, then take everything of org.
+ 
+ (10) void FreeBitmapArray(void);
+ * (inline)
+ * <PixelFree> bitmap_array, or unmap it if it still lives in a mapped file.
+ * Use this instead of "delete [] bitmap_array" in every derived class,
+ * and get every new bitmap_array from <PixelAlloc> (basic_pixel_pool.cpp).
+ 
+ (11) void StandardizeBMP(bmpData org_bmp_data)
+ * may throw: NOT_BMP_FILE (a bit count other than 1, 4, 8, 16, 24 and 32).
+ * Transfer all kinds of BMP data to 24-bit (B:1byte, G:1byte, R:1byte).
  * Can processing Height < 0, and change it to Height > 0.
- * If input(org_bmp_data) is 16-bit, function will printf and exit(1).
+ * A mapped org_bmp_data (from <ReadBmp_Mapped>) is always consumed here:
+ * 24-bit Bottom->Top rows without padding are used in place (zero-copy),
+ * all the others are decoded straight from the mapping and then unmapped.
+ * 1, 4 and 8-bit (palette) data is decoded straight into the final layout:
+ * 1 byte per pixel if every color used is gray, else 3 bytes, never expanded to 3 bytes and collapsed back.
+ * So is BI_RLE8 / BI_RLE4 data (<RleDecode>, basic_bmp_rle.cpp), run by run, without an index image;
+ * if its color table is not all gray, the stream is walked once first for the colors used.
+ * may throw: FILE_DAMAGED (RLE stream cut short, or a bit count RLE does not have).
+ * 24 and 32-bit data is checked for gray first (<IsGray_Simd>, stops at the first colorful pixel),
+ * then every row is copied (24-bit), has its alpha dropped (32-bit, <DropAlpha_Simd>) or keeps only B (gray).
+ * 16-bit data (5-5-5, or the masks of BI_BITFIELDS) and 32-bit BI_BITFIELDS data with other masks than B, G, R, A
+ * is decoded by <Bitfields_Simd> (tables of (15)) into 3 bytes per pixel, then checked for gray and collapsed if it is.
+ 
+ (12) static bool Palette_IsGray(const bmpData &org_bmp_data, long line_byte);
+ * Whether every pixel of a 1, 4 or 8-bit image has a gray color (B == G == R).
+ * Only the color table is checked if all its colors are gray (the usual gray BMP),
+ * else the pixels are checked byte by byte (a table says if a source byte holds a colorful pixel),
+ * and it stops at the first colorful one.
+ 
+ (13) static void Palette_ByteTable(const RgbQuad* color_table, int bit_count, int pixel_byte, unsigned char* byte_table);
+ * For every value of a source byte, the decoded bytes of all the pixels in it
+ * (8 pixels of 1-bit, 2 of 4-bit, 1 of 8-bit), pixel_byte (1: gray, 3: B, G, R) bytes each.
+ * byte_table: 256 * 8 / bit_count * pixel_byte bytes, at most 6144.
+ 
+ (14) static void Palette_DecodeRow(const unsigned char* org_row, unsigned char* target_row, long width, int bit_count,
+                                    int pixel_byte, const unsigned char* byte_table);
+ * Decode one row with the table of (13): one lookup and one fixed-size copy per source byte.
+ 
+ (15) static void Bitfields_Table(const u_word4* masks, BitFieldTable* fields);
+ * From the masks of R, G, B (bmp_Masks), where every channel is in a pixel (shift, mask, at most its top 8 bits)
+ * and how it is widened to 8 bits: its bits repeated (5-bit 10110 -> 10110101), which keeps 0 -> 0 and all ones -> 255.
+ * Both as a multiply and a shift (for SIMD) and as a table of 256 (expand, for the scalar tail).
  *****************************************************************************/
 
 #ifndef BitMapImg_BaseClass_hpp
@@ -36,6 +137,8 @@
 
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
+#include <utility>
 
 class BitMapImg {
 //data:
@@ -43,303 +146,475 @@ protected:
     long width;
     long height;
     bool is_gray;
+    bool is_planar; //color only, see <SetPlanar>.
+    bool is_packed; //gray only, 1 bit per pixel, see <SetPacked>.
     unsigned char* bitmap_array;
-
+    unsigned char* mapped_base; //not NULL: bitmap_array lives in this file mapping.
+    unsigned long mapped_length;
+    
 //functions:
 public:
     BitMapImg(void) {
         width = 0;
         height = 0;
         is_gray = false;
+        is_planar = false;
+        is_packed = false;
         bitmap_array = NULL;
+        mapped_base = NULL;
+        mapped_length = 0;
     }
     BitMapImg(bmpData org_bmp_data) {
+        bitmap_array = NULL;
+        mapped_base = NULL;
+        mapped_length = 0;
         StandardizeBMP(org_bmp_data);
     }
+    BitMapImg(PixelBuffer &&pixels);
+    BitMapImg(BitMapImg &&org) {
+        bitmap_array = NULL;
+        mapped_base = NULL;
+        mapped_length = 0;
+        MoveFrom(org);
+    }
+    BitMapImg& operator=(BitMapImg &&org) {
+        if (this != &org)
+            MoveFrom(org);
+        return *this;
+    }
+    BitMapImg(const BitMapImg &org) = delete;
+    BitMapImg& operator=(const BitMapImg &org) = delete;
     ~BitMapImg(void) {
-        if (NULL != bitmap_array)
-            delete [] bitmap_array;
+        FreeBitmapArray();
     }
     long GetWidth(void) {return width;}
     long GetHeight(void) {return height;}
     bool GetGrayForm(void) {return is_gray;}
-    unsigned char* MoveBitmapDataTo(unsigned char* target) {
-        target = bitmap_array;
+    bool GetPlanar(void) {return is_planar;}
+    void SetPlanar(bool planar);
+    bool GetPacked(void) {return is_packed;}
+    void SetPacked(bool packed);
+    PixelBuffer TakePixels(void);
+    bmpData TransToBmp(void);
+    int SaveToBmp(char* save_file_path, bool direct_io = false);
+protected:
+    static long PlaneStride(long width) {
+        return (width + 63) / 64 * 64;
+    }
+    static long PlaneByte(long width, long height) {
+        return PlaneStride(width) * height;
+    }
+    static long PackedLine(long width) {
+        return (width + 31) / 32 * 4;
+    }
+    long RowByte(long width) {
+        if (is_packed)
+            return PackedLine(width);
+        if (is_gray)
+            return width;
+        return is_planar ? PlaneStride(width) : width * 3;
+    }
+    long ArrayLength(long width, long height) {
+        return RowByte(width) * height * (is_planar ? 3 : 1);
+    }
+    void FreeBitmapArray(void) {
+        if (NULL != mapped_base) {
+            UnmapBmpFile(mapped_base, mapped_length);
+            mapped_base = NULL;
+            mapped_length = 0;
+        }
+        else
+            PixelFree(bitmap_array);
         bitmap_array = NULL;
-        return target;
     }
-    bmpData TransToBmp(void);
+    void MoveFrom(BitMapImg &org) {
+        FreeBitmapArray();
+        width = org.width;
+        height = org.height;
+        is_gray = org.is_gray;
+        is_planar = org.is_planar;
+        is_packed = org.is_packed;
+        bitmap_array = org.bitmap_array;
+        mapped_base = org.mapped_base;
+        mapped_length = org.mapped_length;
+        org.width = 0;
+        org.height = 0;
+        org.is_gray = false;
+        org.is_planar = false;
+        org.is_packed = false;
+        org.bitmap_array = NULL;
+        org.mapped_base = NULL;
+        org.mapped_length = 0;
+    }
+    void PackRows(int threshold);
+    void ClearPackedPadding(void);
 private:
     void StandardizeBMP(bmpData org_bmp_data);
+    static bool Palette_IsGray(const bmpData &org_bmp_data, long line_byte);
+    static void Palette_ByteTable(const RgbQuad* color_table, int bit_count, int pixel_byte, unsigned char* byte_table);
+    static void Palette_DecodeRow(const unsigned char* org_row, unsigned char* target_row, long width, int bit_count,
+                                  int pixel_byte, const unsigned char* byte_table);
+    static void Bitfields_Table(const u_word4* masks, BitFieldTable* fields);
 };
 
 
 
 void BitMapImg::StandardizeBMP(bmpData org_bmp_data) {
-    long line_byte = (abs(org_bmp_data.bmp_Width) * org_bmp_data.bmp_BitCount / 8 + 3) / 4 * 4;
-    long x, y, bitmap_array_index, org_array_index;
-    unsigned char color_index;
+    long line_byte = (abs(org_bmp_data.bmp_Width) * org_bmp_data.bmp_BitCount + 31) / 32 * 4;
+    long x, y, org_array_index;
     
+    TRACE_SCOPE("StandardizeBMP", "BitMapImg");
+    TRACE_BYTES(line_byte * abs(org_bmp_data.bmp_Height));
     is_gray = true;
+    is_planar = false;
+    is_packed = false;
     width = org_bmp_data.bmp_Width;
     height = org_bmp_data.bmp_Height;
-    bitmap_array = new unsigned char[width * abs(height) * 3];
     
-    switch (org_bmp_data.bmp_BitCount) {
-        case 1:
-            if (height > 0) {
-                //y-axis from Bottom to Top
-                for (y = 0; y < height; y++) {
-                    for (x = 0; x < width; x++) {
-                        color_index = (org_bmp_data.bmp_data_array[y * line_byte + (x / 8)] & (0b10000000 >> (x % 8))) >> (7 - x % 8);
-                        
-                        bitmap_array_index = (y * width + x) * 3;
-                        
-                        bitmap_array[bitmap_array_index] = org_bmp_data.bmp_color_table[color_index].rgbBlue;
-                        bitmap_array[bitmap_array_index + 1] = org_bmp_data.bmp_color_table[color_index].rgbGreen;
-                        bitmap_array[bitmap_array_index + 2] = org_bmp_data.bmp_color_table[color_index].rgbRed;
-                        
-                        if (is_gray) {
-                            if ((bitmap_array[bitmap_array_index] !=     bitmap_array[bitmap_array_index + 1]) ||
-                                (bitmap_array[bitmap_array_index] != bitmap_array[bitmap_array_index + 2]) ||
-                                (bitmap_array[bitmap_array_index + 1] != bitmap_array[bitmap_array_index + 2]))
-                                is_gray = false;
-                        }
-                    }
-                }
-            }
-            else {
-                //y-axis from Top to Bottom
-                height = 0 - height;
-                for (y = height - 1; y >= 0; y--) {
-                    for (x = 0; x < width; x++) {
-                        color_index = (org_bmp_data.bmp_data_array[y * line_byte + (x / 8)] & (0b10000000 >> (x % 8))) >> (7 - x % 8);
-
-                        bitmap_array_index = ((height - 1 - y) * width + x) * 3;
-                        
-                        bitmap_array[bitmap_array_index] = org_bmp_data.bmp_color_table[color_index].rgbBlue;
-                        bitmap_array[bitmap_array_index + 1] = org_bmp_data.bmp_color_table[color_index].rgbGreen;
-                        bitmap_array[bitmap_array_index + 2] = org_bmp_data.bmp_color_table[color_index].rgbRed;
-                        
-                        if (is_gray) {
-                            if ((bitmap_array[bitmap_array_index] !=     bitmap_array[bitmap_array_index + 1]) ||
-                                (bitmap_array[bitmap_array_index] != bitmap_array[bitmap_array_index + 2]) ||
-                                (bitmap_array[bitmap_array_index + 1] != bitmap_array[bitmap_array_index + 2]))
-                                is_gray = false;
-                        }
-                    }
-                }
-            }
-            break;
-            
-        case 4:
-            if (height > 0) {
-                //y-axis from Bottom to Top
-                for (y = 0; y < height; y++) {
-                    for (x = 0; x < width; x++) {
-                        color_index = (org_bmp_data.bmp_data_array[y * line_byte + (x / 2)] & (0b11110000 >> ((x % 2) * 4))) >> ((1 - x % 2) * 4);
-                        bitmap_array_index = (y * width + x) * 3;
-                        
-                        bitmap_array[bitmap_array_index] = org_bmp_data.bmp_color_table[color_index].rgbBlue;
-                        bitmap_array[bitmap_array_index + 1] = org_bmp_data.bmp_color_table[color_index].rgbGreen;
-                        bitmap_array[bitmap_array_index + 2] = org_bmp_data.bmp_color_table[color_index].rgbRed;
-                        
-                        if (is_gray) {
-                            if ((bitmap_array[bitmap_array_index] !=     bitmap_array[bitmap_array_index + 1]) ||
-                                (bitmap_array[bitmap_array_index] != bitmap_array[bitmap_array_index + 2]) ||
-                                (bitmap_array[bitmap_array_index + 1] != bitmap_array[bitmap_array_index + 2]))
-                                is_gray = false;
-                        }
-                    }
-                }
+    if (NULL != org_bmp_data.bmp_mapped_base && 24 == org_bmp_data.bmp_BitCount && height > 0 && line_byte == width * 3) {
+        //zero-copy: rows in the mapped file are already in the layout of bitmap_array.
+        unsigned char* org_array = org_bmp_data.bmp_data_array;
+        
+        is_gray = IsGray_Simd(org_array, width * height, 3);
+        if (is_gray) {
+            bitmap_array = PixelAlloc(width * height);
+            TRACE_BYTES(width * height);
+            for (x = 0; x < width * height; x++)
+                bitmap_array[x] = org_array[x * 3];
+            DeleteBmpData(org_bmp_data);
+        }
+        else {
+            bitmap_array = org_array;
+            mapped_base = org_bmp_data.bmp_mapped_base;
+            mapped_length = org_bmp_data.bmp_mapped_length;
+        }
+        return;
+    }
+    
+    if (BI_RLE8 == org_bmp_data.bmp_Compression || BI_RLE4 == org_bmp_data.bmp_Compression) {
+        //RLE: decode the runs straight into the final layout, 1 byte per pixel if all the used colors are gray.
+        int bit_count = (BI_RLE8 == org_bmp_data.bmp_Compression) ? 8 : 4;
+        int pixel_byte, i;
+        bool used[256] = {false};
+        bool all_gray = true;
+        unsigned char color_list[256 * 3];
+        const RgbQuad* entry;
+        
+        height = labs(height);
+        try {
+            if (bit_count != org_bmp_data.bmp_BitCount)
+                throw FILE_DAMAGED;
+            for (i = 0; i < (1 << bit_count); i++) {
+                entry = &org_bmp_data.bmp_color_table[i];
+                all_gray = all_gray && entry->rgbBlue == entry->rgbGreen && entry->rgbBlue == entry->rgbRed;
             }
-            else {
-                //y-axis from Top to Bottom
-                height = 0 - height;
-                for (y = height - 1; y >= 0; y--) {
-                    for (x = 0; x < width; x++) {
-                        color_index = (org_bmp_data.bmp_data_array[y * line_byte + (x / 2)] & (0b11110000 >> ((x % 2) * 4))) >> ((1 - x % 2) * 4);
-                        bitmap_array_index = ((height - 1 - y) * width + x) * 3;
-                        
-                        bitmap_array[bitmap_array_index] = org_bmp_data.bmp_color_table[color_index].rgbBlue;
-                        bitmap_array[bitmap_array_index + 1] = org_bmp_data.bmp_color_table[color_index].rgbGreen;
-                        bitmap_array[bitmap_array_index + 2] = org_bmp_data.bmp_color_table[color_index].rgbRed;
-                        
-                        if (is_gray) {
-                            if ((bitmap_array[bitmap_array_index] !=     bitmap_array[bitmap_array_index + 1]) ||
-                                (bitmap_array[bitmap_array_index] != bitmap_array[bitmap_array_index + 2]) ||
-                                (bitmap_array[bitmap_array_index + 1] != bitmap_array[bitmap_array_index + 2]))
-                                is_gray = false;
-                        }
-                    }
+            if (!all_gray) {
+                RleDecode(org_bmp_data.bmp_data_array, org_bmp_data.bmp_data_length, bit_count, width, height,
+                          NULL, 0, NULL, 0, used);
+                for (i = 0; i < (1 << bit_count) && is_gray; i++) {
+                    entry = &org_bmp_data.bmp_color_table[i];
+                    is_gray = !used[i] || (entry->rgbBlue == entry->rgbGreen && entry->rgbBlue == entry->rgbRed);
                 }
             }
-            break;
-            
-        case 8:
-            if (height > 0) {
-                //y-axis from Bottom to Top
-                for (y = 0; y < height; y++) {
-                    for (x = 0; x < width; x++) {
-                        color_index = org_bmp_data.bmp_data_array[y * line_byte + x];
-                        bitmap_array_index = (y * width + x) * 3;
-                        
-                        bitmap_array[bitmap_array_index] = org_bmp_data.bmp_color_table[color_index].rgbBlue;
-                        bitmap_array[bitmap_array_index + 1] = org_bmp_data.bmp_color_table[color_index].rgbGreen;
-                        bitmap_array[bitmap_array_index + 2] = org_bmp_data.bmp_color_table[color_index].rgbRed;
-                        
-                        if (is_gray) {
-                            if ((bitmap_array[bitmap_array_index] !=     bitmap_array[bitmap_array_index + 1]) ||
-                                (bitmap_array[bitmap_array_index] != bitmap_array[bitmap_array_index + 2]) ||
-                                (bitmap_array[bitmap_array_index + 1] != bitmap_array[bitmap_array_index + 2]))
-                                is_gray = false;
-                        }
-                    }
+            pixel_byte = is_gray ? 1 : 3;
+            for (i = 0; i < (1 << bit_count); i++) {
+                entry = &org_bmp_data.bmp_color_table[i];
+                color_list[i * pixel_byte] = entry->rgbBlue;
+                if (3 == pixel_byte) {
+                    color_list[i * 3 + 1] = entry->rgbGreen;
+                    color_list[i * 3 + 2] = entry->rgbRed;
                 }
             }
-            else {
-                //y-axis from Top to Bottom
-                height = 0 - height;
-                for (y = height - 1; y >= 0; y--) {
-                    for (x = 0; x < width; x++) {
-                        color_index = org_bmp_data.bmp_data_array[y * line_byte + x];
-                        bitmap_array_index = ((height - 1 - y) * width + x) * 3;
-                        
-                        bitmap_array[bitmap_array_index] = org_bmp_data.bmp_color_table[color_index].rgbBlue;
-                        bitmap_array[bitmap_array_index + 1] = org_bmp_data.bmp_color_table[color_index].rgbGreen;
-                        bitmap_array[bitmap_array_index + 2] = org_bmp_data.bmp_color_table[color_index].rgbRed;
-                        
-                        if (is_gray) {
-                            if ((bitmap_array[bitmap_array_index] !=     bitmap_array[bitmap_array_index + 1]) ||
-                                (bitmap_array[bitmap_array_index] != bitmap_array[bitmap_array_index + 2]) ||
-                                (bitmap_array[bitmap_array_index + 1] != bitmap_array[bitmap_array_index + 2]))
-                                is_gray = false;
-                        }
-                    }
-                }
-            }
-            break;
+            bitmap_array = PixelAlloc(width * height * pixel_byte);
+            TRACE_BYTES(width * height * pixel_byte);
             
-        case 24:
-            if (height > 0) {
-                //y-axis from Bottom to Top
-                for (y = 0; y < height; y++) {
-                    for (x = 0; x < width; x++) {
-                        bitmap_array_index = (y * width + x) * 3;
-                        org_array_index = y * line_byte + x * 3;
-                        
-                        bitmap_array[bitmap_array_index] = org_bmp_data.bmp_data_array[org_array_index];
-                        bitmap_array[bitmap_array_index + 1] = org_bmp_data.bmp_data_array[org_array_index + 1];
-                        bitmap_array[bitmap_array_index + 2] = org_bmp_data.bmp_data_array[org_array_index + 2];
-                        
-                        if (is_gray) {
-                            if ((bitmap_array[bitmap_array_index] !=     bitmap_array[bitmap_array_index + 1]) ||
-                                (bitmap_array[bitmap_array_index] != bitmap_array[bitmap_array_index + 2]) ||
-                                (bitmap_array[bitmap_array_index + 1] != bitmap_array[bitmap_array_index + 2]))
-                                is_gray = false;
-                        }
-                    }
-                }
-            }
+            //the stream is Bottom -> Top, fill from the last row while org Height < 0.
+            if (org_bmp_data.bmp_Height > 0)
+                RleDecode(org_bmp_data.bmp_data_array, org_bmp_data.bmp_data_length, bit_count, width, height,
+                          color_list, pixel_byte, bitmap_array, width * pixel_byte, NULL);
+            else
+                RleDecode(org_bmp_data.bmp_data_array, org_bmp_data.bmp_data_length, bit_count, width, height,
+                          color_list, pixel_byte, bitmap_array + (height - 1) * width * pixel_byte, -width * pixel_byte, NULL);
+        } catch (...) {
+            PixelFree(bitmap_array);
+            bitmap_array = NULL;
+            if (NULL != org_bmp_data.bmp_mapped_base)
+                DeleteBmpData(org_bmp_data);
+            throw;
+        }
+        
+        if (NULL != org_bmp_data.bmp_mapped_base)
+            DeleteBmpData(org_bmp_data);
+        return;
+    }
+    
+    if (1 == org_bmp_data.bmp_BitCount || 4 == org_bmp_data.bmp_BitCount || 8 == org_bmp_data.bmp_BitCount) {
+        //palette: decode straight into the final layout, 1 byte per pixel if all the used colors are gray.
+        int bit_count = org_bmp_data.bmp_BitCount;
+        int pixel_byte;
+        unsigned char byte_table[256 * 8 * 3];
+        
+        height = labs(height);
+        is_gray = Palette_IsGray(org_bmp_data, line_byte);
+        pixel_byte = is_gray ? 1 : 3;
+        bitmap_array = PixelAlloc(width * height * pixel_byte);
+        TRACE_BYTES(width * height * pixel_byte);
+        
+        Palette_ByteTable(org_bmp_data.bmp_color_table, bit_count, pixel_byte, byte_table);
+        for (y = 0; y < height; y++) {
+            //y-axis from Bottom to Top, or from Top to Bottom while org Height < 0.
+            org_array_index = (org_bmp_data.bmp_Height > 0 ? y : height - 1 - y) * line_byte;
+            Palette_DecodeRow(org_bmp_data.bmp_data_array + org_array_index, bitmap_array + y * width * pixel_byte,
+                              width, bit_count, pixel_byte, byte_table);
+        }
+        
+        if (NULL != org_bmp_data.bmp_mapped_base)
+            DeleteBmpData(org_bmp_data);
+        return;
+    }
+    
+    if (16 == org_bmp_data.bmp_BitCount || (32 == org_bmp_data.bmp_BitCount && BI_BITFIELDS == org_bmp_data.bmp_Compression
+        && !(0xFF0000 == org_bmp_data.bmp_Masks[0] && 0xFF00 == org_bmp_data.bmp_Masks[1] && 0xFF == org_bmp_data.bmp_Masks[2]))) {
+        //bit fields: every channel is cut out by its mask and widened to 8 bits, then the gray check.
+        //(32-bit with the usual masks B, G, R, A is left to the branch below.)
+        const u_word4 rgb_555[3] = {0x7C00, 0x03E0, 0x001F};
+        int org_pixel_byte = org_bmp_data.bmp_BitCount / 8;
+        BitFieldTable fields;
+        unsigned char* gray_array;
+        
+        height = labs(height);
+        Bitfields_Table(BI_BITFIELDS == org_bmp_data.bmp_Compression ? org_bmp_data.bmp_Masks : rgb_555, &fields);
+        bitmap_array = PixelAlloc(width * height * 3);
+        TRACE_BYTES(width * height * 3);
+        for (y = 0; y < height; y++) {
+            //y-axis from Bottom to Top, or from Top to Bottom while org Height < 0.
+            org_array_index = (org_bmp_data.bmp_Height > 0 ? y : height - 1 - y) * line_byte;
+            Bitfields_Simd(org_bmp_data.bmp_data_array + org_array_index, bitmap_array + y * width * 3, width, org_pixel_byte, &fields);
+        }
+        
+        is_gray = IsGray_Simd(bitmap_array, width * height, 3);
+        if (is_gray) {
+            gray_array = PixelAlloc(width * height);
+            TRACE_BYTES(width * height);
+            for (x = 0; x < width * height; x++)
+                gray_array[x] = bitmap_array[x * 3];
+            PixelFree(bitmap_array);
+            bitmap_array = gray_array;
+        }
+        
+        if (NULL != org_bmp_data.bmp_mapped_base)
+            DeleteBmpData(org_bmp_data);
+        return;
+    }
+    
+    if (24 == org_bmp_data.bmp_BitCount || 32 == org_bmp_data.bmp_BitCount) {
+        //gray check first (stops at the first colorful pixel), then decode each row straight into the final layout.
+        int org_pixel_byte = org_bmp_data.bmp_BitCount / 8;
+        int pixel_byte;
+        unsigned char* target_row;
+        
+        height = labs(height);
+        for (y = 0; y < height && is_gray; y++)
+            is_gray = IsGray_Simd(org_bmp_data.bmp_data_array + y * line_byte, width, org_pixel_byte);
+        pixel_byte = is_gray ? 1 : 3;
+        bitmap_array = PixelAlloc(width * height * pixel_byte);
+        TRACE_BYTES(width * height * pixel_byte);
+        
+        for (y = 0; y < height; y++) {
+            //y-axis from Bottom to Top, or from Top to Bottom while org Height < 0.
+            org_array_index = (org_bmp_data.bmp_Height > 0 ? y : height - 1 - y) * line_byte;
+            target_row = bitmap_array + y * width * pixel_byte;
+            if (3 == pixel_byte && 3 == org_pixel_byte)
+                memcpy(target_row, org_bmp_data.bmp_data_array + org_array_index, width * 3);
+            else if (3 == pixel_byte)
+                DropAlpha_Simd(org_bmp_data.bmp_data_array + org_array_index, target_row, width);
             else {
-                //y-axis from Top to Bottom
-                height = 0 - height;
-                for (y = height - 1; y >= 0; y--) {
-                    for (x = 0; x < width; x++) {
-                        bitmap_array_index = (y * width + x) * 3;
-                        org_array_index = (height - 1 - y) * line_byte + x * 3;
-                        
-                        bitmap_array[bitmap_array_index] = org_bmp_data.bmp_data_array[org_array_index];
-                        bitmap_array[bitmap_array_index + 1] = org_bmp_data.bmp_data_array[org_array_index + 1];
-                        bitmap_array[bitmap_array_index + 2] = org_bmp_data.bmp_data_array[org_array_index + 2];
-                        
-                        if (is_gray) {
-                            if ((bitmap_array[bitmap_array_index] !=     bitmap_array[bitmap_array_index + 1]) ||
-                                (bitmap_array[bitmap_array_index] != bitmap_array[bitmap_array_index + 2]) ||
-                                (bitmap_array[bitmap_array_index + 1] != bitmap_array[bitmap_array_index + 2]))
-                                is_gray = false;
-                        }
-                    }
-                }
-            }
-            break;
-            
-        case 32:
-            if (height > 0) {
-                //y-axis from Bottom to Top
-                for (y = 0; y < height; y++) {
-                    for (x = 0; x < width; x++) {
-                        bitmap_array_index = (y * width + x) * 3;
-                        org_array_index = y * line_byte + x * 4;
-                        
-                        bitmap_array[bitmap_array_index] = org_bmp_data.bmp_data_array[org_array_index];
-                        bitmap_array[bitmap_array_index + 1] = org_bmp_data.bmp_data_array[org_array_index + 1];
-                        bitmap_array[bitmap_array_index + 2] = org_bmp_data.bmp_data_array[org_array_index + 2];
-                        
-                        if (is_gray) {
-                            if ((bitmap_array[bitmap_array_index] !=     bitmap_array[bitmap_array_index + 1]) ||
-                                (bitmap_array[bitmap_array_index] != bitmap_array[bitmap_array_index + 2]) ||
-                                (bitmap_array[bitmap_array_index + 1] != bitmap_array[bitmap_array_index + 2]))
-                                is_gray = false;
-                        }
-                    }
-                }
+                //gray: B == G == R, keep B.
+                for (x = 0; x < width; x++)
+                    target_row[x] = org_bmp_data.bmp_data_array[org_array_index + x * org_pixel_byte];
             }
-            else {
-                //y-axis from Top to Bottom
-                height = 0 - height;
-                for (y = height - 1; y >= 0; y--) {
-                    for (x = 0; x < width; x++) {
-                        bitmap_array_index = (y * width + x) * 3;
-                        org_array_index = (height - 1 - y) * line_byte + x * 4;
-                        
-                        bitmap_array[bitmap_array_index] = org_bmp_data.bmp_data_array[org_array_index];
-                        bitmap_array[bitmap_array_index + 1] = org_bmp_data.bmp_data_array[org_array_index + 1];
-                        bitmap_array[bitmap_array_index + 2] = org_bmp_data.bmp_data_array[org_array_index + 2];
-                        
-                        if (is_gray) {
-                            if ((bitmap_array[bitmap_array_index] !=     bitmap_array[bitmap_array_index + 1]) ||
-                                (bitmap_array[bitmap_array_index] != bitmap_array[bitmap_array_index + 2]) ||
-                                (bitmap_array[bitmap_array_index + 1] != bitmap_array[bitmap_array_index + 2]))
-                                is_gray = false;
-                        }
-                    }
-                }
+        }
+        
+        if (NULL != org_bmp_data.bmp_mapped_base)
+            DeleteBmpData(org_bmp_data);
+        return;
+    }
+    
+    if (NULL != org_bmp_data.bmp_mapped_base)
+        DeleteBmpData(org_bmp_data);
+    throw NOT_BMP_FILE;
+}
+
+bool BitMapImg::Palette_IsGray(const bmpData &org_bmp_data, long line_byte) {
+    int bit_count = org_bmp_data.bmp_BitCount;
+    int pixel_per_byte = 8 / bit_count;
+    int index_mask = (1 << bit_count) - 1;
+    long full_byte = org_bmp_data.bmp_Width / pixel_per_byte;
+    long rest_pixel = org_bmp_data.bmp_Width % pixel_per_byte;
+    bool entry_gray[256], byte_color[256];
+    bool all_gray = true;
+    const unsigned char* org_row;
+    long i, y;
+    int k;
+    
+    for (i = 0; i <= index_mask; i++) {
+        const RgbQuad &entry = org_bmp_data.bmp_color_table[i];
+        entry_gray[i] = (entry.rgbBlue == entry.rgbGreen && entry.rgbBlue == entry.rgbRed);
+        all_gray = all_gray && entry_gray[i];
+    }
+    if (all_gray)
+        return true;    //no need to look at the pixels.
+    
+    //byte_color[b]: a source byte b holds at least one pixel of a colorful entry.
+    for (i = 0; i < 256; i++) {
+        byte_color[i] = false;
+        for (k = 0; k < pixel_per_byte; k++)
+            byte_color[i] = byte_color[i] || !entry_gray[(i >> (8 - bit_count * (k + 1))) & index_mask];
+    }
+    
+    for (y = 0; y < labs(org_bmp_data.bmp_Height); y++) {
+        org_row = org_bmp_data.bmp_data_array + y * line_byte;
+        for (i = 0; i < full_byte; i++) {
+            if (byte_color[org_row[i]])
+                return false;
+        }
+        //the last byte may be only partly used, its padding bits are not pixels.
+        for (k = 0; k < rest_pixel; k++) {
+            if (!entry_gray[(org_row[full_byte] >> (8 - bit_count * (k + 1))) & index_mask])
+                return false;
+        }
+    }
+    return true;
+}
+
+void BitMapImg::Palette_ByteTable(const RgbQuad* color_table, int bit_count, int pixel_byte, unsigned char* byte_table) {
+    int pixel_per_byte = 8 / bit_count;
+    int index_mask = (1 << bit_count) - 1;
+    const RgbQuad* entry;
+    unsigned char* target;
+    
+    for (int i = 0; i < 256; i++) {
+        for (int k = 0; k < pixel_per_byte; k++) {
+            entry = &color_table[(i >> (8 - bit_count * (k + 1))) & index_mask];
+            target = byte_table + (i * pixel_per_byte + k) * pixel_byte;
+            target[0] = entry->rgbBlue;
+            if (3 == pixel_byte) {
+                target[1] = entry->rgbGreen;
+                target[2] = entry->rgbRed;
             }
-            break;
-            
-        default:
-            printf("maybe 16-bit bmp!\n");
-            exit(1);
-            break;
+        }
     }
+}
+
+void BitMapImg::Bitfields_Table(const u_word4* masks, BitFieldTable* fields) {
+    u_word4 mask;
+    int low, bits, total;
     
-    if (is_gray) {
-        unsigned char* gray_array = new unsigned char[width * height];
-        
-        for (x = 0; x < width * height; x++) {
-            gray_array[x] = bitmap_array[x * 3];
+    for (int c = 0; c < 3; c++) {
+        mask = masks[2 - c];    //masks: R, G, B
+        for (low = 0; low < 32 && 0 == ((mask >> low) & 1); low++)
+            ;
+        for (bits = 0; low + bits < 32 && 0 != (mask >> (low + bits)); bits++)
+            ;
+        if (bits > 8) {
+            //more than 8 bits (e.g. 10-bit channels of a 32-bit pixel): the top 8 only.
+            low += bits - 8;
+            bits = 8;
         }
-        delete [] bitmap_array;
-        bitmap_array = gray_array;
+        fields->shift[c] = (0 == bits) ? 0 : low;
+        fields->mask[c] = (1u << bits) - 1;
+        
+        //repeat the bits: multiply by 1 + 2^bits + 2^(2 * bits) ... up to 8 bits at least, and cut it to 8 bits.
+        fields->multiply[c] = 0;
+        for (total = 0; total < 8 && bits > 0; total += bits)
+            fields->multiply[c] = (fields->multiply[c] << bits) | 1;
+        fields->scale_shift[c] = (0 == bits) ? 0 : total - 8;
+        for (int i = 0; i < 256; i++)
+            fields->expand[c][i] = (unsigned char)(((i & fields->mask[c]) * fields->multiply[c]) >> fields->scale_shift[c]);
+    }
+}
+
+//copy <chunk> bytes of byte_table for every full source byte, chunk is a constant in each case.
+#define PALETTE_COPY_ROW(chunk) \
+    for (i = 0; i < full_byte; i++) \
+        memcpy(target_row + i * (chunk), byte_table + org_row[i] * (chunk), (chunk));
+
+void BitMapImg::Palette_DecodeRow(const unsigned char* org_row, unsigned char* target_row, long width, int bit_count,
+                                  int pixel_byte, const unsigned char* byte_table) {
+    int pixel_per_byte = 8 / bit_count;
+    int chunk = pixel_per_byte * pixel_byte;
+    long full_byte = width / pixel_per_byte;
+    long rest_pixel = width % pixel_per_byte;
+    long i;
+    
+    switch (chunk) {
+        case 1:     //8-bit -> gray
+            for (i = 0; i < full_byte; i++)
+                target_row[i] = byte_table[org_row[i]];
+            break;
+        case 2:     //4-bit -> gray
+            PALETTE_COPY_ROW(2)
+            break;
+        case 3:     //8-bit -> B, G, R
+            PALETTE_COPY_ROW(3)
+            break;
+        case 6:     //4-bit -> B, G, R
+            PALETTE_COPY_ROW(6)
+            break;
+        case 8:     //1-bit -> gray
+            PALETTE_COPY_ROW(8)
+            break;
+        case 24:    //1-bit -> B, G, R
+            PALETTE_COPY_ROW(24)
+            break;
     }
-    return;
+    if (rest_pixel > 0)
+        memcpy(target_row + full_byte * chunk, byte_table + org_row[full_byte] * chunk, rest_pixel * pixel_byte);
 }
 
+#undef PALETTE_COPY_ROW
+
 bmpData BitMapImg::TransToBmp(void) {
     bmpData output;
     long line_byte;
     long data_byte;
     long x, y;
     
-    if (is_gray) {
+    TRACE_SCOPE("TransToBmp", "BitMapImg");
+    if (is_packed) {
+        output.bmp_BitCount = 1;
+        line_byte = PackedLine(width);
+        data_byte = line_byte * height;
+        output.bmp_Height = height;
+        output.bmp_Width = width;
+        output.bmp_mapped_base = NULL;
+        output.bmp_mapped_length = 0;
+        output.bmp_Compression = BI_RGB;
+        output.bmp_data_length = data_byte;
+        output.bmp_color_table = new RgbQuad[2]();
+        output.bmp_data_array = PixelAlloc(data_byte);
+        TRACE_ALLOC(2 * sizeof(RgbQuad));
+        TRACE_BYTES(2 * data_byte);
+        
+        output.bmp_color_table[1].rgbBlue = 255;
+        output.bmp_color_table[1].rgbGreen = 255;
+        output.bmp_color_table[1].rgbRed = 255;
+        memcpy(output.bmp_data_array, bitmap_array, data_byte);    //the rows and their padding are BMP rows already.
+    }
+    else if (is_gray) {
         output.bmp_BitCount = 8;
-        line_byte = (width * output.bmp_BitCount / 8 + 3) / 4 * 4;
+        line_byte = (width * output.bmp_BitCount + 31) / 32 * 4;
         data_byte = line_byte * height;
         output.bmp_Height = height;
         output.bmp_Width = width;
+        output.bmp_mapped_base = NULL;
+        output.bmp_mapped_length = 0;
+        output.bmp_Compression = BI_RGB;
+        output.bmp_data_length = data_byte;
         output.bmp_color_table = new RgbQuad[256]();
-        output.bmp_data_array = new unsigned char[data_byte]();
+        output.bmp_data_array = PixelAlloc(data_byte);
+        TRACE_ALLOC(256 * sizeof(RgbQuad));
+        TRACE_BYTES(width * height + data_byte);
         
         for (x = 0; x < 256; x++) {
             output.bmp_color_table[x].rgbBlue = x;
@@ -348,27 +623,169 @@ bmpData BitMapImg::TransToBmp(void) {
         }
         
         for (y = 0; y < height; y++) {
-            for (x = 0; x < width; x++) {
-                output.bmp_data_array[y * line_byte + x] = bitmap_array[y * width + x];
-            }
+            memcpy(output.bmp_data_array + y * line_byte, bitmap_array + y * width, width);
+            memset(output.bmp_data_array + y * line_byte + width, 0, line_byte - width);   //not zeroed by PixelAlloc
         }
     }
     else {
         output.bmp_BitCount = 24;
-        line_byte = (width * output.bmp_BitCount / 8 + 3) / 4 * 4;
+        line_byte = (width * output.bmp_BitCount + 31) / 32 * 4;
         data_byte = line_byte * height;
         output.bmp_color_table = NULL;
         output.bmp_Height = height;
         output.bmp_Width = width;
-        output.bmp_data_array = new unsigned char[data_byte]();
+        output.bmp_mapped_base = NULL;
+        output.bmp_mapped_length = 0;
+        output.bmp_Compression = BI_RGB;
+        output.bmp_data_length = data_byte;
+        output.bmp_data_array = PixelAlloc(data_byte);
+        TRACE_BYTES(width * height * 3 + data_byte);
         
         for (y = 0; y < height; y++) {
-            for (x = 0; x < width * 3; x++) {
-                output.bmp_data_array[y * line_byte + x] = bitmap_array[y * width * 3 + x];
+            if (is_planar) {
+                Interleave_Simd(bitmap_array + y * PlaneStride(width), bitmap_array + PlaneByte(width, height) + y * PlaneStride(width),
+                                bitmap_array + PlaneByte(width, height) * 2 + y * PlaneStride(width), output.bmp_data_array + y * line_byte, width);
             }
+            else
+                memcpy(output.bmp_data_array + y * line_byte, bitmap_array + y * width * 3, width * 3);
+            memset(output.bmp_data_array + y * line_byte + width * 3, 0, line_byte - width * 3);
         }
     }
     return output;
 }
 
+BitMapImg::BitMapImg(PixelBuffer &&pixels) {
+    long row_byte = pixels.GetWidth() * pixels.GetChannel();
+    
+    if (1 != pixels.GetChannel() && 3 != pixels.GetChannel())
+        throw IMG_BAD_CHANNEL;
+    
+    width = pixels.GetWidth();
+    height = pixels.GetHeight();
+    is_gray = (1 == pixels.GetChannel());
+    is_planar = false;
+    is_packed = false;
+    if (row_byte != pixels.GetStride()) {
+        //pack the rows in place, every row only moves to a lower address.
+        for (long y = 1; y < height; y++)
+            memmove(pixels.GetArray() + y * row_byte, pixels.GetRow(y), row_byte);
+    }
+    bitmap_array = pixels.ReleaseArray(mapped_base, mapped_length);
+}
+
+void BitMapImg::SetPlanar(bool planar) {
+    long pixel_count = width * height;
+    long stride = PlaneStride(width);
+    long plane_byte = PlaneByte(width, height);
+    unsigned char* target;
+    unsigned char* plane_row;
+    
+    if (is_gray || planar == is_planar)
+        return;
+    
+    TRACE_SCOPE("SetPlanar", "BitMapImg");
+    TRACE_BYTES(pixel_count * 6);
+    target = PixelAlloc(planar ? plane_byte * 3 : pixel_count * 3);
+    for (long y = 0; y < height; y++) {
+        if (planar) {
+            plane_row = target + y * stride;
+            Deinterleave_Simd(bitmap_array + y * width * 3, plane_row, plane_row + plane_byte, plane_row + plane_byte * 2, width);
+            for (int c = 0; c < 3; c++)
+                memset(plane_row + c * plane_byte + width, 0, stride - width);  //not zeroed by PixelAlloc
+        }
+        else {
+            plane_row = bitmap_array + y * stride;
+            Interleave_Simd(plane_row, plane_row + plane_byte, plane_row + plane_byte * 2, target + y * width * 3, width);
+        }
+    }
+    
+    FreeBitmapArray();
+    bitmap_array = target;
+    is_planar = planar;
+}
+
+void BitMapImg::SetPacked(bool packed) {
+    long line_byte = PackedLine(width);
+    unsigned char* target;
+    
+    if (packed && !is_gray)
+        throw IMG_NOT_GRAY;
+    if (!is_gray || packed == is_packed)
+        return;
+    if (packed) {
+        PackRows(128);
+        return;
+    }
+    
+    TRACE_SCOPE("SetPacked", "BitMapImg");
+    TRACE_BYTES(line_byte * height + width * height);
+    target = PixelAlloc(width * height);
+    for (long y = 0; y < height; y++)
+        UnpackBits_Simd(bitmap_array + y * line_byte, target + y * width, width);
+    
+    FreeBitmapArray();
+    bitmap_array = target;
+    is_packed = false;
+}
+
+void BitMapImg::PackRows(int threshold) {
+    long line_byte = PackedLine(width);
+    long used_byte = (width + 7) / 8;
+    unsigned char* target;
+    
+    TRACE_SCOPE("PackRows", "BitMapImg");
+    TRACE_BYTES(width * height + line_byte * height);
+    target = PixelAlloc(line_byte * height);
+    for (long y = 0; y < height; y++) {
+        PackBits_Simd(bitmap_array + y * width, target + y * line_byte, width, threshold);
+        memset(target + y * line_byte + used_byte, 0, line_byte - used_byte);   //not zeroed by PixelAlloc
+    }
+    
+    FreeBitmapArray();
+    bitmap_array = target;
+    is_packed = true;
+}
+
+void BitMapImg::ClearPackedPadding(void) {
+    long line_byte = PackedLine(width);
+    long used_byte = (width + 7) / 8;
+    unsigned char* row;
+    
+    for (long y = 0; y < height; y++) {
+        row = bitmap_array + y * line_byte;
+        if (0 != width % 8)
+            row[used_byte - 1] &= (unsigned char)(0xFF00 >> (width % 8));
+        memset(row + used_byte, 0, line_byte - used_byte);
+    }
+}
+
+PixelBuffer BitMapImg::TakePixels(void) {
+    SetPlanar(false);
+    SetPacked(false);
+    PixelBuffer pixels(bitmap_array, width, height, is_gray ? 1 : 3, 0, mapped_base, mapped_length);
+    
+    bitmap_array = NULL;
+    mapped_base = NULL;
+    mapped_length = 0;
+    width = 0;
+    height = 0;
+    is_gray = false;
+    return pixels;
+}
+
+int BitMapImg::SaveToBmp(char* save_file_path, bool direct_io) {
+    if (is_planar) {
+        long stride = PlaneStride(width);
+        long plane_byte = PlaneByte(width, height);
+        PixelBuffer interleaved(width, height, 3);
+        
+        for (long y = 0; y < height; y++) {
+            Interleave_Simd(bitmap_array + y * stride, bitmap_array + plane_byte + y * stride, bitmap_array + plane_byte * 2 + y * stride,
+                            interleaved.GetRow(y), width);
+        }
+        return SaveBmp_Gather(save_file_path, interleaved.GetArray(), width, height, 24, direct_io);
+    }
+    return SaveBmp_Gather(save_file_path, bitmap_array, width, height, is_packed ? 1 : (is_gray ? 8 : 24), direct_io);
+}
+
 #endif /* BitMapImg_BaseClass_hpp */
@@ -3,18 +3,31 @@
 
  (1) GrayTrans(bmpData org_bmp_img) : BitMapImg(org_bmp_img);
  
- (2) GrayTrans(BitMapImg &org);
- * copy from a BitMapImg object.
+ (2) ColorTrans(BitMapImg &&org) : BitMapImg(std::move(org));
+ * take the pixels of a BitMapImg (or any derived) object, nothing is copied, org is left empty.
  
  (3) void ColorToGray(void);
  * Trans color(24-bit) to gray(8-bit) with formula:
  * I = 0.3 * Blue + 0.59 * Green + 0.11 * Red
+ * A planar image (see BitMapImg <SetPlanar>) is read plane by plane (<PlanarToGray_Simd>, one row at a time), no shuffles.
  
- (4) void Binary(int threshold = 128);
+ (4) void Binary(int threshold = 128, int window = 0, double k = 0, bool packed = false);
  * Only processing gray images.
  * If is_gray_form == false, will call <ColorToGray> first.
+ * threshold 0 ~ 256: pixels < threshold become 0, the others 255, the same threshold everywhere. Or:
+ * BINARY_OTSU: the threshold is found from the histogram (see <Histogram_Otsu>), for images of two tones.
+ * BINARY_SAUVOLA, BINARY_BRADLEY: every pixel has its own threshold from the window * window pixels
+ * around it (see <Binary_Sauvola>, <Binary_Bradley>), for unevenly lit scans.
+ * k: Sauvola's k (0.2 when 0) or Bradley's t (0.15 when 0);
+ * window: odd, 15 (Sauvola) or width / 8 (Bradley) when 0.
+ * In parallel, the cost does not depend on window.
+ * StreamTrans / PipelineTrans / BatchTrans take only the first form: they never see the whole image at once.
+ * packed: the result is packed to 1 bit per pixel (see BitMapImg <SetPacked>), e.g. to be saved as a 1-bit BMP.
+ * With one threshold for all pixels, the gray pixels are compared and packed in one pass (<PackBits_Simd>),
+ * the 0 / 255 bytes are never written.
  
  (5) void Reverse(void);
+ * A packed image is reversed on its bits, whole bytes at a time, then the padding bits are cleared.
  
  (6) void LogarithmStretch(double a, double b, double c);
  * g(x, y) = a + ln[f(x, y) + 1] / (b * lnc)
@@ -26,6 +39,35 @@
  * Reference: a = 128, b = 2, c = 0.6
  * Usually darker.
  
+ (8) static void ColorToGray_Array(const unsigned char* bgr_array, unsigned char* gray_array, long pixel_count);
+     static void Binary_Array(unsigned char* array, long array_length, int threshold);
+     static void Reverse_Array(unsigned char* array, long array_length);
+     static void LogarithmStretch_Array(unsigned char* array, long array_length, double a, double b, double c);
+     static void ExponentStretch_Array(unsigned char* array, long array_length, double a, double b, double c);
+ * The kernels of (3)~(7), working on any piece of pixels (e.g. a band of rows).
+ * bgr_array and gray_array of <ColorToGray_Array> may be the same array.
+ * ColorToGray, Binary and Reverse run with SSSE3 / AVX2 when the CPU has them (see basic_simd.cpp).
+ * The two stretches compile their curve to a 256-byte lookup table first (see basic_lut.cpp).
+ 
+ (9) void ApplyLut(const unsigned char* lut);
+ * Apply a lookup table made by Lut_xxx (basic_lut.cpp) on every byte (every channel) in one pass,
+ * e.g. several point operations composed into one table.
+ * (5)~(7) and (9) work on every byte the same way, so they run on a planar image as it is (the padding of its rows too).
+ * (6), (7), (9) (and (4) on the gray pixels) unpack a packed image first.
+ 
+ (10) void GetHistogram(Histogram* histogram);
+      void GetStats(ChannelStats* stats);
+ * The histogram of every channel (1: gray; 3: B, G, R, also of a planar image), see <Histogram_Array>,
+ * and min, max, mean, standard deviation of every channel (stats[0] ... stats[channel_count - 1]).
+ * Only read the pixels, in parallel. A packed image only counts its 1 bits (<Histogram_Bits>).
+ 
+ (11) void Equalize(void);
+      void AutoContrast(double low_percent = 0.5, double high_percent = 0.5);
+ * Histogram equalization / auto-contrast of the whole image (see <Lut_Equalize>, <Lut_AutoContrast>):
+ * the histogram is counted once, the curve made from it, and applied by <ApplyLut>,
+ * no parameter to tune by hand (as ExponentStretch needs).
+ 
+ 
  *****************************************************************************/
 
 #ifndef ColorTrans_Class_hpp
@@ -33,26 +75,36 @@
 
 #include <cmath>
 
+//threshold of <ColorTrans::Binary> for the thresholds found from the image.
+#define BINARY_OTSU     -1
+#define BINARY_SAUVOLA  -2
+#define BINARY_BRADLEY  -3
+
 class ColorTrans : public BitMapImg {
 //functions:
 public:
     ColorTrans(bmpData org_bmp_img) : BitMapImg(org_bmp_img) {
         return;
     }
-    ColorTrans(BitMapImg &org) {
-        width = org.GetWidth();
-        height = org.GetHeight();
-        is_gray = org.GetGrayForm();
-        bitmap_array = org.MoveBitmapDataTo(bitmap_array);
-        delete &org;
-        
+    ColorTrans(BitMapImg &&org) : BitMapImg(std::move(org)) {
         return;
     }
     void ColorToGray(void);
-    void Binary(int threshold);
+    void Binary(int threshold, int window, double k, bool packed);
     void Reverse(void);
     void LogarithmStretch(double a, double b, double c);
     void ExponentStretch(double a, double b, double c);
+    void ApplyLut(const unsigned char* lut);
+    void GetHistogram(Histogram* histogram);
+    void GetStats(ChannelStats* stats);
+    void Equalize(void);
+    void AutoContrast(double low_percent, double high_percent);
+    
+    static void ColorToGray_Array(const unsigned char* bgr_array, unsigned char* gray_array, long pixel_count);
+    static void Binary_Array(unsigned char* array, long array_length, int threshold);
+    static void Reverse_Array(unsigned char* array, long array_length);
+    static void LogarithmStretch_Array(unsigned char* array, long array_length, double a, double b, double c);
+    static void ExponentStretch_Array(unsigned char* array, long array_length, double a, double b, double c);
 };
 
 
@@ -61,78 +113,171 @@ void ColorTrans::ColorToGray (void) {
     if (is_gray)
         return;
     
-    unsigned char* gray_bitmap_array = new unsigned char[height * width];
-    for (long i = 0; i < height * width; i++) {
-        gray_bitmap_array[i] = 0.3 * bitmap_array[i * 3] + 0.59 * bitmap_array[i * 3 + 1] + 0.11 * bitmap_array[i * 3 + 2];
+    TRACE_SCOPE("ColorToGray", "ColorTrans");
+    unsigned char* gray_bitmap_array = PixelAlloc(height * width);
+    TRACE_BYTES(height * width * 4);
+    if (is_planar) {
+        for (long y = 0; y < height; y++) {
+            PlanarToGray_Simd(bitmap_array + y * PlaneStride(width), bitmap_array + PlaneByte(width, height) + y * PlaneStride(width),
+                              bitmap_array + PlaneByte(width, height) * 2 + y * PlaneStride(width), gray_bitmap_array + y * width, width);
+        }
     }
+    else
+        ColorToGray_Array(bitmap_array, gray_bitmap_array, height * width);
     
-    delete [] bitmap_array;
+    FreeBitmapArray();
     bitmap_array = gray_bitmap_array;
     is_gray = true;
+    is_planar = false;
 }
 
-void ColorTrans::Binary(int threshold = 128) {
+void ColorTrans::Binary(int threshold = 128, int window = 0, double k = 0, bool packed = false) {
     if (!is_gray)
         ColorToGray();
+    SetPacked(false);
     
-    for (long i = 0; i < height * width; i++) {
-        if (bitmap_array[i] < threshold)
-            bitmap_array[i] = 0;
+    if (BINARY_SAUVOLA == threshold || BINARY_BRADLEY == threshold) {
+        if (BINARY_SAUVOLA == threshold)
+            Binary_Sauvola(bitmap_array, width, height, (0 == window) ? 15 : window, (0 == k) ? 0.2 : k);
         else
-            bitmap_array[i] = 255;
+            Binary_Bradley(bitmap_array, width, height, (0 == window) ? width / 16 * 2 + 1 : window, (0 == k) ? 0.15 : k);
+        SetPacked(packed);
+        return;
+    }
+    if (BINARY_OTSU == threshold) {
+        Histogram histogram;
+        GetHistogram(&histogram);
+        threshold = Histogram_Otsu(&histogram, 0);
     }
+    if (packed) {
+        PackRows(threshold);
+        return;
+    }
+    TRACE_SCOPE("Binary", "ColorTrans");
+    TRACE_BYTES(2 * height * width);
+    Binary_Array(bitmap_array, height * width, threshold);
 }
 
 void ColorTrans::Reverse(void) {
-    long array_length = 0;
-    if (is_gray)
-        array_length = height * width;
-    else
-        array_length = height * width * 3;
+    long array_length = ArrayLength(width, height);
     
-    for (long i = 0; i < array_length; i++) {
-        bitmap_array[i] = 255 - bitmap_array[i];
-    }
+    TRACE_SCOPE("Reverse", "ColorTrans");
+    TRACE_BYTES(2 * array_length);
+    Reverse_Array(bitmap_array, array_length);
+    if (is_packed)
+        ClearPackedPadding();
 }
 
 void ColorTrans::LogarithmStretch(double a = 0, double b = 0.033, double c = 2) {
-    long array_length = 0;
-    if (is_gray)
-        array_length = height * width;
-    else
-        array_length = height * width * 3;
+    long array_length;
     
-    double result;
-    
-    for (long i = 0; i < array_length; i++) {
-        result = a + (log(bitmap_array[i] + 1)) / (b * log(c));
-        if (result > 255)
-            result = 255;
-        else if (result < 0)
-            result = 0;
-        
-        bitmap_array[i] = (int)result;
-    }
+    SetPacked(false);
+    array_length = ArrayLength(width, height);
+    TRACE_SCOPE("LogarithmStretch", "ColorTrans");
+    TRACE_BYTES(2 * array_length);
+    LogarithmStretch_Array(bitmap_array, array_length, a, b, c);
 }
 
 void ColorTrans::ExponentStretch(double a = 128, double b = 2, double c = 0.6) {
-    long array_length = 0;
-    if (is_gray)
-        array_length = height * width;
-    else
-        array_length = height * width * 3;
+    long array_length;
+    
+    SetPacked(false);
+    array_length = ArrayLength(width, height);
+    TRACE_SCOPE("ExponentStretch", "ColorTrans");
+    TRACE_BYTES(2 * array_length);
+    ExponentStretch_Array(bitmap_array, array_length, a, b, c);
+}
+
+void ColorTrans::ApplyLut(const unsigned char* lut) {
+    long array_length;
     
-    double result;
+    SetPacked(false);
+    array_length = ArrayLength(width, height);
+    TRACE_SCOPE("ApplyLut", "ColorTrans");
+    TRACE_BYTES(2 * array_length);
+    ApplyLut_Simd(bitmap_array, array_length, lut);
+}
+
+void ColorTrans::GetHistogram(Histogram* histogram) {
+    Histogram plane;
     
-    for (long i = 0; i < array_length; i++) {
-        result = pow(b, (c * (bitmap_array[i] - a))) - 1;
-        if (result > 255)
-            result = 255;
-        else if (result < 0)
-            result = 0;
-        
-        bitmap_array[i] = (int)result;
+    if (is_packed) {
+        Histogram_Bits(bitmap_array, ArrayLength(width, height), width * height, histogram);
+        return;
+    }
+    if (!is_planar) {
+        Histogram_Array(bitmap_array, width * height, is_gray ? 1 : 3, histogram);
+        return;
+    }
+    //every plane as a gray image of PlaneStride columns, less the padding bytes of every row.
+    histogram->channel_count = 3;
+    histogram->pixel_count = width * height;
+    for (int c = 0; c < 3; c++) {
+        Histogram_Array(bitmap_array + c * PlaneByte(width, height), PlaneByte(width, height), 1, &plane);
+        for (long y = 0; y < height; y++) {
+            for (long x = width; x < PlaneStride(width); x++)
+                plane.count[0][bitmap_array[c * PlaneByte(width, height) + y * PlaneStride(width) + x]]--;
+        }
+        memcpy(histogram->count[c], plane.count[0], sizeof(plane.count[0]));
     }
 }
 
+void ColorTrans::GetStats(ChannelStats* stats) {
+    Histogram histogram;
+    
+    GetHistogram(&histogram);
+    for (int c = 0; c < histogram.channel_count; c++)
+        Histogram_Stats(&histogram, c, &stats[c]);
+}
+
+void ColorTrans::Equalize(void) {
+    Histogram histogram;
+    unsigned char lut[256];
+    
+    TRACE_SCOPE("Equalize", "ColorTrans");
+    GetHistogram(&histogram);
+    Lut_Identity(lut);
+    Lut_Equalize(lut, &histogram);
+    ApplyLut(lut);
+}
+
+void ColorTrans::AutoContrast(double low_percent = 0.5, double high_percent = 0.5) {
+    Histogram histogram;
+    unsigned char lut[256];
+    
+    TRACE_SCOPE("AutoContrast", "ColorTrans");
+    GetHistogram(&histogram);
+    Lut_Identity(lut);
+    Lut_AutoContrast(lut, &histogram, low_percent, high_percent);
+    ApplyLut(lut);
+}
+
+void ColorTrans::ColorToGray_Array(const unsigned char* bgr_array, unsigned char* gray_array, long pixel_count) {
+    ColorToGray_Simd(bgr_array, gray_array, pixel_count);
+}
+
+void ColorTrans::Binary_Array(unsigned char* array, long array_length, int threshold) {
+    Binary_Simd(array, array_length, threshold);
+}
+
+void ColorTrans::Reverse_Array(unsigned char* array, long array_length) {
+    Reverse_Simd(array, array_length);
+}
+
+void ColorTrans::LogarithmStretch_Array(unsigned char* array, long array_length, double a, double b, double c) {
+    unsigned char lut[256];
+    
+    Lut_Identity(lut);
+    Lut_LogarithmStretch(lut, a, b, c);
+    ApplyLut_Simd(array, array_length, lut);
+}
+
+void ColorTrans::ExponentStretch_Array(unsigned char* array, long array_length, double a, double b, double c) {
+    unsigned char lut[256];
+    
+    Lut_Identity(lut);
+    Lut_ExponentStretch(lut, a, b, c);
+    ApplyLut_Simd(array, array_length, lut);
+}
+
 #endif /* ColorTrans_Class_hpp */
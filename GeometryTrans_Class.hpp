@@ -1,25 +1,67 @@
 /* ***************************************************************************
- functions in this (ColorTrans_Class.hpp) hpp file:
-
+ functions in this (GeometryTrans_Class.hpp) hpp file:
+ 
  (1) GeometryTrans(bmpData org_bmp_img) : BitMapImg(org_bmp_img);
  
- (2) GeometryTrans(BitMapImg &org);
- * copy from a BitMapImg object.
+ (2) GeometryTrans(BitMapImg &&org) : BitMapImg(std::move(org));
+ * take the pixels of a BitMapImg (or any derived) object, nothing is copied, org is left empty.
  
  (3) (inline) void Zoom(long out_width, long out_height, int select_algorithm = 1);
-    1-> void Zoom_Neighbor(long out_width, long out_height);
-    2-> void Zoom_DoubleLinear(long out_width, long out_height);
-    3-> void Zoom_Convolution(long out_width, long out_height);
+    1-> template <int CH> static void Zoom_Neighbor(const GeometryTask &task, ImgBand &out);
+    2-> template <int CH, class Interp> static void Zoom_Interpolate(const GeometryTask &task, ImgBand &out);  (Interp_DoubleLinear)
+    3-> template <int CH, class Interp> static void Zoom_Interpolate(const GeometryTask &task, ImgBand &out);  (Interp_Convolution)
+    4-> template <int CH, class Interp> static void Zoom_Separable(const GeometryTask &task, ImgBand &out);  (Interp_DoubleLinear)
+    5-> template <int CH, class Interp> static void Zoom_Separable(const GeometryTask &task, ImgBand &out);  (Interp_Convolution)
+    6-> template <int CH, class Sum> static void Zoom_Area(const GeometryTask &task, ImgBand &out);
  * Zoom the image to a given size.
  * 1 is the fastest, 3 is the clearest.
+ * 4 and 5 are 2 and 3 done as two passes (horizontal, then vertical), much faster:
+ * the weights of every column and every row are computed once (<Zoom_SeparableTable>),
+ * in 14-bit fixed point, and the vertical pass runs with SIMD (see <VerticalSum_Simd>).
+ * Near the margin they repeat the edge pixels instead of falling back to Neighbor,
+ * so the results are close to (not the same as) 2 and 3.
+ * 6 is the average of the box of original pixels every zoomed pixel covers (see <Zoom_AreaBoxes>),
+ * for shrinking by any ratio without aliasing: 1 ~ 5 only read 1, 4 or 16 pixels around.
+ * A summed-area table of org is built first (<Zoom_AreaStrip>), then every box sum is 4 lookups,
+ * so the time does not grow with the ratio: about one pass over the image and one over the table.
+ * When enlarging, every box is a single pixel (like 1, but rounded down).
+ * The kernels only fill rows [out.first_row, out.last_row), columns [out.first_col, out.last_col)
+ * of the zoomed image, reading rows [org.first_row, org.last_row) of the original one,
+ * so they can also work on bands of a stream (see <Zoom_SourceRows>) and on tiles.
+ 
+ (3.1) static void Zoom_Band(const ImgBand &org, ImgBand &out, int select_algorithm);
+ * Call one of the kernels above on all the tiles of out, select_algorithm is the same as <Zoom>.
+ 
+ (3.2) static void Zoom_SeparableTable(long org_size, long out_size, long out_first, long out_last, int taps, long* index, short* weight);
+ * For out columns (rows) [out_first, out_last), the source columns (rows) and their weights:
+ * index[(x - out_first) * taps + t], weight[...] (sum of the weights of x is 16384).
+ * taps: 2 (DoubleLinear) or 4 (Convolution).
+ 
+ (3.3) static void Zoom_SourceRows(long org_height, long out_height, long out_first_row, long out_last_row, long &org_first_row, long &org_last_row);
+ * Which original rows [org_first_row, org_last_row) are needed
+ * to zoom out rows [out_first_row, out_last_row), for any select_algorithm.
+ 
+ (3.4) static void Zoom_AreaBoxes(long org_size, long out_size, long out_first, long out_last, long org_first, long* index);
+ * For out columns (rows) [out_first, out_last) of <Zoom_Area>, the box of source columns (rows)
+ * [index[(x - out_first) * 2], index[(x - out_first) * 2 + 1]), counted from org_first:
+ * [x * org_size / out_size, (x + 1) * org_size / out_size), at least 1 pixel.
+ 
+ (3.5) template <int CH, class Sum> static void Zoom_AreaStrip(long strip_index, void* context);
+ * tile_function of <RunTiles>, context is the GeometryTask: rows of the summed-area table task.area_table,
+ * table[r][c] = sum of org rows [org.first_row, org.first_row + r), columns [0, c), one per channel,
+ * (org.last_row - org.first_row + 1) x (org.width + 1) x CH Sums.
+ * Every strip of GEOMETRY_AREA_STRIP rows starts its sums from 0, so all strips are built at the same time,
+ * the sums of the strips above it are added back from task.area_carry (see <Zoom_Area>).
+ * Sum is unsigned int, or unsigned long long when a box may hold more than 2^32 / 255 pixels:
+ * the sums wrap around, but the difference of 4 of them (a box) is still right.
  
  (4) (inline) void Rotate(double degree, int select_algorithm = 1, unsigned char color_default = 255, bool cut = 0);
     1-> void Rotate_90(void);
     2-> void Rotate_180(void);
     3-> void Rotate_270(void);
-    4-> void Rotate_Neighbor(double degree, unsigned char color_default, bool cut);
-    5-> void Rotate_DoubleLinear(double degree, unsigned char color_default, bool cut);
-    6-> void Rotate_Convolution(double degree, unsigned char color_default, bool cut);
+    4-> void Rotate_Resample(int kernel, double degree, unsigned char color_default, bool cut);  (GEOMETRY_ROTATE_NEIGHBOR)
+    5-> void Rotate_Resample(int kernel, double degree, unsigned char color_default, bool cut);  (GEOMETRY_ROTATE_DOUBLELINEAR)
+    6-> void Rotate_Resample(int kernel, double degree, unsigned char color_default, bool cut);  (GEOMETRY_ROTATE_CONVOLUTION)
  * Rotate (clockwise)(degree).
  * color_default: usually white(255) or black(0).
  * cut: what about the other part out of a rectangle, cut or remain?
@@ -29,6 +71,106 @@
  * So, g(x', y') = f(u, v) : [(a,b), (c,d) are the center before & after rotation]
  * u = x'cos() - y'sin() - c cos() + d cos() + a;
  * v = x'sin() + y'cos() - c sin() - d cos() + b;
+ * Every one of them works through a GeometryTask, by the tile kernels:
+    template <int CH> static void Rotate_90_Tile(const GeometryTask &task, ImgBand &out);
+    template <int CH> static void Rotate_180_Tile(const GeometryTask &task, ImgBand &out);
+    template <int CH> static void Rotate_270_Tile(const GeometryTask &task, ImgBand &out);
+    template <int CH, class Interp, class Border> static void Rotate_Tile(const GeometryTask &task, ImgBand &out);
+ * Rotate_90 / 270 use square tiles (GEOMETRY_TRANSPOSE_TILE), so a few source rows are read at a time,
+ * not a whole column (a cache miss and a TLB miss for every pixel);
+ * inside, full 16 x 16 gray / 8 x 8 BGR blocks are transposed with SIMD
+ * (see <Transpose16_Simd>, <Transpose8_BGR_Simd>).
+ * Rotate_Resample (DoubleLinear / Convolution) walks every row by DDA:
+ * (u, v) of x + 1 is (u, v) of x + (cos, sin), added in 32.32 fixed point,
+ * and uses 8 bits of the fraction and integer weights.
+ * Rotate_Resample (Neighbor) keeps the original double expression of (u, v) for every pixel, so it picks the same pixels as before.
+ * For all three, the part of the row inside the original image is one interval (<Rotate_RowSpan>),
+ * so the pixels out of it are set by memset, and the ones inside need no bounds check.
+ * Zoom and Rotate_Resample unpack a packed image first (see BitMapImg <SetPacked>),
+ * Rotate_90 / 180 / 270 keep it packed (<Rotate_Packed>).
+ 
+ (4.0) void Rotate_Square_InPlace(bool clockwise);
+ * Only with rotate_square_in_place defined: Rotate_90 / 270 of a square (not planar) image in its own array,
+ * by a blocked transpose and a flip, no second array (half the memory, but one thread).
+ 
+ (4.0.1) static void Rotate_RowSpan(const GeometryTask &task, long y, double offset, double low, double high_margin, bool truncate,
+                                    long first_col, long last_col, long &first_x, long &last_x, long long &pos_x, long long &pos_y);
+ * For row y of the rotated image, the columns [first_x, last_x) in [first_col, last_col) where
+ * low <= u + offset < org.width - high_margin and low <= v + offset < org.height - high_margin,
+ * and (u + offset, v + offset) of first_x in fixed point.
+ * truncate (Neighbor: offset 0.5, low 0, high_margin 0): the columns are decided by the original double
+ * expression (long)(x * cos_d + y * row_u + temp1 + 0.5), rounded toward zero, not by the fixed point,
+ * which may round the other way where u + 0.5 is a whole number or close to one. That expression only
+ * grows (or only falls) with x, so the columns inside are still one interval.
+ * DoubleLinear: 0, 0, 1, not truncate; Convolution: 0, 1, 2, not truncate.
+ * (u, v) is the general map of GeometryTask (row_u, row_v), so the kernels can resample
+ * any affine map, e.g. the composed Zoom / Rotate of PipelineTrans.
+ 
+ (4.0.2) static void Border_Clamp::EdgeSpan(const GeometryTask &task, long y, long first_col, long last_col, long long step_x, long long step_y,
+                                          long &first_x, long &last_x, long long &pos_x, long long &pos_y, long &edge_first, long &edge_last);
+     template <int CH, class Interp> static void Rotate_EdgePixels(const GeometryTask &task, Interp &interp, long first_x, long last_x,
+                                                                  long long pos_x, long long pos_y, long long step_x, long long step_y, unsigned char* result);
+     static void Rotate_CubicWeight(int fraction, int* weight);
+ * Only with task.clamp_edge (Border_Clamp): [edge_first, edge_last) are the columns with -1 <= u < org.width and -1 <= v < org.height,
+ * the ones of them out of [first_x, last_x) are done pixel by pixel (<Rotate_EdgePixels>, the weights of Interp),
+ * with the source pixels clamped into org. Border_Fill (no clamp_edge): edge_first = first_x, edge_last = last_x.
+ * <Rotate_CubicWeight>: s(w) of the 4 taps for an 8-bit fraction, 14 bits.
+ 
+ (4.0.3) static void Rotate_Box(long width, long height, double degree, bool cut, long &out_width, long &out_height,
+                                double &sin_d, double &cos_d, double &temp1, double &temp2);
+ * Size of the image rotated by degree, and sin_d, cos_d, temp1, temp2 of its GeometryTask.
+ * Shared by <Rotate_Resample> and PipelineTrans.
+ 
+ (4.0.4) void Rotate_Packed(int kernel);
+         static void Rotate_PackedTile(long tile_index, void* context);
+ * Rotate_90 / 180 / 270 (kernel GEOMETRY_ROTATE_xxx) of a packed image, on its bits, 64 pixels at a time,
+ * task.org / task.out of the GeometryTask (the context) hold rows of <PackedLine> bytes.
+ * 90 / 270: a tile is GEOMETRY_TRANSPOSE_TILE columns of the original image (rows of the result);
+ * the bytes of 8 rows in one byte column are an 8 x 8 block of pixels, one 64-bit word,
+ * transposed by <Rotate_Transpose8x8> and stored as one byte of 8 rows of the result.
+ * 180: a tile is GEOMETRY_TRANSPOSE_TILE rows, every row of the result is read from the other end of its original row,
+ * 64 bits at a time (at any bit offset, as the padding bits are at the end of both) and reversed by <Rotate_ReverseBits>.
+ * The padding bits of the result are 0, as the rows or columns out of the image are read as 0.
+ 
+ (4.0.5) static unsigned long long Rotate_Transpose8x8(unsigned long long block);
+         static unsigned long long Rotate_ReverseBits(unsigned long long word);
+ * An 8 x 8 bit matrix (byte 0 the top byte, bit 7 of a byte its first column) transposed by 3 rounds of masked shifts
+ * (2 x 2 blocks of bits, then of 2 x 2, then of 4 x 4), and the 64 bits of a word in reverse order
+ * (swap bits, pairs, nibbles, bytes, ... of the word), about 20 operations each instead of 64 single bits.
+ 
+ (4.1) static void RunGeometryTask(GeometryTask &task);
+ * Split task.out into GEOMETRY_TILE_ROWS x GEOMETRY_TILE_COLS tiles (see <GeometryTileSize>),
+ * and run the kernel of task on them with <RunTiles> (all cores, see <SetThreadCount>).
+ * Every output pixel only depends on the original image, so the result is the same as in one thread.
+ * The kernel is picked once here (task.tile_kernel, see <GeometryKernelOf>), not per tile or per pixel.
+ 
+ (4.1.1) void RunPlanes(GeometryTask &task);
+ * <RunGeometryTask> on this image: once, or for a planar one (see BitMapImg <SetPlanar>) once per plane,
+ * with 1-byte pixels (task.org / task.out are plane 0, rows of <PlaneStride> bytes, task.out.band_array holds <ArrayLength> bytes).
+ * Every kernel does each channel on its own with the same weights, so the result is the same as interleaved,
+ * but the gray paths run: Transpose16_Simd instead of Transpose8_BGR_Simd, 1-byte loops in the resampling.
+ * Zoom runs <Zoom_Band> per plane the same way.
+ 
+ (4.2) static void GeometryTile(long tile_index, void* context);
+     static void GeometryTileSize(int kernel, long &tile_height, long &tile_width);
+     static GeometryKernelFunction GeometryKernelOf(const GeometryTask &task);
+ * tile_function of <RunTiles>, context is the GeometryTask, it runs task.tile_kernel on one tile.
+ * <GeometryKernelOf>: the instance of the kernel templates for task.kernel, task.taps (Zoom_Separable, Zoom_Area),
+ * task.clamp_edge (Rotate_Tile) and task.org.pixel_byte.
+ 
+ (4.3) Kernel templates:
+ * CH: bytes per pixel (1: gray or one plane, 3: B, G, R), a constant, so the channel loops are unrolled.
+ * Interp: interpolation policy, Interp_Neighbor / Interp_DoubleLinear / Interp_Convolution.
+     enum {taps, low, high_margin, nearest}: the source pixels u - low ~ u - low + taps - 1 (the same for v),
+     nearest: rounded to the nearest pixel (offset 0.5 and truncate of <Rotate_RowSpan>).
+     template <int CH> void Sample(const ImgBand &org, long long pos_x, long long pos_y, unsigned char* result);
+         one pixel of the DDA of Rotate_Tile (fixed point position, no bounds check).
+     void Weights(int fraction_x, int fraction_y, int* weight_x, int* weight_y);
+         the same weights in 14 bits, for <Rotate_EdgePixels>.
+     static unsigned char Core(unsigned char around[taps][taps], double x_pos, double y_pos);
+         <Interpolation_DoubleLinear_core> / <Interpolation_Convolution_core>, for Zoom_Interpolate.
+ * Border: border policy of Rotate_Tile, Border_Fill (color_default) / Border_Clamp (task.clamp_edge), see (4.0.2).
+ * The instances give the same pixels as the kernels with a run time pixel_byte did.
  
  (5) unsigned char Interpolation_DoubleLinear_core(unsigned char around[2][2], double x_pos, double y_pos);
  * Chinese name (utf-8): 双线性插值法
@@ -46,13 +188,67 @@
  *        {1 - 2|w|^2 + |w|^3            ,|w| < 1;
  * s(w) = {4 - 8|w| + 5|w|^2 - |w|^3     ,1 <= |w| < 2;
  *        {0                             ,|w| >= 2.
-
+ 
 *****************************************************************************/
 
 #ifndef GeometryTrans_Class_hpp
 #define GeometryTrans_Class_hpp
 
 #include <cmath>
+#include <cstring>
+
+//#define rotate_square_in_place
+
+//about 12KB of output per tile, with its source it still fits in L1/L2.
+#define GEOMETRY_TILE_ROWS  16
+#define GEOMETRY_TILE_COLS  256
+//Rotate_90 / 270: square tiles, every source row of a tile is read as whole cache lines.
+#define GEOMETRY_TRANSPOSE_TILE 64
+
+//32.32 fixed point of Rotate_RowSpan:
+#define GEOMETRY_FIXED_ONE  4294967296.0
+#define GEOMETRY_FIXED_BITS 32
+
+//kernel of GeometryTask:
+#define GEOMETRY_ZOOM_NEIGHBOR          1
+#define GEOMETRY_ZOOM_DOUBLELINEAR      2
+#define GEOMETRY_ZOOM_CONVOLUTION       3
+#define GEOMETRY_ROTATE_90              4
+#define GEOMETRY_ROTATE_180             5
+#define GEOMETRY_ROTATE_270             6
+#define GEOMETRY_ROTATE_NEIGHBOR        7
+#define GEOMETRY_ROTATE_DOUBLELINEAR    8
+#define GEOMETRY_ROTATE_CONVOLUTION     9
+#define GEOMETRY_ZOOM_SEPARABLE         10
+#define GEOMETRY_ZOOM_AREA              11
+
+//Zoom_Area: rows of the summed-area table built by one <Zoom_AreaStrip>.
+#define GEOMETRY_AREA_STRIP 64
+
+//a tile kernel: one instance of the kernel templates below, picked by <GeometryKernelOf>.
+typedef void (*GeometryKernelFunction)(const struct struct_GeometryTask &task, ImgBand &out);
+
+typedef struct struct_GeometryTask {
+    int kernel;
+    ImgBand org;
+    ImgBand out;
+    double sin_d;   //Rotate only: pixel (x, y) of out comes from (u, v) of org,
+    double cos_d;   //u = x * cos_d + y * row_u + temp1, v = x * sin_d + y * row_v + temp2.
+    double temp1;
+    double temp2;
+    double row_u;   //-sin_d for a rotation,
+    double row_v;   //cos_d for a rotation.
+    unsigned char color_default;
+    bool clamp_edge;    //true: also fill the pixels a little out of org, with its edge pixels.
+    int taps;       //Zoom_Separable only: (see <Zoom_SeparableTable>), Zoom_Area: bytes of a Sum (see <Zoom_AreaStrip>)
+    long* col_index;    //of columns [out.first_col, out.last_col)
+    short* col_weight;
+    long* row_index;    //of rows [out.first_row, out.last_row)
+    short* row_weight;
+    GeometryKernelFunction tile_kernel; //set by <RunGeometryTask>
+    unsigned char* area_table;  //Zoom_Area only: (see <Zoom_AreaStrip>)
+    unsigned char* area_carry;  //sums of the strips above, (strips) x (org.width + 1) x CH Sums
+} GeometryTask;
 
 class GeometryTrans : public BitMapImg {
 //functions:
@@ -60,32 +256,119 @@ public:
     GeometryTrans(bmpData org_bmp_img) : BitMapImg(org_bmp_img) {
         return;
     }
-    GeometryTrans(BitMapImg &org) {
-        width = org.GetWidth();
-        height = org.GetHeight();
-        is_gray = org.GetGrayForm();
-        bitmap_array = org.MoveBitmapDataTo(bitmap_array);
-        delete &org;
-        
+    GeometryTrans(BitMapImg &&org) : BitMapImg(std::move(org)) {
         return;
     }
     inline void Zoom(long out_width, long out_height, int select_algorithm);
     inline void Rotate(double degree, int select_algorithm, unsigned char color_default, bool cut);
     
-private:
-    unsigned char Interpolation_DoubleLinear_core(unsigned char around[2][2], double x_pos, double y_pos);
-    unsigned char Interpolation_Convolution_core(unsigned char around[4][4], double x_pos, double y_pos);
+    static void Zoom_Band(const ImgBand &org, ImgBand &out, int select_algorithm);
+    static void Zoom_SeparableTable(long org_size, long out_size, long out_first, long out_last, int taps, long* index, short* weight);
+    static void Zoom_SourceRows(long org_height, long out_height, long out_first_row, long out_last_row, long &org_first_row, long &org_last_row);
+    static void Zoom_AreaBoxes(long org_size, long out_size, long out_first, long out_last, long org_first, long* index);
+    
+protected:
+    //interpolation policies, see (4.3):
+    struct Interp_Neighbor {
+        enum {taps = 1, low = 0, high_margin = 0, nearest = 1};
+        template <int CH> void Sample(const ImgBand &org, long long pos_x, long long pos_y, unsigned char* result) {
+            const unsigned char* source = org.band_array + (pos_y >> GEOMETRY_FIXED_BITS) * org.stride + (pos_x >> GEOMETRY_FIXED_BITS) * CH;
+            for (int i = 0; i < CH; i++)
+                result[i] = source[i];
+        }
+        void Weights(int /*fraction_x*/, int /*fraction_y*/, int* weight_x, int* weight_y) {
+            weight_x[0] = 16384;
+            weight_y[0] = 16384;
+        }
+    };
+    struct Interp_DoubleLinear {
+        enum {taps = 2, low = 0, high_margin = 1, nearest = 0};
+        template <int CH> void Sample(const ImgBand &org, long long pos_x, long long pos_y, unsigned char* result);
+        void Weights(int fraction_x, int fraction_y, int* weight_x, int* weight_y) {
+            weight_x[0] = (256 - fraction_x) << 6;
+            weight_x[1] = fraction_x << 6;
+            weight_y[0] = (256 - fraction_y) << 6;
+            weight_y[1] = fraction_y << 6;
+        }
+        static unsigned char Core(unsigned char around[2][2], double x_pos, double y_pos) {
+            return Interpolation_DoubleLinear_core(around, x_pos, y_pos);
+        }
+    };
+    struct Interp_Convolution {
+        enum {taps = 4, low = 1, high_margin = 2, nearest = 0};
+        int cubic_weight[256][4];   //s(w) of <Interpolation_Convolution_core> for every 8-bit fraction, 14 bits.
+        Interp_Convolution(void) {
+            for (int i = 0; i < 256; i++)
+                Rotate_CubicWeight(i, cubic_weight[i]);
+        }
+        template <int CH> void Sample(const ImgBand &org, long long pos_x, long long pos_y, unsigned char* result);
+        void Weights(int fraction_x, int fraction_y, int* weight_x, int* weight_y) {
+            memcpy(weight_x, cubic_weight[fraction_x], sizeof(cubic_weight[0]));
+            memcpy(weight_y, cubic_weight[fraction_y], sizeof(cubic_weight[0]));
+        }
+        static unsigned char Core(unsigned char around[4][4], double x_pos, double y_pos) {
+            return Interpolation_Convolution_core(around, x_pos, y_pos);
+        }
+    };
+    //border policies, see (4.3):
+    struct Border_Fill {
+        static void EdgeSpan(const GeometryTask & /*task*/, long /*y*/, long /*first_col*/, long /*last_col*/, long long /*step_x*/, long long /*step_y*/,
+                             long &first_x, long &last_x, long long & /*pos_x*/, long long & /*pos_y*/, long &edge_first, long &edge_last) {
+            edge_first = first_x;
+            edge_last = last_x;
+        }
+        template <int CH, class Interp> static void EdgePixels(const GeometryTask & /*task*/, Interp & /*interp*/, long /*first_x*/, long /*last_x*/,
+                                                              long long /*pos_x*/, long long /*pos_y*/, long long /*step_x*/, long long /*step_y*/, unsigned char* /*result*/) {
+            return;
+        }
+    };
+    struct Border_Clamp {
+        static void EdgeSpan(const GeometryTask &task, long y, long first_col, long last_col, long long step_x, long long step_y,
+                             long &first_x, long &last_x, long long &pos_x, long long &pos_y, long &edge_first, long &edge_last);
+        template <int CH, class Interp> static void EdgePixels(const GeometryTask &task, Interp &interp, long first_x, long last_x,
+                                                              long long pos_x, long long pos_y, long long step_x, long long step_y, unsigned char* result) {
+            Rotate_EdgePixels<CH>(task, interp, first_x, last_x, pos_x, pos_y, step_x, step_y, result);
+        }
+    };
+    
+    static unsigned char Interpolation_DoubleLinear_core(unsigned char around[2][2], double x_pos, double y_pos);
+    static unsigned char Interpolation_Convolution_core(unsigned char around[4][4], double x_pos, double y_pos);
+    
+    static void RunGeometryTask(GeometryTask &task);
+    void RunPlanes(GeometryTask &task);
+    static void GeometryTileSize(int kernel, long &tile_height, long &tile_width);
+    static void GeometryTile(long tile_index, void* context);
+    static GeometryKernelFunction GeometryKernelOf(const GeometryTask &task);
+    template <int CH, class Interp> static GeometryKernelFunction Rotate_TileOf(bool clamp_edge);
     
-    void Zoom_Neighbor(long out_width, long out_height);
-    void Zoom_DoubleLinear(long out_width, long out_height);
-    void Zoom_Convolution(long out_width, long out_height);
+    template <int CH> static void Zoom_Neighbor(const GeometryTask &task, ImgBand &out);
+    template <int CH, class Interp> static void Zoom_Interpolate(const GeometryTask &task, ImgBand &out);
+    template <int CH, class Interp> static void Zoom_Separable(const GeometryTask &task, ImgBand &out);
+    template <int CH, class Sum> static void Zoom_Area(const GeometryTask &task, ImgBand &out);
+    template <int CH, class Sum> static void Zoom_AreaStrip(long strip_index, void* context);
     
     void Rotate_90(void);
     void Rotate_180(void);
     void Rotate_270(void);
-    void Rotate_Neighbor(double degree, unsigned char color_default, bool cut);
-    void Rotate_DoubleLinear(double degree, unsigned char color_default, bool cut);
-    void Rotate_Convolution(double degree, unsigned char color_default, bool cut);
+    void Rotate_Resample(int kernel, double degree, unsigned char color_default, bool cut);
+    
+    void Rotate_Square_InPlace(bool clockwise);
+    void Rotate_Packed(int kernel);
+    static void Rotate_PackedTile(long tile_index, void* context);
+    static unsigned long long Rotate_Transpose8x8(unsigned long long block);
+    static unsigned long long Rotate_ReverseBits(unsigned long long word);
+    
+    template <int CH> static void Rotate_90_Tile(const GeometryTask &task, ImgBand &out);
+    template <int CH> static void Rotate_180_Tile(const GeometryTask &task, ImgBand &out);
+    template <int CH> static void Rotate_270_Tile(const GeometryTask &task, ImgBand &out);
+    template <int CH, class Interp, class Border> static void Rotate_Tile(const GeometryTask &task, ImgBand &out);
+    static void Rotate_RowSpan(const GeometryTask &task, long y, double offset, double low, double high_margin, bool truncate,
+                               long first_col, long last_col, long &first_x, long &last_x, long long &pos_x, long long &pos_y);
+    template <int CH, class Interp> static void Rotate_EdgePixels(const GeometryTask &task, Interp &interp, long first_x, long last_x,
+                                                                 long long pos_x, long long pos_y, long long step_x, long long step_y, unsigned char* result);
+    static void Rotate_CubicWeight(int fraction, int* weight);
+    static void Rotate_Box(long width, long height, double degree, bool cut, long &out_width, long &out_height,
+                           double &sin_d, double &cos_d, double &temp1, double &temp2);
 };
 
 
@@ -93,13 +376,36 @@ private:
 inline void GeometryTrans::Zoom(long out_width, long out_height, int select_algorithm = 1) {
     if (out_width == width && out_height == height)
         return;
+    if (select_algorithm < 1 || select_algorithm > 6)
+        return;
+    SetPacked(false);
+    
+    TRACE_SCOPE(1 == select_algorithm ? "Zoom_Neighbor" : 2 == select_algorithm ? "Zoom_DoubleLinear" :
+                3 == select_algorithm ? "Zoom_Convolution" : 6 == select_algorithm ? "Zoom_Area" : "Zoom_Separable", "GeometryTrans");
+    int pixel_byte = (is_gray || is_planar) ? 1 : 3;
+    ImgBand org = {bitmap_array, width, height, pixel_byte, 0, height, 0, width, RowByte(width)};
+    ImgBand out = {PixelAlloc(ArrayLength(out_width, out_height)), out_width, out_height, pixel_byte, 0, out_height, 0, out_width, RowByte(out_width)};
+    unsigned char* out_array = out.band_array;
+    TRACE_BYTES(ArrayLength(width, height) + ArrayLength(out_width, out_height));
+    
+    try {
+        Zoom_Band(org, out, select_algorithm);
+        if (is_planar) {
+            for (int c = 1; c < 3; c++) {
+                org.band_array = bitmap_array + c * PlaneByte(width, height);
+                out.band_array = out_array + c * PlaneByte(out_width, out_height);
+                Zoom_Band(org, out, select_algorithm);
+            }
+        }
+    } catch (...) {
+        PixelFree(out_array);  //on a throw (std::bad_alloc, or of a tile), the image is left as it was.
+        throw;
+    }
     
-    if (1 == select_algorithm)
-        Zoom_Neighbor(out_width, out_height);
-    else if (2 == select_algorithm)
-        Zoom_DoubleLinear(out_width, out_height);
-    else if (3 == select_algorithm)
-        Zoom_Convolution(out_width, out_height);
+    FreeBitmapArray();
+    bitmap_array = out_array;
+    width = out_width;
+    height = out_height;
 }
 
 inline void GeometryTrans::Rotate(double degree, int select_algorithm = 1, unsigned char color_default = 255, bool cut = false) {
@@ -119,12 +425,8 @@ inline void GeometryTrans::Rotate(double degree, int select_algorithm = 1, unsig
     else if (fabs(degree - 360) < eps)
         return;
     else {
-        if (1 == select_algorithm)
-            Rotate_Neighbor(degree, color_default, cut);
-        else if (2 == select_algorithm)
-            Rotate_DoubleLinear(degree, color_default, cut);
-        else if (3 == select_algorithm)
-            Rotate_Convolution(degree, color_default, cut);
+        if (select_algorithm >= 1 && select_algorithm <= 3)
+            Rotate_Resample(GEOMETRY_ROTATE_NEIGHBOR + select_algorithm - 1, degree, color_default, cut);
     }
 }
 
@@ -203,396 +505,1090 @@ unsigned char GeometryTrans::Interpolation_Convolution_core(unsigned char around
     return (unsigned char)result_ABC;
 }
 
-void GeometryTrans::Zoom_Neighbor(long out_width, long out_height) {
-    double ratio_x = (double)out_width / width;
-    double ratio_y = (double)out_height / height;
-    long org_x, org_y;
-    int pixel_byte = is_gray ? 1 : 3;
-    long x, y;
-    unsigned char* result = new unsigned char[out_width * out_height * pixel_byte];
+void GeometryTrans::Zoom_Band(const ImgBand &org, ImgBand &out, int select_algorithm) {
+    if (select_algorithm < 1 || select_algorithm > 6)
+        return;
     
-    for (y = 0; y < out_height; y++) {
-        for (x = 0; x < out_width; x++) {
-            //calculate (x, y)'s position in original bitmap (org_x, org_y)
-            org_x = (double)x / ratio_x + 0.5;
-            org_y = (double)y / ratio_y + 0.5;
-            
-            if (0 <= org_x && org_x < width && 0 <= org_y && org_y < height) {
-                for (int i = 0; i < pixel_byte; i++) {
-                    result[(y * out_width + x) * pixel_byte + i] = bitmap_array[(org_y * width + org_x) * pixel_byte + i];
-                }
+    GeometryTask task = {select_algorithm, org, out, 0, 0, 0, 0, 0, 0, 0, false, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+    long col_count = out.last_col - out.first_col;
+    long row_count = out.last_row - out.first_row;
+    
+    if (6 == select_algorithm) {
+        long table_rows = org.last_row - org.first_row + 1;
+        long strips = (table_rows - 1 + GEOMETRY_AREA_STRIP - 1) / GEOMETRY_AREA_STRIP;
+        long line_length = (org.width + 1) * org.pixel_byte;    //Sums per row of the table
+        //the biggest box: 255 * pixels must not wrap around twice.
+        double box_pixels = (double)(org.width / out.width + 1) * (org.height / out.height + 1);
+        task.kernel = GEOMETRY_ZOOM_AREA;
+        task.taps = (box_pixels * 255 < 4294967296.0) ? sizeof(unsigned int) : sizeof(unsigned long long);
+        task.col_index = new long[col_count * 2];
+        task.row_index = new long[row_count * 2];
+        //from the pixel pool: the pages are usually mapped already (the table is bigger than the image).
+        task.area_table = PixelAlloc(table_rows * line_length * task.taps);
+        task.area_carry = new unsigned char[MAX(strips, 1) * line_length * task.taps]();
+        TRACE_ALLOC((col_count + row_count) * 2 * sizeof(long) + (table_rows + MAX(strips, 1)) * line_length * task.taps);
+        Zoom_AreaBoxes(org.width, out.width, out.first_col, out.last_col, 0, task.col_index);
+        Zoom_AreaBoxes(org.height, out.height, out.first_row, out.last_row, org.first_row, task.row_index);
+        
+        //row 0 and column 0 are 0, the strips start from row 1.
+        memset(task.area_table, 0, line_length * task.taps);
+        if (sizeof(unsigned int) == task.taps) {
+            RunTiles(strips, 1 == org.pixel_byte ? Zoom_AreaStrip<1, unsigned int> : Zoom_AreaStrip<3, unsigned int>, &task);
+            unsigned int* carry = (unsigned int*)task.area_carry;
+            for (long s = 1; s < strips; s++) {
+                const unsigned int* last = (const unsigned int*)task.area_table + s * GEOMETRY_AREA_STRIP * line_length;
+                for (long i = 0; i < line_length; i++)
+                    carry[s * line_length + i] = carry[(s - 1) * line_length + i] + last[i];
+            }
+        }
+        else {
+            RunTiles(strips, 1 == org.pixel_byte ? Zoom_AreaStrip<1, unsigned long long> : Zoom_AreaStrip<3, unsigned long long>, &task);
+            unsigned long long* carry = (unsigned long long*)task.area_carry;
+            for (long s = 1; s < strips; s++) {
+                const unsigned long long* last = (const unsigned long long*)task.area_table + s * GEOMETRY_AREA_STRIP * line_length;
+                for (long i = 0; i < line_length; i++)
+                    carry[s * line_length + i] = carry[(s - 1) * line_length + i] + last[i];
+            }
+        }
+    }
+    else if (select_algorithm >= 4) {
+        task.kernel = GEOMETRY_ZOOM_SEPARABLE;
+        task.taps = (4 == select_algorithm) ? 2 : 4;
+        task.col_index = new long[col_count * task.taps];
+        task.col_weight = new short[col_count * task.taps];
+        task.row_index = new long[row_count * task.taps];
+        task.row_weight = new short[row_count * task.taps];
+        TRACE_ALLOC((col_count + row_count) * task.taps * (sizeof(long) + sizeof(short)));
+        Zoom_SeparableTable(org.width, out.width, out.first_col, out.last_col, task.taps, task.col_index, task.col_weight);
+        Zoom_SeparableTable(org.height, out.height, out.first_row, out.last_row, task.taps, task.row_index, task.row_weight);
+    }
+    
+    RunGeometryTask(task);
+    
+    delete[] task.col_index;
+    delete[] task.col_weight;
+    delete[] task.row_index;
+    delete[] task.row_weight;
+    PixelFree(task.area_table);
+    delete[] task.area_carry;
+}
+
+void GeometryTrans::Zoom_SeparableTable(long org_size, long out_size, long out_first, long out_last, int taps, long* index, short* weight) {
+    double ratio = (double)out_size / org_size;
+    double org_pos, w, weight_d[4];
+    long u, x, source;
+    int t, weight_sum, biggest;
+    
+    for (x = out_first; x < out_last; x++) {
+        //the same position as <Zoom_Interpolate>
+        org_pos = x / ratio;
+        u = (long)org_pos;
+        
+        for (t = 0; t < taps; t++) {
+            if (2 == taps) {
+                //taps: u, u + 1
+                weight_d[t] = (0 == t) ? 1 - (org_pos - u) : org_pos - u;
             }
             else {
-                for (int i = 0; i < pixel_byte; i++)
-                    result[(y * out_width + x) * pixel_byte + i] = 255;
+                //taps: u - 1 ... u + 2, s(w) of <Interpolation_Convolution_core>
+                w = fabs(org_pos - u + 1 - t);
+                if (w < 1)
+                    weight_d[t] = w * w * w - 2 * w * w + 1;
+                else if (w < 2)
+                    weight_d[t] = - w * w * w + 5 * w * w - 8 * w + 4;
+                else
+                    weight_d[t] = 0;
             }
         }
+        
+        weight_sum = 0;
+        biggest = 0;
+        for (t = 0; t < taps; t++) {
+            source = u + t - (4 == taps ? 1 : 0);
+            index[(x - out_first) * taps + t] = MIN(MAX(source, 0), org_size - 1);
+            weight[(x - out_first) * taps + t] = (short)floor(weight_d[t] * 16384 + 0.5);
+            weight_sum += weight[(x - out_first) * taps + t];
+            if (weight_d[t] > weight_d[biggest])
+                biggest = t;
+        }
+        //rounding error goes to the biggest weight, so a flat area stays flat.
+        weight[(x - out_first) * taps + biggest] += 16384 - weight_sum;
     }
+}
+
+void GeometryTrans::Zoom_SourceRows(long org_height, long out_height, long out_first_row, long out_last_row, long &org_first_row, long &org_last_row) {
+    double ratio_y = (double)out_height / org_height;
     
-    delete [] bitmap_array;
-    bitmap_array = result;
-    width = out_width;
-    height = out_height;
+    //Convolution reads 1 row above and 2 rows below, Neighbor may round up by 1 row.
+    org_first_row = (long)((double)out_first_row / ratio_y) - 1;
+    org_last_row = (long)((double)(out_last_row - 1) / ratio_y + 0.5) + 3;
+    
+    //Zoom_Area: the boxes of the rows, see <Zoom_AreaBoxes>.
+    org_first_row = MIN(org_first_row, (long)((long long)out_first_row * org_height / out_height));
+    org_last_row = MAX(org_last_row, (long)((long long)out_last_row * org_height / out_height) + 1);
+    
+    if (org_first_row < 0)
+        org_first_row = 0;
+    if (org_last_row > org_height)
+        org_last_row = org_height;
 }
 
-void GeometryTrans::Zoom_DoubleLinear(long out_width, long out_height) {
-    double ratio_x = (double)out_width / width;
-    double ratio_y = (double)out_height / height;
-    double org_x, org_y;
-    int pixel_byte = is_gray ? 1 : 3;
-    long u, v, x, y;
-    unsigned char surrounding[2][2] = {0};
-    unsigned char* result = new unsigned char[out_width * out_height * pixel_byte];
+void GeometryTrans::Zoom_AreaBoxes(long org_size, long out_size, long out_first, long out_last, long org_first, long* index) {
+    long first, last;
+    
+    for (long x = out_first; x < out_last; x++) {
+        first = (long)((long long)x * org_size / out_size);
+        last = (long)((long long)(x + 1) * org_size / out_size);
+        if (last <= first)
+            last = MIN(first + 1, org_size);
+        index[(x - out_first) * 2] = first - org_first;
+        index[(x - out_first) * 2 + 1] = last - org_first;
+    }
+}
+
+template <int CH>
+void GeometryTrans::Zoom_Neighbor(const GeometryTask &task, ImgBand &out) {
+    const ImgBand &org = task.org;
+    double ratio_x = (double)out.width / org.width;
+    double ratio_y = (double)out.height / org.height;
+    long org_x, org_y;
+    long x, y;
+    const unsigned char* source;
+    unsigned char* result;
     
-    for (y = 0; y < out_height; y++) {
-        for (x = 0; x < out_width; x++) {
+    for (y = out.first_row; y < out.last_row; y++) {
+        result = out.band_array + (y - out.first_row) * out.stride;
+        
+        for (x = out.first_col; x < out.last_col; x++) {
             //calculate (x, y)'s position in original bitmap (org_x, org_y)
-            org_x = x / ratio_x;
-            org_y = y / ratio_y;
-            u = (int)org_x;
-            v = (int)org_y;
+            org_x = (double)x / ratio_x + 0.5;
+            org_y = (double)y / ratio_y + 0.5;
             
-            if (0 <= org_x && org_x < width - 1 && 0 <= org_y && org_y < height - 1) {
-                for (int i = 0; i < pixel_byte; i++) {
-                    surrounding[0][0] = bitmap_array[(v * width + u) * pixel_byte + i];
-                    surrounding[0][1] = bitmap_array[(v * width + (u + 1)) * pixel_byte + i];
-                    surrounding[1][0] = bitmap_array[((v + 1) * width + u) * pixel_byte + i];
-                    surrounding[1][1] = bitmap_array[((v + 1) * width + (u + 1)) * pixel_byte + i];
-                    
-                    result[(y * out_width + x) * pixel_byte + i] = Interpolation_DoubleLinear_core(surrounding, org_x - u, org_y - v);
+            if (0 <= org_x && org_x < org.width && 0 <= org_y && org_y < org.height) {
+                source = org.band_array + (org_y - org.first_row) * org.stride + org_x * CH;
+                for (int i = 0; i < CH; i++) {
+                    result[x * CH + i] = source[i];
                 }
             }
             else {
-                //when the pixel is near the margin, use Neighbor Interpolation
-                for (int i = 0; i < pixel_byte; i++) {
-                    result[(y * out_width + x) * pixel_byte + i] = bitmap_array[(v * width + u) * pixel_byte + i];
-                }
+                for (int i = 0; i < CH; i++)
+                    result[x * CH + i] = 255;
             }
         }
     }
-    
-    delete [] bitmap_array;
-    bitmap_array = result;
-    width = out_width;
-    height = out_height;
 }
 
-void GeometryTrans::Zoom_Convolution(long out_width, long out_height) {
-    double ratio_x = (double)out_width / width;
-    double ratio_y = (double)out_height / height;
+template <int CH, class Interp>
+void GeometryTrans::Zoom_Interpolate(const GeometryTask &task, ImgBand &out) {
+    const ImgBand &org = task.org;
+    double ratio_x = (double)out.width / org.width;
+    double ratio_y = (double)out.height / org.height;
     double org_x, org_y;
-    int pixel_byte = is_gray ? 1 : 3;
-    int i, j;
+    long row_byte = org.stride;
     long u, v, x, y;
-    unsigned char surrounding[4][4] = {0};
-    unsigned char* result = new unsigned char[out_width * out_height * pixel_byte];
+    unsigned char surrounding[Interp::taps][Interp::taps] = {{0}};
+    const unsigned char* source;
+    unsigned char* result;
     
-    for (y = 0; y < out_height; y++) {
-        for (x = 0; x < out_width; x++) {
+    for (y = out.first_row; y < out.last_row; y++) {
+        result = out.band_array + (y - out.first_row) * out.stride;
+        
+        for (x = out.first_col; x < out.last_col; x++) {
             //calculate (x, y)'s position in original bitmap (org_x, org_y)
             org_x = x / ratio_x;
             org_y = y / ratio_y;
             u = (int)org_x;
             v = (int)org_y;
+            source = org.band_array + (v - org.first_row) * row_byte + u * CH;
             
-            if (0 <= org_x && org_x < width - 2 && 0 <= org_y && org_y < height - 2) {
-                for (int k = 0; k < pixel_byte; k++) {
-                    for (j = (int)v - 1; j < v + 3; j++) {
-                        for (i = (int)u - 1; i < u + 3; i++) {
-                            surrounding[j - v + 1][i - u + 1] = bitmap_array[(j * width + i) * pixel_byte + k];
+            if (Interp::low <= org_x && org_x < org.width - Interp::high_margin && Interp::low <= org_y && org_y < org.height - Interp::high_margin) {
+                for (int k = 0; k < CH; k++) {
+                    //taps around (u, v): u - low ~ u - low + taps - 1, the same for v.
+                    for (int j = 0; j < Interp::taps; j++) {
+                        for (int i = 0; i < Interp::taps; i++) {
+                            surrounding[j][i] = source[(j - Interp::low) * row_byte + (i - Interp::low) * CH + k];
                         }
                     }
-                    result[(y * out_width + x) * pixel_byte + k] = Interpolation_Convolution_core(surrounding, org_x - u, org_y - v);
+                    result[x * CH + k] = Interp::Core(surrounding, org_x - u, org_y - v);
                 }
             }
             else {
                 //when the pixel is near the margin, use Neighbor Interpolation
-                for (int k = 0; k < pixel_byte; k++) {
-                    result[(y * out_width + x) * pixel_byte + k] = bitmap_array[(v * width + u) * pixel_byte + k];
+                for (int k = 0; k < CH; k++) {
+                    result[x * CH + k] = source[k];
+                }
+            }
+        }
+    }
+}
+
+template <int CH, class Interp>
+void GeometryTrans::Zoom_Separable(const GeometryTask &task, ImgBand &out) {
+    const ImgBand &org = task.org;
+    const int taps = Interp::taps;
+    long line_length = (out.last_col - out.first_col) * CH;
+    const long* col_index = task.col_index + (out.first_col - task.out.first_col) * taps;
+    const short* col_weight = task.col_weight + (out.first_col - task.out.first_col) * taps;
+    const long* row_index = task.row_index + (out.first_row - task.out.first_row) * taps;
+    const short* row_weight = task.row_weight + (out.first_row - task.out.first_row) * taps;
+    //source rows of this tile, the indexes never go down.
+    long first_source = row_index[0];
+    long last_source = row_index[(out.last_row - out.first_row - 1) * taps + taps - 1] + 1;
+    short* horizontal = new short[(last_source - first_source) * line_length];
+    const short* rows[4];
+    const unsigned char* source;
+    short* target;
+    long x, y;
+    int sum;
+    
+    //horizontal pass: source rows -> tile columns, 6-bit fraction kept.
+    for (y = first_source; y < last_source; y++) {
+        source = org.band_array + (y - org.first_row) * org.stride;
+        target = horizontal + (y - first_source) * line_length;
+        for (x = 0; x < out.last_col - out.first_col; x++) {
+            for (int i = 0; i < CH; i++) {
+                sum = 0;
+                for (int t = 0; t < taps; t++) {
+                    sum += col_weight[x * taps + t] * source[col_index[x * taps + t] * CH + i];
                 }
+                target[x * CH + i] = (short)((sum + 128) >> 8);
             }
         }
     }
     
-    delete [] bitmap_array;
-    bitmap_array = result;
-    width = out_width;
-    height = out_height;
+    //vertical pass:
+    for (y = out.first_row; y < out.last_row; y++) {
+        for (int t = 0; t < taps; t++) {
+            rows[t] = horizontal + (row_index[(y - out.first_row) * taps + t] - first_source) * line_length;
+        }
+        VerticalSum_Simd(rows, row_weight + (y - out.first_row) * taps, taps, line_length,
+                         out.band_array + (y - out.first_row) * out.stride + out.first_col * CH, 20);
+    }
+    
+    delete[] horizontal;
 }
 
-void GeometryTrans::Rotate_90(void) {
-    int pixel_byte = is_gray ? 1 : 3;
-    long x, y, swap_temp;
-    unsigned char* result = new unsigned char[height * width * pixel_byte];
+template <int CH, class Sum>
+void GeometryTrans::Zoom_AreaStrip(long strip_index, void* context) {
+    const GeometryTask &task = *(const GeometryTask*)context;
+    const ImgBand &org = task.org;
+    long line_length = (org.width + 1) * CH;
+    long first_row = 1 + strip_index * GEOMETRY_AREA_STRIP;
+    long last_row = MIN(first_row + GEOMETRY_AREA_STRIP, org.last_row - org.first_row + 1);
+    Sum* table = (Sum*)task.area_table;
+    Sum blue, green, red;   //sums of the row so far (gray: blue only)
+    const unsigned char* source;
+    const Sum* above;
+    Sum* target;
+    long r, x;
+    
+    for (r = first_row; r < last_row; r++) {
+        //row r: row r - 1 of the table (0 at the first row of the strip) + sums of org row r - 1 up to every column.
+        source = org.band_array + (r - 1) * org.stride;
+        target = table + r * line_length;
+        above = (r == first_row) ? (const Sum*)task.area_carry : target - line_length;  //carry row 0 is all 0
+        blue = green = red = 0;
+        for (int i = 0; i < CH; i++)
+            target[i] = 0;
+        target += CH;
+        above += CH;
+        //explicit sums, not an array of CH: they stay in registers.
+        if (1 == CH) {
+            for (x = 0; x < org.width; x++) {
+                blue += source[x];
+                target[x] = above[x] + blue;
+            }
+        }
+        else {
+            for (x = 0; x < org.width; x++, source += 3, target += 3, above += 3) {
+                blue += source[0];
+                green += source[1];
+                red += source[2];
+                target[0] = above[0] + blue;
+                target[1] = above[1] + green;
+                target[2] = above[2] + red;
+            }
+        }
+    }
+}
+
+template <int CH, class Sum>
+void GeometryTrans::Zoom_Area(const GeometryTask &task, ImgBand &out) {
+    long line_length = (task.org.width + 1) * CH;
+    const long* col_index = task.col_index + (out.first_col - task.out.first_col) * 2;
+    const long* row_index = task.row_index + (out.first_row - task.out.first_row) * 2;
+    const Sum* table = (const Sum*)task.area_table;
+    const Sum* carry = (const Sum*)task.area_carry;
+    const Sum* top_row;
+    const Sum* top_carry;
+    const Sum* bottom_row;
+    const Sum* bottom_carry;
+    unsigned char* result;
+    long top, bottom, left, right, x, y;
+    double inverse;
+    Sum sum;
     
-    for (y = 0; y < width; y++) {
-        for (x = 0; x < height; x++) {
-            for (int i = 0; i < pixel_byte; i++) {
-                result[(y * height + x) * pixel_byte + i] = bitmap_array[(x * width + (width - y - 1)) * pixel_byte + i];
+    for (y = out.first_row; y < out.last_row; y++) {
+        result = out.band_array + (y - out.first_row) * out.stride;
+        //table rows of the box, each with the sums of the strips above it (row 0 is in no strip, carry 0 is 0).
+        top = row_index[(y - out.first_row) * 2];
+        bottom = row_index[(y - out.first_row) * 2 + 1];
+        top_row = table + top * line_length;
+        top_carry = carry + (top > 0 ? (top - 1) / GEOMETRY_AREA_STRIP : 0) * line_length;
+        bottom_row = table + bottom * line_length;
+        bottom_carry = carry + (bottom > 0 ? (bottom - 1) / GEOMETRY_AREA_STRIP : 0) * line_length;
+        
+        for (x = out.first_col; x < out.last_col; x++) {
+            left = col_index[(x - out.first_col) * 2] * CH;
+            right = col_index[(x - out.first_col) * 2 + 1] * CH;
+            inverse = 1.0 / ((right - left) / CH * (bottom - top));
+            for (int i = 0; i < CH; i++) {
+                sum = (bottom_row[right + i] + bottom_carry[right + i]) - (bottom_row[left + i] + bottom_carry[left + i])
+                    - (top_row[right + i] + top_carry[right + i]) + (top_row[left + i] + top_carry[left + i]);
+                result[x * CH + i] = (unsigned char)(sum * inverse + 0.5);
             }
         }
     }
+}
+
+void GeometryTrans::RunGeometryTask(GeometryTask &task) {
+    long tile_height, tile_width;
+    GeometryTileSize(task.kernel, tile_height, tile_width);
+    long tile_rows = (task.out.last_row - task.out.first_row + tile_height - 1) / tile_height;
+    long tile_cols = (task.out.last_col - task.out.first_col + tile_width - 1) / tile_width;
+    
+    if (tile_rows <= 0 || tile_cols <= 0)
+        return;
+    task.tile_kernel = GeometryKernelOf(task);
+    RunTiles(tile_rows * tile_cols, GeometryTile, &task);
+}
+
+void GeometryTrans::RunPlanes(GeometryTask &task) {
+    GeometryTask plane_task = task;
+    
+    if (!is_planar) {
+        RunGeometryTask(task);
+        return;
+    }
+    for (int c = 0; c < 3; c++) {
+        plane_task.org.band_array = task.org.band_array + c * PlaneByte(task.org.width, task.org.height);
+        plane_task.out.band_array = task.out.band_array + c * PlaneByte(task.out.width, task.out.height);
+        RunGeometryTask(plane_task);
+    }
+}
+
+void GeometryTrans::GeometryTileSize(int kernel, long &tile_height, long &tile_width) {
+    if (GEOMETRY_ROTATE_90 == kernel || GEOMETRY_ROTATE_270 == kernel) {
+        tile_height = GEOMETRY_TRANSPOSE_TILE;
+        tile_width = GEOMETRY_TRANSPOSE_TILE;
+    }
+    else {
+        tile_height = GEOMETRY_TILE_ROWS;
+        tile_width = GEOMETRY_TILE_COLS;
+    }
+}
+
+void GeometryTrans::GeometryTile(long tile_index, void* context) {
+    GeometryTask* task = (GeometryTask*)context;
+    long tile_height, tile_width;
+    GeometryTileSize(task->kernel, tile_height, tile_width);
+    long tile_cols = (task->out.last_col - task->out.first_col + tile_width - 1) / tile_width;
+    ImgBand tile = task->out;
+    
+    tile.first_row = task->out.first_row + tile_index / tile_cols * tile_height;
+    tile.last_row = MIN(tile.first_row + tile_height, task->out.last_row);
+    tile.first_col = task->out.first_col + tile_index % tile_cols * tile_width;
+    tile.last_col = MIN(tile.first_col + tile_width, task->out.last_col);
+    tile.band_array = task->out.band_array + (tile.first_row - task->out.first_row) * tile.stride;
+    
+    task->tile_kernel(*task, tile);
+}
+
+GeometryKernelFunction GeometryTrans::GeometryKernelOf(const GeometryTask &task) {
+    GeometryKernelFunction kernel_1 = NULL, kernel_3 = NULL;    //for 1 and 3-byte pixels
+    
+    switch (task.kernel) {
+        case GEOMETRY_ZOOM_NEIGHBOR:
+            kernel_1 = Zoom_Neighbor<1>;
+            kernel_3 = Zoom_Neighbor<3>;
+            break;
+        case GEOMETRY_ZOOM_DOUBLELINEAR:
+            kernel_1 = Zoom_Interpolate<1, Interp_DoubleLinear>;
+            kernel_3 = Zoom_Interpolate<3, Interp_DoubleLinear>;
+            break;
+        case GEOMETRY_ZOOM_CONVOLUTION:
+            kernel_1 = Zoom_Interpolate<1, Interp_Convolution>;
+            kernel_3 = Zoom_Interpolate<3, Interp_Convolution>;
+            break;
+        case GEOMETRY_ZOOM_SEPARABLE:
+            if (2 == task.taps) {
+                kernel_1 = Zoom_Separable<1, Interp_DoubleLinear>;
+                kernel_3 = Zoom_Separable<3, Interp_DoubleLinear>;
+            }
+            else {
+                kernel_1 = Zoom_Separable<1, Interp_Convolution>;
+                kernel_3 = Zoom_Separable<3, Interp_Convolution>;
+            }
+            break;
+        case GEOMETRY_ZOOM_AREA:
+            if (sizeof(unsigned int) == task.taps) {
+                kernel_1 = Zoom_Area<1, unsigned int>;
+                kernel_3 = Zoom_Area<3, unsigned int>;
+            }
+            else {
+                kernel_1 = Zoom_Area<1, unsigned long long>;
+                kernel_3 = Zoom_Area<3, unsigned long long>;
+            }
+            break;
+        case GEOMETRY_ROTATE_90:
+            kernel_1 = Rotate_90_Tile<1>;
+            kernel_3 = Rotate_90_Tile<3>;
+            break;
+        case GEOMETRY_ROTATE_180:
+            kernel_1 = Rotate_180_Tile<1>;
+            kernel_3 = Rotate_180_Tile<3>;
+            break;
+        case GEOMETRY_ROTATE_270:
+            kernel_1 = Rotate_270_Tile<1>;
+            kernel_3 = Rotate_270_Tile<3>;
+            break;
+        case GEOMETRY_ROTATE_NEIGHBOR:
+            kernel_1 = Rotate_TileOf<1, Interp_Neighbor>(task.clamp_edge);
+            kernel_3 = Rotate_TileOf<3, Interp_Neighbor>(task.clamp_edge);
+            break;
+        case GEOMETRY_ROTATE_DOUBLELINEAR:
+            kernel_1 = Rotate_TileOf<1, Interp_DoubleLinear>(task.clamp_edge);
+            kernel_3 = Rotate_TileOf<3, Interp_DoubleLinear>(task.clamp_edge);
+            break;
+        case GEOMETRY_ROTATE_CONVOLUTION:
+            kernel_1 = Rotate_TileOf<1, Interp_Convolution>(task.clamp_edge);
+            kernel_3 = Rotate_TileOf<3, Interp_Convolution>(task.clamp_edge);
+            break;
+    }
+    return (1 == task.org.pixel_byte) ? kernel_1 : kernel_3;
+}
+
+template <int CH, class Interp>
+GeometryKernelFunction GeometryTrans::Rotate_TileOf(bool clamp_edge) {
+    if (clamp_edge)
+        return Rotate_Tile<CH, Interp, Border_Clamp>;
+    return Rotate_Tile<CH, Interp, Border_Fill>;
+}
+
+void GeometryTrans::Rotate_90(void) {
+    TRACE_SCOPE("Rotate_90", "GeometryTrans");
+    if (is_packed) {
+        Rotate_Packed(GEOMETRY_ROTATE_90);
+        return;
+    }
+#ifdef rotate_square_in_place
+    if (width == height && !is_planar) {
+        Rotate_Square_InPlace(true);
+        return;
+    }
+#endif
+    int pixel_byte = (is_gray || is_planar) ? 1 : 3;
+    long swap_temp;
+    GeometryTask task = {GEOMETRY_ROTATE_90,
+        {bitmap_array, width, height, pixel_byte, 0, height, 0, width, RowByte(width)},
+        {PixelAlloc(ArrayLength(height, width)), height, width, pixel_byte, 0, width, 0, height, RowByte(height)},
+        0, 0, 0, 0, 0, 0, 0, false, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+    TRACE_BYTES(2 * ArrayLength(width, height));
+    
+    try {
+        RunPlanes(task);
+    } catch (...) {
+        PixelFree(task.out.band_array);
+        throw;
+    }
     
-    delete [] bitmap_array;
-    bitmap_array = result;
+    FreeBitmapArray();
+    bitmap_array = task.out.band_array;
     swap_temp = width;
     width = height;
     height = swap_temp;
 }
 
 void GeometryTrans::Rotate_180(void) {
-    int pixel_byte = is_gray ? 1 : 3;
-    long x, y;
-    unsigned char* result = new unsigned char[height * width * pixel_byte];
+    TRACE_SCOPE("Rotate_180", "GeometryTrans");
+    if (is_packed) {
+        Rotate_Packed(GEOMETRY_ROTATE_180);
+        return;
+    }
+    int pixel_byte = (is_gray || is_planar) ? 1 : 3;
+    GeometryTask task = {GEOMETRY_ROTATE_180,
+        {bitmap_array, width, height, pixel_byte, 0, height, 0, width, RowByte(width)},
+        {PixelAlloc(ArrayLength(width, height)), width, height, pixel_byte, 0, height, 0, width, RowByte(width)},
+        0, 0, 0, 0, 0, 0, 0, false, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+    TRACE_BYTES(2 * ArrayLength(width, height));
     
-    for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x++) {
-            for (int i = 0; i < pixel_byte; i++) {
-                result[(y * width + x) * pixel_byte + i] = bitmap_array[((height - y - 1) * width + (width - x - 1)) * pixel_byte + i];
-            }
-        }
+    try {
+        RunPlanes(task);
+    } catch (...) {
+        PixelFree(task.out.band_array);
+        throw;
     }
     
-    delete [] bitmap_array;
-    bitmap_array = result;
+    FreeBitmapArray();
+    bitmap_array = task.out.band_array;
 }
 
 void GeometryTrans::Rotate_270(void) {
-    int pixel_byte = is_gray ? 1 : 3;
-    long x, y, swap_temp;
-    unsigned char* result = new unsigned char[height * width * pixel_byte];
+    TRACE_SCOPE("Rotate_270", "GeometryTrans");
+    if (is_packed) {
+        Rotate_Packed(GEOMETRY_ROTATE_270);
+        return;
+    }
+#ifdef rotate_square_in_place
+    if (width == height && !is_planar) {
+        Rotate_Square_InPlace(false);
+        return;
+    }
+#endif
+    int pixel_byte = (is_gray || is_planar) ? 1 : 3;
+    long swap_temp;
+    GeometryTask task = {GEOMETRY_ROTATE_270,
+        {bitmap_array, width, height, pixel_byte, 0, height, 0, width, RowByte(width)},
+        {PixelAlloc(ArrayLength(height, width)), height, width, pixel_byte, 0, width, 0, height, RowByte(height)},
+        0, 0, 0, 0, 0, 0, 0, false, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+    TRACE_BYTES(2 * ArrayLength(width, height));
     
-    for (y = 0; y < width; y++) {
-        for (x = 0; x < height; x++) {
-            for (int i = 0; i < pixel_byte; i++) {
-                result[(y * height + x) * pixel_byte + i] = bitmap_array[((height - x - 1) * width + y) * pixel_byte + i];
-            }
-        }
+    try {
+        RunPlanes(task);
+    } catch (...) {
+        PixelFree(task.out.band_array);
+        throw;
     }
     
-    delete [] bitmap_array;
-    bitmap_array = result;
+    FreeBitmapArray();
+    bitmap_array = task.out.band_array;
     swap_temp = width;
     width = height;
     height = swap_temp;
 }
 
-void GeometryTrans::Rotate_Neighbor(double degree, unsigned char color_default, bool cut) {
-    long org_x, org_y;
-    int pixel_byte = is_gray ? 1 : 3;
-    long x, y, out_width, out_height;
-    unsigned char* result;
-    double before_edge_x[4], before_edge_y[4];
-    double after_edge_x[4], after_edge_y[4];
-    //0: left-up, 1: right-up, 2: left-down, 3: right-down.
-    double temp1, temp2;
-    
-    double sin_d = sin(2 * (4 * atan(1)) * degree / 360);
-    double cos_d = cos(2 * (4 * atan(1)) * degree / 360);
-    before_edge_x[0] = - ((double)width  - 1) / 2;
-    before_edge_y[0] =   ((double)height - 1) / 2;
-    before_edge_x[1] =   ((double)width  - 1) / 2;
-    before_edge_y[1] =   ((double)height - 1) / 2;
-    before_edge_x[2] = - ((double)width  - 1) / 2;
-    before_edge_y[2] = - ((double)height - 1) / 2;
-    before_edge_x[3] =   ((double)width  - 1) / 2;
-    before_edge_y[3] = - ((double)height - 1) / 2;
-    after_edge_x[0] =  cos_d * before_edge_x[0] + sin_d * before_edge_y[0];
-    after_edge_y[0] = -sin_d * before_edge_x[0] + cos_d * before_edge_y[0];
-    after_edge_x[1] =  cos_d * before_edge_x[1] + sin_d * before_edge_y[1];
-    after_edge_y[1] = -sin_d * before_edge_x[1] + cos_d * before_edge_y[1];
-    after_edge_x[2] =  cos_d * before_edge_x[2] + sin_d * before_edge_y[2];
-    after_edge_y[2] = -sin_d * before_edge_x[2] + cos_d * before_edge_y[2];
-    after_edge_x[3] =  cos_d * before_edge_x[3] + sin_d * before_edge_y[3];
-    after_edge_y[3] = -sin_d * before_edge_x[3] + cos_d * before_edge_y[3];
+void GeometryTrans::Rotate_Box(long width, long height, double degree, bool cut, long &out_width, long &out_height,
+                               double &sin_d, double &cos_d, double &temp1, double &temp2) {
+    double half_width = ((double)width - 1) / 2, half_height = ((double)height - 1) / 2;
+    double before_x, before_y;
+    double after_x[4], after_y[4];
+    //corner k: 0: left-up, 1: right-up, 2: left-down, 3: right-down.
+    
+    sin_d = sin(2 * (4 * atan(1)) * degree / 360);
+    cos_d = cos(2 * (4 * atan(1)) * degree / 360);
+    for (int k = 0; k < 4; k++) {
+        before_x = (k & 1) ? half_width : -half_width;
+        before_y = (k & 2) ? -half_height : half_height;
+        after_x[k] =  cos_d * before_x + sin_d * before_y;
+        after_y[k] = -sin_d * before_x + cos_d * before_y;
+    }
     
     if (cut) {
-        out_width = (long)(MIN(fabs(after_edge_x[3] - after_edge_x[0]), fabs(after_edge_x[2] - after_edge_x[1])) + 0.5);
-        out_height = (long)(MIN(fabs(after_edge_y[3] - after_edge_y[0]), fabs(after_edge_y[2] - after_edge_y[1])) + 0.5);
+        out_width = (long)(MIN(fabs(after_x[3] - after_x[0]), fabs(after_x[2] - after_x[1])) + 0.5);
+        out_height = (long)(MIN(fabs(after_y[3] - after_y[0]), fabs(after_y[2] - after_y[1])) + 0.5);
     }
     else {
-        out_width = (long)(MAX(fabs(after_edge_x[3] - after_edge_x[0]), fabs(after_edge_x[2] - after_edge_x[1])) + 0.5);
-        out_height = (long)(MAX(fabs(after_edge_y[3] - after_edge_y[0]), fabs(after_edge_y[2] - after_edge_y[1])) + 0.5);
+        out_width = (long)(MAX(fabs(after_x[3] - after_x[0]), fabs(after_x[2] - after_x[1])) + 0.5);
+        out_height = (long)(MAX(fabs(after_y[3] - after_y[0]), fabs(after_y[2] - after_y[1])) + 0.5);
     }
     
-    result = new unsigned char[out_height * out_width * pixel_byte];
-    
     temp1 = -0.5 * (out_width - 1) * cos_d + 0.5 * (out_height - 1) * sin_d + 0.5 * (width - 1);
     temp2 = -0.5 * (out_width - 1) * sin_d - 0.5 * (out_height - 1) * cos_d + 0.5 * (height - 1);
+}
+
+void GeometryTrans::Rotate_Resample(int kernel, double degree, unsigned char color_default, bool cut) {
+    SetPacked(false);
+    TRACE_SCOPE(GEOMETRY_ROTATE_NEIGHBOR == kernel ? "Rotate_Neighbor" :
+                GEOMETRY_ROTATE_DOUBLELINEAR == kernel ? "Rotate_DoubleLinear" : "Rotate_Convolution", "GeometryTrans");
+    int pixel_byte = (is_gray || is_planar) ? 1 : 3;
+    long out_width, out_height;
+    double sin_d, cos_d, temp1, temp2;
     
-    for (y = 0; y < out_height; y++) {
-        for (x = 0; x < out_width; x++) {
-            org_x = (long)(x * cos_d - y * sin_d + temp1 + 0.5);
-            org_y = (long)(x * sin_d + y * cos_d + temp2 + 0.5);
-            
-            if (org_x >= 0 && org_x < width && org_y >= 0 && org_y < height) {
-                for (int i = 0; i < pixel_byte; i++) {
-                    result[(y * out_width + x) * pixel_byte + i] = bitmap_array[(org_y * width + org_x) * pixel_byte + i];
-                }
-            }
-            else {
-                for (int i = 0; i < pixel_byte; i++) {
-                    result[(y * out_width + x) * pixel_byte + i] = color_default;
-                }
-            }
-        }
+    Rotate_Box(width, height, degree, cut, out_width, out_height, sin_d, cos_d, temp1, temp2);
+    
+    GeometryTask task = {kernel,
+        {bitmap_array, width, height, pixel_byte, 0, height, 0, width, RowByte(width)},
+        {PixelAlloc(ArrayLength(out_width, out_height)), out_width, out_height, pixel_byte, 0, out_height, 0, out_width, RowByte(out_width)},
+        sin_d, cos_d, temp1, temp2, -sin_d, cos_d, color_default, false, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+    TRACE_BYTES(ArrayLength(width, height) + ArrayLength(out_width, out_height));
+    try {
+        RunPlanes(task);
+    } catch (...) {
+        PixelFree(task.out.band_array);
+        throw;
     }
     
-    delete [] bitmap_array;
-    bitmap_array = result;
+    FreeBitmapArray();
+    bitmap_array = task.out.band_array;
     width = out_width;
     height = out_height;
 }
 
-void GeometryTrans::Rotate_DoubleLinear(double degree, unsigned char color_default, bool cut) {
-    long org_x, org_y;
-    int pixel_byte = is_gray ? 1 : 3;
-    long x, y, out_width, out_height, u, v;
+void GeometryTrans::Rotate_Packed(int kernel) {
+    long out_width = (GEOMETRY_ROTATE_180 == kernel) ? width : height;
+    long out_height = (GEOMETRY_ROTATE_180 == kernel) ? height : width;
+    long tile_count;
+    GeometryTask task = {kernel,
+        {bitmap_array, width, height, 1, 0, height, 0, width, PackedLine(width)},
+        {PixelAlloc(PackedLine(out_width) * out_height), out_width, out_height, 1, 0, out_height, 0, out_width, PackedLine(out_width)},
+        0, 0, 0, 0, 0, 0, 0, false, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+    TRACE_BYTES(2 * ArrayLength(width, height));
+    
+    if (GEOMETRY_ROTATE_180 == kernel)
+        tile_count = (height + GEOMETRY_TRANSPOSE_TILE - 1) / GEOMETRY_TRANSPOSE_TILE;
+    else
+        tile_count = (width + GEOMETRY_TRANSPOSE_TILE - 1) / GEOMETRY_TRANSPOSE_TILE;
+    try {
+        RunTiles(tile_count, Rotate_PackedTile, &task);
+    } catch (...) {
+        PixelFree(task.out.band_array);
+        throw;
+    }
+    
+    FreeBitmapArray();
+    bitmap_array = task.out.band_array;
+    width = out_width;
+    height = out_height;
+}
+
+void GeometryTrans::Rotate_PackedTile(long tile_index, void* context) {
+    const GeometryTask &task = *(const GeometryTask*)context;
+    const ImgBand &org = task.org;
+    const ImgBand &out = task.out;
+    long org_line = PackedLine(org.width);
+    long out_line = PackedLine(out.width);
+    long first = tile_index * GEOMETRY_TRANSPOSE_TILE;
+    long last = MIN(first + GEOMETRY_TRANSPOSE_TILE, (GEOMETRY_ROTATE_180 == task.kernel) ? org.height : org.width);
+    long used_byte = (org.height + 7) / 8;
+    unsigned long long word;
+    long x, y, start, k;
+    
+    if (GEOMETRY_ROTATE_180 == task.kernel) {
+        //row y of out: original row (org.height - 1 - y), its bit x is original bit (org.width - 1 - x),
+        //so word m (bits 64m ~ 64m + 63) is the original bits start ~ start + 63 reversed, start = org.width - 64 (m + 1).
+        //16 zero bytes around the row, as start goes down to about -90.
+        unsigned char* row = new unsigned char[org_line + 32];
+        unsigned char* result = new unsigned char[out_line + 8];
+        const unsigned char* source;
+        
+        memset(row, 0, org_line + 32);
+        for (y = first; y < last; y++) {
+            memcpy(row + 16, org.band_array + (org.height - 1 - y) * org_line, org_line);
+            for (x = 0; x < out_line; x += 8) {
+                start = org.width - 8 * (x + 8) + 128;  //+ 128: not negative, for / and %
+                source = row + 16 + start / 8 - 16;
+                word = 0;
+                for (k = 0; k < 8; k++)
+                    word = word << 8 | source[k];
+                if (0 != start % 8)
+                    word = word << (start % 8) | source[8] >> (8 - start % 8);
+                word = Rotate_ReverseBits(word);
+                for (k = 0; k < 8; k++)
+                    result[x + k] = (unsigned char)(word >> (56 - 8 * k));
+            }
+            memcpy(out.band_array + y * out_line, result, out_line);
+        }
+        delete[] row;
+        delete[] result;
+        return;
+    }
+    
+    //Rotate_90: row y of out is original column (org.width - 1 - y), from row 0 up;
+    //Rotate_270: row y of out is original column y, from the last row down.
+    //Byte j of out (bits 8j ~ 8j + 7) comes from 8 original rows (source, source + org_step, ...),
+    //the ones out of the image are 0; the bytes of 8 columns go to 8 rows of out (result, result + out_step, ...).
+    long org_step = (GEOMETRY_ROTATE_90 == task.kernel) ? org_line : -org_line;
+    long out_step = (GEOMETRY_ROTATE_90 == task.kernel) ? -out_line : out_line;
+    unsigned char* first_row = out.band_array + ((GEOMETRY_ROTATE_90 == task.kernel) ? org.width - 1 - first : first) * out_line;
+    const unsigned char* source;
     unsigned char* result;
-    double before_edge_x[4], before_edge_y[4];
-    double after_edge_x[4], after_edge_y[4];
-    //0: left-up, 1: right-up, 2: left-down, 3: right-down.
-    double temp1, temp2;
-    unsigned char surrounding[2][2];
-    
-    double sin_d = sin(2 * (4 * atan(1)) * degree / 360);
-    double cos_d = cos(2 * (4 * atan(1)) * degree / 360);
-    before_edge_x[0] = - ((double)width  - 1) / 2;
-    before_edge_y[0] =   ((double)height - 1) / 2;
-    before_edge_x[1] =   ((double)width  - 1) / 2;
-    before_edge_y[1] =   ((double)height - 1) / 2;
-    before_edge_x[2] = - ((double)width  - 1) / 2;
-    before_edge_y[2] = - ((double)height - 1) / 2;
-    before_edge_x[3] =   ((double)width  - 1) / 2;
-    before_edge_y[3] = - ((double)height - 1) / 2;
-    after_edge_x[0] =  cos_d * before_edge_x[0] + sin_d * before_edge_y[0];
-    after_edge_y[0] = -sin_d * before_edge_x[0] + cos_d * before_edge_y[0];
-    after_edge_x[1] =  cos_d * before_edge_x[1] + sin_d * before_edge_y[1];
-    after_edge_y[1] = -sin_d * before_edge_x[1] + cos_d * before_edge_y[1];
-    after_edge_x[2] =  cos_d * before_edge_x[2] + sin_d * before_edge_y[2];
-    after_edge_y[2] = -sin_d * before_edge_x[2] + cos_d * before_edge_y[2];
-    after_edge_x[3] =  cos_d * before_edge_x[3] + sin_d * before_edge_y[3];
-    after_edge_y[3] = -sin_d * before_edge_x[3] + cos_d * before_edge_y[3];
+    long rows, cols;
     
-    if (cut) {
-        out_width = (long)(MIN(fabs(after_edge_x[3] - after_edge_x[0]), fabs(after_edge_x[2] - after_edge_x[1])) + 0.5);
-        out_height = (long)(MIN(fabs(after_edge_y[3] - after_edge_y[0]), fabs(after_edge_y[2] - after_edge_y[1])) + 0.5);
+    for (long j = 0; j < used_byte; j++) {
+        rows = MIN(8, org.height - j * 8);
+        source = org.band_array + ((GEOMETRY_ROTATE_90 == task.kernel) ? j * 8 : org.height - 1 - j * 8) * org_line;
+        for (long b = first / 8; b < (last + 7) / 8; b++) {
+            word = 0;
+            for (k = 0; k < rows; k++)
+                word |= (unsigned long long)source[k * org_step + b] << (56 - 8 * k);
+            word = Rotate_Transpose8x8(word);
+            result = first_row + (b * 8 - first) * out_step + j;
+            cols = MIN(8, last - b * 8);
+            for (k = 0; k < cols; k++)
+                result[k * out_step] = (unsigned char)(word >> (56 - 8 * k));
+        }
     }
-    else {
-        out_width = (long)(MAX(fabs(after_edge_x[3] - after_edge_x[0]), fabs(after_edge_x[2] - after_edge_x[1])) + 0.5);
-        out_height = (long)(MAX(fabs(after_edge_y[3] - after_edge_y[0]), fabs(after_edge_y[2] - after_edge_y[1])) + 0.5);
+    for (k = 0; k < last - first; k++)
+        memset(first_row + k * out_step + used_byte, 0, out_line - used_byte);
+}
+
+unsigned long long GeometryTrans::Rotate_Transpose8x8(unsigned long long block) {
+    //every round swaps the two off-diagonal sub-blocks of every 2 x 2, 4 x 4, 8 x 8 block.
+    block = (block & 0xAA55AA55AA55AA55ULL) | ((block & 0x00AA00AA00AA00AAULL) << 7) | ((block >> 7) & 0x00AA00AA00AA00AAULL);
+    block = (block & 0xCCCC3333CCCC3333ULL) | ((block & 0x0000CCCC0000CCCCULL) << 14) | ((block >> 14) & 0x0000CCCC0000CCCCULL);
+    block = (block & 0xF0F0F0F00F0F0F0FULL) | ((block & 0x00000000F0F0F0F0ULL) << 28) | ((block >> 28) & 0x00000000F0F0F0F0ULL);
+    return block;
+}
+
+unsigned long long GeometryTrans::Rotate_ReverseBits(unsigned long long word) {
+    word = ((word >> 1) & 0x5555555555555555ULL) | ((word & 0x5555555555555555ULL) << 1);
+    word = ((word >> 2) & 0x3333333333333333ULL) | ((word & 0x3333333333333333ULL) << 2);
+    word = ((word >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((word & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    word = ((word >> 8) & 0x00FF00FF00FF00FFULL) | ((word & 0x00FF00FF00FF00FFULL) << 8);
+    word = ((word >> 16) & 0x0000FFFF0000FFFFULL) | ((word & 0x0000FFFF0000FFFFULL) << 16);
+    return (word >> 32) | (word << 32);
+}
+
+void GeometryTrans::Rotate_Square_InPlace(bool clockwise) {
+    int pixel_byte = is_gray ? 1 : 3;
+    long row_byte = width * pixel_byte;
+    long x, y, block_x, block_y;
+    unsigned char temp[3];
+    unsigned char* front;
+    unsigned char* back;
+    
+    //transpose: swap (x, y) and (y, x) under the diagonal, block by block.
+    for (block_y = 0; block_y < height; block_y += 16) {
+        for (block_x = 0; block_x <= block_y; block_x += 16) {
+            for (y = block_y; y < MIN(block_y + 16, height); y++) {
+                for (x = block_x; x < MIN(block_x + 16, y); x++) {
+                    front = bitmap_array + y * row_byte + x * pixel_byte;
+                    back = bitmap_array + x * row_byte + y * pixel_byte;
+                    memcpy(temp, front, pixel_byte);
+                    memcpy(front, back, pixel_byte);
+                    memcpy(back, temp, pixel_byte);
+                }
+            }
+        }
     }
     
-    result = new unsigned char[out_height * out_width * pixel_byte];
+    if (clockwise) {
+        //Rotate_90: upside down.
+        unsigned char* row_temp = new unsigned char[row_byte];
+        for (y = 0; y < height / 2; y++) {
+            front = bitmap_array + y * row_byte;
+            back = bitmap_array + (height - 1 - y) * row_byte;
+            memcpy(row_temp, front, row_byte);
+            memcpy(front, back, row_byte);
+            memcpy(back, row_temp, row_byte);
+        }
+        delete[] row_temp;
+    }
+    else {
+        //Rotate_270: left to right.
+        for (y = 0; y < height; y++) {
+            for (x = 0; x < width / 2; x++) {
+                front = bitmap_array + y * row_byte + x * pixel_byte;
+                back = bitmap_array + y * row_byte + (width - 1 - x) * pixel_byte;
+                memcpy(temp, front, pixel_byte);
+                memcpy(front, back, pixel_byte);
+                memcpy(back, temp, pixel_byte);
+            }
+        }
+    }
+}
+
+template <int CH>
+void GeometryTrans::Rotate_90_Tile(const GeometryTask &task, ImgBand &out) {
+    const ImgBand &org = task.org;
+    long org_row_byte = org.stride;
+    long out_row_byte = out.stride;
+    long x, y, block_x, block_y;
+    const unsigned char* source;
+    unsigned char* result;
     
-    temp1 = -0.5 * (out_width - 1) * cos_d + 0.5 * (out_height - 1) * sin_d + 0.5 * (width - 1);
-    temp2 = -0.5 * (out_width - 1) * sin_d - 0.5 * (out_height - 1) * cos_d + 0.5 * (height - 1);
+    const int block = (1 == CH) ? 16 : 8;
     
-    for (y = 0; y < out_height; y++) {
-        for (x = 0; x < out_width; x++) {
-            org_x = x * cos_d - y * sin_d + temp1;
-            org_y = x * sin_d + y * cos_d + temp2;
-            u = (long)org_x;
-            v = (long)org_y;
-            
-            if (org_x >= 0 && org_x < width - 1 && org_y >= 0 && org_y < height - 1) {
-                for (int i = 0; i < pixel_byte; i++) {
-                    surrounding[0][0] = bitmap_array[(v * width + u) * pixel_byte + i];
-                    surrounding[0][1] = bitmap_array[(v * width + (u + 1)) * pixel_byte + i];
-                    surrounding[1][0] = bitmap_array[((v + 1) * width + u) * pixel_byte + i];
-                    surrounding[1][1] = bitmap_array[((v + 1) * width + (u + 1)) * pixel_byte + i];
-                    
-                    result[(y * out_width + x) * pixel_byte + i] = Interpolation_DoubleLinear_core(surrounding, org_x - u, org_y - v);
+    for (block_y = out.first_row; block_y < out.last_row; block_y += block) {
+        for (block_x = out.first_col; block_x < out.last_col; block_x += block) {
+            if (block_y + block <= out.last_row && block_x + block <= out.last_col) {
+                //source rows block_x ~ block_x + block - 1, columns (org.width - block - block_y) ~ ...,
+                //its first column is the last row of the block.
+                source = org.band_array + block_x * org_row_byte + (org.width - block - block_y) * CH;
+                result = out.band_array + (block_y + block - 1 - out.first_row) * out_row_byte + block_x * CH;
+                if (1 == CH)
+                    Transpose16_Simd(source, org_row_byte, result, -out_row_byte);
+                else
+                    Transpose8_BGR_Simd(source, org_row_byte, result, -out_row_byte);
+                continue;
+            }
+            for (y = block_y; y < MIN(block_y + block, out.last_row); y++) {
+                result = out.band_array + (y - out.first_row) * out_row_byte;
+                for (x = block_x; x < MIN(block_x + block, out.last_col); x++) {
+                    source = org.band_array + x * org_row_byte + (org.width - y - 1) * CH;
+                    for (int i = 0; i < CH; i++) {
+                        result[x * CH + i] = source[i];
+                    }
                 }
             }
-            else {
-                for (int i = 0; i < pixel_byte; i++) {
-                    result[(y * out_width + x) * pixel_byte + i] = color_default;
+        }
+    }
+}
+
+template <int CH>
+void GeometryTrans::Rotate_180_Tile(const GeometryTask &task, ImgBand &out) {
+    const ImgBand &org = task.org;
+    long x, y;
+    unsigned char* result;
+    
+    for (y = out.first_row; y < out.last_row; y++) {
+        result = out.band_array + (y - out.first_row) * out.stride;
+        for (x = out.first_col; x < out.last_col; x++) {
+            for (int i = 0; i < CH; i++) {
+                result[x * CH + i] = org.band_array[(org.height - y - 1) * org.stride + (org.width - x - 1) * CH + i];
+            }
+        }
+    }
+}
+
+template <int CH>
+void GeometryTrans::Rotate_270_Tile(const GeometryTask &task, ImgBand &out) {
+    const ImgBand &org = task.org;
+    long org_row_byte = org.stride;
+    long out_row_byte = out.stride;
+    long x, y, block_x, block_y;
+    const unsigned char* source;
+    unsigned char* result;
+    
+    const int block = (1 == CH) ? 16 : 8;
+    
+    for (block_y = out.first_row; block_y < out.last_row; block_y += block) {
+        for (block_x = out.first_col; block_x < out.last_col; block_x += block) {
+            if (block_y + block <= out.last_row && block_x + block <= out.last_col) {
+                //source rows (org.height - 1 - block_x) down to ..., columns block_y ~ block_y + block - 1.
+                source = org.band_array + (org.height - 1 - block_x) * org_row_byte + block_y * CH;
+                result = out.band_array + (block_y - out.first_row) * out_row_byte + block_x * CH;
+                if (1 == CH)
+                    Transpose16_Simd(source, -org_row_byte, result, out_row_byte);
+                else
+                    Transpose8_BGR_Simd(source, -org_row_byte, result, out_row_byte);
+                continue;
+            }
+            for (y = block_y; y < MIN(block_y + block, out.last_row); y++) {
+                result = out.band_array + (y - out.first_row) * out_row_byte;
+                for (x = block_x; x < MIN(block_x + block, out.last_col); x++) {
+                    source = org.band_array + (org.height - x - 1) * org_row_byte + y * CH;
+                    for (int i = 0; i < CH; i++) {
+                        result[x * CH + i] = source[i];
+                    }
                 }
             }
         }
     }
+}
+
+void GeometryTrans::Rotate_RowSpan(const GeometryTask &task, long y, double offset, double low, double high_margin, bool truncate,
+                                   long first_col, long last_col, long &first_x, long &last_x, long long &pos_x, long long &pos_y) {
+    //u = x * cos_d + start_u, v = x * sin_d + start_v
+    double start_u = task.temp1 + y * task.row_u + offset;
+    double start_v = task.temp2 + y * task.row_v + offset;
+    double step[2] = {task.cos_d, task.sin_d};
+    double start[2] = {start_u, start_v};
+    double high[2] = {task.org.width - high_margin, task.org.height - high_margin};
+    double from = first_col, to = last_col;
+    long long fixed_start[2], fixed_step[2], fixed_low, fixed_high[2];
+    long long position;
+    long org_x, org_y;
+    bool inside;
+    int k;
     
-    delete [] bitmap_array;
-    bitmap_array = result;
-    width = out_width;
-    height = out_height;
+    if (truncate)
+        low -= 1;   //(long) makes (-1, 0) column 0
+    for (k = 0; k < 2; k++) {
+        fixed_start[k] = (long long)floor(start[k] * GEOMETRY_FIXED_ONE + 0.5);
+        fixed_step[k] = (long long)floor(step[k] * GEOMETRY_FIXED_ONE + 0.5);
+        fixed_high[k] = (long long)(high[k] * GEOMETRY_FIXED_ONE);
+        
+        //low <= start + x * step < high
+        if (step[k] > 0) {
+            from = MAX(from, (low - start[k]) / step[k]);
+            to = MIN(to, (high[k] - start[k]) / step[k]);
+        }
+        else if (step[k] < 0) {
+            from = MAX(from, (high[k] - start[k]) / step[k]);
+            to = MIN(to, (low - start[k]) / step[k]);
+        }
+        else if (start[k] < low || start[k] >= high[k]) {
+            to = from;
+        }
+    }
+    fixed_low = (long long)(low * GEOMETRY_FIXED_ONE);
+    
+    //the doubles above may be 1 pixel off, the fixed point (or the original expression) decides.
+    #define ROTATE_INSIDE(x) (truncate ? ( \
+        org_x = (long)((x) * task.cos_d + y * task.row_u + task.temp1 + offset), \
+        org_y = (long)((x) * task.sin_d + y * task.row_v + task.temp2 + offset), \
+        org_x >= 0 && org_x < task.org.width && org_y >= 0 && org_y < task.org.height) : ( \
+        position = fixed_start[0] + (x) * fixed_step[0], \
+        inside = (fixed_low <= position && position < fixed_high[0]), \
+        position = fixed_start[1] + (x) * fixed_step[1], \
+        inside && fixed_low <= position && position < fixed_high[1]))
+    
+    first_x = (long)MIN(MAX(ceil(from), first_col), last_col);
+    last_x = (long)MIN(MAX(ceil(to), first_x), last_col);
+    while (first_x < last_x && !ROTATE_INSIDE(first_x))
+        first_x++;
+    while (first_x > first_col && ROTATE_INSIDE(first_x - 1))
+        first_x--;
+    if (last_x < first_x)
+        last_x = first_x;
+    while (last_x > first_x && !ROTATE_INSIDE(last_x - 1))
+        last_x--;
+    while (last_x < last_col && ROTATE_INSIDE(last_x))
+        last_x++;
+    
+    #undef ROTATE_INSIDE
+    
+    pos_x = fixed_start[0] + first_x * fixed_step[0];
+    pos_y = fixed_start[1] + first_x * fixed_step[1];
 }
 
-void GeometryTrans::Rotate_Convolution(double degree, unsigned char color_default, bool cut) {
+template <int CH, class Interp, class Border>
+void GeometryTrans::Rotate_Tile(const GeometryTask &task, ImgBand &out) {
+    const ImgBand &org = task.org;
+    long long step_x = (long long)floor(task.cos_d * GEOMETRY_FIXED_ONE + 0.5);
+    long long step_y = (long long)floor(task.sin_d * GEOMETRY_FIXED_ONE + 0.5);
+    double row_u, row_v;
+    long long pos_x, pos_y;
     long org_x, org_y;
-    int pixel_byte = is_gray ? 1 : 3;
-    long x, y, out_width, out_height, u, v;
+    long first_x, last_x, edge_first, edge_last, x, y;
+    Interp interp;
     unsigned char* result;
-    double before_edge_x[4], before_edge_y[4];
-    double after_edge_x[4], after_edge_y[4];
-    //0: left-up, 1: right-up, 2: left-down, 3: right-down.
-    double temp1, temp2;
-    int i, j;
-    unsigned char surrounding[4][4];
-    
-    double sin_d = sin(2 * (4 * atan(1)) * degree / 360);
-    double cos_d = cos(2 * (4 * atan(1)) * degree / 360);
-    before_edge_x[0] = - ((double)width  - 1) / 2;
-    before_edge_y[0] =   ((double)height - 1) / 2;
-    before_edge_x[1] =   ((double)width  - 1) / 2;
-    before_edge_y[1] =   ((double)height - 1) / 2;
-    before_edge_x[2] = - ((double)width  - 1) / 2;
-    before_edge_y[2] = - ((double)height - 1) / 2;
-    before_edge_x[3] =   ((double)width  - 1) / 2;
-    before_edge_y[3] = - ((double)height - 1) / 2;
-    after_edge_x[0] =  cos_d * before_edge_x[0] + sin_d * before_edge_y[0];
-    after_edge_y[0] = -sin_d * before_edge_x[0] + cos_d * before_edge_y[0];
-    after_edge_x[1] =  cos_d * before_edge_x[1] + sin_d * before_edge_y[1];
-    after_edge_y[1] = -sin_d * before_edge_x[1] + cos_d * before_edge_y[1];
-    after_edge_x[2] =  cos_d * before_edge_x[2] + sin_d * before_edge_y[2];
-    after_edge_y[2] = -sin_d * before_edge_x[2] + cos_d * before_edge_y[2];
-    after_edge_x[3] =  cos_d * before_edge_x[3] + sin_d * before_edge_y[3];
-    after_edge_y[3] = -sin_d * before_edge_x[3] + cos_d * before_edge_y[3];
     
-    if (cut) {
-        out_width = (long)(MIN(fabs(after_edge_x[3] - after_edge_x[0]), fabs(after_edge_x[2] - after_edge_x[1])) + 0.5);
-        out_height = (long)(MIN(fabs(after_edge_y[3] - after_edge_y[0]), fabs(after_edge_y[2] - after_edge_y[1])) + 0.5);
+    for (y = out.first_row; y < out.last_row; y++) {
+        result = out.band_array + (y - out.first_row) * out.stride;
+        //nearest: (long)(u + 0.5); the others: u - low ~ u + high_margin and v - low ~ v + high_margin must be inside.
+        Rotate_RowSpan(task, y, Interp::nearest ? 0.5 : 0, Interp::low, Interp::high_margin, Interp::nearest, out.first_col, out.last_col, first_x, last_x, pos_x, pos_y);
+        row_u = y * task.row_u;
+        row_v = y * task.row_v;
+        
+        Border::EdgeSpan(task, y, out.first_col, out.last_col, step_x, step_y, first_x, last_x, pos_x, pos_y, edge_first, edge_last);
+        
+        memset(result + out.first_col * CH, task.color_default, (edge_first - out.first_col) * CH);
+        Border::template EdgePixels<CH>(task, interp, edge_first, first_x, pos_x - (first_x - edge_first) * step_x, pos_y - (first_x - edge_first) * step_y, step_x, step_y, result);
+        for (x = first_x; x < last_x; x++) {
+            if (Interp::nearest) {
+                //(long)(u + 0.5): the nearest pixel, the same double expression as <Rotate_RowSpan>.
+                org_x = (long)(x * task.cos_d + row_u + task.temp1 + 0.5);
+                org_y = (long)(x * task.sin_d + row_v + task.temp2 + 0.5);
+                interp.template Sample<CH>(org, (long long)org_x << GEOMETRY_FIXED_BITS, (long long)org_y << GEOMETRY_FIXED_BITS, result + x * CH);
+            }
+            else
+                interp.template Sample<CH>(org, pos_x, pos_y, result + x * CH);
+            pos_x += step_x;
+            pos_y += step_y;
+        }
+        Border::template EdgePixels<CH>(task, interp, last_x, edge_last, pos_x, pos_y, step_x, step_y, result);
+        memset(result + edge_last * CH, task.color_default, (out.last_col - edge_last) * CH);
     }
-    else {
-        out_width = (long)(MAX(fabs(after_edge_x[3] - after_edge_x[0]), fabs(after_edge_x[2] - after_edge_x[1])) + 0.5);
-        out_height = (long)(MAX(fabs(after_edge_y[3] - after_edge_y[0]), fabs(after_edge_y[2] - after_edge_y[1])) + 0.5);
+}
+
+template <int CH>
+void GeometryTrans::Interp_DoubleLinear::Sample(const ImgBand &org, long long pos_x, long long pos_y, unsigned char* result) {
+    long row_byte = org.stride;
+    const unsigned char* source = org.band_array + (pos_y >> GEOMETRY_FIXED_BITS) * row_byte + (pos_x >> GEOMETRY_FIXED_BITS) * CH;
+    int fraction_x = (int)(pos_x >> (GEOMETRY_FIXED_BITS - 8)) & 0xFF;
+    int fraction_y = (int)(pos_y >> (GEOMETRY_FIXED_BITS - 8)) & 0xFF;
+    int top, bottom;
+    
+    for (int i = 0; i < CH; i++) {
+        top = source[i] * (256 - fraction_x) + source[CH + i] * fraction_x;
+        bottom = source[row_byte + i] * (256 - fraction_x) + source[row_byte + CH + i] * fraction_x;
+        result[i] = (unsigned char)((top * (256 - fraction_y) + bottom * fraction_y + 32768) >> 16);
     }
+}
+
+template <int CH>
+void GeometryTrans::Interp_Convolution::Sample(const ImgBand &org, long long pos_x, long long pos_y, unsigned char* result) {
+    long row_byte = org.stride;
+    const unsigned char* source = org.band_array + ((pos_y >> GEOMETRY_FIXED_BITS) - 1) * row_byte + ((pos_x >> GEOMETRY_FIXED_BITS) - 1) * CH;
+    const int* weight_x = cubic_weight[(pos_x >> (GEOMETRY_FIXED_BITS - 8)) & 0xFF];
+    const int* weight_y = cubic_weight[(pos_y >> (GEOMETRY_FIXED_BITS - 8)) & 0xFF];
+    int sum, row_sum;
     
-    result = new unsigned char[out_height * out_width * pixel_byte];
+    for (int k = 0; k < CH; k++) {
+        sum = 1 << 20;
+        for (int j = 0; j < 4; j++) {
+            row_sum = 0;
+            for (int i = 0; i < 4; i++) {
+                row_sum += weight_x[i] * source[j * row_byte + i * CH + k];
+            }
+            //14 + 14 bits would overflow, keep 7 bits of the row.
+            sum += weight_y[j] * ((row_sum + 64) >> 7);
+        }
+        sum >>= 21;
+        result[k] = (unsigned char)MIN(MAX(sum, 0), 255);
+    }
+}
+
+void GeometryTrans::Border_Clamp::EdgeSpan(const GeometryTask &task, long y, long first_col, long last_col, long long step_x, long long step_y,
+                                         long &first_x, long &last_x, long long &pos_x, long long &pos_y, long &edge_first, long &edge_last) {
+    long long edge_x, edge_y;
     
-    temp1 = -0.5 * (out_width - 1) * cos_d + 0.5 * (out_height - 1) * sin_d + 0.5 * (width - 1);
-    temp2 = -0.5 * (out_width - 1) * sin_d - 0.5 * (out_height - 1) * cos_d + 0.5 * (height - 1);
+    //-1 <= u < org.width and -1 <= v < org.height, it covers [first_x, last_x) of every kernel.
+    Rotate_RowSpan(task, y, 0, -1, 0, false, first_col, last_col, edge_first, edge_last, edge_x, edge_y);
+    if (first_x >= last_x) {
+        pos_x += (edge_first - first_x) * step_x;
+        pos_y += (edge_first - first_x) * step_y;
+        first_x = edge_first;
+        last_x = edge_first;
+    }
+    else {
+        //the truncated Neighbor columns reach down to u = -1.5.
+        edge_first = MIN(edge_first, first_x);
+        edge_last = MAX(edge_last, last_x);
+    }
+}
+
+template <int CH, class Interp>
+void GeometryTrans::Rotate_EdgePixels(const GeometryTask &task, Interp &interp, long first_x, long last_x,
+                                      long long pos_x, long long pos_y, long long step_x, long long step_y, unsigned char* result) {
+    const ImgBand &org = task.org;
+    const int taps = Interp::taps;
+    long col[taps], row[taps], u, v, x;
+    int weight_x[taps], weight_y[taps];
+    int fraction_x, fraction_y, i, j, k, sum, row_sum;
     
-    for (y = 0; y < out_height; y++) {
-        for (x = 0; x < out_width; x++) {
-            org_x = x * cos_d - y * sin_d + temp1;
-            org_y = x * sin_d + y * cos_d + temp2;
-            u = (long)org_x;
-            v = (long)org_y;
-            
-            if (org_x >= 0 && org_x < width - 2 && org_y >= 0 && org_y < height - 2) {
-                for (int k = 0; k < pixel_byte; k++) {
-                    for (j = (int)v - 1; j < v + 3; j++) {
-                        for (i = (int)u - 1; i < u + 3; i++) {
-                            surrounding[j - v + 1][i - u + 1] = bitmap_array[(j * width + i) * pixel_byte + k];
-                        }
-                    }
-                    result[(y * out_width + x) * pixel_byte + k] = Interpolation_Convolution_core(surrounding, org_x - u, org_y - v);
-                }
-            }
-            else {
-                for (int k = 0; k < pixel_byte; k++) {
-                    result[(y * out_width + x) * pixel_byte + k] = color_default;
+    for (x = first_x; x < last_x; x++, pos_x += step_x, pos_y += step_y) {
+        u = (long)(pos_x >> GEOMETRY_FIXED_BITS) - Interp::low;
+        v = (long)(pos_y >> GEOMETRY_FIXED_BITS) - Interp::low;
+        fraction_x = (int)(pos_x >> (GEOMETRY_FIXED_BITS - 8)) & 0xFF;
+        fraction_y = (int)(pos_y >> (GEOMETRY_FIXED_BITS - 8)) & 0xFF;
+        
+        //the same weights as the kernels, but every source pixel is clamped into org.
+        interp.Weights(fraction_x, fraction_y, weight_x, weight_y);
+        for (i = 0; i < taps; i++) {
+            col[i] = MIN(MAX(u + i, 0), org.width - 1);
+            row[i] = MIN(MAX(v + i, 0), org.height - 1);
+        }
+        
+        for (k = 0; k < CH; k++) {
+            sum = 1 << 20;
+            for (j = 0; j < taps; j++) {
+                row_sum = 0;
+                for (i = 0; i < taps; i++) {
+                    row_sum += weight_x[i] * org.band_array[row[j] * org.stride + col[i] * CH + k];
                 }
+                sum += weight_y[j] * ((row_sum + 64) >> 7);
             }
+            sum >>= 21;
+            result[x * CH + k] = (unsigned char)MIN(MAX(sum, 0), 255);
         }
     }
+}
+
+void GeometryTrans::Rotate_CubicWeight(int fraction, int* weight) {
+    double w;
     
-    delete [] bitmap_array;
-    bitmap_array = result;
-    width = out_width;
-    height = out_height;
+    for (int j = 0; j < 4; j++) {
+        w = fabs(fraction / 256.0 + 1 - j);
+        if (w < 1)
+            weight[j] = (int)floor((w * w * w - 2 * w * w + 1) * 16384 + 0.5);
+        else if (w < 2)
+            weight[j] = (int)floor((- w * w * w + 5 * w * w - 8 * w + 4) * 16384 + 0.5);
+        else
+            weight[j] = 0;
+    }
 }
 
 #endif /* GeometryTrans_Class_hpp */
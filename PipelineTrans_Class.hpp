@@ -0,0 +1,367 @@
+/* ***************************************************************************
+ functions in this (PipelineTrans_Class.hpp) hpp file:
+ 
+ (1) PipelineTrans(bmpData org_bmp_img) : GeometryTrans(org_bmp_img);
+ 
+ (2) PipelineTrans(BitMapImg &&org) : GeometryTrans(std::move(org));
+ * take the pixels of a BitMapImg (or any derived) object, nothing is copied, org is left empty.
+ * Moving a PipelineTrans into another class takes the pixels only, so <Run> it first.
+ 
+ (3) void ColorToGray(void);
+     void Binary(int threshold = 128);
+     void Reverse(void);
+     void LogarithmStretch(double a = 0, double b = 0.033, double c = 2);
+     void ExponentStretch(double a = 128, double b = 2, double c = 0.6);
+     void Zoom(long out_width, long out_height, int select_algorithm = 1);
+     void Rotate(double degree, int select_algorithm = 1, unsigned char color_default = 255, bool cut = false);
+ * may throw: PIPELINE_TOO_MANY_OPS.
+ * Only record the operation, same meaning as in ColorTrans / GeometryTrans.
+ * Nothing is done until <Run>.
+ 
+ (4) void Run(void);
+ * Do all the recorded operations (in order), then forget them. Call it before TransToBmp.
+ * Continuous point operations are one pass over the image, in place (see <StreamTrans::ApplyOps>).
+ * Continuous Zoom / Rotate are composed into one affine map and resampled once (<RunGeometry>),
+ * and the point operations right after them are done on every tile while it is still in cache.
+ * e.g. gray -> stretch -> zoom -> rotate: one pass in place, one resample, one new array.
+ * The fused tiles work on interleaved pixels, so a planar image is interleaved first (BitMapImg <SetPlanar>),
+ * and on bytes, so a packed one is unpacked first (BitMapImg <SetPacked>).
+ 
+ (5) int RunGeometry(int first_op, int last_op, int point_last);
+ * Do the Zoom / Rotate op_list[first_op] ... op_list[last_op - 1] as one resample,
+ * and the point operations op_list[last_op] ... op_list[point_last - 1] in its tiles.
+ * Return the first operation not done yet (last_op or point_last).
+ * Only Zoom, or only right-angle Rotate: done by GeometryTrans, the same as one by one.
+ * Zoom and right-angle Rotate, but no other Rotate: one by one by GeometryTrans.
+ * Others: the Rotate kernels of GeometryTrans with the composed map (u, v of GeometryTask),
+ * with the best interpolation of them (1: Neighbor, 2: DoubleLinear, 3: Convolution, Zoom 4 / 5 / 6 count as 2 / 3 / 2),
+ * pixels out of the image take color_default of the last Rotate,
+ * but with a Zoom, the ones a little out of it (by <= 1 pixel) take its edge pixels (clamp_edge),
+ * as Zoom itself never leaves the image.
+ * So the result is close to (not the same as) the one by one result:
+ * one interpolation instead of several, and no rounding to bytes in between.
+ 
+ (6) static void PipelineTile(long tile_index, void* context);
+ * tile_function of <RunTiles>, context is a PipelineTask:
+ * resample a GEOMETRY_TILE_ROWS x GEOMETRY_TILE_COLS tile into a buffer on the stack,
+ * apply lut_before, ColorToGray (if to_gray) and lut_after on it, and copy it into out_array.
+ 
+ (7) static void AddAffine(double* affine, double a, double b, double c, double d, double e, double f);
+ * affine = affine * [a, b, c; d, e, f; 0, 0, 1].
+ * affine[6] maps (x, y) of the result to (u, v) of the original: {cos_d, row_u, temp1, sin_d, row_v, temp2}.
+ 
+ (8) void CompileOps(int first_op, int last_op, int pixel_byte, unsigned char* lut_before, bool &to_gray, unsigned char* lut_after);
+ * Point operations op_list[first_op] ... op_list[last_op - 1] on pixels of pixel_byte,
+ * as lut_before -> ColorToGray (if to_gray) -> lut_after, so a tile does not build its own tables.
+ *****************************************************************************/
+
+#ifndef PipelineTrans_Class_hpp
+#define PipelineTrans_Class_hpp
+
+#include <cmath>
+#include <cstring>
+
+#define PIPELINE_MAX_OPS    32
+//op_code of StreamOp, besides STREAM_OP_xxx:
+#define PIPELINE_OP_ZOOM    16
+#define PIPELINE_OP_ROTATE  17
+
+typedef struct struct_PipelineTask {
+    GeometryTask geometry;  //out.band_array is not used, tiles go to out_array.
+    unsigned char* out_array;
+    int out_pixel_byte;
+    unsigned char lut_before[256];
+    unsigned char lut_after[256];
+    bool lut_before_used;
+    bool to_gray;
+    bool lut_after_used;
+} PipelineTask;
+
+class PipelineTrans : public GeometryTrans {
+//data:
+private:
+    StreamOp op_list[PIPELINE_MAX_OPS];
+    int op_count;
+    
+//functions:
+public:
+    PipelineTrans(bmpData org_bmp_img) : GeometryTrans(org_bmp_img) {
+        op_count = 0;
+    }
+    PipelineTrans(BitMapImg &&org) : GeometryTrans(std::move(org)) {
+        op_count = 0;
+    }
+    void ColorToGray(void) {AddOp(STREAM_OP_GRAY, 0, 0, 0, 0);}
+    void Binary(int threshold = 128) {AddOp(STREAM_OP_BINARY, threshold, 0, 0, 0);}
+    void Reverse(void) {AddOp(STREAM_OP_REVERSE, 0, 0, 0, 0);}
+    void LogarithmStretch(double a = 0, double b = 0.033, double c = 2) {AddOp(STREAM_OP_LOG, a, b, c, 0);}
+    void ExponentStretch(double a = 128, double b = 2, double c = 0.6) {AddOp(STREAM_OP_EXP, a, b, c, 0);}
+    void Zoom(long out_width, long out_height, int select_algorithm = 1) {
+        AddOp(PIPELINE_OP_ZOOM, out_width, out_height, select_algorithm, 0);
+    }
+    void Rotate(double degree, int select_algorithm = 1, unsigned char color_default = 255, bool cut = false) {
+        AddOp(PIPELINE_OP_ROTATE, degree, select_algorithm, color_default, cut);
+    }
+    void Run(void);
+    
+private:
+    void AddOp(int op_code, double arg0, double arg1, double arg2, double arg3) {
+        if (op_count >= PIPELINE_MAX_OPS)
+            throw PIPELINE_TOO_MANY_OPS;
+        op_list[op_count].op_code = op_code;
+        op_list[op_count].arg[0] = arg0;
+        op_list[op_count].arg[1] = arg1;
+        op_list[op_count].arg[2] = arg2;
+        op_list[op_count].arg[3] = arg3;
+        op_count++;
+    }
+    bool IsGeometryOp(int i) {
+        return PIPELINE_OP_ZOOM == op_list[i].op_code || PIPELINE_OP_ROTATE == op_list[i].op_code;
+    }
+    static int ZoomLevel(int algorithm) {
+        return (6 == algorithm) ? 2 : (algorithm <= 3 ? algorithm : algorithm - 2);
+    }
+    int RunGeometry(int first_op, int last_op, int point_last);
+    void CompileOps(int first_op, int last_op, int pixel_byte, unsigned char* lut_before, bool &to_gray, unsigned char* lut_after);
+    static void PipelineTile(long tile_index, void* context);
+    static void AddAffine(double* affine, double a, double b, double c, double d, double e, double f);
+};
+
+
+
+void PipelineTrans::Run(void) {
+    int first_op = 0, last_op, point_last;
+    int pixel_byte;
+    
+    if (op_count > 0) {
+        SetPlanar(false);
+        SetPacked(false);
+    }
+    while (first_op < op_count) {
+        //point operations: one pass in place.
+        for (last_op = first_op; last_op < op_count && !IsGeometryOp(last_op); last_op++);
+        if (last_op > first_op) {
+            TRACE_SCOPE("point ops", "PipelineTrans");
+            pixel_byte = is_gray ? 1 : 3;
+            TRACE_BYTES(2 * width * height * pixel_byte);
+            StreamTrans::ApplyOps(op_list, first_op, last_op, bitmap_array, width * height, pixel_byte);
+            is_gray = (1 == pixel_byte);
+            first_op = last_op;
+        }
+        if (first_op >= op_count)
+            break;
+        
+        //Zoom / Rotate, and the point operations after them.
+        TRACE_SCOPE("geometry", "PipelineTrans");
+        for (last_op = first_op; last_op < op_count && IsGeometryOp(last_op); last_op++);
+        for (point_last = last_op; point_last < op_count && !IsGeometryOp(point_last); point_last++);
+        first_op = RunGeometry(first_op, last_op, point_last);
+    }
+    op_count = 0;
+}
+
+int PipelineTrans::RunGeometry(int first_op, int last_op, int point_last) {
+    const double eps = 1e-10;
+    double affine[6] = {1, 0, 0, 0, 1, 0};
+    long out_width = width, out_height = height, swap_temp;
+    int level = 1, zoom_algorithm = 1, right_degree = 0;
+    bool only_zoom = true, only_right = true, changed = false, has_zoom = false, free_rotate = false;
+    unsigned char color_default = 255;
+    double degree, degree_float, sin_d, cos_d, temp1, temp2;
+    int degree_int, algorithm;
+    
+    for (int i = first_op; i < last_op; i++) {
+        if (PIPELINE_OP_ZOOM == op_list[i].op_code) {
+            long zoom_width = (long)op_list[i].arg[0];
+            long zoom_height = (long)op_list[i].arg[1];
+            algorithm = (int)op_list[i].arg[2];
+            if (algorithm < 1 || algorithm > 6 || (zoom_width == out_width && zoom_height == out_height))
+                continue;
+            
+            //(x, y) of the zoomed image is (x * out_width / zoom_width, ...) before it, see <Zoom_Neighbor>.
+            AddAffine(affine, (double)out_width / zoom_width, 0, 0, 0, (double)out_height / zoom_height, 0);
+            out_width = zoom_width;
+            out_height = zoom_height;
+            if (ZoomLevel(algorithm) > ZoomLevel(zoom_algorithm))
+                zoom_algorithm = algorithm;
+            level = MAX(level, ZoomLevel(algorithm));
+            only_right = false;
+            changed = true;
+            has_zoom = true;
+            continue;
+        }
+        
+        //the same as <GeometryTrans::Rotate>:
+        degree = op_list[i].arg[0];
+        algorithm = (int)op_list[i].arg[1];
+        degree_int = (int)degree;
+        degree_float = degree - degree_int;
+        degree_int %= 360;
+        degree = degree_int + degree_float;
+        
+        if (fabs(degree - 90) < eps) {
+            AddAffine(affine, 0, -1, out_width - 1, 1, 0, 0);   //see <Rotate_90_Tile>
+            right_degree += 90;
+            swap_temp = out_width;
+            out_width = out_height;
+            out_height = swap_temp;
+        }
+        else if (fabs(degree - 180) < eps) {
+            AddAffine(affine, -1, 0, out_width - 1, 0, -1, out_height - 1);
+            right_degree += 180;
+        }
+        else if (fabs(degree - 270) < eps) {
+            AddAffine(affine, 0, 1, 0, -1, 0, out_height - 1);
+            right_degree += 270;
+            swap_temp = out_width;
+            out_width = out_height;
+            out_height = swap_temp;
+        }
+        else if (fabs(degree - 360) < eps || algorithm < 1 || algorithm > 3) {
+            continue;
+        }
+        else {
+            Rotate_Box(out_width, out_height, degree, op_list[i].arg[3] != 0, out_width, out_height, sin_d, cos_d, temp1, temp2);
+            AddAffine(affine, cos_d, -sin_d, temp1, sin_d, cos_d, temp2);
+            level = MAX(level, algorithm);
+            color_default = (unsigned char)op_list[i].arg[2];
+            only_right = false;
+            only_zoom = false;
+            changed = true;
+            free_rotate = true;
+            continue;
+        }
+        only_zoom = false;
+        changed = true;
+    }
+    
+    if (!changed)
+        return last_op;
+    if (only_zoom) {
+        GeometryTrans::Zoom(out_width, out_height, zoom_algorithm);
+        return last_op;
+    }
+    if (only_right) {
+        if (90 == right_degree % 360)
+            Rotate_90();
+        else if (180 == right_degree % 360)
+            Rotate_180();
+        else if (270 == right_degree % 360)
+            Rotate_270();
+        return last_op;
+    }
+    if (!free_rotate) {
+        //Zoom and right-angle Rotate: one by one, as the composed map would sample the Zoom
+        //at other positions (a Neighbor Zoom could pick other pixels).
+        for (int i = first_op; i < last_op; i++) {
+            if (PIPELINE_OP_ZOOM == op_list[i].op_code)
+                GeometryTrans::Zoom((long)op_list[i].arg[0], (long)op_list[i].arg[1], (int)op_list[i].arg[2]);
+            else
+                GeometryTrans::Rotate(op_list[i].arg[0], (int)op_list[i].arg[1], (unsigned char)op_list[i].arg[2], op_list[i].arg[3] != 0);
+        }
+        return last_op;
+    }
+    
+    int pixel_byte = is_gray ? 1 : 3;
+    PipelineTask task;
+    GeometryTask geometry = {GEOMETRY_ROTATE_NEIGHBOR + level - 1,
+        {bitmap_array, width, height, pixel_byte, 0, height, 0, width, width * pixel_byte},
+        {NULL, out_width, out_height, pixel_byte, 0, out_height, 0, out_width, out_width * pixel_byte},
+        affine[3], affine[0], affine[2], affine[5], affine[1], affine[4], color_default, has_zoom, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+    long tile_rows = (out_height + GEOMETRY_TILE_ROWS - 1) / GEOMETRY_TILE_ROWS;
+    long tile_cols = (out_width + GEOMETRY_TILE_COLS - 1) / GEOMETRY_TILE_COLS;
+    
+    geometry.tile_kernel = GeometryKernelOf(geometry);  //once, not per tile
+    task.geometry = geometry;
+    CompileOps(last_op, point_last, pixel_byte, task.lut_before, task.to_gray, task.lut_after);
+    task.out_pixel_byte = task.to_gray ? 1 : pixel_byte;
+    task.lut_before_used = false;
+    task.lut_after_used = false;
+    for (int i = 0; i < 256; i++) {
+        task.lut_before_used = task.lut_before_used || task.lut_before[i] != i;
+        task.lut_after_used = task.lut_after_used || task.lut_after[i] != i;
+    }
+    task.out_array = PixelAlloc(out_width * out_height * task.out_pixel_byte);
+    
+    try {
+        if (tile_rows > 0 && tile_cols > 0)
+            RunTiles(tile_rows * tile_cols, PipelineTile, &task);
+    } catch (...) {
+        PixelFree(task.out_array);
+        throw;
+    }
+    
+    FreeBitmapArray();
+    bitmap_array = task.out_array;
+    width = out_width;
+    height = out_height;
+    is_gray = (1 == task.out_pixel_byte);
+    return point_last;
+}
+
+void PipelineTrans::PipelineTile(long tile_index, void* context) {
+    PipelineTask* task = (PipelineTask*)context;
+    const GeometryTask &geometry = task->geometry;
+    unsigned char tile_array[GEOMETRY_TILE_ROWS * GEOMETRY_TILE_COLS * 3];
+    long tile_cols = (geometry.out.width + GEOMETRY_TILE_COLS - 1) / GEOMETRY_TILE_COLS;
+    long first_row = tile_index / tile_cols * GEOMETRY_TILE_ROWS;
+    long first_col = tile_index % tile_cols * GEOMETRY_TILE_COLS;
+    long tile_height = MIN(GEOMETRY_TILE_ROWS, geometry.out.height - first_row);
+    long tile_width = MIN(GEOMETRY_TILE_COLS, geometry.out.width - first_col);
+    int pixel_byte = geometry.out.pixel_byte;
+    int out_pixel_byte = task->out_pixel_byte;
+    
+    //the tile is an image of its own: (0, 0) of it is (first_col, first_row).
+    GeometryTask tile_task = geometry;
+    tile_task.temp1 += first_col * geometry.cos_d + first_row * geometry.row_u;
+    tile_task.temp2 += first_col * geometry.sin_d + first_row * geometry.row_v;
+    ImgBand tile = {tile_array, tile_width, tile_height, pixel_byte, 0, tile_height, 0, tile_width, tile_width * pixel_byte};
+    tile_task.out = tile;
+    geometry.tile_kernel(tile_task, tile);
+    
+    if (task->lut_before_used)
+        ApplyLut_Simd(tile_array, tile_width * tile_height * pixel_byte, task->lut_before);
+    if (task->to_gray)
+        ColorTrans::ColorToGray_Array(tile_array, tile_array, tile_width * tile_height);
+    if (task->lut_after_used)
+        ApplyLut_Simd(tile_array, tile_width * tile_height * out_pixel_byte, task->lut_after);
+    
+    for (long y = 0; y < tile_height; y++) {
+        memcpy(task->out_array + ((first_row + y) * geometry.out.width + first_col) * out_pixel_byte,
+               tile_array + y * tile_width * out_pixel_byte, tile_width * out_pixel_byte);
+    }
+}
+
+void PipelineTrans::AddAffine(double* affine, double a, double b, double c, double d, double e, double f) {
+    double result[6];
+    
+    result[0] = affine[0] * a + affine[1] * d;
+    result[1] = affine[0] * b + affine[1] * e;
+    result[2] = affine[0] * c + affine[1] * f + affine[2];
+    result[3] = affine[3] * a + affine[4] * d;
+    result[4] = affine[3] * b + affine[4] * e;
+    result[5] = affine[3] * c + affine[4] * f + affine[5];
+    memcpy(affine, result, sizeof(result));
+}
+
+void PipelineTrans::CompileOps(int first_op, int last_op, int pixel_byte, unsigned char* lut_before, bool &to_gray, unsigned char* lut_after) {
+    int gray_op = last_op;
+    int lut_pixel_byte = 1;
+    
+    //the first operation which turns BGR pixels to gray, the ones before it work on single bytes.
+    if (3 == pixel_byte) {
+        for (gray_op = first_op; gray_op < last_op; gray_op++) {
+            if (STREAM_OP_GRAY == op_list[gray_op].op_code || STREAM_OP_BINARY == op_list[gray_op].op_code)
+                break;
+        }
+    }
+    to_gray = gray_op < last_op;
+    
+    //on 256 "gray pixels" 0 ~ 255, the operations give their lookup table.
+    Lut_Identity(lut_before);
+    StreamTrans::ApplyOps(op_list, first_op, gray_op, lut_before, 256, lut_pixel_byte);
+    Lut_Identity(lut_after);
+    StreamTrans::ApplyOps(op_list, gray_op, last_op, lut_after, 256, lut_pixel_byte);
+}
+
+#endif /* PipelineTrans_Class_hpp */
@@ -0,0 +1,150 @@
+/* ***************************************************************************
+ functions in this (PixelBuffer_Class.hpp) hpp file:
+ 
+ (1) PixelBuffer(void);
+ * an empty buffer (no pixels).
+ 
+ (2) PixelBuffer(long width, long height, int channel, long stride = 0);
+ * may throw: std::bad_alloc.
+ * A new buffer (not zeroed) from <PixelAlloc>, channel: bytes per pixel (1: gray; 3: B, G, R),
+ * stride: bytes per row, 0: width * channel (rows without padding, as bitmap_array of BitMapImg).
+ 
+ (3) PixelBuffer(unsigned char* array, long width, long height, int channel, long stride,
+                 unsigned char* mapped_base = NULL, unsigned long mapped_length = 0);
+ * Take over an array of <PixelAlloc>, or (mapped_base not NULL) an array inside that file mapping
+ * of <ReadBmp_Mapped>, which is then unmapped instead.
+ 
+ (4) PixelBuffer(PixelBuffer &&org);
+     PixelBuffer& operator=(PixelBuffer &&org);
+ * Move only: the pixels go to the new owner, org is left empty. It can not be copied,
+ * so every buffer is freed exactly once (by <Reset> or the destructor).
+ 
+ (5) ~PixelBuffer(void);
+     void Reset(void);
+ * <PixelFree> the array (or unmap it), then empty.
+ 
+ (6) unsigned char* GetArray(void);
+     unsigned char* GetRow(long y);
+     long GetWidth(void); long GetHeight(void); int GetChannel(void); long GetStride(void);
+     bool IsMapped(void);
+ 
+ (7) unsigned long GetAlignment(void);
+ * The largest power of 2 (at most 2 MB) the address of the array is a multiple of,
+ * e.g. 64 (a cache line) or 2 MB (a huge page) from the pixel pool, 0 if empty.
+ 
+ (8) unsigned char* ReleaseArray(unsigned char* &mapped_base, unsigned long &mapped_length);
+ * Hand the array (and its mapping, if any) over to the caller and empty, nothing is freed.
+ * Only for the owners which keep raw arrays, i.e. <BitMapImg>.
+ *****************************************************************************/
+
+#ifndef PixelBuffer_Class_hpp
+#define PixelBuffer_Class_hpp
+
+#include <cstdlib>
+#include <utility>
+
+class PixelBuffer {
+//data:
+private:
+    unsigned char* array;
+    long width;
+    long height;
+    int channel;    //bytes per pixel
+    long stride;    //bytes per row
+    unsigned char* mapped_base; //not NULL: array lives in this file mapping.
+    unsigned long mapped_length;
+    
+//functions:
+public:
+    PixelBuffer(void) {
+        array = NULL;
+        width = 0;
+        height = 0;
+        channel = 0;
+        stride = 0;
+        mapped_base = NULL;
+        mapped_length = 0;
+    }
+    PixelBuffer(long width, long height, int channel, long stride = 0) {
+        this->width = width;
+        this->height = height;
+        this->channel = channel;
+        this->stride = (0 == stride) ? width * channel : stride;
+        mapped_base = NULL;
+        mapped_length = 0;
+        array = PixelAlloc(this->stride * height);
+    }
+    PixelBuffer(unsigned char* array, long width, long height, int channel, long stride,
+                unsigned char* mapped_base = NULL, unsigned long mapped_length = 0) {
+        this->array = array;
+        this->width = width;
+        this->height = height;
+        this->channel = channel;
+        this->stride = (0 == stride) ? width * channel : stride;
+        this->mapped_base = mapped_base;
+        this->mapped_length = mapped_length;
+    }
+    PixelBuffer(PixelBuffer &&org) {
+        array = NULL;
+        mapped_base = NULL;
+        *this = std::move(org);
+    }
+    PixelBuffer& operator=(PixelBuffer &&org) {
+        if (this != &org) {
+            Reset();
+            array = org.ReleaseArray(mapped_base, mapped_length);
+            width = org.width;
+            height = org.height;
+            channel = org.channel;
+            stride = org.stride;
+            org.width = 0;
+            org.height = 0;
+            org.channel = 0;
+            org.stride = 0;
+        }
+        return *this;
+    }
+    PixelBuffer(const PixelBuffer &org) = delete;
+    PixelBuffer& operator=(const PixelBuffer &org) = delete;
+    ~PixelBuffer(void) {
+        Reset();
+    }
+    void Reset(void) {
+        if (NULL != mapped_base)
+            UnmapBmpFile(mapped_base, mapped_length);
+        else
+            PixelFree(array);
+        array = NULL;
+        mapped_base = NULL;
+        mapped_length = 0;
+        width = 0;
+        height = 0;
+        channel = 0;
+        stride = 0;
+    }
+    unsigned char* GetArray(void) {return array;}
+    unsigned char* GetRow(long y) {return array + y * stride;}
+    long GetWidth(void) {return width;}
+    long GetHeight(void) {return height;}
+    int GetChannel(void) {return channel;}
+    long GetStride(void) {return stride;}
+    bool IsMapped(void) {return NULL != mapped_base;}
+    unsigned long GetAlignment(void) {
+        unsigned long address = (unsigned long)array;
+        if (NULL == array)
+            return 0;
+        address &= -address;    //lowest bit set
+        return address < (2UL << 20) ? address : (2UL << 20);
+    }
+    unsigned char* ReleaseArray(unsigned char* &mapped_base, unsigned long &mapped_length) {
+        unsigned char* target = array;
+        mapped_base = this->mapped_base;
+        mapped_length = this->mapped_length;
+        array = NULL;
+        this->mapped_base = NULL;
+        this->mapped_length = 0;
+        return target;
+    }
+};
+
+#endif /* PixelBuffer_Class_hpp */
@@ -0,0 +1,454 @@
+/* ***************************************************************************
+ functions in this (StreamTrans_Class.hpp) hpp file:
+ 
+ (1) StreamTrans(char* read_path, char* save_path, long band_rows = 64);
+ * Nothing is read until <Run>, just remember the paths (do not free them before <Run>).
+ * band_rows: how many rows are processed at one time.
+ * Not a BitMapImg: it never holds the whole image.
+ 
+ (2) ~StreamTrans(void);
+ * close the files and delete [] all the band buffers.
+ 
+ (3) void ColorToGray(void);
+     void Binary(int threshold = 128);
+     void Reverse(void);
+     void LogarithmStretch(double a = 0, double b = 0.033, double c = 2);
+     void ExponentStretch(double a = 128, double b = 2, double c = 0.6);
+     void Zoom(long out_width, long out_height, int select_algorithm = 1);
+ * may throw: STREAM_TOO_MANY_OPS, STREAM_TOO_MANY_ZOOM.
+ * Only record the operation, same meaning as in ColorTrans / GeometryTrans.
+ * At most one Zoom in a stream, the halo rows it needs are kept in a small window.
+ 
+ (4) void Run(void);
+ * may throw: WRONG_FILE_PATH, NOT_BMP_FILE, FILE_DAMAGED, WRITE_IN_ERROR.
+ * Read the BMP band by band, apply all operations (in order), and write every band out.
+ * Peak memory is several bands (+ the window of Zoom), no matter how large the image is.
+ * Output is the same as ReadBmp -> ColorTrans / GeometryTrans -> TransToBmp -> SaveBmp.
+ * Rows are read at their offsets in the file, so a compressed (RLE) BMP is NOT_BMP_FILE here, read it by ReadBmp.
+ * So are 16-bit and BI_BITFIELDS BMPs, except 32-bit ones with the masks of BI_RGB (B, G, R, A).
+ 
+ (5) void ReadRows(long first_row, long last_row, unsigned char* target);
+ * may throw: FILE_DAMAGED.
+ * Read rows [first_row, last_row) of the original image (Bottom -> Top, as bitmap_array),
+ * decode them like <StandardizeBMP> and apply the operations before Zoom.
+ 
+ (6) void DecodeRow(const unsigned char* org_row, unsigned char* bgr_row);
+ * <StandardizeBMP> for a single row, always to 24-bit (B, G, R).
+ 
+ (7) bool CheckGray(void);
+ * is_gray of <StandardizeBMP>, but stop at the first colorful pixel.
+ 
+ (8) void FillWindow(long first_row, long last_row);
+ * Keep rows [first_row, last_row) of the original image in window_array, only read the new ones.
+ 
+ (9) static void ApplyOps(const StreamOp* op_list, int first_op, int last_op, unsigned char* array, long pixel_count, int &pixel_byte);
+ * Apply op_list[first_op] ... op_list[last_op - 1] on some pixels (also used by PipelineTrans).
+ * pixel_byte changes to 1 after ColorToGray / Binary.
+ * Continuous point operations (Binary on gray, Reverse, stretches) are composed into
+ * one lookup table (see basic_lut.cpp), and the pixels are passed only once for all of them.
+ 
+ (10) static int OpsPixelByte(const StreamOp* op_list, int first_op, int last_op, int pixel_byte);
+ * pixel_byte after <ApplyOps>, without touching any pixel.
+ *****************************************************************************/
+
+#ifndef StreamTrans_Class_hpp
+#define StreamTrans_Class_hpp
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define STREAM_MAX_OPS  32
+//op_code of StreamOp:
+#define STREAM_OP_GRAY      1
+#define STREAM_OP_BINARY    2
+#define STREAM_OP_REVERSE   3
+#define STREAM_OP_LOG       4
+#define STREAM_OP_EXP       5
+
+typedef struct struct_StreamOp {
+    int op_code;
+    double arg[4];
+} StreamOp;
+
+class StreamTrans {
+//data:
+private:
+    char* read_path;
+    char* save_path;
+    FILE* read_file;
+    FILE* save_file;
+    long band_rows;
+    
+    StreamOp op_list[STREAM_MAX_OPS];
+    int op_count;
+    int zoom_position;  //ops before it work on the original rows, -1: no Zoom.
+    long zoom_width;
+    long zoom_height;
+    int zoom_algorithm;
+    
+    long width;
+    long height;
+    bool top_to_bottom;
+    bool is_gray;
+    unsigned short bit_count;
+    long line_byte;
+    unsigned long data_offset;
+    RgbQuad color_table[256];
+    
+    unsigned char* raw_array;       //band_rows rows, as in the file
+    unsigned char* decode_array;    //band_rows rows, 24-bit
+    unsigned char* window_array;    //original rows [window_first, window_last), for Zoom
+    unsigned char* band_array;      //band_rows rows of output
+    unsigned char* encode_array;    //band_rows rows of output, padded
+    long window_first;
+    long window_last;
+    
+//functions:
+public:
+    StreamTrans(char* read_path, char* save_path, long band_rows = 64) {
+        this->read_path = read_path;
+        this->save_path = save_path;
+        this->band_rows = band_rows > 0 ? band_rows : 64;
+        read_file = NULL;
+        save_file = NULL;
+        op_count = 0;
+        zoom_position = -1;
+        zoom_width = 0;
+        zoom_height = 0;
+        zoom_algorithm = 1;
+        raw_array = NULL;
+        decode_array = NULL;
+        window_array = NULL;
+        band_array = NULL;
+        encode_array = NULL;
+        window_first = 0;
+        window_last = 0;
+    }
+    ~StreamTrans(void) {
+        if (NULL != read_file)
+            fclose(read_file);
+        if (NULL != save_file)
+            fclose(save_file);
+        delete [] raw_array;
+        delete [] decode_array;
+        delete [] window_array;
+        delete [] band_array;
+        delete [] encode_array;
+    }
+    void ColorToGray(void) {AddOp(STREAM_OP_GRAY, 0, 0, 0);}
+    void Binary(int threshold = 128) {AddOp(STREAM_OP_BINARY, threshold, 0, 0);}
+    void Reverse(void) {AddOp(STREAM_OP_REVERSE, 0, 0, 0);}
+    void LogarithmStretch(double a = 0, double b = 0.033, double c = 2) {AddOp(STREAM_OP_LOG, a, b, c);}
+    void ExponentStretch(double a = 128, double b = 2, double c = 0.6) {AddOp(STREAM_OP_EXP, a, b, c);}
+    void Zoom(long out_width, long out_height, int select_algorithm = 1) {
+        if (-1 != zoom_position)
+            throw STREAM_TOO_MANY_ZOOM;
+        zoom_position = op_count;
+        zoom_width = out_width;
+        zoom_height = out_height;
+        zoom_algorithm = select_algorithm;
+    }
+    void Run(void);
+    
+    static void ApplyOps(const StreamOp* op_list, int first_op, int last_op, unsigned char* array, long pixel_count, int &pixel_byte);
+    static int OpsPixelByte(const StreamOp* op_list, int first_op, int last_op, int pixel_byte);
+private:
+    void AddOp(int op_code, double arg0, double arg1, double arg2) {
+        if (op_count >= STREAM_MAX_OPS)
+            throw STREAM_TOO_MANY_OPS;
+        op_list[op_count].op_code = op_code;
+        op_list[op_count].arg[0] = arg0;
+        op_list[op_count].arg[1] = arg1;
+        op_list[op_count].arg[2] = arg2;
+        op_count++;
+    }
+    void ReadRows(long first_row, long last_row, unsigned char* target);
+    void DecodeRow(const unsigned char* org_row, unsigned char* bgr_row);
+    bool CheckGray(void);
+    void FillWindow(long first_row, long last_row);
+};
+
+
+
+void StreamTrans::Run(void) {
+    BitMapFileHeader bmp_file_header = {0};
+    BitMapInfoHeader bmp_info_header = {0};
+    unsigned long color_table_count = 0;
+    int mid_pixel_byte, out_pixel_byte, pixel_byte;
+    long out_width, out_height, out_line_byte;
+    long out_first, out_last, need_first, need_last, window_rows = 0;
+    long y;
+    bool has_zoom;
+    TRACE_SCOPE("Run", "StreamTrans");
+    
+    read_file = fopen(read_path, "rb");
+    if (NULL == read_file)
+        throw WRONG_FILE_PATH;
+    ReadBmpHeader(read_file, &bmp_file_header, &bmp_info_header);
+    
+    width = bmp_info_header.biWidth;
+    height = labs(bmp_info_header.biHeight);
+    top_to_bottom = bmp_info_header.biHeight < 0;
+    bit_count = bmp_info_header.biBitCount;
+    if (1 != bit_count && 4 != bit_count && 8 != bit_count && 24 != bit_count && 32 != bit_count)
+        throw NOT_BMP_FILE;
+    if (BI_RLE8 == bmp_info_header.biCompression || BI_RLE4 == bmp_info_header.biCompression)
+        throw NOT_BMP_FILE;
+    if (BI_BITFIELDS == bmp_info_header.biCompression) {
+        //only 32-bit with the usual masks (B, G, R, A), that is BI_RGB.
+        u_word4 masks[3];
+        for (int i = 0; i < 3; i++)
+            read_by_byte(&masks[i], 4, read_file);
+        if (32 != bit_count || 0xFF0000 != masks[0] || 0xFF00 != masks[1] || 0xFF != masks[2])
+            throw NOT_BMP_FILE;
+    }
+    line_byte = (width * bit_count + 31) / 32 * 4;
+    data_offset = bmp_file_header.bfOffBits;
+    
+    if (bit_count <= 8) {
+        color_table_count = 1UL << bit_count;
+        if (color_table_count != fread(color_table, sizeof(RgbQuad), color_table_count, read_file))
+            throw FILE_DAMAGED;
+    }
+    
+    raw_array = new unsigned char[band_rows * line_byte];
+    decode_array = new unsigned char[band_rows * width * 3];
+    is_gray = CheckGray();
+    
+    //layout of the pixels before Zoom, and at last:
+    has_zoom = (-1 != zoom_position) && !(zoom_width == width && zoom_height == height);
+    if (!has_zoom)
+        zoom_position = -1; //a Zoom to the same size does nothing, like <GeometryTrans::Zoom>.
+    mid_pixel_byte = OpsPixelByte(op_list, 0, has_zoom ? zoom_position : op_count, is_gray ? 1 : 3);
+    out_pixel_byte = has_zoom ? OpsPixelByte(op_list, zoom_position, op_count, mid_pixel_byte) : mid_pixel_byte;
+    out_width = has_zoom ? zoom_width : width;
+    out_height = has_zoom ? zoom_height : height;
+    out_line_byte = (out_width * out_pixel_byte + 3) / 4 * 4;
+    
+    if (has_zoom) {
+        for (out_first = 0; out_first < out_height; out_first += band_rows) {
+            out_last = MIN(out_first + band_rows, out_height);
+            GeometryTrans::Zoom_SourceRows(height, out_height, out_first, out_last, need_first, need_last);
+            window_rows = MAX(window_rows, need_last - need_first);
+        }
+        window_array = new unsigned char[window_rows * width * mid_pixel_byte];
+        window_first = 0;
+        window_last = 0;
+    }
+    band_array = new unsigned char[band_rows * out_width * 3];
+    encode_array = new unsigned char[band_rows * out_line_byte]();
+    
+    save_file = fopen(save_path, "wb");
+    if (NULL == save_file)
+        throw WRONG_FILE_PATH;
+    WriteBmpHeader(save_file, out_width, out_height, 1 == out_pixel_byte ? 8 : 24);
+    if (1 == out_pixel_byte) {
+        RgbQuad gray_table[256];
+        for (int i = 0; i < 256; i++) {
+            gray_table[i].rgbBlue = i;
+            gray_table[i].rgbGreen = i;
+            gray_table[i].rgbRed = i;
+            gray_table[i].rgbReserved = 0;
+        }
+        if (256 != fwrite(gray_table, sizeof(RgbQuad), 256, save_file))
+            throw WRITE_IN_ERROR;
+    }
+    
+    for (out_first = 0; out_first < out_height; out_first += band_rows) {
+        out_last = MIN(out_first + band_rows, out_height);
+        
+        if (has_zoom) {
+            GeometryTrans::Zoom_SourceRows(height, out_height, out_first, out_last, need_first, need_last);
+            FillWindow(need_first, need_last);
+            
+            ImgBand org = {window_array, width, height, mid_pixel_byte, window_first, window_last, 0, width, width * mid_pixel_byte};
+            ImgBand out = {band_array, out_width, out_height, mid_pixel_byte, out_first, out_last, 0, out_width, out_width * mid_pixel_byte};
+            GeometryTrans::Zoom_Band(org, out, zoom_algorithm);
+            
+            pixel_byte = mid_pixel_byte;
+            ApplyOps(op_list, zoom_position, op_count, band_array, (out_last - out_first) * out_width, pixel_byte);
+        }
+        else {
+            ReadRows(out_first, out_last, band_array);
+        }
+        
+        for (y = 0; y < out_last - out_first; y++) {
+            memcpy(encode_array + y * out_line_byte, band_array + y * out_width * out_pixel_byte, out_width * out_pixel_byte);
+        }
+        if ((unsigned long)((out_last - out_first) * out_line_byte) != fwrite(encode_array, sizeof(unsigned char), (out_last - out_first) * out_line_byte, save_file))
+            throw WRITE_IN_ERROR;
+    }
+    
+    fclose(read_file);
+    read_file = NULL;
+    fclose(save_file);
+    save_file = NULL;
+}
+
+void StreamTrans::ReadRows(long first_row, long last_row, unsigned char* target) {
+    long chunk_first, chunk_last, rows, file_first, r;
+    int pixel_byte;
+    
+    for (chunk_first = first_row; chunk_first < last_row; chunk_first += band_rows) {
+        chunk_last = MIN(chunk_first + band_rows, last_row);
+        rows = chunk_last - chunk_first;
+        
+        //row y of bitmap_array is row y in file (Bottom -> Top), or row (height - 1 - y) (Top -> Bottom).
+        file_first = top_to_bottom ? height - chunk_last : chunk_first;
+        if (0 != fseek(read_file, (long)data_offset + file_first * line_byte, SEEK_SET))
+            throw FILE_DAMAGED;
+        if ((unsigned long)(rows * line_byte) != fread(raw_array, sizeof(unsigned char), rows * line_byte, read_file))
+            throw FILE_DAMAGED;
+        
+        for (r = 0; r < rows; r++) {
+            if (top_to_bottom)
+                DecodeRow(raw_array + (rows - 1 - r) * line_byte, decode_array + r * width * 3);
+            else
+                DecodeRow(raw_array + r * line_byte, decode_array + r * width * 3);
+        }
+        
+        pixel_byte = 3;
+        if (is_gray) {
+            for (r = 0; r < rows * width; r++) {
+                decode_array[r] = decode_array[r * 3];
+            }
+            pixel_byte = 1;
+        }
+        ApplyOps(op_list, 0, -1 == zoom_position ? op_count : zoom_position, decode_array, rows * width, pixel_byte);
+        
+        memcpy(target + (chunk_first - first_row) * width * pixel_byte, decode_array, rows * width * pixel_byte);
+    }
+}
+
+void StreamTrans::DecodeRow(const unsigned char* org_row, unsigned char* bgr_row) {
+    unsigned char color_index;
+    long x;
+    
+    switch (bit_count) {
+        case 1:
+        case 4:
+        case 8:
+            for (x = 0; x < width; x++) {
+                if (1 == bit_count)
+                    color_index = (org_row[x / 8] & (0b10000000 >> (x % 8))) >> (7 - x % 8);
+                else if (4 == bit_count)
+                    color_index = (org_row[x / 2] & (0b11110000 >> ((x % 2) * 4))) >> ((1 - x % 2) * 4);
+                else
+                    color_index = org_row[x];
+            
+                bgr_row[x * 3] = color_table[color_index].rgbBlue;
+                bgr_row[x * 3 + 1] = color_table[color_index].rgbGreen;
+                bgr_row[x * 3 + 2] = color_table[color_index].rgbRed;
+            }
+            break;
+        
+        case 24:
+            memcpy(bgr_row, org_row, width * 3);
+            break;
+        
+        case 32:
+            DropAlpha_Simd(org_row, bgr_row, width);
+            break;
+    }
+}
+
+bool StreamTrans::CheckGray(void) {
+    long chunk_first, rows, file_first, i;
+    
+    if (bit_count <= 8) {
+        for (i = 0; i < (1L << bit_count); i++) {
+            if (color_table[i].rgbBlue != color_table[i].rgbGreen || color_table[i].rgbBlue != color_table[i].rgbRed)
+                break;
+        }
+        if (i == (1L << bit_count))
+            return true;    //all colors in the table are gray, no need to look at the pixels.
+    }
+    
+    for (chunk_first = 0; chunk_first < height; chunk_first += band_rows) {
+        rows = MIN(band_rows, height - chunk_first);
+        file_first = chunk_first;
+        if (0 != fseek(read_file, (long)data_offset + file_first * line_byte, SEEK_SET))
+            throw FILE_DAMAGED;
+        if ((unsigned long)(rows * line_byte) != fread(raw_array, sizeof(unsigned char), rows * line_byte, read_file))
+            throw FILE_DAMAGED;
+        
+        for (long r = 0; r < rows; r++) {
+            DecodeRow(raw_array + r * line_byte, decode_array);
+            if (!IsGray_Simd(decode_array, width, 3))
+                return false;
+        }
+    }
+    return true;
+}
+
+void StreamTrans::FillWindow(long first_row, long last_row) {
+    int pixel_byte = OpsPixelByte(op_list, 0, zoom_position, is_gray ? 1 : 3);
+    long row_byte = width * pixel_byte;
+    
+    if (first_row >= window_last || first_row < window_first) {
+        //nothing in the window can be used again.
+        window_first = first_row;
+        window_last = first_row;
+    }
+    else if (first_row > window_first) {
+        memmove(window_array, window_array + (first_row - window_first) * row_byte, (window_last - first_row) * row_byte);
+        window_first = first_row;
+    }
+    
+    if (last_row > window_last) {
+        ReadRows(window_last, last_row, window_array + (window_last - window_first) * row_byte);
+        window_last = last_row;
+    }
+}
+
+void StreamTrans::ApplyOps(const StreamOp* op_list, int first_op, int last_op, unsigned char* array, long pixel_count, int &pixel_byte) {
+    unsigned char lut[256];
+    bool lut_used = false;
+    
+    Lut_Identity(lut);
+    for (int i = first_op; i < last_op; i++) {
+        if ((STREAM_OP_GRAY == op_list[i].op_code || STREAM_OP_BINARY == op_list[i].op_code) && 3 == pixel_byte) {
+            //the table works on single bytes, apply it before the pixels are mixed.
+            if (lut_used) {
+                ApplyLut_Simd(array, pixel_count * pixel_byte, lut);
+                Lut_Identity(lut);
+                lut_used = false;
+            }
+            ColorTrans::ColorToGray_Array(array, array, pixel_count);
+            pixel_byte = 1;
+        }
+        
+        switch (op_list[i].op_code) {
+            case STREAM_OP_BINARY:
+                Lut_Binary(lut, (int)op_list[i].arg[0]);
+                lut_used = true;
+                break;
+            case STREAM_OP_REVERSE:
+                Lut_Reverse(lut);
+                lut_used = true;
+                break;
+            case STREAM_OP_LOG:
+                Lut_LogarithmStretch(lut, op_list[i].arg[0], op_list[i].arg[1], op_list[i].arg[2]);
+                lut_used = true;
+                break;
+            case STREAM_OP_EXP:
+                Lut_ExponentStretch(lut, op_list[i].arg[0], op_list[i].arg[1], op_list[i].arg[2]);
+                lut_used = true;
+                break;
+        }
+    }
+    
+    if (lut_used)
+        ApplyLut_Simd(array, pixel_count * pixel_byte, lut);
+}
+
+int StreamTrans::OpsPixelByte(const StreamOp* op_list, int first_op, int last_op, int pixel_byte) {
+    for (int i = first_op; i < last_op; i++) {
+        if (STREAM_OP_GRAY == op_list[i].op_code || STREAM_OP_BINARY == op_list[i].op_code)
+            pixel_byte = 1;
+    }
+    return pixel_byte;
+}
+
+#endif /* StreamTrans_Class_hpp */
@@ -2,26 +2,47 @@
  functions in this (basic_bmp_io.cpp) cpp file:
  
  (1) void DeleteBmpData (bmpData bmp_image);
- * free memory of a bmpData (if not NULL).
+ * free memory of a bmpData (if not NULL), bmp_data_array by <PixelFree>.
+ * If it comes from <ReadBmp_Mapped>, unmap the file instead.
  
  (2) bmpData ReadBmp (char* bmp_file_path);
  * may throw: WRONG_FILE_PATH, NOT_BMP_FILE, FILE_DAMAGED.
  * Read BMP file, get it's file-header and info-header,
  * but read in color-table and data directly (without any processing).
+ * BI_RLE8 / BI_RLE4 data is read as it is (biSizeImage bytes, or up to the end of the file if 0),
+ * see bmp_Compression, and decoded by <StandardizeBMP>.
+ * BI_BITFIELDS (16 or 32-bit): the masks are read into bmp_Masks.
  * If in big-endian, this function will call <read_by_byte>.
  
- (3) bool read_by_byte (void* target, unsigned long size_byte, FILE* source);
+ (3) void ReadBmpHeader (FILE* bmp_file, BitMapFileHeader* bmp_file_header, BitMapInfoHeader* bmp_info_header);
+ * may throw: NOT_BMP_FILE, FILE_DAMAGED.
+ * Read "BM", file-header and info-header from the start of an opened file.
+ * If in big-endian, this function will call <read_by_byte>.
+ 
+ (4) bool read_by_byte (void* target, unsigned long size_byte, FILE* source);
  * may throw: FILE_DAMAGED.
  * Read in data byte by byte, MAX: 4bytes.
  * Designed for different endian mode.
  
- (4) int SaveBmp (char* save_file_path, bmpData bmp_image);
+ (5) int SaveBmp (char* save_file_path, bmpData bmp_image, int compression = BI_RGB);
  * may throw: NO_DATA, WRONG_FILE_PATH, WRITE_IN_ERROR.
  * Save data in bmp_image to a new BMP file, and then <DeleteBmpData>.
  * Logically similar with <ReadBmp>.
+ * compression: BI_RLE8 for an 8-bit, BI_RLE4 for a 4-bit bmp_image: the rows are encoded (<RleEncode>)
+ * and written Bottom -> Top, any other bit count is saved uncompressed.
+ * A bmp_image which is compressed already (bmp_Compression, from <ReadBmp>) is written as it is,
+ * so is BI_BITFIELDS data, with its bmp_Masks.
+ * On a throw, the file is closed and the RLE stream freed, bmp_image is left to the caller.
+ 
+ (6) void WriteBmpHeader (FILE* bmp_file, long width, long height, unsigned short bit_count,
+                          u_word4 compression = BI_RGB, unsigned long data_byte = 0);
+ * may throw: WRITE_IN_ERROR.
+ * Write "BM", file-header and info-header of an uncompressed BMP (BI_RGB or BI_BITFIELDS),
+ * or of a compressed one with data_byte bytes of data.
+ * The masks (BI_BITFIELDS) or color table (if any) and data should be written by the caller right after.
  * If in big-endian, this function will call <write_by_byte>.
  
- (5) bool write_by_byte (void* content, unsigned long size_byte, FILE* output);
+ (7) bool write_by_byte (void* content, unsigned long size_byte, FILE* output);
  * may throw: WRITE_IN_ERROR.
  * MAX: 4bytes.
  * Logically similar with <read_by_byte>.
@@ -33,6 +54,7 @@
 #include "const_bmpSystem.h"
 #include "const_ErrorCodes.h"
 #include "struct_bmpFileStructure.h"
+#include "struct_TraceScope.h"
 
 //#define debug_bmp_io
 //#define debug_bmp_io_endian
@@ -41,22 +63,36 @@
  while complied on Xcode(macOS) with clang, "FILE* bmp_file = NULL;" has a strange bug:
     if that phrase is inside function <read_bmp>,
     "fread( , , , source)" in function <read_by_byte> will EXC_BAD_ACCESS.
- but on Linux or Windows, the bug won't appear. */
+ but on Linux or Windows, the bug won't appear.
+ It is thread_local, so several threads can still read and save files at the same time. */
 
 extern bool is_little_endian;
 #ifdef running_with_clang
-static FILE* bmp_file = NULL;
+static thread_local FILE* bmp_file = NULL;
 #endif
 
+void ReadBmpHeader (FILE* bmp_file, BitMapFileHeader* bmp_file_header, BitMapInfoHeader* bmp_info_header);  //basic_bmp_io.cpp
 bool read_by_byte (void* target, unsigned long size_byte, FILE* source);    //basic_bmp_io.cpp
+void WriteBmpHeader (FILE* bmp_file, long width, long height, unsigned short bit_count,
+                     u_word4 compression = BI_RGB, unsigned long data_byte = 0);    //basic_bmp_io.cpp
 bool write_by_byte (void* content, unsigned long size_byte, FILE* output);  //basic_bmp_io.cpp
+void UnmapBmpFile (unsigned char* mapped_base, unsigned long mapped_length);    //basic_bmp_mmap.cpp
+unsigned char* PixelAlloc (unsigned long size_byte);    //basic_pixel_pool.cpp
+void PixelFree (unsigned char* buffer); //basic_pixel_pool.cpp
+unsigned long RleEncode (const unsigned char* data_array, long line_byte, int bit_count, long width, long height,
+                         unsigned char* rle_array);  //basic_bmp_rle.cpp
+unsigned long RleBound (long width, long height);   //basic_bmp_rle.cpp
 
 void DeleteBmpData (bmpData bmp_image) {
+    if (NULL != bmp_image.bmp_mapped_base) {
+        UnmapBmpFile(bmp_image.bmp_mapped_base, bmp_image.bmp_mapped_length);
+        return;
+    }
+    
     if (NULL != bmp_image.bmp_color_table)
         delete [] bmp_image.bmp_color_table;
     
-    if (NULL != bmp_image.bmp_data_array)
-        delete [] bmp_image.bmp_data_array;
+    PixelFree(bmp_image.bmp_data_array);
 }
 
 bmpData ReadBmp (char* bmp_file_path) {
@@ -64,7 +100,6 @@ bmpData ReadBmp (char* bmp_file_path) {
 #ifndef running_with_clang
     FILE* bmp_file = NULL;
 #endif
-    unsigned short file_type_check = 0;
     unsigned long line_byte = 0;
     unsigned long data_byte = 0;
     unsigned long color_table_byte = 0;
@@ -73,63 +108,17 @@ bmpData ReadBmp (char* bmp_file_path) {
     BitMapInfoHeader bmp_info_header = {0};
     RgbQuad *bmp_quad = NULL;
     
+    TRACE_SCOPE("open", "ReadBmp");
     bmp_file = fopen(bmp_file_path, "rb");
     if (NULL == bmp_file)
         throw WRONG_FILE_PATH;
     
-#ifdef debug_bmp_io_endian
-    if (0) {
-#else
-    if (is_little_endian) {
-#endif
-        //just a faster process, only on little_endian machine.
-        
-        if (1 != fread(&file_type_check, sizeof(unsigned short), 1, bmp_file))
-            throw NOT_BMP_FILE;
-        if (0x4D42 != file_type_check)   //little_endian
-            throw NOT_BMP_FILE;
-        
-        succeeded_length = fread(&bmp_file_header, sizeof(BitMapFileHeader), 1, bmp_file);
-        if (1 != succeeded_length)
-            throw FILE_DAMAGED;
-        succeeded_length = fread(&bmp_info_header, sizeof(BitMapInfoHeader), 1, bmp_file);
-        if (1 != succeeded_length)
-            throw FILE_DAMAGED;
-    }
-    else {
-        //no matter little or big endian.
-        //But if running on a little-endian machine, the "if" bench can process faster than "else" bench.
-        
-        if (!read_by_byte(&file_type_check, 2, bmp_file))
-            throw NOT_BMP_FILE;
-        if (0x4D42 != file_type_check)
-            throw NOT_BMP_FILE;
-        
-        try {
-            read_by_byte(&bmp_file_header.bfSize, 4, bmp_file);
-            read_by_byte(&bmp_file_header.bfReserved1, 2, bmp_file);
-            read_by_byte(&bmp_file_header.bfReserved2, 2, bmp_file);
-            read_by_byte(&bmp_file_header.bfOffBits, 4, bmp_file);
-            
-            read_by_byte(&bmp_info_header.biSize, 4, bmp_file);
-            read_by_byte(&bmp_info_header.biWidth, 4, bmp_file);
-            read_by_byte(&bmp_info_header.biHeight, 4, bmp_file);
-            read_by_byte(&bmp_info_header.biPlanes, 2, bmp_file);
-            read_by_byte(&bmp_info_header.biBitCount, 2, bmp_file);
-            read_by_byte(&bmp_info_header.biCompression, 4, bmp_file);
-            read_by_byte(&bmp_info_header.biSizeImage, 4, bmp_file);
-            read_by_byte(&bmp_info_header.biXPelsPerMeter, 4, bmp_file);
-            read_by_byte(&bmp_info_header.biYPelsPerMeter, 4, bmp_file);
-            read_by_byte(&bmp_info_header.biClrUsed, 4, bmp_file);
-            read_by_byte(&bmp_info_header.biClrImportant, 4, bmp_file);
-        } catch (...) {
-            throw FILE_DAMAGED;
-        }
-    }
+    TRACE_NEXT("header");
+    ReadBmpHeader(bmp_file, &bmp_file_header, &bmp_info_header);
+    TRACE_BYTES(54);
     
 #ifdef debug_bmp_io
     printf("BitMapFileHeader:\n");
-    printf("file type: %x\n", file_type_check);
     printf("size of the file: %u\n", bmp_file_header.bfSize);
     printf("reserved words: %u %u\n", bmp_file_header.bfReserved1, bmp_file_header.bfReserved2);
     printf("OffBits: %u\n\n", bmp_file_header.bfOffBits);
@@ -150,10 +139,16 @@ bmpData ReadBmp (char* bmp_file_path) {
     bmp_image.bmp_Width = bmp_info_header.biWidth;
     bmp_image.bmp_Height = bmp_info_header.biHeight;
     bmp_image.bmp_BitCount = bmp_info_header.biBitCount;
+    bmp_image.bmp_Compression = bmp_info_header.biCompression;
+    bmp_image.bmp_mapped_base = NULL;
+    bmp_image.bmp_mapped_length = 0;
     
     if (bmp_image.bmp_BitCount <= 8) {
+        TRACE_NEXT("color table");
         color_table_byte = (unsigned long)pow(2, bmp_image.bmp_BitCount);
         bmp_quad = new RgbQuad[color_table_byte];
+        TRACE_ALLOC(color_table_byte * sizeof(RgbQuad));
+        TRACE_BYTES(color_table_byte * sizeof(RgbQuad));
         succeeded_length = fread(bmp_quad, sizeof(RgbQuad), color_table_byte, bmp_file);
         if (succeeded_length != color_table_byte)
             throw FILE_DAMAGED;
@@ -163,10 +158,30 @@ bmpData ReadBmp (char* bmp_file_path) {
         bmp_quad = NULL;
     }
     bmp_image.bmp_color_table = bmp_quad;
+    if (BI_BITFIELDS == bmp_image.bmp_Compression && (16 == bmp_image.bmp_BitCount || 32 == bmp_image.bmp_BitCount)) {
+        //masks of R, G, B right after a 40-byte info-header (the same place in a V4 / V5 one), data at bfOffBits.
+        TRACE_NEXT("masks");
+        fseek(bmp_file, 54, SEEK_SET);
+        for (int i = 0; i < 3; i++)
+            read_by_byte(&bmp_image.bmp_Masks[i], 4, bmp_file);
+        fseek(bmp_file, bmp_file_header.bfOffBits, SEEK_SET);
+    }
     
-    line_byte = (abs(bmp_image.bmp_Width) * bmp_image.bmp_BitCount / 8 + 3) / 4 * 4;
+    line_byte = (abs(bmp_image.bmp_Width) * bmp_image.bmp_BitCount + 31) / 32 * 4;
     data_byte = line_byte * abs(bmp_image.bmp_Height);
-    bmp_image.bmp_data_array = new unsigned char[data_byte];
+    if (BI_RLE8 == bmp_image.bmp_Compression || BI_RLE4 == bmp_image.bmp_Compression) {
+        data_byte = bmp_info_header.biSizeImage;
+        if (0 == data_byte) {
+            long data_position = ftell(bmp_file);
+            fseek(bmp_file, 0, SEEK_END);
+            data_byte = ftell(bmp_file) - data_position;
+            fseek(bmp_file, data_position, SEEK_SET);
+        }
+    }
+    bmp_image.bmp_data_length = data_byte;
+    TRACE_NEXT("pixels");
+    bmp_image.bmp_data_array = PixelAlloc(data_byte);
+    TRACE_BYTES(data_byte);
     succeeded_length = fread(bmp_image.bmp_data_array, sizeof(unsigned char), data_byte, bmp_file);
     if (succeeded_length != data_byte)
         throw FILE_DAMAGED;
@@ -175,6 +190,61 @@ bmpData ReadBmp (char* bmp_file_path) {
     return bmp_image;
 }
 
+void ReadBmpHeader (FILE* bmp_file, BitMapFileHeader* bmp_file_header, BitMapInfoHeader* bmp_info_header) {
+    unsigned short file_type_check = 0;
+    unsigned long succeeded_length = 0;
+    
+#ifdef debug_bmp_io_endian
+    if (0) {
+#else
+    if (is_little_endian) {
+#endif
+        //just a faster process, only on little_endian machine.
+        
+        if (1 != fread(&file_type_check, sizeof(unsigned short), 1, bmp_file))
+            throw NOT_BMP_FILE;
+        if (0x4D42 != file_type_check)   //little_endian
+            throw NOT_BMP_FILE;
+        
+        succeeded_length = fread(bmp_file_header, sizeof(BitMapFileHeader), 1, bmp_file);
+        if (1 != succeeded_length)
+            throw FILE_DAMAGED;
+        succeeded_length = fread(bmp_info_header, sizeof(BitMapInfoHeader), 1, bmp_file);
+        if (1 != succeeded_length)
+            throw FILE_DAMAGED;
+    }
+    else {
+        //no matter little or big endian.
+        //But if running on a little-endian machine, the "if" bench can process faster than "else" bench.
+        
+        if (!read_by_byte(&file_type_check, 2, bmp_file))
+            throw NOT_BMP_FILE;
+        if (0x4D42 != file_type_check)
+            throw NOT_BMP_FILE;
+        
+        try {
+            read_by_byte(&bmp_file_header->bfSize, 4, bmp_file);
+            read_by_byte(&bmp_file_header->bfReserved1, 2, bmp_file);
+            read_by_byte(&bmp_file_header->bfReserved2, 2, bmp_file);
+            read_by_byte(&bmp_file_header->bfOffBits, 4, bmp_file);
+            
+            read_by_byte(&bmp_info_header->biSize, 4, bmp_file);
+            read_by_byte(&bmp_info_header->biWidth, 4, bmp_file);
+            read_by_byte(&bmp_info_header->biHeight, 4, bmp_file);
+            read_by_byte(&bmp_info_header->biPlanes, 2, bmp_file);
+            read_by_byte(&bmp_info_header->biBitCount, 2, bmp_file);
+            read_by_byte(&bmp_info_header->biCompression, 4, bmp_file);
+            read_by_byte(&bmp_info_header->biSizeImage, 4, bmp_file);
+            read_by_byte(&bmp_info_header->biXPelsPerMeter, 4, bmp_file);
+            read_by_byte(&bmp_info_header->biYPelsPerMeter, 4, bmp_file);
+            read_by_byte(&bmp_info_header->biClrUsed, 4, bmp_file);
+            read_by_byte(&bmp_info_header->biClrImportant, 4, bmp_file);
+        } catch (...) {
+            throw FILE_DAMAGED;
+        }
+    }
+}
+
 bool read_by_byte (void* target, unsigned long size_byte, FILE* source) {
     unsigned long succeeded_length = 0;
     unsigned char read_buffer[4] = {0};
@@ -191,24 +261,20 @@ bool read_by_byte (void* target, unsigned long size_byte, FILE* source) {
     return true;
 }
 
-int SaveBmp (char* save_file_path, bmpData bmp_image) {
+int SaveBmp (char* save_file_path, bmpData bmp_image, int compression) {
     unsigned long line_byte = 0;
     unsigned long data_byte = 0;
     unsigned long color_table_byte = 0;
-    unsigned short file_type = 0;
     unsigned long succeeded_length = 0;
+    unsigned char* data_array = NULL;
 #ifndef running_with_clang
     FILE* bmp_file = NULL;
 #endif
-    BitMapFileHeader bmp_file_header = {0};
-    BitMapInfoHeader bmp_info_header = {0};
     
     if (NULL == bmp_image.bmp_data_array)
         throw NO_DATA;
     
-    //edit the file_header and info_header:
-    file_type = 0x4D42;
-    line_byte = (abs(bmp_image.bmp_Width) * bmp_image.bmp_BitCount / 8 + 3) / 4 * 4;
+    line_byte = (abs(bmp_image.bmp_Width) * bmp_image.bmp_BitCount + 31) / 32 * 4;
     data_byte = line_byte * abs(bmp_image.bmp_Height);
     if (bmp_image.bmp_BitCount <= 8) {
         color_table_byte = (unsigned long)pow(2, bmp_image.bmp_BitCount) * 4;
@@ -216,28 +282,112 @@ int SaveBmp (char* save_file_path, bmpData bmp_image) {
     else {
         color_table_byte = 0;
     }
+    data_array = bmp_image.bmp_data_array;
+    if (BI_BITFIELDS == bmp_image.bmp_Compression)
+        compression = BI_BITFIELDS;
+    else if (BI_RGB != bmp_image.bmp_Compression) {
+        //compressed already: as it is.
+        compression = bmp_image.bmp_Compression;
+        data_byte = bmp_image.bmp_data_length;
+    }
+    else if (!((BI_RLE8 == compression && 8 == bmp_image.bmp_BitCount) || (BI_RLE4 == compression && 4 == bmp_image.bmp_BitCount)))
+        compression = BI_RGB;
+    
+    //write the data(s) to target file:
+    TRACE_SCOPE("open", "SaveBmp");
+    bmp_file = fopen(save_file_path, "wb");
+    if (NULL == bmp_file)
+        throw WRONG_FILE_PATH;
+    
+    try {
+        if (BI_RGB != compression && BI_RGB == bmp_image.bmp_Compression) {
+            //RLE is always Bottom -> Top: start from the last row while Height < 0.
+            const unsigned char* first_row = bmp_image.bmp_data_array;
+            long stride = (long)line_byte;
+            if (bmp_image.bmp_Height < 0) {
+                first_row += (labs(bmp_image.bmp_Height) - 1) * line_byte;
+                stride = -stride;
+            }
+            data_array = PixelAlloc(RleBound(labs(bmp_image.bmp_Width), labs(bmp_image.bmp_Height)));
+            data_byte = RleEncode(first_row, stride, bmp_image.bmp_BitCount, labs(bmp_image.bmp_Width), labs(bmp_image.bmp_Height), data_array);
+            bmp_image.bmp_Height = labs(bmp_image.bmp_Height);
+        }
+        
+        TRACE_NEXT("header");
+        WriteBmpHeader(bmp_file, bmp_image.bmp_Width, bmp_image.bmp_Height, bmp_image.bmp_BitCount, compression, data_byte);
+        TRACE_BYTES(54);
+        if (BI_BITFIELDS == compression) {
+            for (int i = 0; i < 3; i++)
+                write_by_byte(&bmp_image.bmp_Masks[i], 4, bmp_file);
+        }
+        
+        if (0 != color_table_byte) {
+            TRACE_NEXT("color table");
+            TRACE_BYTES(color_table_byte);
+            succeeded_length = fwrite(bmp_image.bmp_color_table, sizeof(RgbQuad), color_table_byte / 4, bmp_file);
+            if (succeeded_length != color_table_byte / 4)
+                throw WRITE_IN_ERROR;
+        }
+        
+        TRACE_NEXT("pixels");
+        TRACE_BYTES(data_byte);
+        succeeded_length = fwrite(data_array, sizeof(unsigned char), data_byte, bmp_file);
+        if (succeeded_length != data_byte)
+            throw WRITE_IN_ERROR;
+    } catch (...) {
+        //the RLE stream is freed here, bmp_image is left to the caller.
+        fclose(bmp_file);
+        if (data_array != bmp_image.bmp_data_array)
+            PixelFree(data_array);
+        throw;
+    }
+    
+    TRACE_NEXT("close");
+    fclose(bmp_file);
+    if (data_array != bmp_image.bmp_data_array)
+        PixelFree(data_array);
+    DeleteBmpData(bmp_image);
+    return 0;
+}
+
+void WriteBmpHeader (FILE* bmp_file, long width, long height, unsigned short bit_count, u_word4 compression, unsigned long data_byte) {
+    unsigned long line_byte = 0;
+    unsigned long color_table_byte = 0;
+    unsigned short file_type = 0;
+    unsigned long succeeded_length = 0;
+    BitMapFileHeader bmp_file_header = {0};
+    BitMapInfoHeader bmp_info_header = {0};
+    
+    //edit the file_header and info_header:
+    file_type = 0x4D42;
+    line_byte = (labs(width) * bit_count + 31) / 32 * 4;
+    if (BI_RGB == compression || BI_BITFIELDS == compression)
+        data_byte = line_byte * labs(height);
+    if (bit_count <= 8) {
+        color_table_byte = (unsigned long)pow(2, bit_count) * 4;
+    }
+    else {
+        color_table_byte = 0;
+    }
     bmp_file_header.bfReserved1 = 0;
     bmp_file_header.bfReserved2 = 0;
+    if (BI_BITFIELDS == compression)
+        color_table_byte = 12;  //the masks of R, G, B
     bmp_file_header.bfSize = 54 + (u_word4)color_table_byte + (u_word4)data_byte;
     bmp_file_header.bfOffBits = 54 + (u_word4)color_table_byte;
     
     bmp_info_header.biSize = 40;
-    bmp_info_header.biWidth = (word4)bmp_image.bmp_Width;
-    bmp_info_header.biHeight = (word4)bmp_image.bmp_Height;
+    bmp_info_header.biWidth = (word4)width;
+    bmp_info_header.biHeight = (word4)height;
     bmp_info_header.biPlanes = 1;
-    bmp_info_header.biBitCount = bmp_image.bmp_BitCount;
-    bmp_info_header.biCompression = BI_RGB;
+    bmp_info_header.biBitCount = bit_count;
+    bmp_info_header.biCompression = compression;
     bmp_info_header.biSizeImage = (u_word4)data_byte;
     bmp_info_header.biXPelsPerMeter = 0;
     bmp_info_header.biYPelsPerMeter = 0;
     bmp_info_header.biClrUsed = 0;
     bmp_info_header.biClrImportant = 0;
     
-    //write the data(s) to target file:
-    bmp_file = fopen(save_file_path, "wb");
-    if (NULL == bmp_file)
-        throw WRONG_FILE_PATH;
-    
 #ifdef debug_bmp_io_endian
     if (0) {
 #else
@@ -278,20 +428,6 @@ int SaveBmp (char* save_file_path, bmpData bmp_image) {
             throw WRITE_IN_ERROR;
         }
     }
-    
-    if (0 != color_table_byte) {
-        succeeded_length = fwrite(bmp_image.bmp_color_table, sizeof(RgbQuad), color_table_byte / 4, bmp_file);
-        if (succeeded_length != color_table_byte / 4)
-            throw WRITE_IN_ERROR;
-    }
-        
-    succeeded_length = fwrite(bmp_image.bmp_data_array, sizeof(unsigned char), data_byte, bmp_file);
-    if (succeeded_length != data_byte)
-        throw WRITE_IN_ERROR;
-    
-    fclose(bmp_file);
-    DeleteBmpData(bmp_image);
-    return 0;
 }
 
 bool write_by_byte (void* content, unsigned long size_byte, FILE* output) {
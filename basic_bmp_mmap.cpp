@@ -0,0 +1,152 @@
+/* ***************************************************************************
+ functions in this (basic_bmp_mmap.cpp) cpp file:
+ 
+ (1) bmpData ReadBmp_Mapped (char* bmp_file_path);
+ * may throw: WRONG_FILE_PATH, NOT_BMP_FILE, FILE_DAMAGED.
+ * Map the whole BMP file (private, copy-on-write) instead of fread-ing it.
+ * bmp_color_table and bmp_data_array point straight into the mapping,
+ * so nothing is copied; bmp_mapped_base / bmp_mapped_length own the mapping.
+ * Header fields are parsed byte by byte, so it works in either endian mode.
+ * BI_RLE8 / BI_RLE4 data is mapped as it is (biSizeImage bytes, or up to the end of the file if 0).
+ * BI_BITFIELDS (16 or 32-bit): the masks are read into bmp_Masks.
+ * Without mmap (not unix-like), this function just calls <ReadBmp>.
+ 
+ (2) void UnmapBmpFile (unsigned char* mapped_base, unsigned long mapped_length);
+ * Release a mapping made by <ReadBmp_Mapped>.
+ * Called by <DeleteBmpData> and by BitMapImg, never free the arrays by yourself.
+ 
+ (3) unsigned long get_by_byte (const unsigned char* source, int size_byte);
+ * Read a little-endian number out of memory, MAX: 4bytes.
+ *****************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include "const_bmpSystem.h"
+#include "const_ErrorCodes.h"
+#include "struct_bmpFileStructure.h"
+#include "struct_TraceScope.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define bmp_mmap_available
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+bmpData ReadBmp (char* bmp_file_path);  //basic_bmp_io.cpp
+unsigned long get_by_byte (const unsigned char* source, int size_byte);  //basic_bmp_mmap.cpp
+
+#ifdef bmp_mmap_available
+
+bmpData ReadBmp_Mapped (char* bmp_file_path) {
+    bmpData bmp_image;
+    int bmp_fd = -1;
+    struct stat file_stat;
+    unsigned char* mapped = NULL;
+    unsigned long mapped_length = 0;
+    unsigned long line_byte = 0;
+    unsigned long data_byte = 0;
+    unsigned long color_table_byte = 0;
+    unsigned long info_size = 0;
+    unsigned long data_offset = 0;
+    int error_code = 0;
+    
+    TRACE_SCOPE("open", "ReadBmp_Mapped");
+    bmp_fd = open(bmp_file_path, O_RDONLY);
+    if (bmp_fd < 0)
+        throw WRONG_FILE_PATH;
+    if (0 != fstat(bmp_fd, &file_stat) || file_stat.st_size < 54) {
+        close(bmp_fd);
+        throw NOT_BMP_FILE;
+    }
+    mapped_length = (unsigned long)file_stat.st_size;
+    
+    //PROT_WRITE + MAP_PRIVATE: point operations may work in place, the file is never touched.
+    mapped = (unsigned char*)mmap(NULL, mapped_length, PROT_READ | PROT_WRITE, MAP_PRIVATE, bmp_fd, 0);
+    close(bmp_fd);
+    if (MAP_FAILED == (void*)mapped)
+        throw FILE_DAMAGED;
+    madvise(mapped, mapped_length, MADV_SEQUENTIAL);
+    
+    TRACE_NEXT("header");
+    TRACE_BYTES(54);
+    if (0x4D42 != get_by_byte(mapped, 2)) {
+        munmap(mapped, mapped_length);
+        throw NOT_BMP_FILE;
+    }
+    
+    data_offset = get_by_byte(mapped + 10, 4);
+    info_size = get_by_byte(mapped + 14, 4);
+    bmp_image.bmp_Width = (word4)get_by_byte(mapped + 18, 4);
+    bmp_image.bmp_Height = (word4)get_by_byte(mapped + 22, 4);
+    bmp_image.bmp_BitCount = (unsigned short)get_by_byte(mapped + 28, 2);
+    bmp_image.bmp_Compression = (u_word4)get_by_byte(mapped + 30, 4);
+    bmp_image.bmp_mapped_base = mapped;
+    bmp_image.bmp_mapped_length = mapped_length;
+    
+    if (bmp_image.bmp_BitCount <= 8) {
+        color_table_byte = (1UL << bmp_image.bmp_BitCount) * sizeof(RgbQuad);
+        if (14 + info_size + color_table_byte > mapped_length)
+            error_code = FILE_DAMAGED;
+        bmp_image.bmp_color_table = (RgbQuad*)(mapped + 14 + info_size);
+    }
+    else {
+        //while BitCount == 24 or 32, there's no color table.
+        bmp_image.bmp_color_table = NULL;
+    }
+    
+    if (BI_BITFIELDS == bmp_image.bmp_Compression && (16 == bmp_image.bmp_BitCount || 32 == bmp_image.bmp_BitCount)) {
+        //masks of R, G, B right after a 40-byte info-header (the same place in a V4 / V5 one).
+        if (66 > mapped_length)
+            error_code = FILE_DAMAGED;
+        else {
+            for (int i = 0; i < 3; i++)
+                bmp_image.bmp_Masks[i] = (u_word4)get_by_byte(mapped + 54 + i * 4, 4);
+        }
+    }
+    
+    line_byte = (labs(bmp_image.bmp_Width) * bmp_image.bmp_BitCount + 31) / 32 * 4;
+    data_byte = line_byte * labs(bmp_image.bmp_Height);
+    if (BI_RLE8 == bmp_image.bmp_Compression || BI_RLE4 == bmp_image.bmp_Compression) {
+        data_byte = get_by_byte(mapped + 34, 4);    //biSizeImage
+        if (0 == data_byte && data_offset <= mapped_length)
+            data_byte = mapped_length - data_offset;
+    }
+    if (data_offset + data_byte > mapped_length)
+        error_code = FILE_DAMAGED;
+    bmp_image.bmp_data_array = mapped + data_offset;
+    bmp_image.bmp_data_length = data_byte;
+    
+    if (0 != error_code) {
+        munmap(mapped, mapped_length);
+        throw error_code;
+    }
+    return bmp_image;
+}
+
+void UnmapBmpFile (unsigned char* mapped_base, unsigned long mapped_length) {
+    if (NULL != mapped_base)
+        munmap(mapped_base, mapped_length);
+}
+
+#else
+
+bmpData ReadBmp_Mapped (char* bmp_file_path) {
+    return ReadBmp(bmp_file_path);
+}
+
+void UnmapBmpFile (unsigned char* mapped_base, unsigned long mapped_length) {
+    return;
+}
+
+#endif /* bmp_mmap_available */
+
+unsigned long get_by_byte (const unsigned char* source, int size_byte) {
+    unsigned long result = 0;
+    
+    for (int i = size_byte - 1; i >= 0; i--) {
+        result = (result << 8) + source[i];
+    }
+    return result;
+}
@@ -0,0 +1,267 @@
+/* ***************************************************************************
+ functions in this (basic_bmp_rle.cpp) cpp file:
+ 
+ (1) void RleDecode (const unsigned char* rle_array, unsigned long rle_length, int bit_count, long width, long height,
+                     const unsigned char* color_list, int pixel_byte, unsigned char* target, long target_stride, bool* used);
+ * may throw: FILE_DAMAGED.
+ * Decode a BI_RLE8 (bit_count 8) or BI_RLE4 (bit_count 4) stream straight into the decoded pixels,
+ * no index image in between: color_list holds pixel_byte bytes (1: gray, 3: B, G, R) for every color index,
+ * row y of the stream (Bottom -> Top) goes to target + y * target_stride (negative: Top -> Bottom).
+ * An encoded run is one memset (gray) or one repeated pattern, an absolute run one lookup per pixel.
+ * The pixels skipped by a delta, an early end of line or an early end of bitmap get color 0,
+ * pixels beyond width are dropped, and the stream may end without an end of bitmap.
+ * FILE_DAMAGED: the stream ends in the middle of a code.
+ * target == NULL: nothing is written, used[i] is set for every color index the image uses (gray check of <StandardizeBMP>).
+ 
+ (2) unsigned long RleEncode (const unsigned char* data_array, long line_byte, int bit_count, long width, long height,
+                              unsigned char* rle_array);
+ * Encode rows of 8 or 4-bit color indices (as bmp_data_array of BI_RGB, Bottom -> Top, line_byte per row,
+ * negative: from the last row of a Top -> Bottom bmp_data_array)
+ * into BI_RLE8 / BI_RLE4, return the bytes written to rle_array (at most <RleBound>).
+ * Runs of at least 3 pixels (RLE4: 4 pixels of two alternating indices) are encoded, the pixels between them
+ * go out in absolute mode (or as short runs, below 3 pixels). Every row ends with an end of line,
+ * the image with an end of bitmap.
+ 
+ (3) unsigned long RleBound (long width, long height);
+ * The largest size of (2): 2 bytes per pixel (runs of 1), an end of line per row, an end of bitmap.
+ 
+ (4) static void rle_fill (unsigned char* target, long target_stride, int pixel_byte, const unsigned char* color,
+                           long width, long height, long from_x, long from_y, long to_x, long to_y);
+ * Set pixels [(from_x, from_y), (to_x, to_y)) (in row order) to color, for (1).
+ 
+ (5) static long rle_run_length (const unsigned char* index_row, long x, long width, int period);
+ * How many pixels from x repeat the first period (1 or 2) of them, at most 255.
+ *****************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "const_bmpSystem.h"
+#include "const_ErrorCodes.h"
+#include "struct_TraceScope.h"
+
+void RleDecode (const unsigned char* rle_array, unsigned long rle_length, int bit_count, long width, long height,
+                const unsigned char* color_list, int pixel_byte, unsigned char* target, long target_stride, bool* used);  //basic_bmp_rle.cpp
+unsigned long RleEncode (const unsigned char* data_array, long line_byte, int bit_count, long width, long height,
+                         unsigned char* rle_array);  //basic_bmp_rle.cpp
+unsigned long RleBound (long width, long height);   //basic_bmp_rle.cpp
+
+static void rle_fill (unsigned char* target, long target_stride, int pixel_byte, const unsigned char* color,
+                      long width, long height, long from_x, long from_y, long to_x, long to_y);
+static long rle_run_length (const unsigned char* index_row, long x, long width, int period);
+
+void RleDecode (const unsigned char* rle_array, unsigned long rle_length, int bit_count, long width, long height,
+                const unsigned char* color_list, int pixel_byte, unsigned char* target, long target_stride, bool* used) {
+    unsigned long i = 0;
+    long x = 0, y = 0, count, n, k;
+    int value, index;
+    unsigned char* row = target;    //row y of target
+    const unsigned char* color;
+    
+    TRACE_SCOPE("RleDecode", "BitMapImg");
+    TRACE_BYTES(rle_length);
+    while (y < height) {
+        if (i + 2 > rle_length) {
+            if (i < rle_length)
+                throw FILE_DAMAGED;
+            break;  //no end of bitmap
+        }
+        count = rle_array[i];
+        value = rle_array[i + 1];
+        i += 2;
+        
+        if (count > 0) {
+            //encoded: count pixels of value (RLE4: its two indices by turns).
+            n = (count < width - x) ? count : width - x;
+            if (NULL == target) {
+                if (n > 0)
+                    used[8 == bit_count ? value : value >> 4] = true;
+                if (4 == bit_count && n > 1)
+                    used[value & 15] = true;
+            }
+            else if (8 == bit_count && 1 == pixel_byte)
+                memset(row + x, color_list[value], n);
+            else if (8 == bit_count) {
+                color = color_list + value * 3;
+                for (k = 0; k < n; k++)
+                    memcpy(row + (x + k) * 3, color, 3);
+            }
+            else {
+                for (k = 0; k < n; k++) {
+                    index = (k & 1) ? value & 15 : value >> 4;
+                    memcpy(row + (x + k) * pixel_byte, color_list + index * pixel_byte, pixel_byte);
+                }
+            }
+            x += n;
+        }
+        else if (0 == value) {
+            //end of line
+            if (NULL != target)
+                rle_fill(target, target_stride, pixel_byte, color_list, width, height, x, y, 0, y + 1);
+            else if (x < width)
+                used[0] = true;
+            x = 0;
+            y++;
+            if (NULL != target)
+                row = target + y * target_stride;
+        }
+        else if (1 == value) {
+            //end of bitmap
+            break;
+        }
+        else if (2 == value) {
+            //delta: right dx, up dy.
+            if (i + 2 > rle_length)
+                throw FILE_DAMAGED;
+            long to_x = (x + rle_array[i] < width) ? x + rle_array[i] : width, to_y = y + rle_array[i + 1];
+            i += 2;
+            if (NULL != target)
+                rle_fill(target, target_stride, pixel_byte, color_list, width, height, x, y, to_x, to_y);
+            else if (to_x > x || to_y > y)
+                used[0] = true;
+            x = to_x;
+            y = to_y;
+            if (NULL != target)
+                row = target + y * target_stride;
+        }
+        else {
+            //absolute: value indices, 1 byte (RLE8) or 4 bits (RLE4) each, padded to 2 bytes.
+            unsigned long data_byte = (8 == bit_count) ? value : (value + 1) / 2;
+            const unsigned char* data = rle_array + i;
+            if (i + data_byte > rle_length)
+                throw FILE_DAMAGED;
+            i += (data_byte + 1) & ~1UL;
+            n = (value < width - x) ? value : width - x;
+            for (k = 0; k < n; k++) {
+                index = (8 == bit_count) ? data[k] : ((k & 1) ? data[k >> 1] & 15 : data[k >> 1] >> 4);
+                if (NULL == target)
+                    used[index] = true;
+                else if (1 == pixel_byte)
+                    row[x + k] = color_list[index];
+                else
+                    memcpy(row + (x + k) * 3, color_list + index * 3, 3);
+            }
+            x += n;
+        }
+    }
+    
+    if (NULL != target)
+        rle_fill(target, target_stride, pixel_byte, color_list, width, height, x, y, 0, height);
+    else if (y < height - 1 || (y < height && x < width))
+        used[0] = true;
+}
+
+static void rle_fill (unsigned char* target, long target_stride, int pixel_byte, const unsigned char* color,
+                      long width, long height, long from_x, long from_y, long to_x, long to_y) {
+    long x, last_x;
+    
+    for (; from_y < height && (from_y < to_y || (from_y == to_y && from_x < to_x)); from_y++, from_x = 0) {
+        last_x = (from_y < to_y) ? width : to_x;
+        if (1 == pixel_byte)
+            memset(target + from_y * target_stride + from_x, color[0], last_x - from_x);
+        else {
+            for (x = from_x; x < last_x; x++)
+                memcpy(target + from_y * target_stride + x * 3, color, 3);
+        }
+    }
+}
+
+unsigned long RleEncode (const unsigned char* data_array, long line_byte, int bit_count, long width, long height,
+                         unsigned char* rle_array) {
+    int period = (8 == bit_count) ? 1 : 2;
+    int min_run = (8 == bit_count) ? 3 : 4;
+    unsigned char* index_row = NULL;
+    const unsigned char* org_row;
+    unsigned long length = 0;
+    long x, y, run, literal, k;
+    
+    TRACE_SCOPE("RleEncode", "SaveBmp");
+    TRACE_BYTES(labs(line_byte) * height);
+    if (4 == bit_count)
+        index_row = new unsigned char[width + 1];
+    
+    for (y = 0; y < height; y++) {
+        org_row = data_array + y * line_byte;
+        if (4 == bit_count) {
+            for (x = 0; x < width; x++)
+                index_row[x] = (x & 1) ? org_row[x >> 1] & 15 : org_row[x >> 1] >> 4;
+            org_row = index_row;
+        }
+        
+        for (x = 0; x < width; ) {
+            run = rle_run_length(org_row, x, width, period);
+            if (run >= min_run) {
+                rle_array[length++] = (unsigned char)run;
+                rle_array[length++] = (8 == bit_count) ? org_row[x] : (unsigned char)(org_row[x] << 4 | org_row[x + 1]);
+                x += run;
+                continue;
+            }
+            
+            //absolute until the next run worth encoding (or 255 pixels).
+            for (literal = 1; x + literal < width && literal < 255; literal++) {
+                if (rle_run_length(org_row, x + literal, (x + literal + min_run < width) ? x + literal + min_run : width, period) >= min_run)
+                    break;
+            }
+            if (literal < 3) {
+                //absolute needs 3 pixels at least: short runs.
+                if (8 == bit_count) {
+                    for (k = 0; k < literal; k++) {
+                        rle_array[length++] = 1;
+                        rle_array[length++] = org_row[x + k];
+                    }
+                }
+                else {
+                    rle_array[length++] = (unsigned char)literal;
+                    rle_array[length++] = (unsigned char)(org_row[x] << 4 | (literal > 1 ? org_row[x + 1] : 0));
+                }
+            }
+            else {
+                rle_array[length++] = 0;
+                rle_array[length++] = (unsigned char)literal;
+                if (8 == bit_count) {
+                    memcpy(rle_array + length, org_row + x, literal);
+                    length += literal;
+                }
+                else {
+                    for (k = 0; k < literal; k += 2)
+                        rle_array[length++] = (unsigned char)(org_row[x + k] << 4 | (k + 1 < literal ? org_row[x + k + 1] : 0));
+                }
+                if (length & 1)
+                    rle_array[length++] = 0;
+            }
+            x += literal;
+        }
+        
+        //end of line
+        rle_array[length++] = 0;
+        rle_array[length++] = 0;
+    }
+    //end of bitmap
+    rle_array[length++] = 0;
+    rle_array[length++] = 1;
+    
+    if (NULL != index_row)
+        delete [] index_row;
+    return length;
+}
+
+unsigned long RleBound (long width, long height) {
+    return ((unsigned long)width * 2 + 2) * height + 2;
+}
+
+static long rle_run_length (const unsigned char* index_row, long x, long width, int period) {
+    long last = (x + 255 < width) ? x + 255 : width;
+    long k;
+    
+    if (1 == period) {
+        for (k = x + 1; k < last && index_row[k] == index_row[x]; k++)
+            ;
+    }
+    else {
+        for (k = x + 2; k < last && index_row[k] == index_row[k - 2]; k++)
+            ;
+        if (k > last)
+            k = last;   //a single pixel
+    }
+    return k - x;
+}
@@ -0,0 +1,287 @@
+/* ***************************************************************************
+ functions in this (basic_bmp_writev.cpp) cpp file:
+ 
+ (1) int SaveBmp_Gather (char* save_file_path, const unsigned char* bitmap_array, long width, long height,
+                         unsigned short bit_count, bool direct_io);
+ * may throw: NO_DATA, WRONG_FILE_PATH, WRITE_IN_ERROR.
+ * Save the pixels of a BitMapImg (rows without padding, 1 byte gray or 3 bytes B, G, R per pixel)
+ * as an 8-bit (gray) or 24-bit BMP file, without any padded copy of it (no bmpData, no <TransToBmp>):
+ * header, color table and rows are handed to writev straight from where they are,
+ * the padding of every row comes from a static zero buffer.
+ * If no row needs padding (width * pixel_byte % 4 == 0), all the rows are one single vector.
+ * bit_count 1: a packed image (see BitMapImg <SetPacked>), its rows are BMP rows already (always one vector),
+ * with the color table black, white.
+ * direct_io (for large outputs): the file is allocated at its full size first (fallocate),
+ * then written with O_DIRECT (not through the page cache) from an aligned buffer of BMP_DIRECT_BUFFER bytes.
+ * If the file system refuses O_DIRECT, the file is written as without it.
+ * bitmap_array is not freed. Without writev (not unix-like), the padded rows are made and <SaveBmp> is called.
+ 
+ (2) void MakeBmpHeader (unsigned char* header, long width, long height, unsigned short bit_count);
+ * The 54 bytes of "BM", file-header and info-header of an uncompressed BMP (BI_RGB),
+ * the same as <WriteBmpHeader> writes, but into memory. Byte by byte, so it works in either endian mode.
+ 
+ (3) void put_by_byte (unsigned char* target, unsigned long content, int size_byte);
+ * Write a little-endian number into memory, MAX: 4bytes.
+ * Logically similar with <get_by_byte>.
+ 
+ (4) static void write_vectors (int bmp_fd, struct iovec* vector_list, int vector_count);
+ * may throw: WRITE_IN_ERROR.
+ * writev all of vector_list, at most BMP_MAX_VECTOR at a time, again after a short write.
+ 
+ (5) static void write_direct (int bmp_fd, const unsigned char* header, unsigned long header_byte,
+                               const unsigned char* bitmap_array, long row_byte, long line_byte, long height);
+ * may throw: WRITE_IN_ERROR.
+ * The direct_io part of (1): gather into the aligned buffer, write it whenever it is full.
+ * The last block is written in full, then the file is cut to its real size.
+ *****************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "const_bmpSystem.h"
+#include "const_ErrorCodes.h"
+#include "struct_bmpFileStructure.h"
+#include "struct_TraceScope.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define bmp_writev_available
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/uio.h>
+#endif
+
+#define BMP_MAX_VECTOR      1024    //IOV_MAX of Linux and macOS
+#define BMP_DIRECT_ALIGN    4096    //O_DIRECT: address, size and offset of every write
+#define BMP_DIRECT_BUFFER   (4 << 20)
+
+int SaveBmp (char* save_file_path, bmpData bmp_image, int compression = BI_RGB); //basic_bmp_io.cpp
+unsigned char* PixelAlloc (unsigned long size_byte);    //basic_pixel_pool.cpp
+void MakeBmpHeader (unsigned char* header, long width, long height, unsigned short bit_count);   //basic_bmp_writev.cpp
+void put_by_byte (unsigned char* target, unsigned long content, int size_byte);  //basic_bmp_writev.cpp
+
+#ifdef bmp_writev_available
+
+static const unsigned char zero_padding[4] = {0};
+
+static void write_vectors (int bmp_fd, struct iovec* vector_list, int vector_count);
+static void write_direct (int bmp_fd, const unsigned char* header, unsigned long header_byte,
+                          const unsigned char* bitmap_array, long row_byte, long line_byte, long height);
+
+int SaveBmp_Gather (char* save_file_path, const unsigned char* bitmap_array, long width, long height,
+                    unsigned short bit_count, bool direct_io) {
+    long line_byte = (width * bit_count + 31) / 32 * 4;
+    long row_byte = (1 == bit_count) ? line_byte : width * bit_count / 8;
+    unsigned long header_byte = (bit_count <= 8) ? 54 + (4UL << bit_count) : 54;
+    unsigned long file_byte = header_byte + (unsigned long)line_byte * height;
+    unsigned char header[54 + 256 * 4];
+    std::vector<struct iovec> vector_list;
+    int bmp_fd = -1;
+    int error_code = 0;
+    
+    if (NULL == bitmap_array)
+        throw NO_DATA;
+    
+    MakeBmpHeader(header, width, height, bit_count);
+    if (bit_count <= 8) {
+        //gray: 0 ~ 255; 1-bit: 0 black, 1 white.
+        for (int i = 0; i < (1 << bit_count); i++) {
+            header[54 + i * 4] = (1 == bit_count) ? i * 255 : i;
+            header[54 + i * 4 + 1] = header[54 + i * 4];
+            header[54 + i * 4 + 2] = header[54 + i * 4];
+            header[54 + i * 4 + 3] = 0;
+        }
+    }
+    
+    TRACE_SCOPE("open", "SaveBmp_Gather");
+    if (direct_io) {
+#ifdef O_DIRECT
+        bmp_fd = open(save_file_path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0666);
+        if (bmp_fd < 0 && EINVAL == errno)
+            direct_io = false;  //e.g. tmpfs
+#else
+        direct_io = false;
+#endif
+    }
+    if (bmp_fd < 0)
+        bmp_fd = open(save_file_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (bmp_fd < 0)
+        throw WRONG_FILE_PATH;
+    
+    try {
+#ifdef __linux__
+        if (direct_io && ENOSPC == posix_fallocate(bmp_fd, 0, file_byte))
+            throw WRITE_IN_ERROR;
+#endif
+        TRACE_NEXT("pixels");
+        TRACE_BYTES(file_byte);
+        if (direct_io) {
+            write_direct(bmp_fd, header, header_byte, bitmap_array, row_byte, line_byte, height);
+        }
+        else if (row_byte == line_byte) {
+            struct iovec whole[2] = {{header, header_byte}, {(void*)bitmap_array, (size_t)(row_byte * height)}};
+            write_vectors(bmp_fd, whole, 2);
+        }
+        else {
+            vector_list.resize(1 + height * 2);
+            vector_list[0].iov_base = header;
+            vector_list[0].iov_len = header_byte;
+            for (long y = 0; y < height; y++) {
+                vector_list[1 + y * 2].iov_base = (void*)(bitmap_array + y * row_byte);
+                vector_list[1 + y * 2].iov_len = row_byte;
+                vector_list[2 + y * 2].iov_base = (void*)zero_padding;
+                vector_list[2 + y * 2].iov_len = line_byte - row_byte;
+            }
+            write_vectors(bmp_fd, &vector_list[0], (int)vector_list.size());
+        }
+    } catch (const int error) {
+        error_code = error;
+    }
+    
+    TRACE_NEXT("close");
+    if (0 != close(bmp_fd) && 0 == error_code)
+        error_code = WRITE_IN_ERROR;
+    if (0 != error_code)
+        throw error_code;
+    return 0;
+}
+
+static void write_vectors (int bmp_fd, struct iovec* vector_list, int vector_count) {
+    ssize_t succeeded_length;
+    
+    while (vector_count > 0) {
+        succeeded_length = writev(bmp_fd, vector_list, vector_count < BMP_MAX_VECTOR ? vector_count : BMP_MAX_VECTOR);
+        if (succeeded_length < 0) {
+            if (EINTR == errno)
+                continue;
+            throw WRITE_IN_ERROR;
+        }
+        //skip the vectors written, and the written part of the next one (a short write).
+        while (vector_count > 0 && (size_t)succeeded_length >= vector_list->iov_len) {
+            succeeded_length -= vector_list->iov_len;
+            vector_list++;
+            vector_count--;
+        }
+        if (vector_count > 0) {
+            vector_list->iov_base = (char*)vector_list->iov_base + succeeded_length;
+            vector_list->iov_len -= succeeded_length;
+        }
+    }
+}
+
+static void write_direct (int bmp_fd, const unsigned char* header, unsigned long header_byte,
+                          const unsigned char* bitmap_array, long row_byte, long line_byte, long height) {
+    unsigned char* buffer = NULL;
+    unsigned long used = 0;
+    unsigned long file_byte = header_byte + (unsigned long)line_byte * height;
+    unsigned long written = 0;
+    unsigned long length, part;
+    long y = 0, x = 0;  //next byte of the rows to gather: row y, byte x (x >= row_byte: padding)
+    int error_code = 0;
+    
+    if (0 != posix_memalign((void**)&buffer, BMP_DIRECT_ALIGN, BMP_DIRECT_BUFFER))
+        throw WRITE_IN_ERROR;
+    TRACE_ALLOC(BMP_DIRECT_BUFFER);
+    
+    memcpy(buffer, header, header_byte);
+    used = header_byte;
+    while (written < file_byte) {
+        //gather until the buffer is full or the rows end:
+        while (used < BMP_DIRECT_BUFFER && y < height) {
+            if (x < row_byte) {
+                part = row_byte - x;
+                if (part > BMP_DIRECT_BUFFER - used)
+                    part = BMP_DIRECT_BUFFER - used;
+                memcpy(buffer + used, bitmap_array + y * row_byte + x, part);
+            }
+            else {
+                part = line_byte - x;
+                if (part > BMP_DIRECT_BUFFER - used)
+                    part = BMP_DIRECT_BUFFER - used;
+                memset(buffer + used, 0, part);
+            }
+            used += part;
+            x += part;
+            if (x == line_byte) {
+                x = 0;
+                y++;
+            }
+        }
+        
+        length = (used + BMP_DIRECT_ALIGN - 1) / BMP_DIRECT_ALIGN * BMP_DIRECT_ALIGN;
+        memset(buffer + used, 0, length - used);
+        if ((ssize_t)length != pwrite(bmp_fd, buffer, length, written)) {
+            error_code = WRITE_IN_ERROR;
+            break;
+        }
+        written += used;
+        used = 0;
+    }
+    free(buffer);
+    
+    if (0 == error_code && 0 != ftruncate(bmp_fd, file_byte))
+        error_code = WRITE_IN_ERROR;
+    if (0 != error_code)
+        throw error_code;
+}
+
+#else
+
+int SaveBmp_Gather (char* save_file_path, const unsigned char* bitmap_array, long width, long height,
+                    unsigned short bit_count, bool direct_io) {
+    bmpData bmp_image;
+    long line_byte = (width * bit_count + 31) / 32 * 4;
+    long row_byte = (1 == bit_count) ? line_byte : width * bit_count / 8;
+    
+    if (NULL == bitmap_array)
+        throw NO_DATA;
+    bmp_image.bmp_Width = width;
+    bmp_image.bmp_Height = height;
+    bmp_image.bmp_BitCount = bit_count;
+    bmp_image.bmp_Compression = BI_RGB;
+    bmp_image.bmp_data_length = line_byte * height;
+    bmp_image.bmp_mapped_base = NULL;
+    bmp_image.bmp_mapped_length = 0;
+    bmp_image.bmp_color_table = NULL;
+    if (bit_count <= 8) {
+        bmp_image.bmp_color_table = new RgbQuad[1 << bit_count];
+        for (int i = 0; i < (1 << bit_count); i++) {
+            bmp_image.bmp_color_table[i].rgbBlue = (1 == bit_count) ? i * 255 : i;
+            bmp_image.bmp_color_table[i].rgbGreen = bmp_image.bmp_color_table[i].rgbBlue;
+            bmp_image.bmp_color_table[i].rgbRed = bmp_image.bmp_color_table[i].rgbBlue;
+            bmp_image.bmp_color_table[i].rgbReserved = 0;
+        }
+    }
+    bmp_image.bmp_data_array = PixelAlloc(line_byte * height);
+    memset(bmp_image.bmp_data_array, 0, line_byte * height);
+    for (long y = 0; y < height; y++)
+        memcpy(bmp_image.bmp_data_array + y * line_byte, bitmap_array + y * row_byte, row_byte);
+    return SaveBmp(save_file_path, bmp_image);
+}
+
+#endif /* bmp_writev_available */
+
+void MakeBmpHeader (unsigned char* header, long width, long height, unsigned short bit_count) {
+    unsigned long line_byte = (labs(width) * bit_count + 31) / 32 * 4;
+    unsigned long data_byte = line_byte * labs(height);
+    unsigned long color_table_byte = bit_count <= 8 ? (1UL << bit_count) * 4 : 0;
+    
+    memset(header, 0, 54);
+    put_by_byte(header, 0x4D42, 2);
+    put_by_byte(header + 2, 54 + color_table_byte + data_byte, 4);  //bfSize
+    put_by_byte(header + 10, 54 + color_table_byte, 4); //bfOffBits
+    put_by_byte(header + 14, 40, 4);    //biSize
+    put_by_byte(header + 18, (u_word4)width, 4);
+    put_by_byte(header + 22, (u_word4)height, 4);
+    put_by_byte(header + 26, 1, 2);     //biPlanes
+    put_by_byte(header + 28, bit_count, 2);
+    put_by_byte(header + 30, BI_RGB, 4);
+    put_by_byte(header + 34, data_byte, 4); //biSizeImage
+}
+
+void put_by_byte (unsigned char* target, unsigned long content, int size_byte) {
+    for (int i = 0; i < size_byte; i++) {
+        target[i] = (unsigned char)(content >> (8 * i));
+    }
+}
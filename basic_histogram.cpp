@@ -0,0 +1,263 @@
+/* ***************************************************************************
+ functions in this (basic_histogram.cpp) cpp file:
+ 
+ (1) void Histogram_Array (const unsigned char* array, long pixel_count, int pixel_byte, Histogram* histogram);
+ * Count every value of every channel of pixel_count pixels (pixel_byte 1: gray; 3: B, G, R),
+ * histogram->channel_count = pixel_byte.
+ * The pixels are cut into one part per thread (<RunTiles>, see <SetThreadCount>),
+ * every part is counted into its own sub-histogram, and they are added up at the end:
+ * no thread writes a counter of another one.
+ 
+ (2) void Histogram_Stats (const Histogram* histogram, int channel, ChannelStats* stats);
+ * min, max, mean and standard deviation of a channel, from its 256 counters only.
+ * channel -1: all channels as one. No pixel: all 0.
+ 
+ (3) int Histogram_Percentile (const Histogram* histogram, int channel, double percent);
+ * The smallest value v of channel with more than percent% of the pixels <= v,
+ * so 0 is the min value, 100 the max value. channel -1: all channels as one.
+ 
+ (4) int Histogram_Otsu (const Histogram* histogram, int channel);
+ * Otsu's threshold of channel (-1: all channels as one): the value t that splits the pixels into
+ * [0, t) and [t, 255] with the largest between-class variance w0 * w1 * (mean0 - mean1)^2.
+ * Made for <ColorTrans::Binary>, pixels < t become 0. An image of one value: 128.
+ 
+ (4.1) void Histogram_Bits (const unsigned char* bits, long byte_count, long pixel_count, Histogram* histogram);
+ * The gray histogram of a packed image (see BitMapImg <SetPacked>): count[0][255] is the number of 1 bits
+ * in byte_count bytes (the padding bits must be 0), count[0][0] the rest of pixel_count.
+ * 64 pixels at a time: the bits of a word are added up by 3 masked shifts and one multiply.
+ 
+ (5) static void histogram_tile (long tile_index, void* context);
+ * tile_function of <RunTiles>, context is a HistogramTask: count part tile_index of the pixels
+ * into sub_count[tile_index].
+ 
+ (6) static void histogram_count (const unsigned char* array, long pixel_count, int pixel_byte, unsigned int (*count)[256]);
+ * Add pixel_count pixels to count, 4 tables per channel (count[c * 4 + k]), pixel i goes to table k = i % 4.
+ * A run of equal values (flat areas, the most usual case) increments one counter again and again,
+ * every increment has to wait for the store of the one before; with 4 tables 4 of them are in flight.
+ *****************************************************************************/
+
+#include <cstring>
+#include <cmath>
+#include "struct_Histogram.h"
+#include "struct_TraceScope.h"
+
+//at least this many pixels per part of <Histogram_Array>, below it the threads cost more than they save.
+#define HISTOGRAM_MIN_PART  65536
+
+typedef struct struct_HistogramTask {
+    const unsigned char* array;
+    long pixel_count;
+    int pixel_byte;
+    long part_pixels;   //pixels of a part (the last one may have less)
+    unsigned long (*sub_count)[3][256]; //[part][channel][value]
+} HistogramTask;
+
+int GetThreadCount (void);  //basic_thread_pool.cpp
+void RunTiles (long tile_count, void (*tile_function)(long tile_index, void* context), void* context);  //basic_thread_pool.cpp
+void Histogram_Array (const unsigned char* array, long pixel_count, int pixel_byte, Histogram* histogram);    //basic_histogram.cpp
+void Histogram_Stats (const Histogram* histogram, int channel, ChannelStats* stats);   //basic_histogram.cpp
+int Histogram_Percentile (const Histogram* histogram, int channel, double percent);    //basic_histogram.cpp
+int Histogram_Otsu (const Histogram* histogram, int channel);  //basic_histogram.cpp
+void Histogram_Bits (const unsigned char* bits, long byte_count, long pixel_count, Histogram* histogram);    //basic_histogram.cpp
+
+static void histogram_tile (long tile_index, void* context);
+static void histogram_count (const unsigned char* array, long pixel_count, int pixel_byte, unsigned int (*count)[256]);
+
+void Histogram_Array (const unsigned char* array, long pixel_count, int pixel_byte, Histogram* histogram) {
+    long parts = pixel_count / HISTOGRAM_MIN_PART;
+    HistogramTask task;
+    long p;
+    int c, v;
+    
+    TRACE_SCOPE("Histogram", "ColorTrans");
+    TRACE_BYTES(pixel_count * pixel_byte);
+    if (parts > GetThreadCount())
+        parts = GetThreadCount();
+    if (parts < 1)
+        parts = 1;
+    task.array = array;
+    task.pixel_count = pixel_count;
+    task.pixel_byte = pixel_byte;
+    task.part_pixels = (pixel_count + parts - 1) / parts;
+    task.sub_count = new unsigned long[parts][3][256];
+    TRACE_ALLOC(parts * sizeof(task.sub_count[0]));
+    
+    RunTiles(parts, histogram_tile, &task);
+    
+    memset(histogram, 0, sizeof(Histogram));
+    histogram->channel_count = pixel_byte;
+    histogram->pixel_count = pixel_count;
+    for (p = 0; p < parts; p++) {
+        for (c = 0; c < pixel_byte; c++) {
+            for (v = 0; v < 256; v++)
+                histogram->count[c][v] += task.sub_count[p][c][v];
+        }
+    }
+    delete[] task.sub_count;
+}
+
+static void histogram_tile (long tile_index, void* context) {
+    HistogramTask* task = (HistogramTask*)context;
+    long first = tile_index * task->part_pixels;
+    long last = (first + task->part_pixels < task->pixel_count) ? first + task->part_pixels : task->pixel_count;
+    unsigned int count[3 * 4][256];
+    int c, v;
+    
+    memset(count, 0, sizeof(count));
+    if (last > first)
+        histogram_count(task->array + first * task->pixel_byte, last - first, task->pixel_byte, count);
+    
+    for (c = 0; c < 3; c++) {
+        for (v = 0; v < 256; v++)
+            task->sub_count[tile_index][c][v] = (unsigned long)count[c * 4][v] + count[c * 4 + 1][v] + count[c * 4 + 2][v] + count[c * 4 + 3][v];
+    }
+}
+
+static void histogram_count (const unsigned char* array, long pixel_count, int pixel_byte, unsigned int (*count)[256]) {
+    long i = 0;
+    
+    if (1 == pixel_byte) {
+        for (; i + 8 <= pixel_count; i += 8) {
+            count[0][array[i]]++;
+            count[1][array[i + 1]]++;
+            count[2][array[i + 2]]++;
+            count[3][array[i + 3]]++;
+            count[0][array[i + 4]]++;
+            count[1][array[i + 5]]++;
+            count[2][array[i + 6]]++;
+            count[3][array[i + 7]]++;
+        }
+        for (; i < pixel_count; i++)
+            count[i & 3][array[i]]++;
+    }
+    else {
+        //4 pixels: B, G, R of each to its own table.
+        for (; i + 4 <= pixel_count; i += 4) {
+            const unsigned char* pixel = array + i * 3;
+            count[0][pixel[0]]++;
+            count[4][pixel[1]]++;
+            count[8][pixel[2]]++;
+            count[1][pixel[3]]++;
+            count[5][pixel[4]]++;
+            count[9][pixel[5]]++;
+            count[2][pixel[6]]++;
+            count[6][pixel[7]]++;
+            count[10][pixel[8]]++;
+            count[3][pixel[9]]++;
+            count[7][pixel[10]]++;
+            count[11][pixel[11]]++;
+        }
+        for (; i < pixel_count; i++) {
+            for (int c = 0; c < 3; c++)
+                count[c * 4 + (i & 3)][array[i * 3 + c]]++;
+        }
+    }
+}
+
+void Histogram_Stats (const Histogram* histogram, int channel, ChannelStats* stats) {
+    unsigned long count[256], total = 0;
+    double sum = 0, square_sum = 0, variance;
+    int v, c;
+    
+    for (v = 0; v < 256; v++) {
+        count[v] = 0;
+        for (c = 0; c < histogram->channel_count; c++) {
+            if (-1 == channel || c == channel)
+                count[v] += histogram->count[c][v];
+        }
+        total += count[v];
+        sum += (double)count[v] * v;
+        square_sum += (double)count[v] * v * v;
+    }
+    
+    memset(stats, 0, sizeof(ChannelStats));
+    if (0 == total)
+        return;
+    for (v = 0; 0 == count[v]; v++);
+    stats->min = v;
+    for (v = 255; 0 == count[v]; v--);
+    stats->max = v;
+    stats->mean = sum / total;
+    variance = square_sum / total - stats->mean * stats->mean;
+    stats->stddev = (variance > 0) ? sqrt(variance) : 0;
+}
+
+int Histogram_Percentile (const Histogram* histogram, int channel, double percent) {
+    unsigned long count[256], total = 0, below = 0;
+    double target;
+    int v, c, last = 0;
+    
+    for (v = 0; v < 256; v++) {
+        count[v] = 0;
+        for (c = 0; c < histogram->channel_count; c++) {
+            if (-1 == channel || c == channel)
+                count[v] += histogram->count[c][v];
+        }
+        total += count[v];
+        if (count[v] > 0)
+            last = v;
+    }
+    
+    target = percent / 100 * total;
+    for (v = 0; v < 256; v++) {
+        below += count[v];
+        if (below > target)
+            return v;
+    }
+    return last;
+}
+
+int Histogram_Otsu (const Histogram* histogram, int channel) {
+    double count[256], total = 0, sum = 0;
+    double below = 0, below_sum = 0, variance, best_variance = 0;
+    int v, c, threshold = 128;
+    
+    for (v = 0; v < 256; v++) {
+        count[v] = 0;
+        for (c = 0; c < histogram->channel_count; c++) {
+            if (-1 == channel || c == channel)
+                count[v] += histogram->count[c][v];
+        }
+        total += count[v];
+        sum += count[v] * v;
+    }
+    
+    //split after v: [0, v] and [v + 1, 255].
+    for (v = 0; v < 255; v++) {
+        below += count[v];
+        below_sum += count[v] * v;
+        if (0 == below || below == total)
+            continue;
+        double mean_difference = below_sum / below - (sum - below_sum) / (total - below);
+        variance = below * (total - below) * mean_difference * mean_difference;
+        if (variance > best_variance) {
+            best_variance = variance;
+            threshold = v + 1;
+        }
+    }
+    return threshold;
+}
+
+void Histogram_Bits (const unsigned char* bits, long byte_count, long pixel_count, Histogram* histogram) {
+    unsigned long long word;
+    unsigned long ones = 0;
+    long i;
+    
+    for (i = 0; i + 8 <= byte_count; i += 8) {
+        memcpy(&word, bits + i, 8);
+        word = word - ((word >> 1) & 0x5555555555555555ULL);
+        word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+        word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+        ones += (unsigned long)((word * 0x0101010101010101ULL) >> 56);
+    }
+    for (; i < byte_count; i++) {
+        for (int k = 0; k < 8; k++)
+            ones += (bits[i] >> k) & 1;
+    }
+    
+    memset(histogram->count, 0, sizeof(histogram->count));
+    histogram->channel_count = 1;
+    histogram->pixel_count = pixel_count;
+    histogram->count[0][255] = ones;
+    histogram->count[0][0] = pixel_count - ones;
+}
@@ -0,0 +1,143 @@
+/* ***************************************************************************
+ functions in this (basic_lut.cpp) cpp file:
+ 
+ (1) void Lut_Identity (unsigned char* lut);
+ * lut[i] = i, the start of every lookup table.
+ * A lookup table (lut) is 256 bytes: the result of a point operation for every byte value,
+ * so a tone curve is computed 256 times instead of once per byte of the image.
+ 
+ (2) void Lut_Reverse (unsigned char* lut);
+     void Lut_Binary (unsigned char* lut, int threshold);
+     void Lut_LogarithmStretch (unsigned char* lut, double a, double b, double c);
+     void Lut_ExponentStretch (unsigned char* lut, double a, double b, double c);
+ * Append a point operation (same formula as in ColorTrans) after what lut already does:
+ * lut[i] = operation(lut[i]). So several operations compose into one lut, e.g.
+ *     Lut_Identity(lut);
+ *     Lut_ExponentStretch(lut, 128, 2, 0.6);
+ *     Lut_Reverse(lut);
+ *     ApplyLut_Simd(array, array_length, lut);  //one pass over the image
+ 
+ (3) void Lut_Compose (unsigned char* lut, const unsigned char* next_lut);
+ * lut[i] = next_lut[lut[i]], do next_lut after lut.
+ 
+ (4) void Lut_Equalize (unsigned char* lut, const Histogram* histogram);
+     void Lut_AutoContrast (unsigned char* lut, const Histogram* histogram, double low_percent, double high_percent);
+ * Append a curve made from the histogram (basic_histogram.cpp) of the pixels it will be applied on,
+ * all channels of it as one, so the colors keep their balance.
+ * Equalize: v -> 255 * (pixels <= v, but not of the min value) / (pixels not of the min value),
+ * so the cumulative histogram becomes a straight line.
+ * AutoContrast: the low_percent% darkest and the high_percent% brightest pixels are clipped,
+ * the values between are stretched linearly to 0 ~ 255.
+ * An image of one value (nothing to stretch) is left as it is.
+ *****************************************************************************/
+
+#include <cmath>
+#include "struct_Histogram.h"
+
+void Lut_Identity (unsigned char* lut);  //basic_lut.cpp
+void Lut_Compose (unsigned char* lut, const unsigned char* next_lut);    //basic_lut.cpp
+int Histogram_Percentile (const Histogram* histogram, int channel, double percent);    //basic_histogram.cpp
+
+void Lut_Identity (unsigned char* lut) {
+    for (int i = 0; i < 256; i++) {
+        lut[i] = (unsigned char)i;
+    }
+}
+
+void Lut_Compose (unsigned char* lut, const unsigned char* next_lut) {
+    for (int i = 0; i < 256; i++) {
+        lut[i] = next_lut[lut[i]];
+    }
+}
+
+void Lut_Reverse (unsigned char* lut) {
+    for (int i = 0; i < 256; i++) {
+        lut[i] = 255 - lut[i];
+    }
+}
+
+void Lut_Binary (unsigned char* lut, int threshold) {
+    for (int i = 0; i < 256; i++) {
+        if (lut[i] < threshold)
+            lut[i] = 0;
+        else
+            lut[i] = 255;
+    }
+}
+
+void Lut_LogarithmStretch (unsigned char* lut, double a, double b, double c) {
+    unsigned char curve[256];
+    double result;
+    double divisor = b * log(c);
+    
+    for (int i = 0; i < 256; i++) {
+        result = a + (log(i + 1)) / divisor;
+        if (result > 255)
+            result = 255;
+        else if (result < 0)
+            result = 0;
+        
+        curve[i] = (int)result;
+    }
+    Lut_Compose(lut, curve);
+}
+
+void Lut_ExponentStretch (unsigned char* lut, double a, double b, double c) {
+    unsigned char curve[256];
+    double result;
+    
+    for (int i = 0; i < 256; i++) {
+        result = pow(b, (c * (i - a))) - 1;
+        if (result > 255)
+            result = 255;
+        else if (result < 0)
+            result = 0;
+        
+        curve[i] = (int)result;
+    }
+    Lut_Compose(lut, curve);
+}
+
+void Lut_Equalize (unsigned char* lut, const Histogram* histogram) {
+    unsigned char curve[256];
+    unsigned long count[256], total = 0, below = 0, first_count = 0;
+    int v, c;
+    
+    for (v = 0; v < 256; v++) {
+        count[v] = 0;
+        for (c = 0; c < histogram->channel_count; c++)
+            count[v] += histogram->count[c][v];
+        total += count[v];
+        if (0 == first_count)
+            first_count = count[v];
+    }
+    if (total == first_count)
+        return;
+    
+    //the min value goes to 0, the max one to 255.
+    for (v = 0; v < 256; v++) {
+        below += count[v];
+        curve[v] = (below < first_count) ? 0 : (unsigned char)floor((double)(below - first_count) * 255 / (total - first_count) + 0.5);
+    }
+    Lut_Compose(lut, curve);
+}
+
+void Lut_AutoContrast (unsigned char* lut, const Histogram* histogram, double low_percent, double high_percent) {
+    unsigned char curve[256];
+    int low = Histogram_Percentile(histogram, -1, low_percent);
+    int high = Histogram_Percentile(histogram, -1, 100 - high_percent);
+    double result;
+    
+    if (high <= low)
+        return;
+    for (int i = 0; i < 256; i++) {
+        result = (double)(i - low) * 255 / (high - low) + 0.5;
+        if (result > 255)
+            result = 255;
+        else if (result < 0)
+            result = 0;
+        
+        curve[i] = (int)result;
+    }
+    Lut_Compose(lut, curve);
+}
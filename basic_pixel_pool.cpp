@@ -0,0 +1,195 @@
+/* ***************************************************************************
+ functions in this (basic_pixel_pool.cpp) cpp file:
+ 
+ (1) unsigned char* PixelAlloc (unsigned long size_byte);
+ * may throw: std::bad_alloc.
+ * A pixel buffer of at least size_byte bytes (not zeroed), from the current allocator (see (3)).
+ * Every bitmap_array of BitMapImg and its derived classes, and every bmp_data_array
+ * of <ReadBmp> / <TransToBmp>, comes from here; give it back by <PixelFree>, never delete [] it.
+ 
+ (2) void PixelFree (unsigned char* buffer);
+ * Give back a buffer of <PixelAlloc> (nothing if NULL).
+ 
+ (3) void SetPixelAllocator (const PixelAllocator* allocator);
+ * Use another allocator (copied), NULL: the pixel pool of (4) again (default).
+ * Call it while no buffer is out (e.g. at start), a buffer is always released by the allocator that made it.
+ 
+ (4) static unsigned char* pool_allocate (unsigned long size_byte, void* context);
+     static void pool_release (unsigned char* buffer, void* context);
+ * The default allocator, a pool of recycled buffers in size classes:
+ * the size is rounded up to a class (4 classes per power of 2, at most 25% more),
+ * a released buffer waits in the free list of its class, and the next request of the class takes it back
+ * (last in, first out: still in cache and its pages already mapped, no page fault, no zeroing).
+ * So an operation which can not work in place (ColorToGray, Zoom, Rotate ...) writes into the buffer
+ * the previous one has just released: two buffers ping-pong through a chain of operations.
+ * Buffers of PIXEL_POOL_HUGE_PAGE bytes or more are aligned to huge pages (and advised so on Linux),
+ * the others to a cache line. At most PIXEL_POOL_MAX_CACHED bytes wait, a buffer beyond it is freed.
+ 
+ (5) void PixelPoolStatsOf (PixelPoolStats* stats);
+     void PixelPoolReport (FILE* output);
+ * Counters of the pool (hit rate = hit_count / request_count), and print them.
+ 
+ (6) void PixelPoolTrim (void);
+ * Free all the waiting buffers. Also done at exit.
+ 
+ (7) static unsigned long pool_size_class (unsigned long size_byte);
+ *****************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <mutex>
+#include <map>
+#include <vector>
+#include <unordered_map>
+#include "struct_PixelAllocator.h"
+#include "struct_TraceScope.h"
+
+#if defined(__linux__)
+    #include <sys/mman.h>
+#endif
+
+#define PIXEL_POOL_HUGE_PAGE    (2UL << 20)
+#define PIXEL_POOL_MAX_CACHED   (1UL << 30)
+
+unsigned char* PixelAlloc (unsigned long size_byte);    //basic_pixel_pool.cpp
+void PixelFree (unsigned char* buffer); //basic_pixel_pool.cpp
+void SetPixelAllocator (const PixelAllocator* allocator);   //basic_pixel_pool.cpp
+void PixelPoolStatsOf (PixelPoolStats* stats);  //basic_pixel_pool.cpp
+void PixelPoolReport (FILE* output);    //basic_pixel_pool.cpp
+void PixelPoolTrim (void);  //basic_pixel_pool.cpp
+
+static unsigned char* pool_allocate (unsigned long size_byte, void* context);
+static void pool_release (unsigned char* buffer, void* context);
+static unsigned long pool_size_class (unsigned long size_byte);
+
+static PixelAllocator current_allocator = {pool_allocate, pool_release, NULL};
+static std::mutex pool_mutex;
+static std::map<unsigned long, std::vector<unsigned char*> > free_list;    //size class -> waiting buffers
+static std::unordered_map<unsigned char*, unsigned long> busy_list;    //buffer out -> its size class
+static PixelPoolStats pool_stats = {0, 0, 0, 0, 0, 0};
+
+static struct struct_PixelPoolKeeper {
+    ~struct_PixelPoolKeeper(void) {
+        PixelPoolTrim();    //before free_list is destroyed, so the waiting buffers are freed, not lost.
+    }
+} pixel_pool_keeper;
+
+unsigned char* PixelAlloc (unsigned long size_byte) {
+    unsigned char* buffer = current_allocator.allocate(size_byte, current_allocator.context);
+    
+    if (NULL == buffer)
+        throw std::bad_alloc();
+    return buffer;
+}
+
+void PixelFree (unsigned char* buffer) {
+    if (NULL != buffer)
+        current_allocator.release(buffer, current_allocator.context);
+}
+
+void SetPixelAllocator (const PixelAllocator* allocator) {
+    if (NULL == allocator) {
+        current_allocator.allocate = pool_allocate;
+        current_allocator.release = pool_release;
+        current_allocator.context = NULL;
+    }
+    else
+        current_allocator = *allocator;
+}
+
+static unsigned char* pool_allocate (unsigned long size_byte, void* /*context*/) {
+    unsigned long size_class = pool_size_class(size_byte);
+    unsigned long alignment = size_class >= PIXEL_POOL_HUGE_PAGE ? PIXEL_POOL_HUGE_PAGE : 64;
+    unsigned char* buffer = NULL;
+    
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        std::vector<unsigned char*> &waiting = free_list[size_class];
+        
+        pool_stats.request_count++;
+        if (!waiting.empty()) {
+            buffer = waiting.back();
+            waiting.pop_back();
+            pool_stats.hit_count++;
+            pool_stats.cached_bytes -= size_class;
+            busy_list[buffer] = size_class;
+            return buffer;
+        }
+    }
+    
+    if (0 != posix_memalign((void**)&buffer, alignment, size_class))
+        return NULL;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (size_class >= PIXEL_POOL_HUGE_PAGE)
+        madvise(buffer, size_class, MADV_HUGEPAGE);
+#endif
+    TRACE_ALLOC(size_class);
+    
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    pool_stats.system_bytes += size_class;
+    busy_list[buffer] = size_class;
+    return buffer;
+}
+
+static void pool_release (unsigned char* buffer, void* /*context*/) {
+    std::unique_lock<std::mutex> lock(pool_mutex);
+    std::unordered_map<unsigned char*, unsigned long>::iterator it = busy_list.find(buffer);
+    unsigned long size_class;
+    
+    pool_stats.release_count++;
+    if (busy_list.end() == it) {
+        //not out of the pool (see (3)), posix_memalign-ed all the same.
+        lock.unlock();
+        free(buffer);
+        return;
+    }
+    size_class = it->second;
+    busy_list.erase(it);
+    
+    if (pool_stats.cached_bytes + size_class > PIXEL_POOL_MAX_CACHED) {
+        lock.unlock();
+        free(buffer);
+        return;
+    }
+    free_list[size_class].push_back(buffer);
+    pool_stats.cached_bytes += size_class;
+    if (pool_stats.cached_bytes > pool_stats.peak_cached_bytes)
+        pool_stats.peak_cached_bytes = pool_stats.cached_bytes;
+}
+
+void PixelPoolStatsOf (PixelPoolStats* stats) {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    *stats = pool_stats;
+}
+
+void PixelPoolReport (FILE* output) {
+    PixelPoolStats stats;
+    
+    PixelPoolStatsOf(&stats);
+    fprintf(output, "pixel pool: %lu requests, %lu hits (%.1f%%), %lu releases, %.1f MB from system, %.1f MB cached (peak %.1f MB)\n",
+            stats.request_count, stats.hit_count, stats.request_count > 0 ? 100.0 * stats.hit_count / stats.request_count : 0.0,
+            stats.release_count, stats.system_bytes / 1e6, stats.cached_bytes / 1e6, stats.peak_cached_bytes / 1e6);
+}
+
+void PixelPoolTrim (void) {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    
+    for (std::map<unsigned long, std::vector<unsigned char*> >::iterator it = free_list.begin(); it != free_list.end(); ++it) {
+        for (size_t i = 0; i < it->second.size(); i++)
+            free(it->second[i]);
+    }
+    free_list.clear();
+    pool_stats.cached_bytes = 0;
+}
+
+static unsigned long pool_size_class (unsigned long size_byte) {
+    unsigned long step = 64;
+    
+    if (size_byte < 64)
+        return 64;
+    //step: a quarter of the highest power of 2 in size_byte, at least 64.
+    while (step * 8 <= size_byte)
+        step *= 2;
+    return (size_byte + step - 1) / step * step;
+}
@@ -0,0 +1,1373 @@
+/* ***************************************************************************
+ functions in this (basic_simd.cpp) cpp file:
+ 
+ (1) int GetSimdLevel (void);
+ * What the CPU supports, checked once at the first call:
+ * SIMD_NONE, SIMD_SSSE3 (16 pixels per instruction) or SIMD_AVX2 (32 pixels per instruction).
+ * The kernels below pick their version by it, so the program is built for plain x86-64
+ * and still runs AVX2 code on the CPUs that have it.
+ 
+ (1.1) void SetSimdLevel (int simd_level);
+ * Use at most simd_level from now on (never more than the CPU has), e.g. SIMD_SSSE3 on an AVX2 CPU
+ * to test or time the SSSE3 versions; SIMD_AVX2 undoes it. Not while other threads run kernels.
+ 
+ (2) void Reverse_Simd (unsigned char* array, long array_length);
+ * array[i] = 255 - array[i].
+ 
+ (3) void Binary_Simd (unsigned char* array, long array_length, int threshold);
+ * array[i] = array[i] < threshold ? 0 : 255.
+ 
+ (4) void ColorToGray_Simd (const unsigned char* bgr_array, unsigned char* gray_array, long pixel_count);
+ * gray = 0.3 * Blue + 0.59 * Green + 0.11 * Red in double, truncated (see ColorTrans <ColorToGray>).
+ * The SIMD versions split the packed B, G, R bytes into three planes with byte shuffles,
+ * sum s = 30 * Blue + 59 * Green + 11 * Red in 16 bits and divide by 100 with a multiply-high:
+ * s / 100 == (s * 41944) >> 22 for s <= 25500. That is the double result unless s is a multiple
+ * of 100 (not 0): then the double sum may round to just below s / 100, so a block with such
+ * a pixel is done by the scalar one instead.
+ * bgr_array and gray_array may be the same array.
+ 
+ (5) void ApplyLut_Simd (unsigned char* array, long array_length, const unsigned char* lut);
+ * array[i] = lut[array[i]], lut is 256 bytes (see basic_lut.cpp).
+ * AVX2 only: lut is cut into 16 rows of 16 bytes, every row is looked up by the low 4 bits
+ * with a byte shuffle, and kept where the high 4 bits select that row.
+ * (With SSSE3 the same trick is no faster than the scalar one.)
+ 
+ (6) void VerticalSum_Simd (const short* const* rows, const short* weights, int taps, long length, unsigned char* result, int shift);
+ * result[i] = (rows[0][i] * weights[0] + ... + rows[taps - 1][i] * weights[taps - 1]) >> shift,
+ * rounded and limited to 0~255. taps must be even (2 or 4), used by Zoom_Separable.
+ * The SIMD versions multiply-add 2 rows at a time (pmaddwd), 8 (SSE2) or 16 (AVX2) values per step.
+ 
+ (7) void Transpose16_Simd (const unsigned char* source, long source_stride, unsigned char* target, long target_stride);
+ * target row i, byte j = source row j, byte i, for a 16 x 16 block of bytes (1-byte pixels).
+ * Strides are in bytes and may be negative, so one flip of the rows comes for free (Rotate_90 / 270).
+ * SSE2: 16 loads, 4 rounds of unpack (8, 16, 32, 64 bits), 16 stores.
+ 
+ (7.1) void Transpose8_BGR_Simd (const unsigned char* source, long source_stride, unsigned char* target, long target_stride);
+ * The same for an 8 x 8 block of 3-byte pixels (B, G, R).
+ * SSSE3: every row (24 bytes) is spread to 8 x 32 bits by byte shuffles,
+ * transposed as four 4 x 4 blocks of 32 bits, and packed back to 24 bytes.
+ 
+ (7.2) void DropAlpha_Simd (const unsigned char* bgra_array, unsigned char* bgr_array, long pixel_count);
+ * 4-byte pixels (B, G, R, A) -> 3-byte pixels (B, G, R), the arrays must not overlap.
+ * One byte shuffle per 4 pixels (SSSE3), or per 8 pixels with a 32-bit permute joining the lanes (AVX2).
+ 
+ (7.3) bool IsGray_Simd (const unsigned char* array, long pixel_count, int pixel_byte);
+ * Whether B == G == R in every pixel, pixel_byte: 3 (B, G, R) or 4 (B, G, R, A).
+ * The array is compared with itself moved by one byte (B with G, G with R), so one compare
+ * covers 10 (AVX2) or 5 (SSE2) 3-byte pixels, 8 or 4 4-byte pixels, and it stops at the first colorful block.
+ 
+ (7.4) void Deinterleave_Simd (const unsigned char* bgr_array, unsigned char* blue, unsigned char* green, unsigned char* red, long pixel_count);
+     void Interleave_Simd (const unsigned char* blue, const unsigned char* green, const unsigned char* red, unsigned char* bgr_array, long pixel_count);
+ * 3-byte pixels (B, G, R) <-> three planes of 1 byte per pixel (see BitMapImg <SetPlanar>), the arrays must not overlap.
+ * The same byte shuffles as (4), 48 bytes <-> 3 x 16 (SSSE3) or 96 bytes <-> 3 x 32 (AVX2) per step.
+ 
+ (7.5) void PlanarToGray_Simd (const unsigned char* blue, const unsigned char* green, const unsigned char* red, unsigned char* gray_array, long pixel_count);
+ * (4) for planar pixels: no shuffles, straight loads of every plane. gray_array may be blue.
+ 
+ (7.6) void Bitfields_Simd (const unsigned char* org_array, unsigned char* bgr_array, long pixel_count, int org_pixel_byte,
+                            const BitFieldTable* fields);
+ * 16-bit (org_pixel_byte 2) or 32-bit (4) pixels of BI_BITFIELDS -> 3-byte pixels (B, G, R), see BitMapImg <Bitfields_Table>.
+ * 16-bit: every channel is moved to the top of the word by a multiply, masked, and widened to 8 bits by a multiply-high,
+ * so no shift by a register count (slow, it takes the shuffle port) is left in the loop;
+ * 32-bit: shifted down, masked, widened by a 16-bit multiply and a shift (AVX2: per-lane shifts, one micro-op each).
+ * The B, G, R, 0 words are packed by the byte shuffle of (7.2):
+ * 16 (AVX2) or 8 (SSSE3) 16-bit pixels, 8 or 4 32-bit pixels per step. The scalar one looks the channels up in expand.
+ 
+ (7.7) void PackBits_Simd (const unsigned char* array, unsigned char* bits, long pixel_count, int threshold);
+ * 1 bit per pixel (see BitMapImg <SetPacked>): bit 7 - i % 8 of bits[i / 8] is array[i] >= threshold,
+ * the unused low bits of the last byte are 0. (3) and the packing in one pass, the 0 / 255 bytes are never stored.
+ * The compare of (3), a byte shuffle reversing every 8 bytes (pixel 0 goes to the top bit), and one movemask:
+ * 32 (AVX2) or 16 (SSSE3) pixels -> 4 or 2 bytes per step.
+ 
+ (7.8) void UnpackBits_Simd (const unsigned char* bits, unsigned char* array, long pixel_count);
+ * The other way: array[i] = 255 if that bit is 1, else 0.
+ * A byte shuffle copies every byte of bits to 8 bytes, each keeps its own bit (and) and is widened by a compare.
+ 
+ (8) ...._Scalar (...);
+ * One byte (pixel) per step, used without SIMD and for the tail of the arrays.
+ * With debug_simd defined, (2)~(7.8) check their results against these and report mismatches.
+ * tests/test_simd.cpp compares (2)~(4) and (7.5) with them at every SIMD level the CPU has.
+ *****************************************************************************/
+
+#include <cstdio>
+#include <cstring>
+#include "struct_bmpFileStructure.h"
+
+//#define debug_simd
+
+#define SIMD_NONE   0
+#define SIMD_SSSE3  1
+#define SIMD_AVX2   2
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    #define simd_x86_available
+    #include <immintrin.h>
+#endif
+
+int GetSimdLevel (void);    //basic_simd.cpp
+void SetSimdLevel (int simd_level); //basic_simd.cpp
+void Reverse_Scalar (unsigned char* array, long array_length);  //basic_simd.cpp
+void Binary_Scalar (unsigned char* array, long array_length, int threshold);    //basic_simd.cpp
+void ColorToGray_Scalar (const unsigned char* bgr_array, unsigned char* gray_array, long pixel_count);   //basic_simd.cpp
+void ApplyLut_Scalar (unsigned char* array, long array_length, const unsigned char* lut);   //basic_simd.cpp
+void VerticalSum_Scalar (const short* const* rows, const short* weights, int taps, long length, unsigned char* result, int shift);  //basic_simd.cpp
+void Transpose16_Scalar (const unsigned char* source, long source_stride, unsigned char* target, long target_stride);   //basic_simd.cpp
+void Transpose8_BGR_Scalar (const unsigned char* source, long source_stride, unsigned char* target, long target_stride); //basic_simd.cpp
+void DropAlpha_Scalar (const unsigned char* bgra_array, unsigned char* bgr_array, long pixel_count);  //basic_simd.cpp
+bool IsGray_Scalar (const unsigned char* array, long pixel_count, int pixel_byte);  //basic_simd.cpp
+void Deinterleave_Scalar (const unsigned char* bgr_array, unsigned char* blue, unsigned char* green, unsigned char* red, long pixel_count);   //basic_simd.cpp
+void Interleave_Scalar (const unsigned char* blue, const unsigned char* green, const unsigned char* red, unsigned char* bgr_array, long pixel_count);   //basic_simd.cpp
+void PlanarToGray_Scalar (const unsigned char* blue, const unsigned char* green, const unsigned char* red, unsigned char* gray_array, long pixel_count);    //basic_simd.cpp
+void Bitfields_Scalar (const unsigned char* org_array, unsigned char* bgr_array, long pixel_count, int org_pixel_byte,
+                       const BitFieldTable* fields);    //basic_simd.cpp
+void PackBits_Scalar (const unsigned char* array, unsigned char* bits, long pixel_count, int threshold);    //basic_simd.cpp
+void UnpackBits_Scalar (const unsigned char* bits, unsigned char* array, long pixel_count);  //basic_simd.cpp
+
+static int cpu_simd_level = -1;    //what the CPU has, -1: not checked yet
+static int simd_level_limit = SIMD_AVX2;    //see <SetSimdLevel>
+
+int GetSimdLevel (void) {
+    if (cpu_simd_level < 0) {
+#ifdef simd_x86_available
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            cpu_simd_level = SIMD_AVX2;
+        else if (__builtin_cpu_supports("ssse3"))
+            cpu_simd_level = SIMD_SSSE3;
+        else
+            cpu_simd_level = SIMD_NONE;
+#else
+        cpu_simd_level = SIMD_NONE;
+#endif
+    }
+    return cpu_simd_level < simd_level_limit ? cpu_simd_level : simd_level_limit;
+}
+
+void SetSimdLevel (int simd_level) {
+    simd_level_limit = simd_level;
+}
+
+void Reverse_Scalar (unsigned char* array, long array_length) {
+    for (long i = 0; i < array_length; i++) {
+        array[i] = 255 - array[i];
+    }
+}
+
+void Binary_Scalar (unsigned char* array, long array_length, int threshold) {
+    for (long i = 0; i < array_length; i++) {
+        if (array[i] < threshold)
+            array[i] = 0;
+        else
+            array[i] = 255;
+    }
+}
+
+void ColorToGray_Scalar (const unsigned char* bgr_array, unsigned char* gray_array, long pixel_count) {
+    for (long i = 0; i < pixel_count; i++) {
+        gray_array[i] = 0.3 * bgr_array[i * 3] + 0.59 * bgr_array[i * 3 + 1] + 0.11 * bgr_array[i * 3 + 2];
+    }
+}
+
+void ApplyLut_Scalar (unsigned char* array, long array_length, const unsigned char* lut) {
+    for (long i = 0; i < array_length; i++) {
+        array[i] = lut[array[i]];
+    }
+}
+
+void VerticalSum_Scalar (const short* const* rows, const short* weights, int taps, long length, unsigned char* result, int shift) {
+    int sum;
+    
+    for (long i = 0; i < length; i++) {
+        sum = 1 << (shift - 1);
+        for (int t = 0; t < taps; t++) {
+            sum += rows[t][i] * weights[t];
+        }
+        sum >>= shift;
+        result[i] = (unsigned char)(sum > 255 ? 255 : (sum < 0 ? 0 : sum));
+    }
+}
+
+void Transpose16_Scalar (const unsigned char* source, long source_stride, unsigned char* target, long target_stride) {
+    for (int i = 0; i < 16; i++) {
+        for (int j = 0; j < 16; j++) {
+            target[i * target_stride + j] = source[j * source_stride + i];
+        }
+    }
+}
+
+void Transpose8_BGR_Scalar (const unsigned char* source, long source_stride, unsigned char* target, long target_stride) {
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++) {
+            target[i * target_stride + j * 3] = source[j * source_stride + i * 3];
+            target[i * target_stride + j * 3 + 1] = source[j * source_stride + i * 3 + 1];
+            target[i * target_stride + j * 3 + 2] = source[j * source_stride + i * 3 + 2];
+        }
+    }
+}
+
+void DropAlpha_Scalar (const unsigned char* bgra_array, unsigned char* bgr_array, long pixel_count) {
+    for (long i = 0; i < pixel_count; i++) {
+        bgr_array[i * 3] = bgra_array[i * 4];
+        bgr_array[i * 3 + 1] = bgra_array[i * 4 + 1];
+        bgr_array[i * 3 + 2] = bgra_array[i * 4 + 2];
+    }
+}
+
+bool IsGray_Scalar (const unsigned char* array, long pixel_count, int pixel_byte) {
+    for (long i = 0; i < pixel_count * pixel_byte; i += pixel_byte) {
+        if (array[i] != array[i + 1] || array[i] != array[i + 2])
+            return false;
+    }
+    return true;
+}
+
+void Deinterleave_Scalar (const unsigned char* bgr_array, unsigned char* blue, unsigned char* green, unsigned char* red, long pixel_count) {
+    for (long i = 0; i < pixel_count; i++) {
+        blue[i] = bgr_array[i * 3];
+        green[i] = bgr_array[i * 3 + 1];
+        red[i] = bgr_array[i * 3 + 2];
+    }
+}
+
+void Interleave_Scalar (const unsigned char* blue, const unsigned char* green, const unsigned char* red, unsigned char* bgr_array, long pixel_count) {
+    for (long i = 0; i < pixel_count; i++) {
+        bgr_array[i * 3] = blue[i];
+        bgr_array[i * 3 + 1] = green[i];
+        bgr_array[i * 3 + 2] = red[i];
+    }
+}
+
+void PlanarToGray_Scalar (const unsigned char* blue, const unsigned char* green, const unsigned char* red, unsigned char* gray_array, long pixel_count) {
+    for (long i = 0; i < pixel_count; i++) {
+        gray_array[i] = 0.3 * blue[i] + 0.59 * green[i] + 0.11 * red[i];
+    }
+}
+
+void Bitfields_Scalar (const unsigned char* org_array, unsigned char* bgr_array, long pixel_count, int org_pixel_byte,
+                       const BitFieldTable* fields) {
+    u_word4 pixel;
+    
+    for (long i = 0; i < pixel_count; i++) {
+        if (2 == org_pixel_byte)
+            pixel = org_array[i * 2] | (u_word4)org_array[i * 2 + 1] << 8;
+        else
+            pixel = org_array[i * 4] | (u_word4)org_array[i * 4 + 1] << 8 | (u_word4)org_array[i * 4 + 2] << 16 | (u_word4)org_array[i * 4 + 3] << 24;
+        for (int c = 0; c < 3; c++)
+            bgr_array[i * 3 + c] = fields->expand[c][(pixel >> fields->shift[c]) & fields->mask[c]];
+    }
+}
+
+void PackBits_Scalar (const unsigned char* array, unsigned char* bits, long pixel_count, int threshold) {
+    unsigned char byte;
+    
+    for (long i = 0; i < pixel_count; i += 8) {
+        byte = 0;
+        for (int k = 0; k < 8 && i + k < pixel_count; k++) {
+            if (array[i + k] >= threshold)
+                byte |= 0x80 >> k;
+        }
+        bits[i / 8] = byte;
+    }
+}
+
+void UnpackBits_Scalar (const unsigned char* bits, unsigned char* array, long pixel_count) {
+    for (long i = 0; i < pixel_count; i++) {
+        array[i] = ((bits[i / 8] << (i % 8)) & 0x80) ? 255 : 0;
+    }
+}
+
+#ifdef simd_x86_available
+
+//every kernel returns how many bytes (pixels) it has done, the rest is left to the scalar one.
+
+__attribute__((target("ssse3")))
+static long Reverse_SSSE3 (unsigned char* array, long array_length) {
+    const __m128i all_one = _mm_set1_epi8((char)0xFF);
+    long i;
+    
+    for (i = 0; i + 16 <= array_length; i += 16) {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(array + i));
+        _mm_storeu_si128((__m128i*)(array + i), _mm_xor_si128(pixels, all_one));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static long Reverse_AVX2 (unsigned char* array, long array_length) {
+    const __m256i all_one = _mm256_set1_epi8((char)0xFF);
+    long i;
+    
+    for (i = 0; i + 32 <= array_length; i += 32) {
+        __m256i pixels = _mm256_loadu_si256((const __m256i*)(array + i));
+        _mm256_storeu_si256((__m256i*)(array + i), _mm256_xor_si256(pixels, all_one));
+    }
+    return i;
+}
+
+//threshold: 1 ~ 255 here. x >= threshold <=> max(x, threshold) == x.
+__attribute__((target("ssse3")))
+static long Binary_SSSE3 (unsigned char* array, long array_length, int threshold) {
+    const __m128i limit = _mm_set1_epi8((char)threshold);
+    long i;
+    
+    for (i = 0; i + 16 <= array_length; i += 16) {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(array + i));
+        _mm_storeu_si128((__m128i*)(array + i), _mm_cmpeq_epi8(_mm_max_epu8(pixels, limit), pixels));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static long Binary_AVX2 (unsigned char* array, long array_length, int threshold) {
+    const __m256i limit = _mm256_set1_epi8((char)threshold);
+    long i;
+    
+    for (i = 0; i + 32 <= array_length; i += 32) {
+        __m256i pixels = _mm256_loadu_si256((const __m256i*)(array + i));
+        _mm256_storeu_si256((__m256i*)(array + i), _mm256_cmpeq_epi8(_mm256_max_epu8(pixels, limit), pixels));
+    }
+    return i;
+}
+
+/* shuffle masks: 16 pixels are in 3 blocks of 16 bytes (a0, a1, a2),
+ B of pixel n is byte 3n, G is 3n + 1, R is 3n + 2; -1 (0x80) gives 0. */
+#define SHUFFLE_MASKS \
+    const char mask_b0[16] = { 0, 3, 6, 9,12,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1}; \
+    const char mask_b1[16] = {-1,-1,-1,-1,-1,-1, 2, 5, 8,11,14,-1,-1,-1,-1,-1}; \
+    const char mask_b2[16] = {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 1, 4, 7,10,13}; \
+    const char mask_g0[16] = { 1, 4, 7,10,13,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1}; \
+    const char mask_g1[16] = {-1,-1,-1,-1,-1, 0, 3, 6, 9,12,15,-1,-1,-1,-1,-1}; \
+    const char mask_g2[16] = {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 2, 5, 8,11,14}; \
+    const char mask_r0[16] = { 2, 5, 8,11,14,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1}; \
+    const char mask_r1[16] = {-1,-1,-1,-1,-1, 1, 4, 7,10,13,-1,-1,-1,-1,-1,-1}; \
+    const char mask_r2[16] = {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 0, 3, 6, 9,12,15};
+
+//the reverse: output byte 16k + j is byte (16k + j) / 3 of plane (16k + j) % 3.
+#define INTERLEAVE_MASKS \
+    const char mask_ib0[16] = { 0,-1,-1, 1,-1,-1, 2,-1,-1, 3,-1,-1, 4,-1,-1, 5}; \
+    const char mask_ib1[16] = {-1,-1, 6,-1,-1, 7,-1,-1, 8,-1,-1, 9,-1,-1,10,-1}; \
+    const char mask_ib2[16] = {-1,11,-1,-1,12,-1,-1,13,-1,-1,14,-1,-1,15,-1,-1}; \
+    const char mask_ig0[16] = {-1, 0,-1,-1, 1,-1,-1, 2,-1,-1, 3,-1,-1, 4,-1,-1}; \
+    const char mask_ig1[16] = { 5,-1,-1, 6,-1,-1, 7,-1,-1, 8,-1,-1, 9,-1,-1,10}; \
+    const char mask_ig2[16] = {-1,-1,11,-1,-1,12,-1,-1,13,-1,-1,14,-1,-1,15,-1}; \
+    const char mask_ir0[16] = {-1,-1, 0,-1,-1, 1,-1,-1, 2,-1,-1, 3,-1,-1, 4,-1}; \
+    const char mask_ir1[16] = {-1, 5,-1,-1, 6,-1,-1, 7,-1,-1, 8,-1,-1, 9,-1,-1}; \
+    const char mask_ir2[16] = {10,-1,-1,11,-1,-1,12,-1,-1,13,-1,-1,14,-1,-1,15};
+
+//gray of 16 pixels from their B, G, R bytes (see (4)),
+//exact: not 0 if a sum is a multiple of 100 (not 0), then leave the block to the double formula.
+__attribute__((target("ssse3")))
+static inline __m128i WeightGray_SSSE3 (__m128i blue, __m128i green, __m128i red, int &exact) {
+    const __m128i weight_b = _mm_set1_epi16(30), weight_g = _mm_set1_epi16(59), weight_r = _mm_set1_epi16(11);
+    const __m128i divide_100 = _mm_set1_epi16((short)41944), hundred = _mm_set1_epi16(100);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum_low, sum_high, gray_low, gray_high;
+    
+    sum_low = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(blue, zero), weight_b),
+                                          _mm_mullo_epi16(_mm_unpacklo_epi8(green, zero), weight_g)),
+                            _mm_mullo_epi16(_mm_unpacklo_epi8(red, zero), weight_r));
+    sum_high = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(blue, zero), weight_b),
+                                           _mm_mullo_epi16(_mm_unpackhi_epi8(green, zero), weight_g)),
+                             _mm_mullo_epi16(_mm_unpackhi_epi8(red, zero), weight_r));
+    gray_low = _mm_srli_epi16(_mm_mulhi_epu16(sum_low, divide_100), 6);
+    gray_high = _mm_srli_epi16(_mm_mulhi_epu16(sum_high, divide_100), 6);
+    exact = _mm_movemask_epi8(_mm_or_si128(_mm_andnot_si128(_mm_cmpeq_epi16(sum_low, zero), _mm_cmpeq_epi16(_mm_mullo_epi16(gray_low, hundred), sum_low)),
+                                           _mm_andnot_si128(_mm_cmpeq_epi16(sum_high, zero), _mm_cmpeq_epi16(_mm_mullo_epi16(gray_high, hundred), sum_high))));
+    return _mm_packus_epi16(gray_low, gray_high);
+}
+
+//the same for 32 pixels.
+__attribute__((target("avx2")))
+static inline __m256i WeightGray_AVX2 (__m256i blue, __m256i green, __m256i red, int &exact) {
+    const __m256i weight_b = _mm256_set1_epi16(30), weight_g = _mm256_set1_epi16(59), weight_r = _mm256_set1_epi16(11);
+    const __m256i divide_100 = _mm256_set1_epi16((short)41944), hundred = _mm256_set1_epi16(100);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i sum_low, sum_high, gray_low, gray_high;
+    
+    sum_low = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(blue, zero), weight_b),
+                                                _mm256_mullo_epi16(_mm256_unpacklo_epi8(green, zero), weight_g)),
+                               _mm256_mullo_epi16(_mm256_unpacklo_epi8(red, zero), weight_r));
+    sum_high = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(blue, zero), weight_b),
+                                                 _mm256_mullo_epi16(_mm256_unpackhi_epi8(green, zero), weight_g)),
+                                _mm256_mullo_epi16(_mm256_unpackhi_epi8(red, zero), weight_r));
+    gray_low = _mm256_srli_epi16(_mm256_mulhi_epu16(sum_low, divide_100), 6);
+    gray_high = _mm256_srli_epi16(_mm256_mulhi_epu16(sum_high, divide_100), 6);
+    exact = _mm256_movemask_epi8(_mm256_or_si256(_mm256_andnot_si256(_mm256_cmpeq_epi16(sum_low, zero), _mm256_cmpeq_epi16(_mm256_mullo_epi16(gray_low, hundred), sum_low)),
+                                                 _mm256_andnot_si256(_mm256_cmpeq_epi16(sum_high, zero), _mm256_cmpeq_epi16(_mm256_mullo_epi16(gray_high, hundred), sum_high))));
+    return _mm256_packus_epi16(gray_low, gray_high);
+}
+
+__attribute__((target("ssse3")))
+static long ColorToGray_SSSE3 (const unsigned char* bgr_array, unsigned char* gray_array, long pixel_count) {
+    SHUFFLE_MASKS
+    const __m128i b0 = _mm_loadu_si128((const __m128i*)mask_b0), b1 = _mm_loadu_si128((const __m128i*)mask_b1), b2 = _mm_loadu_si128((const __m128i*)mask_b2);
+    const __m128i g0 = _mm_loadu_si128((const __m128i*)mask_g0), g1 = _mm_loadu_si128((const __m128i*)mask_g1), g2 = _mm_loadu_si128((const __m128i*)mask_g2);
+    const __m128i r0 = _mm_loadu_si128((const __m128i*)mask_r0), r1 = _mm_loadu_si128((const __m128i*)mask_r1), r2 = _mm_loadu_si128((const __m128i*)mask_r2);
+    long i;
+    int exact;
+    
+    for (i = 0; i + 16 <= pixel_count; i += 16) {
+        //all 48 bytes are loaded before the store, so gray_array may be bgr_array.
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(bgr_array + i * 3));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(bgr_array + i * 3 + 16));
+        __m128i a2 = _mm_loadu_si128((const __m128i*)(bgr_array + i * 3 + 32));
+        __m128i blue = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, b0), _mm_shuffle_epi8(a1, b1)), _mm_shuffle_epi8(a2, b2));
+        __m128i green = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, g0), _mm_shuffle_epi8(a1, g1)), _mm_shuffle_epi8(a2, g2));
+        __m128i red = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, r0), _mm_shuffle_epi8(a1, r1)), _mm_shuffle_epi8(a2, r2));
+        __m128i gray = WeightGray_SSSE3(blue, green, red, exact);
+        
+        if (exact)
+            ColorToGray_Scalar(bgr_array + i * 3, gray_array + i, 16);
+        else
+            _mm_storeu_si128((__m128i*)(gray_array + i), gray);
+    }
+    return i;
+}
+
+//the same as SSSE3, pixel 0~15 in the low 128-bit lane, pixel 16~31 in the high one.
+__attribute__((target("avx2")))
+static long ColorToGray_AVX2 (const unsigned char* bgr_array, unsigned char* gray_array, long pixel_count) {
+    SHUFFLE_MASKS
+    const __m256i b0 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_b0));
+    const __m256i b1 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_b1));
+    const __m256i b2 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_b2));
+    const __m256i g0 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_g0));
+    const __m256i g1 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_g1));
+    const __m256i g2 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_g2));
+    const __m256i r0 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_r0));
+    const __m256i r1 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_r1));
+    const __m256i r2 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_r2));
+    const unsigned char* source;
+    long i;
+    int exact;
+    
+    for (i = 0; i + 32 <= pixel_count; i += 32) {
+        source = bgr_array + i * 3;
+        __m256i a0 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)source)),
+                                             _mm_loadu_si128((const __m128i*)(source + 48)), 1);
+        __m256i a1 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(source + 16))),
+                                             _mm_loadu_si128((const __m128i*)(source + 64)), 1);
+        __m256i a2 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(source + 32))),
+                                             _mm_loadu_si128((const __m128i*)(source + 80)), 1);
+        __m256i blue = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(a0, b0), _mm256_shuffle_epi8(a1, b1)), _mm256_shuffle_epi8(a2, b2));
+        __m256i green = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(a0, g0), _mm256_shuffle_epi8(a1, g1)), _mm256_shuffle_epi8(a2, g2));
+        __m256i red = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(a0, r0), _mm256_shuffle_epi8(a1, r1)), _mm256_shuffle_epi8(a2, r2));
+        __m256i gray = WeightGray_AVX2(blue, green, red, exact);
+        
+        if (exact)
+            ColorToGray_Scalar(bgr_array + i * 3, gray_array + i, 32);
+        else
+            _mm256_storeu_si256((__m256i*)(gray_array + i), gray);
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+static long Deinterleave_SSSE3 (const unsigned char* bgr_array, unsigned char* blue, unsigned char* green, unsigned char* red, long pixel_count) {
+    SHUFFLE_MASKS
+    const __m128i b0 = _mm_loadu_si128((const __m128i*)mask_b0), b1 = _mm_loadu_si128((const __m128i*)mask_b1), b2 = _mm_loadu_si128((const __m128i*)mask_b2);
+    const __m128i g0 = _mm_loadu_si128((const __m128i*)mask_g0), g1 = _mm_loadu_si128((const __m128i*)mask_g1), g2 = _mm_loadu_si128((const __m128i*)mask_g2);
+    const __m128i r0 = _mm_loadu_si128((const __m128i*)mask_r0), r1 = _mm_loadu_si128((const __m128i*)mask_r1), r2 = _mm_loadu_si128((const __m128i*)mask_r2);
+    long i;
+    
+    for (i = 0; i + 16 <= pixel_count; i += 16) {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(bgr_array + i * 3));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(bgr_array + i * 3 + 16));
+        __m128i a2 = _mm_loadu_si128((const __m128i*)(bgr_array + i * 3 + 32));
+        _mm_storeu_si128((__m128i*)(blue + i), _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, b0), _mm_shuffle_epi8(a1, b1)), _mm_shuffle_epi8(a2, b2)));
+        _mm_storeu_si128((__m128i*)(green + i), _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, g0), _mm_shuffle_epi8(a1, g1)), _mm_shuffle_epi8(a2, g2)));
+        _mm_storeu_si128((__m128i*)(red + i), _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, r0), _mm_shuffle_epi8(a1, r1)), _mm_shuffle_epi8(a2, r2)));
+    }
+    return i;
+}
+
+//the loads of ColorToGray_AVX2.
+__attribute__((target("avx2")))
+static long Deinterleave_AVX2 (const unsigned char* bgr_array, unsigned char* blue, unsigned char* green, unsigned char* red, long pixel_count) {
+    SHUFFLE_MASKS
+    const __m256i b0 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_b0));
+    const __m256i b1 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_b1));
+    const __m256i b2 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_b2));
+    const __m256i g0 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_g0));
+    const __m256i g1 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_g1));
+    const __m256i g2 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_g2));
+    const __m256i r0 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_r0));
+    const __m256i r1 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_r1));
+    const __m256i r2 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_r2));
+    const unsigned char* source;
+    long i;
+    
+    for (i = 0; i + 32 <= pixel_count; i += 32) {
+        source = bgr_array + i * 3;
+        __m256i a0 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)source)),
+                                             _mm_loadu_si128((const __m128i*)(source + 48)), 1);
+        __m256i a1 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(source + 16))),
+                                             _mm_loadu_si128((const __m128i*)(source + 64)), 1);
+        __m256i a2 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(source + 32))),
+                                             _mm_loadu_si128((const __m128i*)(source + 80)), 1);
+        _mm256_storeu_si256((__m256i*)(blue + i), _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(a0, b0), _mm256_shuffle_epi8(a1, b1)), _mm256_shuffle_epi8(a2, b2)));
+        _mm256_storeu_si256((__m256i*)(green + i), _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(a0, g0), _mm256_shuffle_epi8(a1, g1)), _mm256_shuffle_epi8(a2, g2)));
+        _mm256_storeu_si256((__m256i*)(red + i), _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(a0, r0), _mm256_shuffle_epi8(a1, r1)), _mm256_shuffle_epi8(a2, r2)));
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+static long Interleave_SSSE3 (const unsigned char* blue, const unsigned char* green, const unsigned char* red, unsigned char* bgr_array, long pixel_count) {
+    INTERLEAVE_MASKS
+    const __m128i b0 = _mm_loadu_si128((const __m128i*)mask_ib0), b1 = _mm_loadu_si128((const __m128i*)mask_ib1), b2 = _mm_loadu_si128((const __m128i*)mask_ib2);
+    const __m128i g0 = _mm_loadu_si128((const __m128i*)mask_ig0), g1 = _mm_loadu_si128((const __m128i*)mask_ig1), g2 = _mm_loadu_si128((const __m128i*)mask_ig2);
+    const __m128i r0 = _mm_loadu_si128((const __m128i*)mask_ir0), r1 = _mm_loadu_si128((const __m128i*)mask_ir1), r2 = _mm_loadu_si128((const __m128i*)mask_ir2);
+    long i;
+    
+    for (i = 0; i + 16 <= pixel_count; i += 16) {
+        __m128i b = _mm_loadu_si128((const __m128i*)(blue + i));
+        __m128i g = _mm_loadu_si128((const __m128i*)(green + i));
+        __m128i r = _mm_loadu_si128((const __m128i*)(red + i));
+        _mm_storeu_si128((__m128i*)(bgr_array + i * 3), _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(b, b0), _mm_shuffle_epi8(g, g0)), _mm_shuffle_epi8(r, r0)));
+        _mm_storeu_si128((__m128i*)(bgr_array + i * 3 + 16), _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(b, b1), _mm_shuffle_epi8(g, g1)), _mm_shuffle_epi8(r, r1)));
+        _mm_storeu_si128((__m128i*)(bgr_array + i * 3 + 32), _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(b, b2), _mm_shuffle_epi8(g, g2)), _mm_shuffle_epi8(r, r2)));
+    }
+    return i;
+}
+
+//pixel 0~15 in the low lanes give bytes 0~47, pixel 16~31 in the high lanes bytes 48~95,
+//the six 16-byte blocks are put in order by 128-bit permutes.
+__attribute__((target("avx2")))
+static long Interleave_AVX2 (const unsigned char* blue, const unsigned char* green, const unsigned char* red, unsigned char* bgr_array, long pixel_count) {
+    INTERLEAVE_MASKS
+    const __m256i b0 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_ib0));
+    const __m256i b1 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_ib1));
+    const __m256i b2 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_ib2));
+    const __m256i g0 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_ig0));
+    const __m256i g1 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_ig1));
+    const __m256i g2 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_ig2));
+    const __m256i r0 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_ir0));
+    const __m256i r1 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_ir1));
+    const __m256i r2 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_ir2));
+    unsigned char* target;
+    long i;
+    
+    for (i = 0; i + 32 <= pixel_count; i += 32) {
+        __m256i b = _mm256_loadu_si256((const __m256i*)(blue + i));
+        __m256i g = _mm256_loadu_si256((const __m256i*)(green + i));
+        __m256i r = _mm256_loadu_si256((const __m256i*)(red + i));
+        __m256i v0 = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(b, b0), _mm256_shuffle_epi8(g, g0)), _mm256_shuffle_epi8(r, r0));
+        __m256i v1 = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(b, b1), _mm256_shuffle_epi8(g, g1)), _mm256_shuffle_epi8(r, r1));
+        __m256i v2 = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(b, b2), _mm256_shuffle_epi8(g, g2)), _mm256_shuffle_epi8(r, r2));
+        target = bgr_array + i * 3;
+        _mm256_storeu_si256((__m256i*)target, _mm256_permute2x128_si256(v0, v1, 0x20));
+        _mm256_storeu_si256((__m256i*)(target + 32), _mm256_permute2x128_si256(v2, v0, 0x30));
+        _mm256_storeu_si256((__m256i*)(target + 64), _mm256_permute2x128_si256(v1, v2, 0x31));
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+static long PlanarToGray_SSSE3 (const unsigned char* blue, const unsigned char* green, const unsigned char* red, unsigned char* gray_array, long pixel_count) {
+    long i;
+    int exact;
+    
+    for (i = 0; i + 16 <= pixel_count; i += 16) {
+        __m128i gray = WeightGray_SSSE3(_mm_loadu_si128((const __m128i*)(blue + i)), _mm_loadu_si128((const __m128i*)(green + i)),
+                                        _mm_loadu_si128((const __m128i*)(red + i)), exact);
+        
+        if (exact)
+            PlanarToGray_Scalar(blue + i, green + i, red + i, gray_array + i, 16);
+        else
+            _mm_storeu_si128((__m128i*)(gray_array + i), gray);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static long PlanarToGray_AVX2 (const unsigned char* blue, const unsigned char* green, const unsigned char* red, unsigned char* gray_array, long pixel_count) {
+    long i;
+    int exact;
+    
+    for (i = 0; i + 32 <= pixel_count; i += 32) {
+        __m256i gray = WeightGray_AVX2(_mm256_loadu_si256((const __m256i*)(blue + i)), _mm256_loadu_si256((const __m256i*)(green + i)),
+                                       _mm256_loadu_si256((const __m256i*)(red + i)), exact);
+        
+        if (exact)
+            PlanarToGray_Scalar(blue + i, green + i, red + i, gray_array + i, 32);
+        else
+            _mm256_storeu_si256((__m256i*)(gray_array + i), gray);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static long ApplyLut_AVX2 (unsigned char* array, long array_length, const unsigned char* lut) {
+    const __m256i low_4bit = _mm256_set1_epi8(0x0F);
+    __m256i lut_row[16];
+    long i;
+    
+    for (int k = 0; k < 16; k++) {
+        lut_row[k] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(lut + k * 16)));
+    }
+    
+    for (i = 0; i + 32 <= array_length; i += 32) {
+        __m256i pixels = _mm256_loadu_si256((const __m256i*)(array + i));
+        __m256i low = _mm256_and_si256(pixels, low_4bit);
+        __m256i high = _mm256_and_si256(_mm256_srli_epi16(pixels, 4), low_4bit);
+        __m256i result = _mm256_setzero_si256();
+        
+        for (int k = 0; k < 16; k++) {
+            result = _mm256_or_si256(result, _mm256_and_si256(_mm256_shuffle_epi8(lut_row[k], low),
+                                                              _mm256_cmpeq_epi8(high, _mm256_set1_epi8((char)k))));
+        }
+        _mm256_storeu_si256((__m256i*)(array + i), result);
+    }
+    return i;
+}
+
+//weights of row t and t + 1 in every 32-bit lane, for pmaddwd.
+#define WEIGHT_PAIR(weights, t) \
+    ((int)(((unsigned int)(unsigned short)(weights)[(t) + 1] << 16) | (unsigned short)(weights)[t]))
+
+__attribute__((target("sse2")))
+static long VerticalSum_SSE2 (const short* const* rows, const short* weights, int taps, long length, unsigned char* result, int shift) {
+    const __m128i round = _mm_set1_epi32(1 << (shift - 1));
+    const __m128i shift_count = _mm_cvtsi32_si128(shift);
+    long i;
+    
+    for (i = 0; i + 8 <= length; i += 8) {
+        __m128i sum_low = round, sum_high = round;
+        
+        for (int t = 0; t < taps; t += 2) {
+            __m128i row0 = _mm_loadu_si128((const __m128i*)(rows[t] + i));
+            __m128i row1 = _mm_loadu_si128((const __m128i*)(rows[t + 1] + i));
+            __m128i weight = _mm_set1_epi32(WEIGHT_PAIR(weights, t));
+            sum_low = _mm_add_epi32(sum_low, _mm_madd_epi16(_mm_unpacklo_epi16(row0, row1), weight));
+            sum_high = _mm_add_epi32(sum_high, _mm_madd_epi16(_mm_unpackhi_epi16(row0, row1), weight));
+        }
+        sum_low = _mm_packs_epi32(_mm_sra_epi32(sum_low, shift_count), _mm_sra_epi32(sum_high, shift_count));
+        _mm_storel_epi64((__m128i*)(result + i), _mm_packus_epi16(sum_low, sum_low));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static long VerticalSum_AVX2 (const short* const* rows, const short* weights, int taps, long length, unsigned char* result, int shift) {
+    const __m256i round = _mm256_set1_epi32(1 << (shift - 1));
+    const __m128i shift_count = _mm_cvtsi32_si128(shift);
+    long i;
+    
+    for (i = 0; i + 16 <= length; i += 16) {
+        __m256i sum_low = round, sum_high = round;
+        
+        for (int t = 0; t < taps; t += 2) {
+            __m256i row0 = _mm256_loadu_si256((const __m256i*)(rows[t] + i));
+            __m256i row1 = _mm256_loadu_si256((const __m256i*)(rows[t + 1] + i));
+            __m256i weight = _mm256_set1_epi32(WEIGHT_PAIR(weights, t));
+            sum_low = _mm256_add_epi32(sum_low, _mm256_madd_epi16(_mm256_unpacklo_epi16(row0, row1), weight));
+            sum_high = _mm256_add_epi32(sum_high, _mm256_madd_epi16(_mm256_unpackhi_epi16(row0, row1), weight));
+        }
+        //unpack and pack stay inside the 128-bit lanes, so the order comes back; then take qwords 0 and 2.
+        sum_low = _mm256_packs_epi32(_mm256_sra_epi32(sum_low, shift_count), _mm256_sra_epi32(sum_high, shift_count));
+        sum_low = _mm256_permute4x64_epi64(_mm256_packus_epi16(sum_low, sum_low), 0x08);
+        _mm_storeu_si128((__m128i*)(result + i), _mm256_castsi256_si128(sum_low));
+    }
+    return i;
+}
+
+/* after round k, every register holds 2^k bytes of 16 / 2^k columns:
+ 8 bits:  rows (2k, 2k + 1) x columns 0~7 / 8~15
+ 16 bits: rows 4m ~ 4m + 3 x columns 4q ~ 4q + 3
+ 32 bits: rows 8n ~ 8n + 7 x columns 4q + 2h, 4q + 2h + 1
+ 64 bits: rows 0 ~ 15 of one column, which is a row of target. */
+__attribute__((target("sse2")))
+static void Transpose16_SSE2 (const unsigned char* source, long source_stride, unsigned char* target, long target_stride) {
+    __m128i row[16], bit8[16], bit16[16], bit32[16];
+    int k, m, n, q, h;
+    
+    for (k = 0; k < 16; k++) {
+        row[k] = _mm_loadu_si128((const __m128i*)(source + k * source_stride));
+    }
+    for (k = 0; k < 8; k++) {
+        bit8[k] = _mm_unpacklo_epi8(row[2 * k], row[2 * k + 1]);
+        bit8[k + 8] = _mm_unpackhi_epi8(row[2 * k], row[2 * k + 1]);
+    }
+    for (h = 0; h < 2; h++) {
+        for (m = 0; m < 4; m++) {
+            bit16[m * 4 + h * 2] = _mm_unpacklo_epi16(bit8[h * 8 + 2 * m], bit8[h * 8 + 2 * m + 1]);
+            bit16[m * 4 + h * 2 + 1] = _mm_unpackhi_epi16(bit8[h * 8 + 2 * m], bit8[h * 8 + 2 * m + 1]);
+        }
+    }
+    for (n = 0; n < 2; n++) {
+        for (q = 0; q < 4; q++) {
+            bit32[n * 8 + q * 2] = _mm_unpacklo_epi32(bit16[(2 * n) * 4 + q], bit16[(2 * n + 1) * 4 + q]);
+            bit32[n * 8 + q * 2 + 1] = _mm_unpackhi_epi32(bit16[(2 * n) * 4 + q], bit16[(2 * n + 1) * 4 + q]);
+        }
+    }
+    for (q = 0; q < 4; q++) {
+        for (h = 0; h < 2; h++) {
+            _mm_storeu_si128((__m128i*)(target + (4 * q + 2 * h) * target_stride),
+                             _mm_unpacklo_epi64(bit32[q * 2 + h], bit32[8 + q * 2 + h]));
+            _mm_storeu_si128((__m128i*)(target + (4 * q + 2 * h + 1) * target_stride),
+                             _mm_unpackhi_epi64(bit32[q * 2 + h], bit32[8 + q * 2 + h]));
+        }
+    }
+}
+
+//4 x 4 transpose of 32-bit values, like _MM_TRANSPOSE4_PS.
+#define TRANSPOSE4_EPI32(r0, r1, r2, r3) { \
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1), t1 = _mm_unpacklo_epi32(r2, r3); \
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1), t3 = _mm_unpackhi_epi32(r2, r3); \
+    r0 = _mm_unpacklo_epi64(t0, t1); r1 = _mm_unpackhi_epi64(t0, t1); \
+    r2 = _mm_unpacklo_epi64(t2, t3); r3 = _mm_unpackhi_epi64(t2, t3); }
+
+__attribute__((target("ssse3")))
+static void Transpose8_BGR_SSSE3 (const unsigned char* source, long source_stride, unsigned char* target, long target_stride) {
+    const __m128i spread = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    __m128i left[8], right[8];  //pixel 0~3, 4~7 of every row
+    __m128i low, high;
+    int k;
+    
+    for (k = 0; k < 8; k++) {
+        low = _mm_loadu_si128((const __m128i*)(source + k * source_stride));
+        high = _mm_loadl_epi64((const __m128i*)(source + k * source_stride + 16));
+        left[k] = _mm_shuffle_epi8(low, spread);
+        right[k] = _mm_shuffle_epi8(_mm_alignr_epi8(high, low, 12), spread);
+    }
+    TRANSPOSE4_EPI32(left[0], left[1], left[2], left[3]);
+    TRANSPOSE4_EPI32(left[4], left[5], left[6], left[7]);
+    TRANSPOSE4_EPI32(right[0], right[1], right[2], right[3]);
+    TRANSPOSE4_EPI32(right[4], right[5], right[6], right[7]);
+    
+    //target row k: source column k, of rows 0~3 (left / right[k % 4]) and rows 4~7 (... [k % 4 + 4]).
+    for (k = 0; k < 8; k++) {
+        low = _mm_shuffle_epi8(k < 4 ? left[k] : right[k - 4], pack);
+        high = _mm_shuffle_epi8(k < 4 ? left[k + 4] : right[k], pack);
+        _mm_storeu_si128((__m128i*)(target + k * target_stride), _mm_or_si128(low, _mm_slli_si128(high, 12)));
+        _mm_storel_epi64((__m128i*)(target + k * target_stride + 16), _mm_srli_si128(high, 4));
+    }
+}
+
+__attribute__((target("ssse3")))
+static long DropAlpha_SSSE3 (const unsigned char* bgra_array, unsigned char* bgr_array, long pixel_count) {
+    const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    long i;
+    
+    //16 bytes are stored for 12, the last 4 are written again by the next step.
+    for (i = 0; i + 4 <= pixel_count && i * 3 + 16 <= pixel_count * 3; i += 4) {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(bgra_array + i * 4));
+        _mm_storeu_si128((__m128i*)(bgr_array + i * 3), _mm_shuffle_epi8(pixels, pack));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static long DropAlpha_AVX2 (const unsigned char* bgra_array, unsigned char* bgr_array, long pixel_count) {
+    const __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                          0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m256i join = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    long i;
+    
+    //32 bytes are stored for 24.
+    for (i = 0; i + 8 <= pixel_count && i * 3 + 32 <= pixel_count * 3; i += 8) {
+        __m256i pixels = _mm256_loadu_si256((const __m256i*)(bgra_array + i * 4));
+        _mm256_storeu_si256((__m256i*)(bgr_array + i * 3), _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(pixels, pack), join));
+    }
+    return i;
+}
+
+//return -1 at the first colorful block, else how many pixels are gray.
+__attribute__((target("sse2")))
+static long IsGray_SSE2 (const unsigned char* array, long pixel_count, int pixel_byte) {
+    long i;
+    
+    if (3 == pixel_byte) {
+        //bytes 3k (B == G) and 3k + 1 (G == R) of 5 pixels, byte 16 is read too.
+        for (i = 0; i * 3 + 17 <= pixel_count * 3; i += 5) {
+            __m128i here = _mm_loadu_si128((const __m128i*)(array + i * 3));
+            __m128i next = _mm_loadu_si128((const __m128i*)(array + i * 3 + 1));
+            if (0x36DB != (_mm_movemask_epi8(_mm_cmpeq_epi8(here, next)) & 0x36DB))
+                return -1;
+        }
+    }
+    else {
+        for (i = 0; i + 4 <= pixel_count; i += 4) {
+            __m128i pixels = _mm_loadu_si128((const __m128i*)(array + i * 4));
+            if (0x3333 != (_mm_movemask_epi8(_mm_cmpeq_epi8(pixels, _mm_srli_epi32(pixels, 8))) & 0x3333))
+                return -1;
+        }
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static long IsGray_AVX2 (const unsigned char* array, long pixel_count, int pixel_byte) {
+    long i;
+    
+    if (3 == pixel_byte) {
+        //10 pixels (30 bytes) per step, byte 32 is read too.
+        for (i = 0; i * 3 + 33 <= pixel_count * 3; i += 10) {
+            __m256i here = _mm256_loadu_si256((const __m256i*)(array + i * 3));
+            __m256i next = _mm256_loadu_si256((const __m256i*)(array + i * 3 + 1));
+            if (0x1B6DB6DB != (_mm256_movemask_epi8(_mm256_cmpeq_epi8(here, next)) & 0x1B6DB6DB))
+                return -1;
+        }
+    }
+    else {
+        for (i = 0; i + 8 <= pixel_count; i += 8) {
+            __m256i pixels = _mm256_loadu_si256((const __m256i*)(array + i * 4));
+            if ((int)0x33333333 != (_mm256_movemask_epi8(_mm256_cmpeq_epi8(pixels, _mm256_srli_epi32(pixels, 8))) & 0x33333333))
+                return -1;
+        }
+    }
+    return i;
+}
+
+//16-bit pixels, channel c: a multiply moves its bits to the top of the word (dropping the bits above),
+//they are masked there, and a multiply-high widens them to 8 bits: ((bits << (16 - n)) * (multiply << (n - scale_shift))) >> 16,
+//no shift by a count in a register. Return false if a mask goes beyond 16 bits (left to the scalar one).
+static bool bitfield_word_constants (const BitFieldTable* fields, int c, short* to_top, short* top_mask, short* widen) {
+    int bits = 0, top;
+    
+    while (bits < 8 && 0 != ((fields->mask[c] >> bits) & 1))
+        bits++;
+    top = fields->shift[c] + bits;
+    if (0 == bits) {
+        *to_top = *top_mask = *widen = 0;
+        return true;
+    }
+    if (top > 16)
+        return false;
+    *to_top = (short)(1 << (16 - top));
+    *top_mask = (short)(((1 << bits) - 1) << (16 - bits));
+    *widen = (short)(fields->multiply[c] << (bits - fields->scale_shift[c]));
+    return true;
+}
+
+//store the low 12 (24) bytes of packed: all 16 (32) bytes if there is room after them (the rest is written again
+//by the next step), else exactly 12 (24), so the last pixels of a row are not left to the scalar one.
+__attribute__((target("ssse3")))
+static inline void Store12_SSSE3 (unsigned char* target, __m128i packed, bool room) {
+    if (room)
+        _mm_storeu_si128((__m128i*)target, packed);
+    else {
+        _mm_storel_epi64((__m128i*)target, packed);
+        *(int*)(target + 8) = _mm_cvtsi128_si32(_mm_srli_si128(packed, 8));
+    }
+}
+
+__attribute__((target("avx2")))
+static inline void Store24_AVX2 (unsigned char* target, __m256i packed, bool room) {
+    if (room)
+        _mm256_storeu_si256((__m256i*)target, packed);
+    else {
+        _mm_storeu_si128((__m128i*)target, _mm256_castsi256_si128(packed));
+        _mm_storel_epi64((__m128i*)(target + 16), _mm256_extracti128_si256(packed, 1));
+    }
+}
+
+//one channel of 4 (SSSE3) or 8 (AVX2) 32-bit pixels: shifted down, masked and widened to 8 bits,
+//a 16-bit multiply is enough (the masked bits are below 256, the product below 2^15).
+__attribute__((target("ssse3")))
+static inline __m128i BitfieldChannel_SSSE3 (__m128i pixels, __m128i shift, __m128i mask, __m128i multiply, __m128i scale_shift) {
+    return _mm_srl_epi32(_mm_mullo_epi16(_mm_and_si128(_mm_srl_epi32(pixels, shift), mask), multiply), scale_shift);
+}
+
+//(AVX2: shifts by a count in every lane, one micro-op, not on the shuffle port.)
+__attribute__((target("avx2")))
+static inline __m256i BitfieldChannel_AVX2 (__m256i pixels, __m256i shift, __m256i mask, __m256i multiply, __m256i scale_shift) {
+    return _mm256_srlv_epi32(_mm256_mullo_epi16(_mm256_and_si256(_mm256_srlv_epi32(pixels, shift), mask), multiply), scale_shift);
+}
+
+__attribute__((target("ssse3")))
+static long Bitfields_SSSE3 (const unsigned char* org_array, unsigned char* bgr_array, long pixel_count, int org_pixel_byte,
+                             const BitFieldTable* fields) {
+    const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    short to_top[3], top_mask[3], widen[3];
+    long i = 0;
+    
+    if (2 == org_pixel_byte) {
+        if (!bitfield_word_constants(fields, 0, &to_top[0], &top_mask[0], &widen[0]) || !bitfield_word_constants(fields, 1, &to_top[1], &top_mask[1], &widen[1])
+            || !bitfield_word_constants(fields, 2, &to_top[2], &top_mask[2], &widen[2]))
+            return 0;
+        const __m128i to_top_b = _mm_set1_epi16(to_top[0]), top_mask_b = _mm_set1_epi16(top_mask[0]), widen_b = _mm_set1_epi16(widen[0]);
+        const __m128i to_top_g = _mm_set1_epi16(to_top[1]), top_mask_g = _mm_set1_epi16(top_mask[1]), widen_g = _mm_set1_epi16(widen[1]);
+        const __m128i to_top_r = _mm_set1_epi16(to_top[2]), top_mask_r = _mm_set1_epi16(top_mask[2]), widen_r = _mm_set1_epi16(widen[2]);
+        
+        //8 pixels: B | G << 8 and R as words, unpacked to B, G, R, 0 of pixels 0~3 and 4~7.
+        for (i = 0; i + 8 <= pixel_count; i += 8) {
+            __m128i pixels = _mm_loadu_si128((const __m128i*)(org_array + i * 2));
+            __m128i blue = _mm_mulhi_epu16(_mm_and_si128(_mm_mullo_epi16(pixels, to_top_b), top_mask_b), widen_b);
+            __m128i green = _mm_mulhi_epu16(_mm_and_si128(_mm_mullo_epi16(pixels, to_top_g), top_mask_g), widen_g);
+            __m128i red = _mm_mulhi_epu16(_mm_and_si128(_mm_mullo_epi16(pixels, to_top_r), top_mask_r), widen_r);
+            __m128i blue_green = _mm_or_si128(blue, _mm_slli_epi16(green, 8));
+            _mm_storeu_si128((__m128i*)(bgr_array + i * 3), _mm_shuffle_epi8(_mm_unpacklo_epi16(blue_green, red), pack));
+            Store12_SSSE3(bgr_array + (i + 4) * 3, _mm_shuffle_epi8(_mm_unpackhi_epi16(blue_green, red), pack), (i + 8) * 3 + 4 <= pixel_count * 3);
+        }
+    }
+    else {
+        const __m128i shift_b = _mm_cvtsi32_si128(fields->shift[0]), scale_b = _mm_cvtsi32_si128(fields->scale_shift[0]);
+        const __m128i shift_g = _mm_cvtsi32_si128(fields->shift[1]), scale_g = _mm_cvtsi32_si128(fields->scale_shift[1]);
+        const __m128i shift_r = _mm_cvtsi32_si128(fields->shift[2]), scale_r = _mm_cvtsi32_si128(fields->scale_shift[2]);
+        const __m128i mask_b = _mm_set1_epi32((int)fields->mask[0]), multiply_b = _mm_set1_epi32(fields->multiply[0]);
+        const __m128i mask_g = _mm_set1_epi32((int)fields->mask[1]), multiply_g = _mm_set1_epi32(fields->multiply[1]);
+        const __m128i mask_r = _mm_set1_epi32((int)fields->mask[2]), multiply_r = _mm_set1_epi32(fields->multiply[2]);
+        
+        for (i = 0; i + 4 <= pixel_count; i += 4) {
+            __m128i pixels = _mm_loadu_si128((const __m128i*)(org_array + i * 4));
+            __m128i blue = BitfieldChannel_SSSE3(pixels, shift_b, mask_b, multiply_b, scale_b);
+            __m128i green = BitfieldChannel_SSSE3(pixels, shift_g, mask_g, multiply_g, scale_g);
+            __m128i red = BitfieldChannel_SSSE3(pixels, shift_r, mask_r, multiply_r, scale_r);
+            __m128i bgr = _mm_or_si128(_mm_or_si128(blue, _mm_slli_epi32(green, 8)), _mm_slli_epi32(red, 16));
+            Store12_SSSE3(bgr_array + i * 3, _mm_shuffle_epi8(bgr, pack), i * 3 + 16 <= pixel_count * 3);
+        }
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static long Bitfields_AVX2 (const unsigned char* org_array, unsigned char* bgr_array, long pixel_count, int org_pixel_byte,
+                            const BitFieldTable* fields) {
+    const __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                          0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m256i join = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    short to_top[3], top_mask[3], widen[3];
+    long i = 0;
+    
+    if (2 == org_pixel_byte) {
+        if (!bitfield_word_constants(fields, 0, &to_top[0], &top_mask[0], &widen[0]) || !bitfield_word_constants(fields, 1, &to_top[1], &top_mask[1], &widen[1])
+            || !bitfield_word_constants(fields, 2, &to_top[2], &top_mask[2], &widen[2]))
+            return 0;
+        const __m256i to_top_b = _mm256_set1_epi16(to_top[0]), top_mask_b = _mm256_set1_epi16(top_mask[0]), widen_b = _mm256_set1_epi16(widen[0]);
+        const __m256i to_top_g = _mm256_set1_epi16(to_top[1]), top_mask_g = _mm256_set1_epi16(top_mask[1]), widen_g = _mm256_set1_epi16(widen[1]);
+        const __m256i to_top_r = _mm256_set1_epi16(to_top[2]), top_mask_r = _mm256_set1_epi16(top_mask[2]), widen_r = _mm256_set1_epi16(widen[2]);
+        
+        //16 pixels, 64-bit quarters reordered (0, 2, 1, 3) so the in-lane unpacks give pixels 0~7 and 8~15.
+        for (i = 0; i + 16 <= pixel_count; i += 16) {
+            __m256i pixels = _mm256_permute4x64_epi64(_mm256_loadu_si256((const __m256i*)(org_array + i * 2)), 0xD8);
+            __m256i blue = _mm256_mulhi_epu16(_mm256_and_si256(_mm256_mullo_epi16(pixels, to_top_b), top_mask_b), widen_b);
+            __m256i green = _mm256_mulhi_epu16(_mm256_and_si256(_mm256_mullo_epi16(pixels, to_top_g), top_mask_g), widen_g);
+            __m256i red = _mm256_mulhi_epu16(_mm256_and_si256(_mm256_mullo_epi16(pixels, to_top_r), top_mask_r), widen_r);
+            __m256i blue_green = _mm256_or_si256(blue, _mm256_slli_epi16(green, 8));
+            __m256i low = _mm256_unpacklo_epi16(blue_green, red);
+            __m256i high = _mm256_unpackhi_epi16(blue_green, red);
+            _mm256_storeu_si256((__m256i*)(bgr_array + i * 3), _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(low, pack), join));
+            Store24_AVX2(bgr_array + (i + 8) * 3, _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(high, pack), join), (i + 16) * 3 + 8 <= pixel_count * 3);
+        }
+    }
+    else {
+        const __m256i shift_b = _mm256_set1_epi32(fields->shift[0]), scale_b = _mm256_set1_epi32(fields->scale_shift[0]);
+        const __m256i shift_g = _mm256_set1_epi32(fields->shift[1]), scale_g = _mm256_set1_epi32(fields->scale_shift[1]);
+        const __m256i shift_r = _mm256_set1_epi32(fields->shift[2]), scale_r = _mm256_set1_epi32(fields->scale_shift[2]);
+        const __m256i mask_b = _mm256_set1_epi32((int)fields->mask[0]), multiply_b = _mm256_set1_epi32(fields->multiply[0]);
+        const __m256i mask_g = _mm256_set1_epi32((int)fields->mask[1]), multiply_g = _mm256_set1_epi32(fields->multiply[1]);
+        const __m256i mask_r = _mm256_set1_epi32((int)fields->mask[2]), multiply_r = _mm256_set1_epi32(fields->multiply[2]);
+        
+        for (i = 0; i + 8 <= pixel_count; i += 8) {
+            __m256i pixels = _mm256_loadu_si256((const __m256i*)(org_array + i * 4));
+            __m256i blue = BitfieldChannel_AVX2(pixels, shift_b, mask_b, multiply_b, scale_b);
+            __m256i green = BitfieldChannel_AVX2(pixels, shift_g, mask_g, multiply_g, scale_g);
+            __m256i red = BitfieldChannel_AVX2(pixels, shift_r, mask_r, multiply_r, scale_r);
+            __m256i bgr = _mm256_or_si256(_mm256_or_si256(blue, _mm256_slli_epi32(green, 8)), _mm256_slli_epi32(red, 16));
+            Store24_AVX2(bgr_array + i * 3, _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(bgr, pack), join), i * 3 + 32 <= pixel_count * 3);
+        }
+    }
+    return i;
+}
+
+//threshold: 1 ~ 255 here, as Binary_xxx.
+__attribute__((target("ssse3")))
+static long PackBits_SSSE3 (const unsigned char* array, unsigned char* bits, long pixel_count, int threshold) {
+    const __m128i limit = _mm_set1_epi8((char)threshold);
+    const __m128i mirror = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    int mask;
+    long i;
+    
+    for (i = 0; i + 16 <= pixel_count; i += 16) {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(array + i));
+        __m128i white = _mm_cmpeq_epi8(_mm_max_epu8(pixels, limit), pixels);
+        mask = _mm_movemask_epi8(_mm_shuffle_epi8(white, mirror));
+        bits[i / 8] = (unsigned char)mask;
+        bits[i / 8 + 1] = (unsigned char)(mask >> 8);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static long PackBits_AVX2 (const unsigned char* array, unsigned char* bits, long pixel_count, int threshold) {
+    const __m256i limit = _mm256_set1_epi8((char)threshold);
+    const __m256i mirror = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                            7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    unsigned int mask;
+    long i;
+    
+    for (i = 0; i + 32 <= pixel_count; i += 32) {
+        __m256i pixels = _mm256_loadu_si256((const __m256i*)(array + i));
+        __m256i white = _mm256_cmpeq_epi8(_mm256_max_epu8(pixels, limit), pixels);
+        mask = (unsigned int)_mm256_movemask_epi8(_mm256_shuffle_epi8(white, mirror));
+        memcpy(bits + i / 8, &mask, 4);     //little endian: pixels i ~ i + 7 in the first byte
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+static long UnpackBits_SSSE3 (const unsigned char* bits, unsigned char* array, long pixel_count) {
+    const __m128i spread = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1);
+    const __m128i select = _mm_setr_epi8((char)0x80, 0x40, 0x20, 0x10, 8, 4, 2, 1, (char)0x80, 0x40, 0x20, 0x10, 8, 4, 2, 1);
+    long i;
+    
+    for (i = 0; i + 16 <= pixel_count; i += 16) {
+        __m128i pair = _mm_cvtsi32_si128(bits[i / 8] | bits[i / 8 + 1] << 8);
+        __m128i spread_bits = _mm_and_si128(_mm_shuffle_epi8(pair, spread), select);
+        _mm_storeu_si128((__m128i*)(array + i), _mm_cmpeq_epi8(spread_bits, select));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static long UnpackBits_AVX2 (const unsigned char* bits, unsigned char* array, long pixel_count) {
+    const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                            2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i select = _mm256_set1_epi64x(0x0102040810204080LL);
+    int quad;
+    long i;
+    
+    for (i = 0; i + 32 <= pixel_count; i += 32) {
+        memcpy(&quad, bits + i / 8, 4);
+        __m256i spread_bits = _mm256_and_si256(_mm256_shuffle_epi8(_mm256_set1_epi32(quad), spread), select);
+        _mm256_storeu_si256((__m256i*)(array + i), _mm256_cmpeq_epi8(spread_bits, select));
+    }
+    return i;
+}
+
+#endif /* simd_x86_available */
+
+#ifdef debug_simd
+static void check_simd (const char* kernel, const unsigned char* result, const unsigned char* expected, long length) {
+    for (long i = 0; i < length; i++) {
+        if (result[i] != expected[i]) {
+            printf("%s: mismatch at %ld, simd %u, scalar %u (simd level %d)\n", kernel, i, result[i], expected[i], GetSimdLevel());
+            return;
+        }
+    }
+}
+#endif
+
+void Reverse_Simd (unsigned char* array, long array_length) {
+    long done = 0;
+#ifdef debug_simd
+    unsigned char* expected = new unsigned char[array_length > 0 ? array_length : 1];
+    memcpy(expected, array, array_length > 0 ? array_length : 0);
+    Reverse_Scalar(expected, array_length);
+#endif
+    
+#ifdef simd_x86_available
+    if (SIMD_AVX2 == GetSimdLevel())
+        done = Reverse_AVX2(array, array_length);
+    else if (SIMD_SSSE3 == GetSimdLevel())
+        done = Reverse_SSSE3(array, array_length);
+#endif
+    Reverse_Scalar(array + done, array_length - done);
+    
+#ifdef debug_simd
+    check_simd("Reverse", array, expected, array_length);
+    delete[] expected;
+#endif
+}
+
+void Binary_Simd (unsigned char* array, long array_length, int threshold) {
+    long done = 0;
+#ifdef debug_simd
+    unsigned char* expected = new unsigned char[array_length > 0 ? array_length : 1];
+    memcpy(expected, array, array_length > 0 ? array_length : 0);
+    Binary_Scalar(expected, array_length, threshold);
+#endif
+    
+#ifdef simd_x86_available
+    //threshold out of 1~255 is all 0 or all 255, the scalar one does it.
+    if (threshold >= 1 && threshold <= 255) {
+        if (SIMD_AVX2 == GetSimdLevel())
+            done = Binary_AVX2(array, array_length, threshold);
+        else if (SIMD_SSSE3 == GetSimdLevel())
+            done = Binary_SSSE3(array, array_length, threshold);
+    }
+#endif
+    Binary_Scalar(array + done, array_length - done, threshold);
+    
+#ifdef debug_simd
+    check_simd("Binary", array, expected, array_length);
+    delete[] expected;
+#endif
+}
+
+void ColorToGray_Simd (const unsigned char* bgr_array, unsigned char* gray_array, long pixel_count) {
+    long done = 0;
+#ifdef debug_simd
+    unsigned char* expected = new unsigned char[pixel_count > 0 ? pixel_count : 1];
+    ColorToGray_Scalar(bgr_array, expected, pixel_count);
+#endif
+    
+#ifdef simd_x86_available
+    if (SIMD_AVX2 == GetSimdLevel())
+        done = ColorToGray_AVX2(bgr_array, gray_array, pixel_count);
+    else if (SIMD_SSSE3 == GetSimdLevel())
+        done = ColorToGray_SSSE3(bgr_array, gray_array, pixel_count);
+#endif
+    ColorToGray_Scalar(bgr_array + done * 3, gray_array + done, pixel_count - done);
+    
+#ifdef debug_simd
+    check_simd("ColorToGray", gray_array, expected, pixel_count);
+    delete[] expected;
+#endif
+}
+
+void ApplyLut_Simd (unsigned char* array, long array_length, const unsigned char* lut) {
+    long done = 0;
+#ifdef debug_simd
+    unsigned char* expected = new unsigned char[array_length > 0 ? array_length : 1];
+    memcpy(expected, array, array_length > 0 ? array_length : 0);
+    ApplyLut_Scalar(expected, array_length, lut);
+#endif
+    
+#ifdef simd_x86_available
+    if (SIMD_AVX2 == GetSimdLevel())
+        done = ApplyLut_AVX2(array, array_length, lut);
+#endif
+    ApplyLut_Scalar(array + done, array_length - done, lut);
+    
+#ifdef debug_simd
+    check_simd("ApplyLut", array, expected, array_length);
+    delete[] expected;
+#endif
+}
+
+void VerticalSum_Simd (const short* const* rows, const short* weights, int taps, long length, unsigned char* result, int shift) {
+    long done = 0;
+    const short* rest[4];
+#ifdef debug_simd
+    unsigned char* expected = new unsigned char[length > 0 ? length : 1];
+    VerticalSum_Scalar(rows, weights, taps, length, expected, shift);
+#endif
+    
+#ifdef simd_x86_available
+    if (SIMD_AVX2 == GetSimdLevel())
+        done = VerticalSum_AVX2(rows, weights, taps, length, result, shift);
+    else if (SIMD_SSSE3 == GetSimdLevel())
+        done = VerticalSum_SSE2(rows, weights, taps, length, result, shift);
+#endif
+    for (int t = 0; t < taps; t++) {
+        rest[t] = rows[t] + done;
+    }
+    VerticalSum_Scalar(rest, weights, taps, length - done, result + done, shift);
+    
+#ifdef debug_simd
+    check_simd("VerticalSum", result, expected, length);
+    delete[] expected;
+#endif
+}
+
+void Transpose16_Simd (const unsigned char* source, long source_stride, unsigned char* target, long target_stride) {
+#ifdef simd_x86_available
+    if (SIMD_NONE != GetSimdLevel()) {
+        Transpose16_SSE2(source, source_stride, target, target_stride);
+    #ifdef debug_simd
+        unsigned char expected[16 * 16], result[16 * 16];
+        Transpose16_Scalar(source, source_stride, expected, 16);
+        for (int i = 0; i < 16; i++) {
+            memcpy(result + i * 16, target + i * target_stride, 16);
+        }
+        check_simd("Transpose16", result, expected, 16 * 16);
+    #endif
+        return;
+    }
+#endif
+    Transpose16_Scalar(source, source_stride, target, target_stride);
+}
+
+void Transpose8_BGR_Simd (const unsigned char* source, long source_stride, unsigned char* target, long target_stride) {
+#ifdef simd_x86_available
+    if (SIMD_NONE != GetSimdLevel()) {
+        Transpose8_BGR_SSSE3(source, source_stride, target, target_stride);
+    #ifdef debug_simd
+        unsigned char expected[8 * 24], result[8 * 24];
+        Transpose8_BGR_Scalar(source, source_stride, expected, 24);
+        for (int i = 0; i < 8; i++) {
+            memcpy(result + i * 24, target + i * target_stride, 24);
+        }
+        check_simd("Transpose8_BGR", result, expected, 8 * 24);
+    #endif
+        return;
+    }
+#endif
+    Transpose8_BGR_Scalar(source, source_stride, target, target_stride);
+}
+
+void DropAlpha_Simd (const unsigned char* bgra_array, unsigned char* bgr_array, long pixel_count) {
+    long done = 0;
+#ifdef debug_simd
+    unsigned char* expected = new unsigned char[pixel_count > 0 ? pixel_count * 3 : 1];
+    DropAlpha_Scalar(bgra_array, expected, pixel_count);
+#endif
+    
+#ifdef simd_x86_available
+    if (SIMD_AVX2 == GetSimdLevel())
+        done = DropAlpha_AVX2(bgra_array, bgr_array, pixel_count);
+    else if (SIMD_SSSE3 == GetSimdLevel())
+        done = DropAlpha_SSSE3(bgra_array, bgr_array, pixel_count);
+#endif
+    DropAlpha_Scalar(bgra_array + done * 4, bgr_array + done * 3, pixel_count - done);
+    
+#ifdef debug_simd
+    check_simd("DropAlpha", bgr_array, expected, pixel_count * 3);
+    delete[] expected;
+#endif
+}
+
+bool IsGray_Simd (const unsigned char* array, long pixel_count, int pixel_byte) {
+    long done = 0;
+    bool result;
+    
+#ifdef simd_x86_available
+    if (SIMD_AVX2 == GetSimdLevel())
+        done = IsGray_AVX2(array, pixel_count, pixel_byte);
+    else if (SIMD_SSSE3 == GetSimdLevel())
+        done = IsGray_SSE2(array, pixel_count, pixel_byte);
+#endif
+    result = (done >= 0 && IsGray_Scalar(array + done * pixel_byte, pixel_count - done, pixel_byte));
+    
+#ifdef debug_simd
+    if (result != IsGray_Scalar(array, pixel_count, pixel_byte))
+        printf("IsGray: mismatch, simd %d (simd level %d)\n", result, GetSimdLevel());
+#endif
+    return result;
+}
+
+void Deinterleave_Simd (const unsigned char* bgr_array, unsigned char* blue, unsigned char* green, unsigned char* red, long pixel_count) {
+    long done = 0;
+#ifdef debug_simd
+    unsigned char* expected = new unsigned char[pixel_count > 0 ? pixel_count * 3 : 1];
+    Deinterleave_Scalar(bgr_array, expected, expected + pixel_count, expected + pixel_count * 2, pixel_count);
+#endif
+    
+#ifdef simd_x86_available
+    if (SIMD_AVX2 == GetSimdLevel())
+        done = Deinterleave_AVX2(bgr_array, blue, green, red, pixel_count);
+    else if (SIMD_SSSE3 == GetSimdLevel())
+        done = Deinterleave_SSSE3(bgr_array, blue, green, red, pixel_count);
+#endif
+    Deinterleave_Scalar(bgr_array + done * 3, blue + done, green + done, red + done, pixel_count - done);
+    
+#ifdef debug_simd
+    check_simd("Deinterleave blue", blue, expected, pixel_count);
+    check_simd("Deinterleave green", green, expected + pixel_count, pixel_count);
+    check_simd("Deinterleave red", red, expected + pixel_count * 2, pixel_count);
+    delete[] expected;
+#endif
+}
+
+void Interleave_Simd (const unsigned char* blue, const unsigned char* green, const unsigned char* red, unsigned char* bgr_array, long pixel_count) {
+    long done = 0;
+#ifdef debug_simd
+    unsigned char* expected = new unsigned char[pixel_count > 0 ? pixel_count * 3 : 1];
+    Interleave_Scalar(blue, green, red, expected, pixel_count);
+#endif
+    
+#ifdef simd_x86_available
+    if (SIMD_AVX2 == GetSimdLevel())
+        done = Interleave_AVX2(blue, green, red, bgr_array, pixel_count);
+    else if (SIMD_SSSE3 == GetSimdLevel())
+        done = Interleave_SSSE3(blue, green, red, bgr_array, pixel_count);
+#endif
+    Interleave_Scalar(blue + done, green + done, red + done, bgr_array + done * 3, pixel_count - done);
+    
+#ifdef debug_simd
+    check_simd("Interleave", bgr_array, expected, pixel_count * 3);
+    delete[] expected;
+#endif
+}
+
+void PlanarToGray_Simd (const unsigned char* blue, const unsigned char* green, const unsigned char* red, unsigned char* gray_array, long pixel_count) {
+    long done = 0;
+#ifdef debug_simd
+    unsigned char* expected = new unsigned char[pixel_count > 0 ? pixel_count : 1];
+    PlanarToGray_Scalar(blue, green, red, expected, pixel_count);
+#endif
+    
+#ifdef simd_x86_available
+    if (SIMD_AVX2 == GetSimdLevel())
+        done = PlanarToGray_AVX2(blue, green, red, gray_array, pixel_count);
+    else if (SIMD_SSSE3 == GetSimdLevel())
+        done = PlanarToGray_SSSE3(blue, green, red, gray_array, pixel_count);
+#endif
+    PlanarToGray_Scalar(blue + done, green + done, red + done, gray_array + done, pixel_count - done);
+    
+#ifdef debug_simd
+    check_simd("PlanarToGray", gray_array, expected, pixel_count);
+    delete[] expected;
+#endif
+}
+
+void Bitfields_Simd (const unsigned char* org_array, unsigned char* bgr_array, long pixel_count, int org_pixel_byte,
+                     const BitFieldTable* fields) {
+    long done = 0;
+#ifdef debug_simd
+    unsigned char* expected = new unsigned char[pixel_count > 0 ? pixel_count * 3 : 1];
+    Bitfields_Scalar(org_array, expected, pixel_count, org_pixel_byte, fields);
+#endif
+    
+#ifdef simd_x86_available
+    if (SIMD_AVX2 == GetSimdLevel())
+        done = Bitfields_AVX2(org_array, bgr_array, pixel_count, org_pixel_byte, fields);
+    else if (SIMD_SSSE3 == GetSimdLevel())
+        done = Bitfields_SSSE3(org_array, bgr_array, pixel_count, org_pixel_byte, fields);
+#endif
+    Bitfields_Scalar(org_array + done * org_pixel_byte, bgr_array + done * 3, pixel_count - done, org_pixel_byte, fields);
+    
+#ifdef debug_simd
+    check_simd("Bitfields", bgr_array, expected, pixel_count * 3);
+    delete[] expected;
+#endif
+}
+
+void PackBits_Simd (const unsigned char* array, unsigned char* bits, long pixel_count, int threshold) {
+    long done = 0;
+#ifdef debug_simd
+    unsigned char* expected = new unsigned char[pixel_count > 0 ? (pixel_count + 7) / 8 : 1];
+    PackBits_Scalar(array, expected, pixel_count, threshold);
+#endif
+    
+#ifdef simd_x86_available
+    //threshold out of 1~255 is all 0 or all 1, the scalar one does it.
+    if (threshold >= 1 && threshold <= 255) {
+        if (SIMD_AVX2 == GetSimdLevel())
+            done = PackBits_AVX2(array, bits, pixel_count, threshold);
+        else if (SIMD_SSSE3 == GetSimdLevel())
+            done = PackBits_SSSE3(array, bits, pixel_count, threshold);
+    }
+#endif
+    PackBits_Scalar(array + done, bits + done / 8, pixel_count - done, threshold);
+    
+#ifdef debug_simd
+    check_simd("PackBits", bits, expected, (pixel_count + 7) / 8);
+    delete[] expected;
+#endif
+}
+
+void UnpackBits_Simd (const unsigned char* bits, unsigned char* array, long pixel_count) {
+    long done = 0;
+#ifdef debug_simd
+    unsigned char* expected = new unsigned char[pixel_count > 0 ? pixel_count : 1];
+    UnpackBits_Scalar(bits, expected, pixel_count);
+#endif
+    
+#ifdef simd_x86_available
+    if (SIMD_AVX2 == GetSimdLevel())
+        done = UnpackBits_AVX2(bits, array, pixel_count);
+    else if (SIMD_SSSE3 == GetSimdLevel())
+        done = UnpackBits_SSSE3(bits, array, pixel_count);
+#endif
+    UnpackBits_Scalar(bits + done / 8, array + done, pixel_count - done);
+    
+#ifdef debug_simd
+    check_simd("UnpackBits", array, expected, pixel_count);
+    delete[] expected;
+#endif
+}
@@ -0,0 +1,207 @@
+/* ***************************************************************************
+ functions in this (basic_thread_pool.cpp) cpp file:
+ 
+ (1) void SetThreadCount (int thread_count);
+ * How many threads (including the calling one) <RunTiles> may use.
+ * 0 (default): all cores; 1: no extra thread at all.
+ * The pool threads are started at the first parallel <RunTiles>.
+ 
+ (2) int GetThreadCount (void);
+ 
+ (3) void RunTiles (long tile_count, void (*tile_function)(long tile_index, void* context), void* context);
+ * Call tile_function(0, context) ... tile_function(tile_count - 1, context) on all pool threads,
+ * return after all of them are done.
+ * Threads take the next tile from a shared counter, so a thread done early
+ * just takes more tiles (no thread waits for a slow one before the last tile).
+ * Tiles must not depend on each other, then results are the same as running in order.
+ * If the pool is already busy (e.g. called inside a tile, or by another thread at the same time),
+ * the tiles are run one by one in the calling thread.
+ * If a tile throws (an error code, std::bad_alloc from PixelAlloc / new ...), no new tile is started,
+ * RunTiles still waits for the tiles already running, then rethrows the first exception in the calling thread.
+ 
+ (4) void StartPool (int worker_count);
+     void StopPool (void);
+ * start / join the worker threads.
+ 
+ (5) void pool_worker (unsigned long seen_generation);
+ * the loop of a worker thread: wait for a new generation of tiles, run tiles, report.
+ * seen_generation: the generation when it was started, so it never misses the next one.
+ 
+ (6) void pool_fail (void);
+ * In the catch of a tile: keep the first exception of the generation (for <RunTiles> to rethrow),
+ * and move the shared counter to the end, so no thread starts another tile.
+ *****************************************************************************/
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <exception>
+
+void StartPool (int worker_count);  //basic_thread_pool.cpp
+void StopPool (void);   //basic_thread_pool.cpp
+void pool_worker (unsigned long seen_generation);    //basic_thread_pool.cpp
+void pool_fail (void);  //basic_thread_pool.cpp
+
+static std::vector<std::thread> pool_threads;
+static std::mutex pool_mutex;
+static std::mutex run_mutex;    //only one RunTiles at a time uses the pool
+static std::condition_variable pool_wake;
+static std::condition_variable pool_done;
+static unsigned long pool_generation = 0;
+static bool pool_quit = false;
+static std::atomic<int> thread_count_setting(0);   //written under run_mutex, read by any thread.
+
+//tiles of the current generation:
+static void (*job_function)(long tile_index, void* context) = NULL;
+static void* job_context = NULL;
+static long job_tile_count = 0;
+static std::atomic<long> job_next_tile(0);
+static long job_workers_busy = 0;
+static std::exception_ptr job_error;    //the first exception a tile threw.
+
+static thread_local bool is_pool_thread = false;
+
+//the calling thread of RunTiles is a pool thread while it runs tiles, however it leaves them.
+struct struct_PoolThreadMark {
+    bool saved;
+    struct_PoolThreadMark(void) {
+        saved = is_pool_thread;
+        is_pool_thread = true;
+    }
+    ~struct_PoolThreadMark(void) {
+        is_pool_thread = saved;
+    }
+};
+
+static struct struct_PoolKeeper {
+    ~struct_PoolKeeper(void) {
+        StopPool();     //threads must be joined before std::thread is destroyed at exit.
+    }
+} pool_keeper;
+
+void SetThreadCount (int thread_count) {
+    std::lock_guard<std::mutex> run_lock(run_mutex);
+    
+    thread_count_setting = thread_count > 0 ? thread_count : 0;
+    StopPool();
+}
+
+int GetThreadCount (void) {
+    int setting = thread_count_setting.load();
+    
+    if (setting > 0)
+        return setting;
+    
+    int cores = (int)std::thread::hardware_concurrency();
+    return cores > 0 ? cores : 1;
+}
+
+void RunTiles (long tile_count, void (*tile_function)(long tile_index, void* context), void* context) {
+    int thread_count = GetThreadCount();
+    long tile;
+    std::exception_ptr error;
+    
+    if (thread_count <= 1 || tile_count <= 1 || is_pool_thread || !run_mutex.try_lock()) {
+        for (tile = 0; tile < tile_count; tile++)
+            tile_function(tile, context);
+        return;
+    }
+    std::unique_lock<std::mutex> run_lock(run_mutex, std::adopt_lock);
+    
+    if ((int)pool_threads.size() != thread_count - 1)
+        StartPool(thread_count - 1);
+    
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        job_function = tile_function;
+        job_context = context;
+        job_tile_count = tile_count;
+        job_next_tile = 0;
+        job_workers_busy = (long)pool_threads.size();
+        job_error = nullptr;
+        pool_generation++;
+    }
+    pool_wake.notify_all();
+    
+    //the calling thread works too.
+    {
+        struct_PoolThreadMark mark;
+        try {
+            while ((tile = job_next_tile.fetch_add(1)) < tile_count)
+                tile_function(tile, context);
+        }
+        catch (...) {
+            pool_fail();
+        }
+    }
+    
+    //always wait: the workers still use context, which may live in the caller's frame.
+    {
+        std::unique_lock<std::mutex> lock(pool_mutex);
+        pool_done.wait(lock, [] {return 0 == job_workers_busy;});
+        job_function = NULL;
+        job_context = NULL;
+        error = job_error;
+        job_error = nullptr;
+    }
+    run_lock.unlock();
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void StartPool (int worker_count) {
+    StopPool();
+    
+    pool_quit = false;
+    for (int i = 0; i < worker_count; i++)
+        pool_threads.push_back(std::thread(pool_worker, pool_generation));
+}
+
+void StopPool (void) {
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        pool_quit = true;
+    }
+    pool_wake.notify_all();
+    
+    for (size_t i = 0; i < pool_threads.size(); i++)
+        pool_threads[i].join();
+    pool_threads.clear();
+}
+
+void pool_worker (unsigned long seen_generation) {
+    long tile;
+    
+    is_pool_thread = true;
+    std::unique_lock<std::mutex> lock(pool_mutex);
+    
+    while (true) {
+        pool_wake.wait(lock, [&seen_generation] {return pool_quit || pool_generation != seen_generation;});
+        if (pool_quit)
+            return;
+        seen_generation = pool_generation;
+        lock.unlock();
+        
+        try {
+            while ((tile = job_next_tile.fetch_add(1)) < job_tile_count)
+                job_function(tile, job_context);
+        }
+        catch (...) {
+            pool_fail();
+        }
+        
+        lock.lock();
+        if (0 == --job_workers_busy)
+            pool_done.notify_all();
+    }
+}
+
+void pool_fail (void) {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    
+    if (!job_error)
+        job_error = std::current_exception();
+    job_next_tile = job_tile_count;
+}
@@ -0,0 +1,248 @@
+/* ***************************************************************************
+ functions in this (basic_threshold.cpp) cpp file:
+ 
+ (1) void Binary_Sauvola (unsigned char* array, long width, long height, int window, double k);
+ * Adaptive binary of a gray image (width * height bytes, no padding), in place:
+ * a pixel below the threshold of its own window (window * window pixels around it) becomes 0, else 255.
+ * T = mean * (1 + k * (stddev / 128 - 1)), mean and stddev of the window.
+ * Text on an unevenly lit scan stays black, flat paper (small stddev) becomes white.
+ 
+ (2) void Binary_Bradley (unsigned char* array, long width, long height, int window, double t);
+ * Same as (1), T = mean * (1 - t): a pixel t (e.g. 0.15 = 15%) darker than its window becomes 0.
+ 
+ * window: an even one is taken as window + 1, at most BINARY_MAX_WINDOW.
+ * Windows are cut by the image borders (pixels out of the image are not counted).
+ * The sums of every window come from summed-area tables (integral images): 4 lookups a window,
+ * so the cost per pixel does not depend on window.
+ * Both tables are built in strips of BINARY_STRIP rows at the same time (<threshold_strip>),
+ * the strips are joined by one carry row each, then bands of rows are decided in parallel (<threshold_band>).
+ 
+ (3) static void threshold_run (unsigned char* array, long width, long height, int window, double k, bool sauvola);
+ * Body of (1) and (2).
+ 
+ (4) static void threshold_strip (long strip_index, void* context);
+ * tile_function of <RunTiles>, context is a ThresholdTask: rows of the tables of strip strip_index,
+ * every strip starts its sums from 0 (the sums of the strips above are in the carry rows).
+ * Sums are unsigned int / unsigned long long, and wrap around: the sum of a window is still right
+ * as long as it fits (window <= 4096 for the sums, any for the squares).
+ 
+ (5) static void threshold_band (long band_index, void* context);
+ * tile_function of <RunTiles>: decide the pixels of rows [band_index * BINARY_STRIP, ...).
+ * Per row, the two table rows (+ carries) of its window are subtracted once into one row of column sums,
+ * then every window is 2 lookups. The test is made without division, sqrt or branch (see the comments),
+ * a mispredicted branch per noisy pixel cost more than all the arithmetic.
+ *****************************************************************************/
+
+#include <cmath>
+#include "struct_TraceScope.h"
+
+//rows of a strip of the tables, also of a band of <threshold_band>.
+#define BINARY_STRIP    64
+#define BINARY_MAX_WINDOW   4095
+
+typedef struct struct_ThresholdTask {
+    unsigned char* array;
+    long width;
+    long height;
+    int radius;     //window = 2 * radius + 1
+    double k;
+    bool sauvola;   //false: Bradley, no square table.
+    long line_length;   //width + 1: the table has column 0 and row 0 of 0
+    unsigned int* sum_table;    //(height + 1) rows, row r: sums of the pixels above row r in the strip
+    unsigned long long* square_table;
+    unsigned int* sum_carry;    //one row per strip: sums of all the strips above it
+    unsigned long long* square_carry;
+    double* column_count;   //[x]: columns in the window of column x
+} ThresholdTask;
+
+unsigned char* PixelAlloc (unsigned long size_byte);    //basic_pixel_pool.cpp
+void PixelFree (unsigned char* buffer); //basic_pixel_pool.cpp
+void RunTiles (long tile_count, void (*tile_function)(long tile_index, void* context), void* context);  //basic_thread_pool.cpp
+void Binary_Sauvola (unsigned char* array, long width, long height, int window, double k);  //basic_threshold.cpp
+void Binary_Bradley (unsigned char* array, long width, long height, int window, double t);  //basic_threshold.cpp
+
+static void threshold_run (unsigned char* array, long width, long height, int window, double k, bool sauvola);
+static void threshold_strip (long strip_index, void* context);
+static void threshold_band (long band_index, void* context);
+
+void Binary_Sauvola (unsigned char* array, long width, long height, int window, double k) {
+    TRACE_SCOPE("Binary_Sauvola", "ColorTrans");
+    threshold_run(array, width, height, window, k, true);
+}
+
+void Binary_Bradley (unsigned char* array, long width, long height, int window, double t) {
+    TRACE_SCOPE("Binary_Bradley", "ColorTrans");
+    threshold_run(array, width, height, window, t, false);
+}
+
+static void threshold_run (unsigned char* array, long width, long height, int window, double k, bool sauvola) {
+    long strips = (height + BINARY_STRIP - 1) / BINARY_STRIP;
+    ThresholdTask task;
+    long s, i;
+    
+    if (width <= 0 || height <= 0)
+        return;
+    if (window > BINARY_MAX_WINDOW)
+        window = BINARY_MAX_WINDOW;
+    if (sauvola && k < 0)
+        k = 0;
+    task.array = array;
+    task.width = width;
+    task.height = height;
+    task.radius = (window > 1) ? window / 2 : 0;
+    task.k = k;
+    task.sauvola = sauvola;
+    task.line_length = width + 1;
+    //from the pixel pool, as the table of <GeometryTrans::Zoom_Area>.
+    task.sum_table = (unsigned int*)PixelAlloc((height + 1) * task.line_length * sizeof(unsigned int));
+    task.sum_carry = new unsigned int[strips * task.line_length]();
+    task.square_table = NULL;
+    task.square_carry = NULL;
+    if (sauvola) {
+        task.square_table = (unsigned long long*)PixelAlloc((height + 1) * task.line_length * sizeof(unsigned long long));
+        task.square_carry = new unsigned long long[strips * task.line_length]();
+    }
+    task.column_count = new double[width];
+    for (i = 0; i < width; i++)
+        task.column_count[i] = (double)(((i + task.radius + 1 < width) ? i + task.radius + 1 : width) - ((i - task.radius > 0) ? i - task.radius : 0));
+    TRACE_BYTES(width * height * 2);
+    TRACE_ALLOC((height + 1 + strips) * task.line_length * (sizeof(unsigned int) + (sauvola ? sizeof(unsigned long long) : 0)));
+    
+    //row 0 is 0, strip s is rows [1 + s * BINARY_STRIP, ...).
+    for (i = 0; i < task.line_length; i++)
+        task.sum_table[i] = 0;
+    if (sauvola) {
+        for (i = 0; i < task.line_length; i++)
+            task.square_table[i] = 0;
+    }
+    RunTiles(strips, threshold_strip, &task);
+    for (s = 1; s < strips; s++) {
+        const unsigned int* last = task.sum_table + s * BINARY_STRIP * task.line_length;
+        for (i = 0; i < task.line_length; i++)
+            task.sum_carry[s * task.line_length + i] = task.sum_carry[(s - 1) * task.line_length + i] + last[i];
+        if (sauvola) {
+            const unsigned long long* square_last = task.square_table + s * BINARY_STRIP * task.line_length;
+            for (i = 0; i < task.line_length; i++)
+                task.square_carry[s * task.line_length + i] = task.square_carry[(s - 1) * task.line_length + i] + square_last[i];
+        }
+    }
+    
+    RunTiles(strips, threshold_band, &task);
+    
+    PixelFree((unsigned char*)task.sum_table);
+    delete[] task.sum_carry;
+    delete[] task.column_count;
+    if (sauvola) {
+        PixelFree((unsigned char*)task.square_table);
+        delete[] task.square_carry;
+    }
+}
+
+static void threshold_strip (long strip_index, void* context) {
+    const ThresholdTask* task = (const ThresholdTask*)context;
+    long line_length = task->line_length;
+    long first_row = 1 + strip_index * BINARY_STRIP;
+    long last_row = (first_row + BINARY_STRIP < task->height + 1) ? first_row + BINARY_STRIP : task->height + 1;
+    const unsigned char* source;
+    long r, x;
+    
+    for (r = first_row; r < last_row; r++) {
+        //row r: row r - 1 of the strip (0 at its first row) + sums of pixel row r - 1 up to every column.
+        source = task->array + (r - 1) * task->width;
+        unsigned int* target = task->sum_table + r * line_length;
+        const unsigned int* above = (r == first_row) ? task->sum_carry : target - line_length;  //carry row 0 is all 0
+        unsigned int sum = 0;
+        target[0] = 0;
+        for (x = 0; x < task->width; x++) {
+            sum += source[x];
+            target[x + 1] = above[x + 1] + sum;
+        }
+        if (task->sauvola) {
+            unsigned long long* square_target = task->square_table + r * line_length;
+            const unsigned long long* square_above = (r == first_row) ? task->square_carry : square_target - line_length;
+            unsigned long long square = 0;
+            square_target[0] = 0;
+            for (x = 0; x < task->width; x++) {
+                square += source[x] * source[x];
+                square_target[x + 1] = square_above[x + 1] + square;
+            }
+        }
+    }
+}
+
+static void threshold_band (long band_index, void* context) {
+    const ThresholdTask* task = (const ThresholdTask*)context;
+    long line_length = task->line_length;
+    long width = task->width;
+    int radius = task->radius;
+    long first_row = band_index * BINARY_STRIP;
+    long last_row = (first_row + BINARY_STRIP < task->height) ? first_row + BINARY_STRIP : task->height;
+    //the window rows of one row: column_sum[radius + x] = sum of the pixels in columns [0, x) of them,
+    //x out of [0, width] as 0 or width, so the window of pixel x is [x, x + window) with no test.
+    long edge_length = width + 2 * radius + 1;
+    unsigned int* column_sum = new unsigned int[edge_length];
+    unsigned long long* column_square = task->sauvola ? new unsigned long long[edge_length] : NULL;
+    double keep = 1 - task->k;  //Bradley: 1 - t; Sauvola: 1 - k
+    double spread = task->k / 128;
+    long top, bottom, y, x, i;
+    
+    for (i = 0; i < radius; i++) {
+        column_sum[i] = 0;
+        if (task->sauvola)
+            column_square[i] = 0;
+    }
+    for (y = first_row; y < last_row; y++) {
+        unsigned char* pixel = task->array + y * width;
+        //table rows of the window, each with the carry of its strip (row 0 is in no strip, carry 0 is 0).
+        top = (y - radius > 0) ? y - radius : 0;
+        bottom = (y + radius + 1 < task->height) ? y + radius + 1 : task->height;
+        long top_offset = top * line_length;
+        long top_carry_offset = (top > 0 ? (top - 1) / BINARY_STRIP : 0) * line_length;
+        long bottom_offset = bottom * line_length;
+        long bottom_carry_offset = (bottom - 1) / BINARY_STRIP * line_length;
+        const unsigned int* top_row = task->sum_table + top_offset;
+        const unsigned int* top_carry = task->sum_carry + top_carry_offset;
+        const unsigned int* bottom_row = task->sum_table + bottom_offset;
+        const unsigned int* bottom_carry = task->sum_carry + bottom_carry_offset;
+        double rows = (double)(bottom - top);
+        for (i = 0; i < line_length; i++)
+            column_sum[radius + i] = (bottom_row[i] + bottom_carry[i]) - (top_row[i] + top_carry[i]);
+        for (i = radius + line_length; i < edge_length; i++)
+            column_sum[i] = column_sum[radius + width];
+        
+        if (!task->sauvola) {
+            //pixel < mean * (1 - t): pixel * count < sum * (1 - t), no division.
+            for (x = 0; x < width; x++) {
+                double count = task->column_count[x] * rows;
+                double sum = column_sum[x + 2 * radius + 1] - column_sum[x];
+                pixel[x] = (unsigned char)(-(int)(pixel[x] * count >= sum * keep));
+            }
+            continue;
+        }
+        
+        const unsigned long long* square_top = task->square_table + top_offset;
+        const unsigned long long* square_top_carry = task->square_carry + top_carry_offset;
+        const unsigned long long* square_bottom = task->square_table + bottom_offset;
+        const unsigned long long* square_bottom_carry = task->square_carry + bottom_carry_offset;
+        for (i = 0; i < line_length; i++)
+            column_square[radius + i] = (square_bottom[i] + square_bottom_carry[i]) - (square_top[i] + square_top_carry[i]);
+        for (i = radius + line_length; i < edge_length; i++)
+            column_square[i] = column_square[radius + width];
+        //pixel < mean * (1 - k) + mean * k / 128 * stddev, times count (n):
+        //    below = pixel * n - sum * (1 - k) < sum * k / 128 * sqrt(n * square - sum^2) / n,
+        //so black if below < 0, else compare the squares of both sides: no division, no sqrt.
+        for (x = 0; x < width; x++) {
+            double count = task->column_count[x] * rows;
+            double sum = column_sum[x + 2 * radius + 1] - column_sum[x];
+            double square = (double)(long long)(column_square[x + 2 * radius + 1] - column_square[x]);   //signed: one instruction
+            double below = pixel[x] * count - sum * keep;
+            double scale = sum * spread;
+            double variance = count * square - sum * sum;   //n^2 * variance
+            //both tests and no branch: on noisy pixels a branch is mispredicted half the time.
+            int white = (below >= 0) & (below * below * count * count >= scale * scale * variance);
+            pixel[x] = (unsigned char)(-white);
+        }
+    }
+    delete[] column_sum;
+    delete[] column_square;
+}
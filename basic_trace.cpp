@@ -0,0 +1,224 @@
+/* ***************************************************************************
+ functions in this (basic_trace.cpp) cpp file:
+ 
+ (1) void TraceStart (const char* json_path);
+ * Start collecting the stages of TRACE_SCOPE (see struct_TraceScope.h, compiled in with running_trace).
+ * At exit (or <TraceStop>), the trace is saved to json_path (NULL: not saved) and a summary is printed.
+ * Before it (and after <TraceStop>), every probe only checks one flag.
+ 
+ (2) void TraceStop (void);
+ * Stop collecting, then save / print as said in (1). Called at exit by itself.
+ 
+ (3) void TraceSave (const char* json_path);
+ * may throw: WRONG_FILE_PATH.
+ * Save all the stages collected so far as a Chrome trace-event JSON file:
+ * one complete event ("ph": "X") per stage, "ts" and "dur" in microseconds,
+ * one "tid" per thread, bytes / allocations / allocated bytes in "args".
+ * Open it with chrome://tracing or https://ui.perfetto.dev.
+ 
+ (4) void TraceReport (FILE* output);
+ * Print the total time, count, bytes (read + written, and GB/s) and allocations of every stage name.
+ 
+ (5) TraceScope(const char* name, const char* category);
+     ~TraceScope(void);
+     void TraceScope::Next(const char* next_name);
+     static void TraceScope::AddBytes(unsigned long bytes);
+     static void TraceScope::AddAlloc(unsigned long bytes);
+ * A stage starts when it is made, and is recorded when it is destroyed (also by an exception) or at <Next>.
+ * AddBytes / AddAlloc count for the innermost stage of the calling thread (nothing if there is none).
+ 
+ (6) long long trace_now (void);
+ * nanoseconds of a steady clock.
+ 
+ (7) int trace_thread_id (void);
+ * 1, 2, 3 ... in the order the threads record their first stage.
+ *****************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <map>
+#include "const_ErrorCodes.h"
+#include "struct_TraceScope.h"
+
+void TraceStart (const char* json_path);    //basic_trace.cpp
+void TraceStop (void);  //basic_trace.cpp
+void TraceSave (const char* json_path);     //basic_trace.cpp
+void TraceReport (FILE* output);    //basic_trace.cpp
+long long trace_now (void); //basic_trace.cpp
+int trace_thread_id (void); //basic_trace.cpp
+
+typedef struct struct_TraceEvent {
+    const char* name;
+    const char* category;
+    long long start_ns;
+    long long duration_ns;
+    int thread_id;
+    unsigned long bytes;
+    unsigned long alloc_count;
+    unsigned long alloc_bytes;
+} TraceEvent;
+
+static std::vector<TraceEvent> trace_events;
+static std::mutex trace_mutex;
+static std::atomic<bool> trace_enabled(false);
+static std::atomic<int> trace_thread_count(0);
+static long long trace_origin = 0;
+static std::string trace_json_path;
+static bool trace_at_exit = false;
+
+static thread_local TraceScope* trace_current = NULL;
+static thread_local int trace_thread = 0;
+
+void TraceStart (const char* json_path) {
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    
+    trace_json_path = (NULL != json_path) ? json_path : "";
+    if (0 == trace_origin)
+        trace_origin = trace_now();
+    if (!trace_at_exit) {
+        trace_at_exit = true;
+        atexit(TraceStop);
+    }
+    trace_enabled = true;
+}
+
+void TraceStop (void) {
+    std::string json_path;
+    
+    if (!trace_enabled.exchange(false))
+        return;
+    {
+        std::lock_guard<std::mutex> lock(trace_mutex);
+        json_path = trace_json_path;
+    }
+    TraceReport(stdout);
+    if (json_path.empty())
+        return;
+    try {
+        TraceSave(json_path.c_str());
+        printf("trace saved: %s\n", json_path.c_str());
+    } catch (const int error) {
+        fprintf(stderr, "trace: error code: %d\n", error);
+    }
+}
+
+void TraceSave (const char* json_path) {
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    FILE* json_file = fopen(json_path, "w");
+    
+    if (NULL == json_file)
+        throw WRONG_FILE_PATH;
+    
+    fprintf(json_file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    for (size_t i = 0; i < trace_events.size(); i++) {
+        const TraceEvent &event = trace_events[i];
+        fprintf(json_file, "{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %d, "
+                "\"args\": {\"bytes\": %lu, \"allocations\": %lu, \"allocated_bytes\": %lu}}%s\n",
+                event.name, event.category, (event.start_ns - trace_origin) / 1e3, event.duration_ns / 1e3, event.thread_id,
+                event.bytes, event.alloc_count, event.alloc_bytes, i + 1 < trace_events.size() ? "," : "");
+    }
+    fprintf(json_file, "]}\n");
+    if (0 != fclose(json_file))
+        throw WRITE_IN_ERROR;
+}
+
+void TraceReport (FILE* output) {
+    typedef struct struct_TraceTotal {
+        long count;
+        long long duration_ns;
+        unsigned long bytes;
+        unsigned long alloc_count;
+        unsigned long alloc_bytes;
+    } TraceTotal;
+    std::map<std::string, TraceTotal> total_list;
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    
+    for (size_t i = 0; i < trace_events.size(); i++) {
+        const TraceEvent &event = trace_events[i];
+        TraceTotal &total = total_list[std::string(event.category) + "/" + event.name];
+        total.count++;
+        total.duration_ns += event.duration_ns;
+        total.bytes += event.bytes;
+        total.alloc_count += event.alloc_count;
+        total.alloc_bytes += event.alloc_bytes;
+    }
+    
+    fprintf(output, "%-36s %8s %12s %14s %8s %8s %14s\n", "stage", "count", "time(ms)", "bytes", "GB/s", "allocs", "alloc bytes");
+    for (std::map<std::string, TraceTotal>::iterator it = total_list.begin(); it != total_list.end(); ++it) {
+        const TraceTotal &total = it->second;
+        fprintf(output, "%-36s %8ld %12.3f %14lu %8.3f %8lu %14lu\n", it->first.c_str(), total.count, total.duration_ns / 1e6,
+                total.bytes, total.duration_ns > 0 ? (double)total.bytes / total.duration_ns : 0.0, total.alloc_count, total.alloc_bytes);
+    }
+}
+
+TraceScope::struct_TraceScope(const char* name, const char* category) {
+    this->name = name;
+    this->category = category;
+    bytes = 0;
+    alloc_count = 0;
+    alloc_bytes = 0;
+    parent = NULL;
+    start_ns = -1;
+    if (!trace_enabled.load(std::memory_order_relaxed))
+        return;
+    
+    parent = trace_current;
+    trace_current = this;
+    start_ns = trace_now();
+}
+
+TraceScope::~struct_TraceScope(void) {
+    if (start_ns < 0)
+        return;
+    Next(NULL);
+    trace_current = parent;
+}
+
+void TraceScope::Next(const char* next_name) {
+    long long end_ns;
+    
+    if (start_ns < 0)
+        return;
+    end_ns = trace_now();
+    if (0 == trace_thread)
+        trace_thread = trace_thread_id();
+    
+    if (trace_enabled.load(std::memory_order_relaxed)) {
+        TraceEvent event = {name, category, start_ns, end_ns - start_ns, trace_thread, bytes, alloc_count, alloc_bytes};
+        std::lock_guard<std::mutex> lock(trace_mutex);
+        trace_events.push_back(event);
+    }
+    
+    if (NULL != next_name) {
+        name = next_name;
+        bytes = 0;
+        alloc_count = 0;
+        alloc_bytes = 0;
+        start_ns = trace_now();
+    }
+}
+
+void TraceScope::AddBytes(unsigned long bytes) {
+    if (NULL != trace_current)
+        trace_current->bytes += bytes;
+}
+
+void TraceScope::AddAlloc(unsigned long bytes) {
+    if (NULL != trace_current) {
+        trace_current->alloc_count++;
+        trace_current->alloc_bytes += bytes;
+    }
+}
+
+long long trace_now (void) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int trace_thread_id (void) {
+    return ++trace_thread_count;
+}
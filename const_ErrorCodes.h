@@ -10,4 +10,19 @@
 #define FILE_DAMAGED    0x00010004
 #define WRITE_IN_ERROR  0x00010005
 
+//errors in StreamTrans (0x0002----)
+#define STREAM_TOO_MANY_OPS     0x00020001
+#define STREAM_TOO_MANY_ZOOM    0x00020002
+
+//errors in PipelineTrans (0x0003----)
+#define PIPELINE_TOO_MANY_OPS   0x00030001
+
+//errors in BatchTrans (0x0004----)
+#define BATCH_BAD_OPS           0x00040001
+#define BATCH_EXCEPTION         0x00040002  //a std::exception (e.g. std::bad_alloc) failed one file
+
+//errors in BitMapImg (0x0005----)
+#define IMG_BAD_CHANNEL         0x00050001  //a PixelBuffer of other than 1 or 3 channels
+#define IMG_NOT_GRAY            0x00050002  //an operation only for gray images (SetPacked(true)) on a color one
+
 #endif /* const_ErrorCodes_h */
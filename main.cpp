@@ -17,6 +17,63 @@ int main (int argc, const char * argv[]) {
     char read_path[70] = {'\0'};
     char save_path[70] = {'\0'};
     
+#ifdef running_trace
+    TraceStart("trace.json");   //saved at exit, see basic_trace.cpp.
+#endif
+    
+    if (argc > 1 && 0 == strcmp(argv[1], "--bench")) {
+        //benchmark: main --bench [-m max_megapixels] [-f filter] [-o json_file] [-j threads], see Benchmark_Class.hpp.
+        double max_megapixels = 12;
+        const char* filter = "";
+        const char* json_path = NULL;
+        for (i = 2; i + 1 < argc; i += 2) {
+            if (0 == strcmp(argv[i], "-m"))
+                max_megapixels = atof(argv[i + 1]);
+            else if (0 == strcmp(argv[i], "-f"))
+                filter = argv[i + 1];
+            else if (0 == strcmp(argv[i], "-o"))
+                json_path = argv[i + 1];
+            else if (0 == strcmp(argv[i], "-j"))
+                SetThreadCount(atoi(argv[i + 1]));
+        }
+        initial();
+        Benchmark bench(max_megapixels, filter);
+        try {
+            bench.Run();
+            if (NULL != json_path)
+                bench.SaveJson(json_path);
+        } catch (const int error0) {
+            std::cerr << "error code: " << error0 << std::endl;
+            exit(1);
+        }
+        return 0;
+    }
+    
+    if (argc > 1) {
+        //batch: main <op_chain> <save_dir> <input> ... [-j threads], see BatchTrans_Class.hpp.
+        if (argc < 4) {
+            std::cerr << "usage: " << argv[0] << " <op_chain> <save_dir> <bmp file | directory | @list_file> ... [-j threads]" << std::endl;
+            std::cerr << "  e.g. " << argv[0] << " gray,stretch:exp:128:2:0.6,zoom:1920x1080:bicubic out/ in/" << std::endl;
+            std::cerr << "   or: " << argv[0] << " --bench [-m max_megapixels] [-f filter] [-o json_file] [-j threads]" << std::endl;
+            return 1;
+        }
+        initial();
+        BatchTrans batch((char*)argv[2]);
+        try {
+            batch.SetOps(argv[1]);
+            for (i = 3; i < argc; i++) {
+                if (0 == strcmp(argv[i], "-j") && i + 1 < argc)
+                    SetThreadCount(atoi(argv[++i]));
+                else
+                    batch.AddInput(argv[i]);
+            }
+        } catch (const int error0) {
+            std::cerr << "error code: " << error0 << std::endl;
+            exit(1);
+        }
+        return batch.Run() > 0 ? 1 : 0;
+    }
+    
     std::cout << "input a read_path：";
     i = (int)strlen(read_path);
     ch = fgetc(stdin);
@@ -53,13 +110,14 @@ int main (int argc, const char * argv[]) {
     }
     
     BitMapImg *temp = new BitMapImg(buffer);
-    ColorTrans *ptr = new ColorTrans(*temp);
+    ColorTrans *ptr = new ColorTrans(std::move(*temp));
+    delete temp;
     temp = NULL;
     
     ptr->ExponentStretch(128, 2, 0.6);
     
     try {
-        SaveBmp(save_path, ptr->TransToBmp());
+        ptr->SaveToBmp(save_path);
     } catch (const int error2) {
         std::cerr << "error code: " << error2 << std::endl;
         exit(1);
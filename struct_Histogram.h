@@ -0,0 +1,18 @@
+#ifndef struct_Histogram_h
+#define struct_Histogram_h
+//statistics of the pixels of an image, see basic_histogram.cpp.
+
+typedef struct struct_Histogram {
+    int channel_count;  //1: gray; 3: B, G, R.
+    unsigned long pixel_count;
+    unsigned long count[3][256];    //count[c][v]: pixels with value v in channel c.
+} Histogram;
+
+typedef struct struct_ChannelStats {
+    int min;
+    int max;
+    double mean;
+    double stddev;
+} ChannelStats;
+
+#endif /* struct_Histogram_h */
@@ -0,0 +1,17 @@
+#ifndef struct_ImgBand_h
+#define struct_ImgBand_h
+//a horizontal band (some continuous rows) of a standardized bitmap_array.
+
+typedef struct struct_ImgBand {
+    unsigned char* band_array;  //pixels of row <first_row> ... row <last_row - 1>, <stride> bytes apart.
+    long width;     //of the whole image
+    long height;    //of the whole image
+    int pixel_byte; //1: gray; 3: B, G, R.
+    long first_row;
+    long last_row;
+    long first_col; //kernels only fill columns [first_col, last_col) of the band,
+    long last_col;  //usually [0, width).
+    long stride;    //bytes from a row to the next: width * pixel_byte, or more for a plane (see BitMapImg <PlaneStride>).
+} ImgBand;
+
+#endif /* struct_ImgBand_h */
@@ -0,0 +1,20 @@
+#ifndef struct_PixelAllocator_h
+#define struct_PixelAllocator_h
+//where the pixel buffers (bitmap_array, bmp_data_array ...) come from, see basic_pixel_pool.cpp.
+
+typedef struct struct_PixelAllocator {
+    unsigned char* (*allocate)(unsigned long size_byte, void* context);    //NULL: out of memory.
+    void (*release)(unsigned char* buffer, void* context);  //buffer is never NULL.
+    void* context;
+} PixelAllocator;
+
+typedef struct struct_PixelPoolStats {
+    unsigned long request_count;    //<PixelAlloc>
+    unsigned long hit_count;        //served by a recycled buffer
+    unsigned long release_count;    //<PixelFree>
+    unsigned long system_bytes;     //allocated from the system, in all
+    unsigned long cached_bytes;     //recycled buffers waiting now
+    unsigned long peak_cached_bytes;
+} PixelPoolStats;
+
+#endif /* struct_PixelAllocator_h */
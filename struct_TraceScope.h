@@ -0,0 +1,36 @@
+#ifndef struct_TraceScope_h
+#define struct_TraceScope_h
+//a timed stage of the hot path (file open, header, decode, each transform, encode, write ...),
+//collected by basic_trace.cpp and saved as a Chrome trace-event JSON file (chrome://tracing, Perfetto).
+
+//#define running_trace   //compile the TRACE_xxx probes in; without it they are empty and cost nothing.
+
+typedef struct struct_TraceScope {
+    const char* name;       //string literals only, they are kept until <TraceSave>.
+    const char* category;
+    long long start_ns;
+    unsigned long bytes;    //processed in this stage, see TRACE_BYTES
+    unsigned long alloc_count;  //allocations made in this stage, see TRACE_ALLOC
+    unsigned long alloc_bytes;
+    struct struct_TraceScope* parent;   //the stage this one is inside, in the same thread.
+    
+    struct_TraceScope(const char* name, const char* category);
+    ~struct_TraceScope(void);
+    void Next(const char* next_name);   //end this stage and start the next one of the same category.
+    static void AddBytes(unsigned long bytes);
+    static void AddAlloc(unsigned long bytes);
+} TraceScope;
+
+#ifdef running_trace
+    #define TRACE_SCOPE(name, category) TraceScope trace_scope(name, category)
+    #define TRACE_NEXT(name)    trace_scope.Next(name)
+    #define TRACE_BYTES(bytes)  TraceScope::AddBytes(bytes)
+    #define TRACE_ALLOC(bytes)  TraceScope::AddAlloc(bytes)
+#else
+    #define TRACE_SCOPE(name, category)
+    #define TRACE_NEXT(name)
+    #define TRACE_BYTES(bytes)
+    #define TRACE_ALLOC(bytes)
+#endif
+
+#endif /* struct_TraceScope_h */
@@ -1,6 +1,9 @@
 #ifndef struct_bmpFileStructure_h
 #define struct_bmpFileStructure_h
 
+#include <cstddef>
+#include "const_bmpSystem.h"
+
 #if 64 == __WORDSIZE
     typedef unsigned short u_word2;
     typedef short word2;
@@ -51,8 +54,24 @@ typedef struct struct_bmpData {
     long bmp_Width;
     long bmp_Height;
     unsigned short bmp_BitCount;
+    u_word4 bmp_Compression = BI_RGB;   //BI_RGB, or BI_RLE8 / BI_RLE4: bmp_data_array is the compressed stream.
     RgbQuad* bmp_color_table;
     unsigned char* bmp_data_array;
+    unsigned long bmp_data_length = 0;  //bytes of bmp_data_array
+    u_word4 bmp_Masks[3] = {0, 0, 0};   //BI_BITFIELDS (16 or 32-bit) only: masks of R, G, B in a pixel.
+    unsigned char* bmp_mapped_base = NULL;  //not NULL: the two arrays above point into this file mapping.
+    unsigned long bmp_mapped_length = 0;
+    //with the defaults above, a bmpData filled by hand (size, bit count, color table, data) is a plain unmapped BI_RGB image.
 } bmpData;
 
+typedef struct struct_BitFieldTable {
+    //channel c (0: B, 1: G, 2: R) of a 16 or 32-bit pixel: bits = (pixel >> shift[c]) & mask[c] (8 bits at most),
+    //repeated to fill 8 bits: (bits * multiply[c]) >> scale_shift[c], which is expand[c][bits] too.
+    int shift[3];
+    u_word4 mask[3];
+    int multiply[3];
+    int scale_shift[3];
+    unsigned char expand[3][256];
+} BitFieldTable;
+
 #endif /* struct_bmpFileStructure_h */
@@ -0,0 +1,238 @@
+/* ***************************************************************************
+ functions in this (test_rotate.cpp) cpp file:
+ 
+ Build and run (from this directory):
+     g++ -std=c++11 -O2 -I.. test_rotate.cpp ../basic_*.cpp -pthread -o test_rotate && ./test_rotate
+ Exit code 0: every rotation below gave the expected pixels; 1: a mismatch (printed).
+ 
+ (1) int main (void);
+ * For gray and BGR images of several sizes, every angle of test_degrees, cut or not:
+ * Rotate(degree, 1) must give the same bytes as <original_neighbor>,
+ * Rotate(degree, 2 / 3) must take color_default exactly at the pixels out of the window of <inside_window>.
+ 
+ (2) static void original_neighbor (const unsigned char* org_array, long width, long height, int pixel_byte,
+                                     double degree, unsigned char color_default, bool cut,
+                                     unsigned char* &out_array, long &out_width, long &out_height);
+ * The Rotate_Neighbor GeometryTrans had before the tiled DDA kernels (a new[] out_array).
+ 
+ (3) static int inside_window (double u, double v, long width, long height, double low, double high_margin);
+ * 1: low <= u < width - high_margin and low <= v < height - high_margin, 0: out of it,
+ * -1: u or v is within 1e-6 of an edge of the window (not checked, the fixed point may go either way).
+ 
+ (4) static bool rotate_file (const char* path, double degree, int algorithm, unsigned char color_default, bool cut,
+                              bmpData &output);
+ * ReadBmp the file, Rotate it with GeometryTrans, output: <TransToBmp> (free it with DeleteBmpData).
+ 
+ (5) static void make_image (unsigned char* array, long width, long height, bool gray, int low, int high);
+ * Bytes in [low, high], B == G == R for gray, the same bytes in every run.
+ *****************************************************************************/
+
+#include "top_index.h"
+#include <cmath>
+
+#define TEST_FILE       "test_rotate.tmp.bmp"
+#define TEST_SIZES      7
+#define TEST_DEGREES    16
+
+static const long test_width[TEST_SIZES] = {1, 2, 5, 37, 64, 301, 1500};
+static const long test_height[TEST_SIZES] = {1, 1, 3, 23, 40, 199, 1100};
+static const double test_degrees[TEST_DEGREES] = {30, -20, 200, 45, -45, 1, 0.5, 0.001, 12.25, 60, 89, 91, 135.5, 179.9, 271, 333};
+
+static void original_neighbor (const unsigned char* org_array, long width, long height, int pixel_byte,
+                               double degree, unsigned char color_default, bool cut,
+                               unsigned char* &out_array, long &out_width, long &out_height);
+static int inside_window (double u, double v, long width, long height, double low, double high_margin);
+static bool rotate_file (const char* path, double degree, int algorithm, unsigned char color_default, bool cut,
+                         bmpData &output);
+static void make_image (unsigned char* array, long width, long height, bool gray, int low, int high);
+
+int main (void) {
+    long checks = 0;
+    bool passed = true;
+    
+    initial();
+    for (int size = 0; size < TEST_SIZES; size++) {
+        long width = test_width[size], height = test_height[size];
+        long line_byte = (width * 3 + 3) / 4 * 4;
+        
+        for (int gray = 0; gray <= 1; gray++) {
+            int pixel_byte = gray ? 1 : 3;
+            unsigned char* org_array = new unsigned char[width * height * 3];
+            bmpData org_bmp;
+            
+            //(1) nearest: any bytes; (2) interpolation: 100 ~ 150, never color_default (0).
+            for (int pass = 0; pass < 2; pass++) {
+                make_image(org_array, width, height, gray, pass ? 100 : 0, pass ? 150 : 255);
+                org_bmp.bmp_Width = width;
+                org_bmp.bmp_Height = height;
+                org_bmp.bmp_BitCount = 24;
+                org_bmp.bmp_color_table = NULL;
+                org_bmp.bmp_data_array = PixelAlloc(line_byte * height);
+                memset(org_bmp.bmp_data_array, 0, line_byte * height);
+                for (long y = 0; y < height; y++)
+                    memcpy(org_bmp.bmp_data_array + y * line_byte, org_array + y * width * 3, width * 3);
+                SaveBmp((char*)TEST_FILE, org_bmp);   //frees bmp_data_array (by PixelFree)
+                if (gray) {
+                    for (long i = 0; i < width * height; i++)
+                        org_array[i] = org_array[i * 3];
+                }
+                
+                for (int d = 0; d < TEST_DEGREES; d++) {
+                    for (int cut = 0; cut <= 1; cut++) {
+                        double degree = test_degrees[d];
+                        bmpData output;
+                        
+                        if (0 == pass) {
+                            unsigned char* expected;
+                            long out_width, out_height;
+                            
+                            original_neighbor(org_array, width, height, pixel_byte, degree, 7, cut, expected, out_width, out_height);
+                            if (rotate_file(TEST_FILE, degree, 1, 7, cut, output)) {
+                                long out_line = (out_width * pixel_byte + 3) / 4 * 4;
+                                bool same = (output.bmp_Width == out_width && output.bmp_Height == out_height);
+                                
+                                for (long y = 0; same && y < out_height; y++)
+                                    same = (0 == memcmp(output.bmp_data_array + y * out_line, expected + y * out_width * pixel_byte, out_width * pixel_byte));
+                                if (!same) {
+                                    printf("Rotate(%g, 1) %ldx%ld %s cut %d: differs from the original nearest neighbour\n",
+                                           degree, width, height, gray ? "gray" : "BGR", cut);
+                                    passed = false;
+                                }
+                                DeleteBmpData(output);
+                            }
+                            delete [] expected;
+                            checks++;
+                            continue;
+                        }
+                        
+                        for (int algorithm = 2; algorithm <= 3; algorithm++) {
+                            double low = (2 == algorithm) ? 0 : 1, high_margin = (2 == algorithm) ? 1 : 2;
+                            double sin_d = sin(2 * (4 * atan(1)) * degree / 360);
+                            double cos_d = cos(2 * (4 * atan(1)) * degree / 360);
+                            double temp1, temp2;
+                            long out_line, bad = 0;
+                            
+                            if (!rotate_file(TEST_FILE, degree, algorithm, 0, cut, output))
+                                continue;
+                            temp1 = -0.5 * (output.bmp_Width - 1) * cos_d + 0.5 * (output.bmp_Height - 1) * sin_d + 0.5 * (width - 1);
+                            temp2 = -0.5 * (output.bmp_Width - 1) * sin_d - 0.5 * (output.bmp_Height - 1) * cos_d + 0.5 * (height - 1);
+                            out_line = (output.bmp_Width * pixel_byte + 3) / 4 * 4;
+                            for (long y = 0; y < output.bmp_Height; y++) {
+                                for (long x = 0; x < output.bmp_Width; x++) {
+                                    int inside = inside_window(x * cos_d - y * sin_d + temp1, x * sin_d + y * cos_d + temp2,
+                                                               width, height, low, high_margin);
+                                    bool filled = true;
+                                    
+                                    for (int i = 0; i < pixel_byte; i++)
+                                        filled &= (0 == output.bmp_data_array[y * out_line + x * pixel_byte + i]);
+                                    if (inside >= 0 && filled == (1 == inside))
+                                        bad++;
+                                }
+                            }
+                            if (bad) {
+                                printf("Rotate(%g, %d) %ldx%ld %s cut %d: %ld pixels on the wrong side of the window edge\n",
+                                       degree, algorithm, width, height, gray ? "gray" : "BGR", cut, bad);
+                                passed = false;
+                            }
+                            DeleteBmpData(output);
+                            checks++;
+                        }
+                    }
+                }
+            }
+            delete [] org_array;
+        }
+    }
+    remove(TEST_FILE);
+    
+    printf("%ld checks, %s\n", checks, passed ? "all passed" : "FAILED");
+    return passed ? 0 : 1;
+}
+
+static void original_neighbor (const unsigned char* org_array, long width, long height, int pixel_byte,
+                               double degree, unsigned char color_default, bool cut,
+                               unsigned char* &out_array, long &out_width, long &out_height) {
+    long org_x, org_y;
+    long x, y;
+    double before_edge_x[4], before_edge_y[4];
+    double after_edge_x[4], after_edge_y[4];
+    double temp1, temp2;
+    
+    double sin_d = sin(2 * (4 * atan(1)) * degree / 360);
+    double cos_d = cos(2 * (4 * atan(1)) * degree / 360);
+    before_edge_x[0] = - ((double)width  - 1) / 2;
+    before_edge_y[0] =   ((double)height - 1) / 2;
+    before_edge_x[1] =   ((double)width  - 1) / 2;
+    before_edge_y[1] =   ((double)height - 1) / 2;
+    before_edge_x[2] = - ((double)width  - 1) / 2;
+    before_edge_y[2] = - ((double)height - 1) / 2;
+    before_edge_x[3] =   ((double)width  - 1) / 2;
+    before_edge_y[3] = - ((double)height - 1) / 2;
+    for (int i = 0; i < 4; i++) {
+        after_edge_x[i] =  cos_d * before_edge_x[i] + sin_d * before_edge_y[i];
+        after_edge_y[i] = -sin_d * before_edge_x[i] + cos_d * before_edge_y[i];
+    }
+    
+    if (cut) {
+        out_width = (long)(MIN(fabs(after_edge_x[3] - after_edge_x[0]), fabs(after_edge_x[2] - after_edge_x[1])) + 0.5);
+        out_height = (long)(MIN(fabs(after_edge_y[3] - after_edge_y[0]), fabs(after_edge_y[2] - after_edge_y[1])) + 0.5);
+    }
+    else {
+        out_width = (long)(MAX(fabs(after_edge_x[3] - after_edge_x[0]), fabs(after_edge_x[2] - after_edge_x[1])) + 0.5);
+        out_height = (long)(MAX(fabs(after_edge_y[3] - after_edge_y[0]), fabs(after_edge_y[2] - after_edge_y[1])) + 0.5);
+    }
+    
+    out_array = new unsigned char[out_height * out_width * pixel_byte + 1];
+    temp1 = -0.5 * (out_width - 1) * cos_d + 0.5 * (out_height - 1) * sin_d + 0.5 * (width - 1);
+    temp2 = -0.5 * (out_width - 1) * sin_d - 0.5 * (out_height - 1) * cos_d + 0.5 * (height - 1);
+    
+    for (y = 0; y < out_height; y++) {
+        for (x = 0; x < out_width; x++) {
+            org_x = (long)(x * cos_d - y * sin_d + temp1 + 0.5);
+            org_y = (long)(x * sin_d + y * cos_d + temp2 + 0.5);
+            
+            for (int i = 0; i < pixel_byte; i++) {
+                if (org_x >= 0 && org_x < width && org_y >= 0 && org_y < height)
+                    out_array[(y * out_width + x) * pixel_byte + i] = org_array[(org_y * width + org_x) * pixel_byte + i];
+                else
+                    out_array[(y * out_width + x) * pixel_byte + i] = color_default;
+            }
+        }
+    }
+}
+
+static int inside_window (double u, double v, long width, long height, double low, double high_margin) {
+    double edge[4] = {low, width - high_margin, low, height - high_margin};
+    double position[4] = {u, u, v, v};
+    
+    for (int i = 0; i < 4; i++) {
+        if (fabs(position[i] - edge[i]) < 1e-6)
+            return -1;
+    }
+    return (low <= u && u < width - high_margin && low <= v && v < height - high_margin) ? 1 : 0;
+}
+
+static bool rotate_file (const char* path, double degree, int algorithm, unsigned char color_default, bool cut,
+                         bmpData &output) {
+    GeometryTrans* image = new GeometryTrans(ReadBmp((char*)path));
+    
+    image->Rotate(degree, algorithm, color_default, cut);
+    output = image->TransToBmp();
+    delete image;
+    return true;
+}
+
+static void make_image (unsigned char* array, long width, long height, bool gray, int low, int high) {
+    unsigned long long state = 88172645463325252ULL;
+    
+    for (long i = 0; i < width * height * 3; i++) {
+        if (!gray || 0 == i % 3) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            array[i] = (unsigned char)(low + (state >> 24) % (high - low + 1));
+        }
+        else
+            array[i] = array[i - i % 3];
+    }
+}
@@ -0,0 +1,163 @@
+/* ***************************************************************************
+ functions in this (test_simd.cpp) cpp file:
+ 
+ Build and run (from this directory):
+     g++ -std=c++11 -O2 -I.. test_simd.cpp ../basic_*.cpp -pthread -o test_simd && ./test_simd
+ Exit code 0: every SIMD kernel below gave the same bytes as its reference; 1: a mismatch (printed).
+ 
+ (1) int main (void);
+ * For every SIMD level the CPU has (AVX2, SSSE3, none, see <SetSimdLevel>), compare
+ * Reverse_Simd and Binary_Simd (thresholds 0, 1, 128, 255, 256) with Reverse_Scalar and Binary_Scalar,
+ * and ColorToGray_Simd / PlanarToGray_Simd with <original_gray>:
+ * every length 0 ~ 200 (so every tail of 16 / 32 pixels), from every start 0 ~ 63 bytes past a 64-byte boundary,
+ * on random bytes. The bytes before and after the array must not be touched.
+ * Both are also run in place (gray_array == bgr_array / blue), and on all 2^24 colors once.
+ 
+ (2) static bool check (const char* kernel, int level, long length, long offset,
+                        const unsigned char* result, const unsigned char* expected, long byte_count);
+ * Compare byte_count bytes, print the first mismatch.
+ 
+ (3) static void fill_random (unsigned char* array, long byte_count);
+ * xorshift, the same bytes in every run.
+ 
+ (4) static void original_gray (const unsigned char* bgr_array, unsigned char* gray_array, long pixel_count);
+ * The formula ColorTrans::ColorToGray had before the SIMD kernels, the gray result must not change.
+ *****************************************************************************/
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+int GetSimdLevel (void);    //basic_simd.cpp
+void SetSimdLevel (int simd_level); //basic_simd.cpp
+void Reverse_Simd (unsigned char* array, long array_length);    //basic_simd.cpp
+void Binary_Simd (unsigned char* array, long array_length, int threshold);  //basic_simd.cpp
+void ColorToGray_Simd (const unsigned char* bgr_array, unsigned char* gray_array, long pixel_count);    //basic_simd.cpp
+void PlanarToGray_Simd (const unsigned char* blue, const unsigned char* green, const unsigned char* red, unsigned char* gray_array, long pixel_count);  //basic_simd.cpp
+void Reverse_Scalar (unsigned char* array, long array_length);  //basic_simd.cpp
+void Binary_Scalar (unsigned char* array, long array_length, int threshold);    //basic_simd.cpp
+
+#define TEST_MAX_LENGTH 200
+#define TEST_MAX_OFFSET 64
+#define TEST_GUARD      64  //bytes checked after the end of every array
+#define TEST_BUFFER     (TEST_MAX_OFFSET + TEST_MAX_LENGTH * 3 + TEST_GUARD)
+#define TEST_ALL_COLORS (1L << 24)
+
+static const char* level_name[3] = {"none", "SSSE3", "AVX2"};
+static const int thresholds[5] = {0, 1, 128, 255, 256};
+
+static bool check (const char* kernel, int level, long length, long offset,
+                   const unsigned char* result, const unsigned char* expected, long byte_count);
+static void fill_random (unsigned char* array, long byte_count);
+static void original_gray (const unsigned char* bgr_array, unsigned char* gray_array, long pixel_count);
+
+int main (void) {
+    alignas(64) static unsigned char source[TEST_BUFFER];
+    alignas(64) static unsigned char result[TEST_BUFFER];
+    alignas(64) static unsigned char expected[TEST_BUFFER];
+    unsigned char planar_bgr[TEST_MAX_LENGTH * 3];
+    std::vector<unsigned char> all_colors(TEST_ALL_COLORS * 3), all_gray(TEST_ALL_COLORS), all_expected(TEST_ALL_COLORS);
+    std::vector<unsigned char> all_planes(TEST_ALL_COLORS * 3);
+    long length, offset, checks = 0;
+    bool passed = true;
+    
+    fill_random(source, TEST_BUFFER);
+    for (long color = 0; color < TEST_ALL_COLORS; color++) {
+        all_colors[color * 3] = (unsigned char)color;
+        all_colors[color * 3 + 1] = (unsigned char)(color >> 8);
+        all_colors[color * 3 + 2] = (unsigned char)(color >> 16);
+        for (int c = 0; c < 3; c++)
+            all_planes[c * TEST_ALL_COLORS + color] = all_colors[color * 3 + c];
+    }
+    original_gray(all_colors.data(), all_expected.data(), TEST_ALL_COLORS);
+    
+    //from what the CPU has down to the scalar loop only.
+    for (int level = GetSimdLevel(); level >= 0; level--) {
+        SetSimdLevel(level);
+        for (length = 0; length <= TEST_MAX_LENGTH; length++) {
+            for (offset = 0; offset < TEST_MAX_OFFSET; offset++) {
+                memcpy(result, source, TEST_BUFFER);
+                memcpy(expected, source, TEST_BUFFER);
+                Reverse_Simd(result + offset, length);
+                Reverse_Scalar(expected + offset, length);
+                passed &= check("Reverse", level, length, offset, result, expected, TEST_BUFFER);
+                
+                for (int t = 0; t < 5; t++) {
+                    memcpy(result, source, TEST_BUFFER);
+                    memcpy(expected, source, TEST_BUFFER);
+                    Binary_Simd(result + offset, length, thresholds[t]);
+                    Binary_Scalar(expected + offset, length, thresholds[t]);
+                    passed &= check("Binary", level, length, offset, result, expected, TEST_BUFFER);
+                }
+                
+                memcpy(result, source, TEST_BUFFER);
+                memcpy(expected, source, TEST_BUFFER);
+                ColorToGray_Simd(source + offset, result + offset, length);
+                original_gray(source + offset, expected + offset, length);
+                passed &= check("ColorToGray", level, length, offset, result, expected, TEST_BUFFER);
+                
+                memcpy(result, source, TEST_BUFFER);
+                ColorToGray_Simd(result + offset, result + offset, length);
+                passed &= check("ColorToGray (in place)", level, length, offset, result, expected, TEST_BUFFER);
+                
+                //planes: B at offset, G and R TEST_MAX_LENGTH and 2 * TEST_MAX_LENGTH bytes after it.
+                for (long i = 0; i < length; i++) {
+                    for (int c = 0; c < 3; c++)
+                        planar_bgr[i * 3 + c] = source[offset + c * TEST_MAX_LENGTH + i];
+                }
+                memcpy(result, source, TEST_BUFFER);
+                memcpy(expected, source, TEST_BUFFER);
+                PlanarToGray_Simd(source + offset, source + offset + TEST_MAX_LENGTH, source + offset + 2 * TEST_MAX_LENGTH,
+                                  result + offset, length);
+                original_gray(planar_bgr, expected + offset, length);
+                passed &= check("PlanarToGray", level, length, offset, result, expected, TEST_BUFFER);
+                
+                memcpy(result, source, TEST_BUFFER);
+                PlanarToGray_Simd(result + offset, result + offset + TEST_MAX_LENGTH, result + offset + 2 * TEST_MAX_LENGTH,
+                                  result + offset, length);
+                passed &= check("PlanarToGray (in place)", level, length, offset, result, expected, TEST_BUFFER);
+                checks += 10;
+            }
+        }
+        ColorToGray_Simd(all_colors.data(), all_gray.data(), TEST_ALL_COLORS);
+        passed &= check("ColorToGray (all colors)", level, TEST_ALL_COLORS, 0, all_gray.data(), all_expected.data(), TEST_ALL_COLORS);
+        PlanarToGray_Simd(all_planes.data(), all_planes.data() + TEST_ALL_COLORS, all_planes.data() + 2 * TEST_ALL_COLORS,
+                          all_gray.data(), TEST_ALL_COLORS);
+        passed &= check("PlanarToGray (all colors)", level, TEST_ALL_COLORS, 0, all_gray.data(), all_expected.data(), TEST_ALL_COLORS);
+        checks += 2;
+        printf("simd level %s: %s\n", level_name[level], passed ? "passed" : "FAILED");
+    }
+    SetSimdLevel(2);    //SIMD_AVX2: no limit again
+    
+    printf("%ld checks, %s\n", checks, passed ? "all passed" : "FAILED");
+    return passed ? 0 : 1;
+}
+
+static bool check (const char* kernel, int level, long length, long offset,
+                   const unsigned char* result, const unsigned char* expected, long byte_count) {
+    for (long i = 0; i < byte_count; i++) {
+        if (result[i] != expected[i]) {
+            printf("%s (simd level %s, length %ld, offset %ld): byte %ld is %u, expected %u\n",
+                   kernel, level_name[level], length, offset, i - offset, result[i], expected[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void fill_random (unsigned char* array, long byte_count) {
+    static unsigned long long state = 88172645463325252ULL;
+    
+    for (long i = 0; i < byte_count; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        array[i] = (unsigned char)(state >> 24);
+    }
+}
+
+static void original_gray (const unsigned char* bgr_array, unsigned char* gray_array, long pixel_count) {
+    for (long i = 0; i < pixel_count; i++) {
+        gray_array[i] = 0.3 * bgr_array[i * 3] + 0.59 * bgr_array[i * 3 + 1] + 0.11 * bgr_array[i * 3 + 2];
+    }
+}
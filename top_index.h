@@ -13,19 +13,89 @@
 
 //struct(s) or data type(s):
 #include "struct_bmpFileStructure.h"
+#include "struct_ImgBand.h"
+#include "struct_TraceScope.h"
+#include "struct_PixelAllocator.h"
+#include "struct_Histogram.h"
 
 //function(s):
+#include <cstdio>
 #define MAX(a,b) ((a)>(b)?(a):(b))
 #define MIN(a,b) ((a)<(b)?(a):(b))
 bool get_system_endian (void);  //basic_SetUp.cpp
 void initial (void);    //basic_SetUp.cpp
 bmpData ReadBmp (char* bmp_file_path);  //basic_bmp_io.cpp
-int SaveBmp (char* save_file_path, bmpData bmp_image); //basic_bmp_io.cpp
+int SaveBmp (char* save_file_path, bmpData bmp_image, int compression = BI_RGB); //basic_bmp_io.cpp
+void ReadBmpHeader (FILE* bmp_file, BitMapFileHeader* bmp_file_header, BitMapInfoHeader* bmp_info_header);  //basic_bmp_io.cpp
+bool read_by_byte (void* target, unsigned long size_byte, FILE* source);    //basic_bmp_io.cpp
+void WriteBmpHeader (FILE* bmp_file, long width, long height, unsigned short bit_count,
+                     u_word4 compression = BI_RGB, unsigned long data_byte = 0);    //basic_bmp_io.cpp
 void DeleteBmpData (bmpData bmp_image); //basic_bmp_io.cpp
+bmpData ReadBmp_Mapped (char* bmp_file_path);   //basic_bmp_mmap.cpp
+void UnmapBmpFile (unsigned char* mapped_base, unsigned long mapped_length);    //basic_bmp_mmap.cpp
+int SaveBmp_Gather (char* save_file_path, const unsigned char* bitmap_array, long width, long height,
+                    unsigned short bit_count, bool direct_io);  //basic_bmp_writev.cpp
+void MakeBmpHeader (unsigned char* header, long width, long height, unsigned short bit_count);   //basic_bmp_writev.cpp
+void RleDecode (const unsigned char* rle_array, unsigned long rle_length, int bit_count, long width, long height,
+                const unsigned char* color_list, int pixel_byte, unsigned char* target, long target_stride, bool* used);  //basic_bmp_rle.cpp
+unsigned long RleEncode (const unsigned char* data_array, long line_byte, int bit_count, long width, long height,
+                         unsigned char* rle_array);  //basic_bmp_rle.cpp
+unsigned long RleBound (long width, long height);   //basic_bmp_rle.cpp
+unsigned char* PixelAlloc (unsigned long size_byte);    //basic_pixel_pool.cpp
+void PixelFree (unsigned char* buffer); //basic_pixel_pool.cpp
+void SetPixelAllocator (const PixelAllocator* allocator);   //basic_pixel_pool.cpp
+void PixelPoolStatsOf (PixelPoolStats* stats);  //basic_pixel_pool.cpp
+void PixelPoolReport (FILE* output);    //basic_pixel_pool.cpp
+void PixelPoolTrim (void);  //basic_pixel_pool.cpp
+void SetThreadCount (int thread_count);     //basic_thread_pool.cpp
+int GetThreadCount (void);  //basic_thread_pool.cpp
+void RunTiles (long tile_count, void (*tile_function)(long tile_index, void* context), void* context);  //basic_thread_pool.cpp
+int GetSimdLevel (void);    //basic_simd.cpp
+void SetSimdLevel (int simd_level); //basic_simd.cpp
+void Reverse_Simd (unsigned char* array, long array_length);    //basic_simd.cpp
+void Binary_Simd (unsigned char* array, long array_length, int threshold);  //basic_simd.cpp
+void ColorToGray_Simd (const unsigned char* bgr_array, unsigned char* gray_array, long pixel_count);    //basic_simd.cpp
+void ApplyLut_Simd (unsigned char* array, long array_length, const unsigned char* lut); //basic_simd.cpp
+void VerticalSum_Simd (const short* const* rows, const short* weights, int taps, long length, unsigned char* result, int shift);    //basic_simd.cpp
+void Transpose16_Simd (const unsigned char* source, long source_stride, unsigned char* target, long target_stride); //basic_simd.cpp
+void Transpose8_BGR_Simd (const unsigned char* source, long source_stride, unsigned char* target, long target_stride);   //basic_simd.cpp
+void DropAlpha_Simd (const unsigned char* bgra_array, unsigned char* bgr_array, long pixel_count);    //basic_simd.cpp
+bool IsGray_Simd (const unsigned char* array, long pixel_count, int pixel_byte);    //basic_simd.cpp
+void Deinterleave_Simd (const unsigned char* bgr_array, unsigned char* blue, unsigned char* green, unsigned char* red, long pixel_count); //basic_simd.cpp
+void Interleave_Simd (const unsigned char* blue, const unsigned char* green, const unsigned char* red, unsigned char* bgr_array, long pixel_count); //basic_simd.cpp
+void PlanarToGray_Simd (const unsigned char* blue, const unsigned char* green, const unsigned char* red, unsigned char* gray_array, long pixel_count);  //basic_simd.cpp
+void Bitfields_Simd (const unsigned char* org_array, unsigned char* bgr_array, long pixel_count, int org_pixel_byte,
+                     const BitFieldTable* fields);  //basic_simd.cpp
+void PackBits_Simd (const unsigned char* array, unsigned char* bits, long pixel_count, int threshold);   //basic_simd.cpp
+void UnpackBits_Simd (const unsigned char* bits, unsigned char* array, long pixel_count); //basic_simd.cpp
+void Lut_Identity (unsigned char* lut);  //basic_lut.cpp
+void Lut_Compose (unsigned char* lut, const unsigned char* next_lut);    //basic_lut.cpp
+void Lut_Reverse (unsigned char* lut);   //basic_lut.cpp
+void Lut_Binary (unsigned char* lut, int threshold); //basic_lut.cpp
+void Lut_LogarithmStretch (unsigned char* lut, double a, double b, double c);    //basic_lut.cpp
+void Lut_ExponentStretch (unsigned char* lut, double a, double b, double c); //basic_lut.cpp
+void Lut_Equalize (unsigned char* lut, const Histogram* histogram);  //basic_lut.cpp
+void Lut_AutoContrast (unsigned char* lut, const Histogram* histogram, double low_percent, double high_percent);   //basic_lut.cpp
+void Histogram_Array (const unsigned char* array, long pixel_count, int pixel_byte, Histogram* histogram);    //basic_histogram.cpp
+void Histogram_Stats (const Histogram* histogram, int channel, ChannelStats* stats);   //basic_histogram.cpp
+int Histogram_Percentile (const Histogram* histogram, int channel, double percent);    //basic_histogram.cpp
+int Histogram_Otsu (const Histogram* histogram, int channel);  //basic_histogram.cpp
+void Histogram_Bits (const unsigned char* bits, long byte_count, long pixel_count, Histogram* histogram);    //basic_histogram.cpp
+void Binary_Sauvola (unsigned char* array, long width, long height, int window, double k);  //basic_threshold.cpp
+void Binary_Bradley (unsigned char* array, long width, long height, int window, double t);  //basic_threshold.cpp
+void TraceStart (const char* json_path);    //basic_trace.cpp
+void TraceStop (void);  //basic_trace.cpp
+void TraceSave (const char* json_path);     //basic_trace.cpp
+void TraceReport (FILE* output);    //basic_trace.cpp
 
 //class(es):
+#include "PixelBuffer_Class.hpp"
 #include "BitMapImg_BaseClass.hpp"
 #include "ColorTrans_Class.hpp"
 #include "GeometryTrans_Class.hpp"
+#include "StreamTrans_Class.hpp"
+#include "PipelineTrans_Class.hpp"
+#include "BatchTrans_Class.hpp"
+#include "Benchmark_Class.hpp"
 
 #endif /* top_index_h */